@@ -0,0 +1,197 @@
+// host_bench_audio: encodes synthetic desktop audio with AudioEncoder at a
+// range of expected loss and prints one JSON report showing how much of the
+// stream can carry Opus in-band FEC (SILK or hybrid frames) and what it costs.
+
+#include "host/AudioEncoder.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QVector>
+#include <cmath>
+
+namespace host::bench {
+
+namespace {
+constexpr int kChannels = 2;
+constexpr double kPi = 3.14159265358979323846;
+
+struct AudioRun {
+    QString workload;
+    int lossPercent = 0;
+    int bitrateKbps = 64;
+    int frameMs = 20;
+    int seconds = 10;
+};
+
+// `frame` holds frameSamples stereo samples starting at sample `start`.
+void synthesize(const QString &workload, qint64 start, int frameSamples, QRandomGenerator &noise,
+                QVector<qint16> &frame) {
+    frame.resize(frameSamples * kChannels);
+    for (int i = 0; i < frameSamples; ++i) {
+        const double t = double(start + i) / AudioEncoder::kSampleRate;
+        double left = 0;
+        double right = 0;
+        if (workload == QLatin1String("speech")) {
+            // A gliding voiced pitch with harmonics, in syllables with short pauses.
+            const double syllable = std::fmod(t, 0.25);
+            const double envelope = syllable < 0.18 ? std::sin(kPi * syllable / 0.18) : 0.0;
+            const double pitch = 140.0 + 30.0 * std::sin(2 * kPi * 0.7 * t);
+            for (int harmonic = 1; harmonic <= 12; ++harmonic) {
+                left += std::sin(2 * kPi * pitch * harmonic * t) / harmonic;
+            }
+            left *= 0.25 * envelope;
+            right = left;
+        } else {
+            // Music: a changing chord with bright partials, panned apart, plus a little noise.
+            static const double kChords[][3] = {{261.6, 329.6, 392.0}, {220.0, 261.6, 329.6}, {196.0, 246.9, 293.7}};
+            const auto &chord = kChords[int(t / 2.0) % 3];
+            for (int note = 0; note < 3; ++note) {
+                for (int partial = 1; partial <= 6; ++partial) {
+                    const double tone = std::sin(2 * kPi * chord[note] * partial * t) / (partial * 3.0);
+                    left += note == 2 ? tone * 0.4 : tone;
+                    right += note == 0 ? tone * 0.4 : tone;
+                }
+            }
+            left = left * 0.2 + (noise.generateDouble() - 0.5) * 0.02;
+            right = right * 0.2 + (noise.generateDouble() - 0.5) * 0.02;
+        }
+        frame[i * 2] = static_cast<qint16>(qBound(-1.0, left, 1.0) * 32767);
+        frame[i * 2 + 1] = static_cast<qint16>(qBound(-1.0, right, 1.0) * 32767);
+    }
+}
+
+QJsonObject runAudio(const AudioRun &run) {
+    QJsonObject result;
+    result.insert(QStringLiteral("workload"), run.workload);
+    result.insert(QStringLiteral("lossPercent"), run.lossPercent);
+    result.insert(QStringLiteral("bitrateKbps"), run.bitrateKbps);
+    result.insert(QStringLiteral("frameMs"), run.frameMs);
+
+    AudioEncoder encoder;
+    AudioEncoder::Config config;
+    config.channels = kChannels;
+    config.bitrateKbps = run.bitrateKbps;
+    if (!encoder.initialize(config)) {
+        result.insert(QStringLiteral("error"), QStringLiteral("encoder unavailable"));
+        return result;
+    }
+    encoder.setExpectedLoss(run.lossPercent);
+
+    const int frameSamples = AudioEncoder::kSampleRate / 1000 * run.frameMs;
+    const int frames = run.seconds * 1000 / run.frameMs;
+    QRandomGenerator noise(20240611);
+    QVector<qint16> pcm;
+    QByteArray packet;
+    int packets = 0;
+    int silkLayerPackets = 0;
+    int dtxPackets = 0;
+    qint64 bytes = 0;
+    qint64 encodeNs = 0;
+    QElapsedTimer timer;
+    for (int frame = 0; frame < frames; ++frame) {
+        synthesize(run.workload, qint64(frame) * frameSamples, frameSamples, noise, pcm);
+        timer.start();
+        if (!encoder.encode(pcm.constData(), frameSamples, packet)) {
+            result.insert(QStringLiteral("error"), QStringLiteral("encode failed"));
+            return result;
+        }
+        encodeNs += timer.nsecsElapsed();
+        if (AudioEncoder::isDtxPacket(packet)) {
+            ++dtxPackets;
+            continue;
+        }
+        ++packets;
+        bytes += packet.size();
+        if (AudioEncoder::hasSilkLayer(packet)) {
+            ++silkLayerPackets;
+        }
+    }
+    result.insert(QStringLiteral("packets"), packets);
+    result.insert(QStringLiteral("dtxPackets"), dtxPackets);
+    result.insert(QStringLiteral("sentKbps"), double(bytes) * 8 / run.seconds / 1000);
+    // With FEC requested, the share of packets that can actually carry it.
+    result.insert(QStringLiteral("silkOrHybridPercent"), packets > 0 ? 100.0 * silkLayerPackets / packets : 0.0);
+    result.insert(QStringLiteral("encodeUsPerFrame"), frames > 0 ? double(encodeNs) / frames / 1000 : 0.0);
+    return result;
+}
+}  // namespace
+
+int run(QCoreApplication &app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("RemoteDesk Host Opus FEC benchmark");
+    parser.addHelpOption();
+    QCommandLineOption workloadOption("workload", "music or speech (repeatable)", "name");
+    QCommandLineOption lossOption("loss", "Expected loss in percent (repeatable)", "percent");
+    QCommandLineOption bitrateOption("bitrate-kbps", "Opus bitrate", "kbps", "64");
+    QCommandLineOption frameOption("frame-ms", "Frame duration: 10, 20, 40 or 60", "ms", "20");
+    QCommandLineOption secondsOption("seconds", "Audio per run", "seconds", "10");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to a file", "path");
+    parser.addOption(workloadOption);
+    parser.addOption(lossOption);
+    parser.addOption(bitrateOption);
+    parser.addOption(frameOption);
+    parser.addOption(secondsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    AudioRun run;
+    run.bitrateKbps = qBound(6, parser.value(bitrateOption).toInt(), 510);
+    run.frameMs = parser.value(frameOption).toInt();
+    if (run.frameMs != 10 && run.frameMs != 20 && run.frameMs != 40 && run.frameMs != 60) {
+        run.frameMs = 20;
+    }
+    run.seconds = qMax(1, parser.value(secondsOption).toInt());
+    QStringList workloads = parser.values(workloadOption);
+    if (workloads.isEmpty()) {
+        workloads = {QStringLiteral("music"), QStringLiteral("speech")};
+    }
+    QList<int> losses;
+    for (const QString &value : parser.values(lossOption)) {
+        losses.append(qBound(0, value.toInt(), 100));
+    }
+    if (losses.isEmpty()) {
+        losses = {0, 2, 5, 10, 20};
+    }
+
+    QJsonArray runs;
+    for (const QString &workload : workloads) {
+        for (const int loss : losses) {
+            run.workload = workload;
+            run.lossPercent = loss;
+            runs.append(runAudio(run));
+        }
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("host_bench_audio"));
+    report.insert(QStringLiteral("secondsPerRun"), run.seconds);
+    report.insert(QStringLiteral("runs"), runs);
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot write " << file.fileName() << Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
+
+}  // namespace host::bench
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    return host::bench::run(app);
+}
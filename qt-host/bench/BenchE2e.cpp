@@ -0,0 +1,458 @@
+// host_bench_e2e: feeds synthetic desktop workloads (or a recorded session)
+// through convert -> encode -> packetize and prints one JSON report.
+
+#include "SyntheticDesktop.h"
+#include "host/QualityMetrics.h"
+#include "host/SessionReplaySource.h"
+#include "host/VideoPipeline.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <vector>
+
+namespace {
+std::atomic<quint64> g_allocations{0};
+}  // namespace
+
+void *operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace host::bench {
+
+namespace {
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+    int bitrateKbps;
+};
+
+constexpr Resolution kResolutions[] = {
+    {"1080p", 1920, 1080, 6000},
+    {"1440p", 2560, 1440, 10000},
+    {"4k", 3840, 2160, 20000},
+};
+
+qint64 percentile(std::vector<qint64> sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+using FrameSource = std::function<bool(qint64 timestampUs, VideoFrame &frame)>;
+
+struct RunConfig {
+    int frames = 300;
+    int fps = 60;
+    int slices = 1;
+    // Pipeline threads; 0 lets the pipeline pick one per core.
+    int threads = 0;
+    qint64 tileCacheBytes = 0;
+    VideoEncoder::Codec codec = VideoEncoder::Codec::H264;
+    PixelFormat format = PixelFormat::I420;
+    // 0 = the resolution's default.
+    int bitrateKbps = 0;
+    // Compare 1 in this many decoded pictures with the source; 0 = off.
+    int qualityInterval = 0;
+    // Static refinement after this long without damage; 0 = off.
+    int refineAfterMs = 0;
+};
+
+const char *codecName(VideoEncoder::Codec codec) { return codec == VideoEncoder::Codec::AV1 ? "av1" : "h264"; }
+
+int defaultBitrateKbps(int width, int height) {
+    for (const Resolution &resolution : kResolutions) {
+        if (width * height <= resolution.width * resolution.height) {
+            return resolution.bitrateKbps;
+        }
+    }
+    return kResolutions[std::size(kResolutions) - 1].bitrateKbps;
+}
+
+// Drives `run.frames` frames from `next` through a fresh pipeline and fills in the
+// measurements. The source itself is not timed.
+void measure(QJsonObject &result, int width, int height, const RunConfig &run, const FrameSource &next) {
+    const int frames = run.frames;
+    const int fps = run.fps;
+    result.insert(QStringLiteral("width"), width);
+    result.insert(QStringLiteral("height"), height);
+
+    VideoPipeline pipeline;
+    VideoPipeline::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = fps;
+    config.bitrateKbps = run.bitrateKbps > 0 ? run.bitrateKbps : defaultBitrateKbps(width, height);
+    config.rtp.ssrc = 0x1234;
+    config.slices = run.slices;
+    config.threads = run.threads;
+    config.tileCacheBytes = run.tileCacheBytes;
+    config.codec = run.codec;
+    config.format = run.format;
+    config.qualitySampleInterval = run.qualityInterval;
+    config.refineAfterMs = run.refineAfterMs;
+    result.insert(QStringLiteral("targetBitrateKbps"), config.bitrateKbps);
+    result.insert(QStringLiteral("codec"), QString::fromLatin1(codecName(run.codec)));
+    result.insert(QStringLiteral("chroma"), run.format == PixelFormat::I444 ? 444 : 420);
+    if (!pipeline.initialize(config)) {
+        result.insert(QStringLiteral("error"), QStringLiteral("encoder unavailable"));
+        return;
+    }
+    result.insert(QStringLiteral("encoder"), pipeline.encoderName());
+    result.insert(QStringLiteral("threads"), pipeline.threadCount());
+
+    VideoFrame frame;
+    QList<QByteArray> packets;
+    std::vector<qint64> latencies;
+    latencies.reserve(static_cast<size_t>(frames));
+    // Time until the first slice could go on the wire; equals the frame
+    // latency when slices is 1.
+    std::vector<qint64> firstSliceLatencies;
+    firstSliceLatencies.reserve(static_cast<size_t>(frames));
+
+    qint64 totalBytes = 0;
+    qint64 totalPackets = 0;
+    qint64 wallNs = 0;
+    std::clock_t cpuTicks = 0;
+    quint64 allocations = 0;
+    int keyFrames = 0;
+    int framesRefined = 0;
+    int refinedKeyFrames = 0;
+    qint64 moves = 0;
+    qint64 tileLookups = 0;
+    qint64 tileHits = 0;
+    int framesFromTiles = 0;
+    QualityScore qualitySum;
+    int qualitySamples = 0;
+    int processed = 0;
+    QElapsedTimer timer;
+
+    for (int i = 0; i < frames; ++i) {
+        const qint64 timestampUs = static_cast<qint64>(i) * 1000000 / fps;
+        if (!next(timestampUs, frame)) {
+            break;
+        }
+        packets.clear();
+
+        const quint64 allocBefore = g_allocations.load(std::memory_order_relaxed);
+        const std::clock_t cpuBefore = std::clock();
+        timer.start();
+        const bool ok = pipeline.process(frame, packets, i == 0);
+        // Local decoding for --quality is not part of the pipeline's cost.
+        const qint64 qualityUs = pipeline.lastTiming().qualityUs;
+        const qint64 elapsedNs = timer.nsecsElapsed() - qualityUs * 1000;
+        cpuTicks += std::clock() - cpuBefore - static_cast<std::clock_t>(qualityUs * CLOCKS_PER_SEC / 1000000);
+        allocations += g_allocations.load(std::memory_order_relaxed) - allocBefore;
+        if (!ok) {
+            result.insert(QStringLiteral("error"), QStringLiteral("encode failed at frame %1").arg(i));
+            return;
+        }
+
+        ++processed;
+        wallNs += elapsedNs;
+        latencies.push_back(elapsedNs / 1000);
+        if (pipeline.lastTiming().packetCount > 0) {
+            firstSliceLatencies.push_back(pipeline.lastTiming().firstSliceUs);
+        }
+        totalBytes += pipeline.lastTiming().encodedBytes;
+        totalPackets += pipeline.lastTiming().packetCount;
+        keyFrames += pipeline.lastTiming().keyFrame ? 1 : 0;
+        if (pipeline.lastTiming().refined) {
+            ++framesRefined;
+            refinedKeyFrames += pipeline.lastTiming().keyFrame ? 1 : 0;
+        }
+        moves += pipeline.lastMoves().size();
+        tileLookups += pipeline.lastTiles().lookups;
+        tileHits += pipeline.lastTiles().hits;
+        framesFromTiles += pipeline.lastTiming().fromTileCache ? 1 : 0;
+        if (const std::optional<QualityScore> &quality = pipeline.lastQuality()) {
+            qualitySum.psnr += quality->psnr;
+            qualitySum.psnrY += quality->psnrY;
+            qualitySum.psnrU += quality->psnrU;
+            qualitySum.psnrV += quality->psnrV;
+            qualitySum.ssim += quality->ssim;
+            qualitySum.ssimY += quality->ssimY;
+            ++qualitySamples;
+        }
+    }
+    if (processed == 0) {
+        result.insert(QStringLiteral("error"), QStringLiteral("no frames"));
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(firstSliceLatencies.begin(), firstSliceLatencies.end());
+    const double seconds = static_cast<double>(wallNs) / 1e9;
+    const double cpuMs = 1000.0 * static_cast<double>(cpuTicks) / CLOCKS_PER_SEC;
+
+    result.insert(QStringLiteral("frames"), processed);
+    result.insert(QStringLiteral("fpsAchieved"), seconds > 0 ? processed / seconds : 0.0);
+    result.insert(QStringLiteral("cpuMsPerFrame"), cpuMs / processed);
+    result.insert(QStringLiteral("bitrateKbps"), static_cast<double>(totalBytes) * 8.0 * fps / processed / 1000.0);
+    result.insert(QStringLiteral("bytesPerFrame"), static_cast<double>(totalBytes) / processed);
+    result.insert(QStringLiteral("packetsPerFrame"), static_cast<double>(totalPackets) / processed);
+    result.insert(QStringLiteral("allocationsPerFrame"), static_cast<double>(allocations) / processed);
+    result.insert(QStringLiteral("keyFrames"), keyFrames);
+    result.insert(QStringLiteral("movesPerFrame"), static_cast<double>(moves) / processed);
+    if (run.tileCacheBytes > 0) {
+        result.insert(QStringLiteral("tileHitRate"),
+                      tileLookups > 0 ? static_cast<double>(tileHits) / static_cast<double>(tileLookups) : 0.0);
+        result.insert(QStringLiteral("framesFromTileCache"), framesFromTiles);
+    }
+    if (run.refineAfterMs > 0) {
+        // A refinement is meant to be an inter frame; refinedKeyFrames should stay 0.
+        result.insert(QStringLiteral("framesRefined"), framesRefined);
+        result.insert(QStringLiteral("refinedKeyFrames"), refinedKeyFrames);
+    }
+    if (run.qualityInterval > 0) {
+        // Means over the sampled pictures; no samples without a decoder.
+        QJsonObject quality;
+        quality.insert(QStringLiteral("samples"), qualitySamples);
+        if (qualitySamples > 0) {
+            quality.insert(QStringLiteral("psnr"), qualitySum.psnr / qualitySamples);
+            quality.insert(QStringLiteral("psnrY"), qualitySum.psnrY / qualitySamples);
+            quality.insert(QStringLiteral("psnrU"), qualitySum.psnrU / qualitySamples);
+            quality.insert(QStringLiteral("psnrV"), qualitySum.psnrV / qualitySamples);
+            quality.insert(QStringLiteral("ssim"), qualitySum.ssim / qualitySamples);
+            quality.insert(QStringLiteral("ssimY"), qualitySum.ssimY / qualitySamples);
+        }
+        result.insert(QStringLiteral("quality"), quality);
+    }
+
+    QJsonObject latency;
+    latency.insert(QStringLiteral("p50"), percentile(latencies, 0.50));
+    latency.insert(QStringLiteral("p90"), percentile(latencies, 0.90));
+    latency.insert(QStringLiteral("p99"), percentile(latencies, 0.99));
+    latency.insert(QStringLiteral("max"), latencies.back());
+    result.insert(QStringLiteral("latencyUs"), latency);
+
+    result.insert(QStringLiteral("slices"), run.slices);
+    QJsonObject firstSlice;
+    firstSlice.insert(QStringLiteral("p50"), percentile(firstSliceLatencies, 0.50));
+    firstSlice.insert(QStringLiteral("p90"), percentile(firstSliceLatencies, 0.90));
+    firstSlice.insert(QStringLiteral("p99"), percentile(firstSliceLatencies, 0.99));
+    result.insert(QStringLiteral("firstSliceUs"), firstSlice);
+}
+
+QJsonObject runSynthetic(SyntheticDesktop::Workload workload, const Resolution &resolution, const RunConfig &run) {
+    QJsonObject result;
+    result.insert(QStringLiteral("workload"), SyntheticDesktop::workloadName(workload));
+    result.insert(QStringLiteral("resolution"), QString::fromLatin1(resolution.name));
+    SyntheticDesktop source(workload, resolution.width, resolution.height);
+    measure(result, resolution.width, resolution.height, run, [&source](qint64 timestampUs, VideoFrame &frame) {
+        source.nextFrame(timestampUs, frame);
+        return true;
+    });
+    return result;
+}
+
+// Replays a SessionRecorder file through the pipeline at full speed.
+QJsonObject runReplay(const QString &path, const RunConfig &run) {
+    QJsonObject result;
+    result.insert(QStringLiteral("workload"), QStringLiteral("replay"));
+    result.insert(QStringLiteral("recording"), path);
+
+    SessionReplaySource replay;
+    if (!replay.open(path)) {
+        result.insert(QStringLiteral("error"), QStringLiteral("cannot open recording"));
+        return result;
+    }
+    VideoFrame first;
+    if (!replay.readNextFrame(first)) {
+        result.insert(QStringLiteral("error"), QStringLiteral("no frames"));
+        return result;
+    }
+    replay.rewind();
+    RunConfig replayRun = run;
+    replayRun.frames = replay.frameCount();
+    measure(result, first.width, first.height, replayRun,
+            [&replay](qint64, VideoFrame &frame) { return replay.readNextFrame(frame); });
+    return result;
+}
+}  // namespace
+
+int run(QCoreApplication &app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("RemoteDesk Host end-to-end pipeline benchmark");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Frames per run", "count", "300");
+    QCommandLineOption fpsOption("fps", "Nominal frame rate used for timestamps and bitrate", "fps", "60");
+    QCommandLineOption workloadOption("workload", "Workload to run (repeatable)", "name");
+    QCommandLineOption resolutionOption("resolution", "1080p, 1440p or 4k (repeatable)", "name");
+    QCommandLineOption replayOption("replay", "Also run a recorded session (SessionRecorder file)", "path");
+    QCommandLineOption slicesOption("slices", "Slices per frame (low-latency mode above 1)", "n", "1");
+    QCommandLineOption threadsOption("threads", "Pipeline threads, 0 = one per core (repeatable: scaling runs)", "n");
+    QCommandLineOption tileCacheOption("tile-cache-mb", "Tile cache budget in MiB (default 0 = off)", "MiB", "0");
+    QCommandLineOption codecOption("codec", "h264 or av1 (repeatable: the first is the baseline)", "name");
+    QCommandLineOption bitrateOption("bitrate-kbps", "Target bitrate (repeatable: one sweep each)", "kbps");
+    QCommandLineOption qualityOption("quality", "Decode locally and score 1 in <n> frames (PSNR/SSIM)", "n", "0");
+    QCommandLineOption chromaOption("chroma", "420, or 444 (AV1 only)", "mode", "420");
+    QCommandLineOption refineOption("refine-after-ms", "Refine a static picture after <ms> (0 = off)", "ms", "0");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to a file", "path");
+    parser.addOption(framesOption);
+    parser.addOption(fpsOption);
+    parser.addOption(workloadOption);
+    parser.addOption(resolutionOption);
+    parser.addOption(replayOption);
+    parser.addOption(slicesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(tileCacheOption);
+    parser.addOption(codecOption);
+    parser.addOption(chromaOption);
+    parser.addOption(bitrateOption);
+    parser.addOption(qualityOption);
+    parser.addOption(refineOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    RunConfig run;
+    run.frames = qMax(1, parser.value(framesOption).toInt());
+    run.fps = qMax(1, parser.value(fpsOption).toInt());
+    run.slices = qBound(1, parser.value(slicesOption).toInt(), 16);
+    run.tileCacheBytes = qBound(0, parser.value(tileCacheOption).toInt(), 4096) * qint64(1024 * 1024);
+    run.qualityInterval = qMax(0, parser.value(qualityOption).toInt());
+    run.refineAfterMs = qBound(0, parser.value(refineOption).toInt(), 60000);
+    QList<int> bitrates;
+    for (const QString &value : parser.values(bitrateOption)) {
+        bitrates.append(qMax(1, value.toInt()));
+    }
+    if (bitrates.isEmpty()) {
+        bitrates.append(0);
+    }
+    run.format = parser.value(chromaOption) == QLatin1String("444") ? PixelFormat::I444 : PixelFormat::I420;
+    QList<int> threadCounts;
+    for (const QString &value : parser.values(threadsOption)) {
+        threadCounts.append(qBound(0, value.toInt(), 64));
+    }
+    if (threadCounts.isEmpty()) {
+        threadCounts.append(0);
+    }
+    QList<VideoEncoder::Codec> codecs;
+    for (const QString &name : parser.values(codecOption)) {
+        if (name == QLatin1String("h264")) {
+            codecs.append(VideoEncoder::Codec::H264);
+        } else if (name == QLatin1String("av1")) {
+            codecs.append(VideoEncoder::Codec::AV1);
+        } else {
+            QTextStream(stderr) << "Unknown codec: " << name << Qt::endl;
+            return 2;
+        }
+    }
+    if (codecs.isEmpty()) {
+        codecs.append(VideoEncoder::Codec::H264);
+    }
+
+    QList<SyntheticDesktop::Workload> workloads;
+    for (const QString &name : parser.values(workloadOption)) {
+        SyntheticDesktop::Workload workload;
+        if (!SyntheticDesktop::workloadFromName(name, workload)) {
+            QTextStream(stderr) << "Unknown workload: " << name << Qt::endl;
+            return 2;
+        }
+        workloads.append(workload);
+    }
+    if (workloads.isEmpty()) {
+        workloads = SyntheticDesktop::allWorkloads();
+    }
+    const QStringList resolutionNames = parser.values(resolutionOption);
+
+    QJsonArray runs;
+    // One sweep per --bitrate-kbps value: with --quality, the points of a rate-distortion curve.
+    for (const int bitrateKbps : bitrates) {
+        run.bitrateKbps = bitrateKbps;
+        for (const Resolution &resolution : kResolutions) {
+            if (!resolutionNames.isEmpty() && !resolutionNames.contains(QString::fromLatin1(resolution.name))) {
+                continue;
+            }
+            for (SyntheticDesktop::Workload workload : workloads) {
+                // Bitrate and CPU of the first --codec at each thread count.
+                QList<QJsonObject> baselines;
+                for (const VideoEncoder::Codec codec : codecs) {
+                    run.codec = codec;
+                    // Speedup is relative to the first --threads value.
+                    double baseFps = 0.0;
+                    for (int t = 0; t < threadCounts.size(); ++t) {
+                        run.threads = threadCounts.at(t);
+                        QJsonObject result = runSynthetic(workload, resolution, run);
+                        const double achieved = result.value(QStringLiteral("fpsAchieved")).toDouble();
+                        if (baseFps <= 0.0) {
+                            baseFps = achieved;
+                        }
+                        result.insert(QStringLiteral("speedup"), baseFps > 0.0 ? achieved / baseFps : 0.0);
+                        if (baselines.size() <= t) {
+                            baselines.append(result);
+                        } else if (!result.contains(QStringLiteral("error"))) {
+                            const QJsonObject &base = baselines.at(t);
+                            for (const char *key : {"bitrateKbps", "cpuMsPerFrame"}) {
+                                const double baseValue = base.value(QLatin1String(key)).toDouble();
+                                const double value = result.value(QLatin1String(key)).toDouble();
+                                result.insert(QLatin1String(key) + QStringLiteral("VsBaseline"),
+                                              baseValue > 0.0 ? value / baseValue : 0.0);
+                            }
+                        }
+                        runs.append(result);
+                    }
+                }
+            }
+        }
+    }
+    for (const QString &path : parser.values(replayOption)) {
+        run.threads = threadCounts.constFirst();
+        run.bitrateKbps = bitrates.constFirst();
+        runs.append(runReplay(path, run));
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("host_bench_e2e"));
+    report.insert(QStringLiteral("fps"), run.fps);
+    report.insert(QStringLiteral("framesPerRun"), run.frames);
+    if (run.qualityInterval > 0) {
+        report.insert(QStringLiteral("qualityAvx2"), qualityMetricsUseAvx2());
+    }
+    report.insert(QStringLiteral("runs"), runs);
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot write " << file.fileName() << Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
+
+}  // namespace host::bench
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    return host::bench::run(app);
+}
@@ -0,0 +1,351 @@
+// host_bench_transfer: streams a file through FileTransfer between two
+// in-process peer connections over the loopback interface and prints one JSON
+// report with throughput and the deepest send buffer seen per run.
+
+#include "common/Protocol.h"
+#include "host/FileTransfer.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QtEndian>
+#include <cstring>
+#include <memory>
+#include <variant>
+
+#include <rtc/rtc.hpp>
+
+namespace host::bench {
+
+namespace {
+namespace json = protocol::json;
+
+constexpr auto kFileName = "bench.bin";
+constexpr int kTimeoutMs = 120000;
+
+struct TransferRun {
+    int chunkBytes = 16 * 1024;
+    qint64 highWatermarkBytes = 1024 * 1024;
+    // Cancel at this share of the file and resume from what arrived; 0 = straight through.
+    int resumePercent = 0;
+};
+
+bool writeSource(const QString &path, qint64 size) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    // Incompressible, and different per block so a misplaced chunk fails verification.
+    QRandomGenerator generator(20240611);
+    QByteArray block(1024 * 1024, Qt::Uninitialized);
+    for (qint64 written = 0; written < size; written += block.size()) {
+        generator.fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / 4);
+        const qint64 length = qMin<qint64>(block.size(), size - written);
+        if (file.write(block.constData(), length) != length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray controlMessage(const char *type, quint32 id, qint64 offset) {
+    QJsonObject message;
+    message.insert(QStringLiteral("t"), QLatin1String(type));
+    message.insert(QLatin1String(json::kFileId), static_cast<qint64>(id));
+    message.insert(QLatin1String(json::kFileName), QLatin1String(kFileName));
+    message.insert(QLatin1String(json::kFileOffset), offset);
+    return QJsonDocument(message).toJson(QJsonDocument::Compact);
+}
+
+// The viewer side, on the main thread; libdatachannel callbacks queue onto it.
+struct Viewer {
+    std::shared_ptr<rtc::DataChannel> channel;
+    QByteArray received;
+    qint64 size = -1;
+    qint64 receivedBytes = 0;
+    quint32 id = 1;
+    qint64 resumedAt = -1;
+    QString error;
+    bool done = false;
+
+    void request(qint64 offset) {
+        channel->send(controlMessage(json::kFileGet, id, offset).toStdString());
+    }
+};
+
+QJsonObject runTransfer(const QString &directory, qint64 size, const TransferRun &run) {
+    QJsonObject result;
+    result.insert(QStringLiteral("chunkBytes"), run.chunkBytes);
+    result.insert(QStringLiteral("highWatermarkBytes"), run.highWatermarkBytes);
+
+    QObject context;
+    QEventLoop loop;
+    FileTransfer transfer;
+    FileTransfer::Config config;
+    config.directory = directory;
+    config.chunkBytes = run.chunkBytes;
+    config.highWatermarkBytes = run.highWatermarkBytes;
+    config.lowWatermarkBytes = run.highWatermarkBytes / 4;
+    transfer.setConfig(config);
+    qint64 maxBuffered = 0;
+
+    // No ICE servers: both ends gather host candidates and meet on this machine.
+    rtc::Configuration rtcConfig;
+    auto hostPeer = std::make_unique<rtc::PeerConnection>(rtcConfig);
+    auto viewerPeer = std::make_unique<rtc::PeerConnection>(rtcConfig);
+    rtc::PeerConnection *host = hostPeer.get();
+    rtc::PeerConnection *viewerConnection = viewerPeer.get();
+    viewerPeer->onLocalDescription([host](rtc::Description description) { host->setRemoteDescription(description); });
+    viewerPeer->onLocalCandidate([host](rtc::Candidate candidate) { host->addRemoteCandidate(candidate); });
+    hostPeer->onLocalDescription(
+        [viewerConnection](rtc::Description description) { viewerConnection->setRemoteDescription(description); });
+    hostPeer->onLocalCandidate(
+        [viewerConnection](rtc::Candidate candidate) { viewerConnection->addRemoteCandidate(candidate); });
+
+    // Host side: the same wiring as WebRtcPeer::attachFileChannel.
+    std::shared_ptr<rtc::DataChannel> hostChannel;
+    hostPeer->onDataChannel([&](std::shared_ptr<rtc::DataChannel> channel) {
+        QMetaObject::invokeMethod(
+            &context,
+            [&, channel]() {
+                hostChannel = channel;
+                std::weak_ptr<rtc::DataChannel> weakChannel = channel;
+                FileTransfer::Transport transport;
+                transport.send = [weakChannel](const QByteArray &message, bool binary) {
+                    const auto channel = weakChannel.lock();
+                    if (!channel || !channel->isOpen()) {
+                        return false;
+                    }
+                    if (binary) {
+                        channel->send(reinterpret_cast<const std::byte *>(message.constData()),
+                                      static_cast<std::size_t>(message.size()));
+                    } else {
+                        channel->send(message.toStdString());
+                    }
+                    return true;
+                };
+                transport.bufferedAmount = [weakChannel, &maxBuffered]() -> qint64 {
+                    const auto channel = weakChannel.lock();
+                    const qint64 buffered = channel ? static_cast<qint64>(channel->bufferedAmount()) : 0;
+                    maxBuffered = qMax(maxBuffered, buffered);
+                    return buffered;
+                };
+                transfer.attach(std::move(transport));
+                channel->setBufferedAmountLowThreshold(static_cast<std::size_t>(config.lowWatermarkBytes));
+                channel->onMessage([&](rtc::message_variant message) {
+                    const bool binary = std::holds_alternative<rtc::binary>(message);
+                    QByteArray bytes;
+                    if (binary) {
+                        const rtc::binary &data = std::get<rtc::binary>(message);
+                        bytes = QByteArray(reinterpret_cast<const char *>(data.data()), static_cast<int>(data.size()));
+                    } else {
+                        bytes = QByteArray::fromStdString(std::get<std::string>(message));
+                    }
+                    QMetaObject::invokeMethod(
+                        &context, [&, bytes, binary]() { transfer.handleMessage(bytes, binary); },
+                        Qt::QueuedConnection);
+                });
+                channel->onBufferedAmountLow([&]() {
+                    QMetaObject::invokeMethod(&context, [&]() { transfer.pump(); }, Qt::QueuedConnection);
+                });
+            },
+            Qt::QueuedConnection);
+    });
+
+    Viewer viewer;
+    QElapsedTimer elapsed;
+    auto handleViewerMessage = [&](const QByteArray &bytes, bool binary) {
+        if (viewer.done) {
+            return;
+        }
+        if (!binary) {
+            const QJsonObject message = QJsonDocument::fromJson(bytes).object();
+            const QString type = message.value(QStringLiteral("t")).toString();
+            const auto id = static_cast<quint32>(message.value(QLatin1String(json::kFileId)).toInteger());
+            if (type == QLatin1String(json::kFileHeader) && id == viewer.id && viewer.size < 0) {
+                viewer.size = message.value(QLatin1String(json::kFileSize)).toInteger();
+                viewer.received.resize(viewer.size);
+            } else if (type == QLatin1String(json::kFileDone) && id == viewer.id) {
+                viewer.done = true;
+                loop.quit();
+            } else if (type == QLatin1String(json::kFileError)) {
+                viewer.error = message.value(QLatin1String(json::kMessage)).toString();
+                loop.quit();
+            }
+            return;
+        }
+        const auto *header = reinterpret_cast<const uchar *>(bytes.constData());
+        const quint32 id = qFromBigEndian<quint32>(header);
+        const auto offset = static_cast<qint64>(qFromBigEndian<quint64>(header + 4));
+        const qint64 length = bytes.size() - json::kFileChunkHeader;
+        if (id != viewer.id) {
+            // In flight when the first request was cancelled.
+            return;
+        }
+        if (offset != viewer.receivedBytes || offset + length > viewer.size) {
+            viewer.error = QStringLiteral("chunk at %1, expected %2").arg(offset).arg(viewer.receivedBytes);
+            loop.quit();
+            return;
+        }
+        memcpy(viewer.received.data() + offset, bytes.constData() + json::kFileChunkHeader,
+               static_cast<size_t>(length));
+        viewer.receivedBytes += length;
+        if (run.resumePercent > 0 && viewer.resumedAt < 0 &&
+            viewer.receivedBytes >= viewer.size * run.resumePercent / 100) {
+            viewer.resumedAt = viewer.receivedBytes;
+            viewer.channel->send(controlMessage(json::kFileCancel, viewer.id, 0).toStdString());
+            ++viewer.id;
+            viewer.request(viewer.receivedBytes);
+        }
+    };
+
+    viewer.channel = viewerPeer->createDataChannel(json::kFileChannelName);
+    viewer.channel->onOpen([&]() {
+        QMetaObject::invokeMethod(
+            &context,
+            [&]() {
+                elapsed.start();
+                viewer.request(0);
+            },
+            Qt::QueuedConnection);
+    });
+    viewer.channel->onMessage([&](rtc::message_variant message) {
+        const bool binary = std::holds_alternative<rtc::binary>(message);
+        QByteArray bytes;
+        if (binary) {
+            const rtc::binary &data = std::get<rtc::binary>(message);
+            bytes = QByteArray(reinterpret_cast<const char *>(data.data()), static_cast<int>(data.size()));
+        } else {
+            bytes = QByteArray::fromStdString(std::get<std::string>(message));
+        }
+        QMetaObject::invokeMethod(
+            &context, [&, bytes, binary]() { handleViewerMessage(bytes, binary); }, Qt::QueuedConnection);
+    });
+
+    QTimer::singleShot(kTimeoutMs, &loop, [&]() {
+        viewer.error = QStringLiteral("timed out");
+        loop.quit();
+    });
+    loop.exec();
+    const qint64 elapsedNs = elapsed.isValid() ? elapsed.nsecsElapsed() : 0;
+
+    // No callback may run into this frame once it returns.
+    viewer.channel->resetCallbacks();
+    if (hostChannel) {
+        hostChannel->resetCallbacks();
+    }
+    viewerPeer->close();
+    hostPeer->close();
+    transfer.detach();
+
+    if (!viewer.error.isEmpty()) {
+        result.insert(QStringLiteral("error"), viewer.error);
+        return result;
+    }
+    QFile source(QDir(directory).filePath(QLatin1String(kFileName)));
+    bool verified = false;
+    if (source.open(QIODevice::ReadOnly)) {
+        const uchar *mapped = source.map(0, size);
+        verified = mapped && viewer.received.size() == size &&
+                   memcmp(mapped, viewer.received.constData(), static_cast<size_t>(size)) == 0;
+    }
+    const double seconds = elapsedNs / 1e9;
+    result.insert(QStringLiteral("seconds"), seconds);
+    result.insert(QStringLiteral("mibPerSecond"), seconds > 0 ? size / (1024.0 * 1024.0) / seconds : 0.0);
+    result.insert(QStringLiteral("maxBufferedBytes"), maxBuffered);
+    if (viewer.resumedAt >= 0) {
+        result.insert(QStringLiteral("resumedAt"), viewer.resumedAt);
+    }
+    result.insert(QStringLiteral("verified"), verified);
+    return result;
+}
+}  // namespace
+
+int run(QCoreApplication &app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("RemoteDesk Host file transfer benchmark (loopback)");
+    parser.addHelpOption();
+    QCommandLineOption sizeOption("size-mb", "File size in MiB", "MiB", "128");
+    QCommandLineOption chunkOption("chunk-kb", "Chunk payload in KiB, up to 63 (repeatable; default 16)", "KiB");
+    QCommandLineOption watermarkOption("high-watermark-kb",
+                                       "Send buffer high watermark in KiB (repeatable; default 1024)", "KiB");
+    QCommandLineOption resumeOption("resume-at", "Cancel at this percent and resume from the received offset",
+                                    "percent", "0");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to a file", "path");
+    parser.addOption(sizeOption);
+    parser.addOption(chunkOption);
+    parser.addOption(watermarkOption);
+    parser.addOption(resumeOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    const qint64 size = qMax<qint64>(1, parser.value(sizeOption).toLongLong()) * 1024 * 1024;
+    QList<int> chunkSizes;
+    for (const QString &value : parser.values(chunkOption)) {
+        // Header included, a chunk stays within the 64 KiB message limit.
+        chunkSizes.append(qBound(1, value.toInt(), 63) * 1024);
+    }
+    if (chunkSizes.isEmpty()) {
+        chunkSizes.append(FileTransfer::Config{}.chunkBytes);
+    }
+    QList<qint64> watermarks;
+    for (const QString &value : parser.values(watermarkOption)) {
+        watermarks.append(qMax<qint64>(16, value.toLongLong()) * 1024);
+    }
+    if (watermarks.isEmpty()) {
+        watermarks.append(FileTransfer::Config{}.highWatermarkBytes);
+    }
+
+    QTemporaryDir directory;
+    if (!directory.isValid() || !writeSource(QDir(directory.path()).filePath(QLatin1String(kFileName)), size)) {
+        QTextStream(stderr) << "Cannot create the source file" << Qt::endl;
+        return 1;
+    }
+
+    QJsonArray runs;
+    for (const int chunkBytes : chunkSizes) {
+        for (const qint64 watermark : watermarks) {
+            TransferRun run;
+            run.chunkBytes = chunkBytes;
+            run.highWatermarkBytes = watermark;
+            run.resumePercent = qBound(0, parser.value(resumeOption).toInt(), 99);
+            runs.append(runTransfer(directory.path(), size, run));
+        }
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("host_bench_transfer"));
+    report.insert(QStringLiteral("sizeBytes"), size);
+    report.insert(QStringLiteral("runs"), runs);
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot write " << file.fileName() << Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
+
+}  // namespace host::bench
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    return host::bench::run(app);
+}
@@ -0,0 +1,232 @@
+#include "SyntheticDesktop.h"
+
+#include <algorithm>
+
+namespace host::bench {
+
+namespace {
+constexpr int kTitleBarHeight = 28;
+constexpr int kGlyphWidth = 9;
+constexpr int kLineHeight = 18;
+constexpr int kScrollPxPerFrame = kLineHeight;
+constexpr int kDragDx = 12;
+constexpr int kDragDy = 6;
+constexpr int kAltTabFrames = 30;
+// Scrolls the second window's text so the two windows differ.
+constexpr int kOtherWindowScroll = 40 * kLineHeight;
+
+constexpr quint32 kWindowBackground = 0xfffafafa;
+constexpr quint32 kTitleBar = 0xff3c3f41;
+constexpr quint32 kInk = 0xff202020;
+
+inline quint32 mix(quint32 value) {
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+inline quint32 *rowOf(VideoFrame &frame, int y) {
+    return reinterpret_cast<quint32 *>(frame.data.data() + y * frame.stride);
+}
+
+// Glyph ink for a character cell at (line, column); about one in six cells is blank
+// and every line has its own length so the text looks ragged.
+inline bool inkAt(int line, int column, int gx, int gy) {
+    if (gx >= kGlyphWidth - 1 || gy < 3 || gy > 14) {
+        return false;
+    }
+    const quint32 lineSeed = mix(static_cast<quint32>(line) * 0x9e3779b9U);
+    if (column >= static_cast<int>(lineSeed % 90) + 10) {
+        return false;
+    }
+    const quint32 cell = mix(lineSeed ^ static_cast<quint32>(column));
+    if (cell % 6 == 0) {
+        return false;
+    }
+    return (mix(cell + static_cast<quint32>(gy * 8 + gx)) & 3) == 0;
+}
+}  // namespace
+
+SyntheticDesktop::SyntheticDesktop(Workload workload, int width, int height)
+    : m_workload(workload), m_width(width), m_height(height),
+      m_window(width / 8, height / 8, width * 5 / 8, height * 5 / 8),
+      m_otherWindow(width * 3 / 8, height / 4, width / 2, height * 5 / 8) {
+    m_caret = QPoint(m_window.left() + kGlyphWidth, m_window.top() + kTitleBarHeight + 4);
+}
+
+QList<SyntheticDesktop::Workload> SyntheticDesktop::allWorkloads() {
+    return {Workload::StaticDesktop, Workload::ScrollingText, Workload::WindowDrag, Workload::FullScreenVideo,
+            Workload::Typing, Workload::AltTab};
+}
+
+QString SyntheticDesktop::workloadName(Workload workload) {
+    switch (workload) {
+    case Workload::StaticDesktop:
+        return QStringLiteral("static");
+    case Workload::ScrollingText:
+        return QStringLiteral("scroll");
+    case Workload::WindowDrag:
+        return QStringLiteral("drag");
+    case Workload::FullScreenVideo:
+        return QStringLiteral("video");
+    case Workload::Typing:
+        return QStringLiteral("typing");
+    case Workload::AltTab:
+        return QStringLiteral("alttab");
+    }
+    return QString();
+}
+
+bool SyntheticDesktop::workloadFromName(const QString &name, Workload &workload) {
+    for (Workload candidate : allWorkloads()) {
+        if (workloadName(candidate) == name) {
+            workload = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SyntheticDesktop::nextFrame(qint64 timestampUs, VideoFrame &frame) {
+    frame.format = PixelFormat::Bgra;
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.stride = m_width * 4;
+    frame.timestampUs = timestampUs;
+    frame.dirtyRects.clear();
+    if (frame.data.size() != frame.stride * m_height) {
+        frame.data.resize(frame.stride * m_height);
+    }
+
+    const int index = m_frameIndex++;
+    if (index == 0) {
+        paintFull(frame);
+        frame.dirtyRects.append(QRect(0, 0, m_width, m_height));
+        return;
+    }
+
+    switch (m_workload) {
+    case Workload::StaticDesktop:
+        break;
+    case Workload::ScrollingText: {
+        const QRect content = m_window.adjusted(0, kTitleBarHeight, 0, 0);
+        paintWindow(frame, m_window, index * kScrollPxPerFrame);
+        frame.dirtyRects.append(content);
+        break;
+    }
+    case Workload::WindowDrag: {
+        const QRect screen(0, 0, m_width, m_height);
+        QRect next = m_window.translated(kDragDx, kDragDy);
+        if (!screen.contains(next)) {
+            next.moveTo(0, 0);
+        }
+        const QRect previous = m_window;
+        m_window = next;
+        paintWallpaper(frame, previous);
+        paintWindow(frame, m_window, 0);
+        frame.dirtyRects.append(previous);
+        frame.dirtyRects.append(m_window);
+        break;
+    }
+    case Workload::FullScreenVideo:
+        paintVideo(frame);
+        frame.dirtyRects.append(QRect(0, 0, m_width, m_height));
+        break;
+    case Workload::Typing: {
+        const QRect content = m_window.adjusted(kGlyphWidth, kTitleBarHeight + 4, -kGlyphWidth, -kLineHeight);
+        if (m_caret.x() + kGlyphWidth > content.right()) {
+            m_caret = QPoint(content.left(), m_caret.y() + kLineHeight);
+        }
+        if (m_caret.y() + kLineHeight > content.bottom()) {
+            m_caret = content.topLeft();
+            paintWindow(frame, m_window, 0);
+            frame.dirtyRects.append(m_window);
+        }
+        paintGlyph(frame, m_caret.x(), m_caret.y(), static_cast<quint32>(index));
+        frame.dirtyRects.append(QRect(m_caret, QSize(kGlyphWidth, kLineHeight)));
+        m_caret.rx() += kGlyphWidth;
+        break;
+    }
+    case Workload::AltTab: {
+        if (index % kAltTabFrames != 0) {
+            break;
+        }
+        const bool other = (index / kAltTabFrames) % 2 != 0;
+        const QRect &hidden = other ? m_window : m_otherWindow;
+        const QRect &shown = other ? m_otherWindow : m_window;
+        paintWallpaper(frame, hidden);
+        paintWindow(frame, shown, other ? kOtherWindowScroll : 0);
+        frame.dirtyRects.append(hidden);
+        frame.dirtyRects.append(shown);
+        break;
+    }
+    }
+}
+
+void SyntheticDesktop::paintFull(VideoFrame &frame) {
+    if (m_workload == Workload::FullScreenVideo) {
+        paintVideo(frame);
+        return;
+    }
+    paintWallpaper(frame, QRect(0, 0, m_width, m_height));
+    paintWindow(frame, m_window, 0);
+}
+
+void SyntheticDesktop::paintWallpaper(VideoFrame &frame, const QRect &rect) {
+    const QRect clipped = rect.intersected(QRect(0, 0, m_width, m_height));
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y) {
+        quint32 *row = rowOf(frame, y);
+        const quint32 blue = static_cast<quint32>(96 + (y * 96) / m_height);
+        for (int x = clipped.left(); x <= clipped.right(); ++x) {
+            const quint32 green = static_cast<quint32>(48 + (x * 64) / m_width);
+            row[x] = 0xff000000U | (24U << 16) | (green << 8) | blue;
+        }
+    }
+}
+
+void SyntheticDesktop::paintWindow(VideoFrame &frame, const QRect &rect, int scrollPx) {
+    const QRect clipped = rect.intersected(QRect(0, 0, m_width, m_height));
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y) {
+        quint32 *row = rowOf(frame, y);
+        const int localY = y - rect.top();
+        if (localY < kTitleBarHeight) {
+            std::fill(row + clipped.left(), row + clipped.right() + 1, kTitleBar);
+            continue;
+        }
+        const int contentY = localY - kTitleBarHeight + scrollPx;
+        const int line = contentY / kLineHeight;
+        const int gy = contentY % kLineHeight;
+        for (int x = clipped.left(); x <= clipped.right(); ++x) {
+            const int localX = x - rect.left() - kGlyphWidth;
+            const bool ink = localX >= 0 && inkAt(line, localX / kGlyphWidth, localX % kGlyphWidth, gy);
+            row[x] = ink ? kInk : kWindowBackground;
+        }
+    }
+}
+
+void SyntheticDesktop::paintVideo(VideoFrame &frame) {
+    const int t = m_frameIndex;
+    for (int y = 0; y < m_height; ++y) {
+        quint32 *row = rowOf(frame, y);
+        const auto ry = static_cast<quint32>((y + t * 2) & 0xff);
+        for (int x = 0; x < m_width; ++x) {
+            const auto rx = static_cast<quint32>((x + t * 3) & 0xff);
+            const quint32 noise = mix(static_cast<quint32>(y * m_width + x + t * 7919)) & 0x0f;
+            row[x] = 0xff000000U | ((rx ^ ry) << 16) | (((rx + ry) >> 1) << 8) | (((rx * ry >> 8) + noise) & 0xff);
+        }
+    }
+}
+
+void SyntheticDesktop::paintGlyph(VideoFrame &frame, int x, int y, quint32 seed) {
+    for (int gy = 0; gy < kLineHeight && y + gy < m_height; ++gy) {
+        quint32 *row = rowOf(frame, y + gy);
+        for (int gx = 0; gx < kGlyphWidth && x + gx < m_width; ++gx) {
+            row[x + gx] = inkAt(static_cast<int>(seed), 0, gx, gy) ? kInk : kWindowBackground;
+        }
+    }
+}
+
+}  // namespace host::bench
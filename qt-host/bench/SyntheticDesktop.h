@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QList>
+#include <QRect>
+#include <QString>
+
+#include "host/VideoFrame.h"
+
+namespace host::bench {
+
+// Deterministic BGRA desktop content shaped like what CaptureVideo delivers:
+// a wallpaper, a text window and per-frame damage rectangles.
+class SyntheticDesktop {
+public:
+    enum class Workload {
+        StaticDesktop,
+        ScrollingText,
+        WindowDrag,
+        FullScreenVideo,
+        Typing,
+        // Two windows brought to the front in turn, as with Alt+Tab.
+        AltTab,
+    };
+
+    SyntheticDesktop(Workload workload, int width, int height);
+
+    static QList<Workload> allWorkloads();
+    static QString workloadName(Workload workload);
+    static bool workloadFromName(const QString &name, Workload &workload);
+
+    // Renders the next frame into `frame`, reusing its buffer across calls.
+    void nextFrame(qint64 timestampUs, VideoFrame &frame);
+
+private:
+    void paintFull(VideoFrame &frame);
+    void paintWallpaper(VideoFrame &frame, const QRect &rect);
+    void paintWindow(VideoFrame &frame, const QRect &rect, int scrollPx);
+    void paintVideo(VideoFrame &frame);
+    void paintGlyph(VideoFrame &frame, int x, int y, quint32 seed);
+
+    Workload m_workload;
+    int m_width = 0;
+    int m_height = 0;
+    int m_frameIndex = 0;
+    QRect m_window;
+    QRect m_otherWindow;
+    QPoint m_caret;
+};
+
+}  // namespace host::bench
@@ -42,6 +42,51 @@ inline constexpr auto kMessage        = "message";
 inline constexpr auto kError          = "error";
 inline constexpr auto kDataChannel    = "input";
 inline constexpr auto kDataChannelName= "input";
+// 指针移动/滚轮走不可靠、无序的通道（negotiated，双方用同一 id 创建；
+// 也接受 viewer 带内创建的同名通道）。move 带递增的 seq，过期的直接丢弃
+inline constexpr auto kMotionChannelName = "input-motion";
+inline constexpr int  kMotionChannelId   = 100;
+inline constexpr auto kSeq               = "seq";
+// viewer 在 input 通道发送 {"t":"caps","copyRect":true} 后，主机在每帧编码并交给发送队列之后
+// 推送该帧检测到的滚动/窗口移动：{"t":"copyRect","rtpTs":..,"rects":[[x,y,w,h,dx,dy],..]}。
+// 它与视频包走不同传输，先后不定，viewer 按 rtpTs 与帧对应
+inline constexpr auto kCaps              = "caps";
+inline constexpr auto kCopyRect          = "copyRect";
+inline constexpr auto kRtpTimestamp      = "rtpTs";
+inline constexpr auto kRects             = "rects";
+// caps 里带 "tileCache":<字节数> 表示 viewer 愿意缓存图块（每个 64x64 RGBA 槽 16 KiB）。
+// 主机随帧推送 {"t":"tiles","rtpTs":..,"store":[[slot,x,y],..],"draw":[[slot,x,y],..]}：
+// 先把当前画面 (x,y) 处的图块存入 slot，再把 slot 画到 (x,y)；带 draw 的帧没有视频，
+// 画上的图块一直保留到比 rtpTs 更新的视频帧显示为止
+inline constexpr auto kTileCache         = "tileCache";
+inline constexpr auto kTiles             = "tiles";
+inline constexpr auto kTileStore         = "store";
+inline constexpr auto kTileDraw          = "draw";
+// 文件传输走单独的可靠有序通道（negotiated，id 102；也接受 viewer 带内创建的同名通道），
+// 只在主机 --file-dir 指定的目录里读写，文件名不能带路径。控制消息是 JSON：
+//   viewer→host: {"t":"list"} / {"t":"get","id":n,"name":..,"offset":k}
+//                {"t":"put","id":n,"name":..,"size":s} / {"t":"cancel","id":n}
+//   host→viewer: {"t":"files","files":[{"name":..,"size":s},..]}
+//                {"t":"file","id":n,"name":..,"size":s,"offset":k} / {"t":"putReady","id":n,"offset":k}
+//                {"t":"done","id":n} / {"t":"fileError","id":n,"message":..}
+// 数据块是二进制消息：4 字节 id + 8 字节 offset（大端）+ 数据。断点续传：get 带上已收到的字节数；
+// put 时主机回复已有的 .part 字节数，viewer 从那里接着发
+inline constexpr auto kFileChannelName   = "file";
+inline constexpr int  kFileChannelId     = 102;
+inline constexpr int  kFileChunkHeader   = 12;
+inline constexpr auto kFileList          = "list";
+inline constexpr auto kFiles             = "files";
+inline constexpr auto kFileGet           = "get";
+inline constexpr auto kFilePut           = "put";
+inline constexpr auto kFileCancel        = "cancel";
+inline constexpr auto kFileHeader        = "file";
+inline constexpr auto kFilePutReady      = "putReady";
+inline constexpr auto kFileDone          = "done";
+inline constexpr auto kFileError         = "fileError";
+inline constexpr auto kFileId            = "id";
+inline constexpr auto kFileName          = "name";
+inline constexpr auto kFileSize          = "size";
+inline constexpr auto kFileOffset        = "offset";
 
 inline constexpr auto kCode6          = "code6";
 inline constexpr auto kRole           = "role";
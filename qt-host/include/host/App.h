@@ -2,8 +2,12 @@
 
 #include <QApplication>
 #include <QObject>
+#include <QRect>
 #include <QString>
 #include <memory>
+#include <optional>
+
+#include "host/VideoEncoder.h"
 
 namespace host {
 
@@ -26,7 +30,22 @@ private:
     std::unique_ptr<UiMainWindow> m_mainWindow;
     QString m_initialCode;
     int m_initialScreenIndex = 0;
+    QString m_captureWindowTitle;
+    QRect m_captureRect;
     bool m_initialAllowControl = false;
+    QString m_recordPath;
+    QString m_replayPath;
+    int m_statsPort = 0;
+    int m_videoSlices = 1;
+    int m_tileCacheMb = 64;
+    int m_idleFps = 1;
+    int m_roiStrength = 0;
+    int m_fps = 30;
+    std::optional<VideoEncoder::Codec> m_videoCodec = VideoEncoder::Codec::H264;
+    bool m_fullChroma = false;
+    int m_refineAfterMs = 0;
+    int m_qualitySampleInterval = 0;
+    QString m_fileDirectory;
 };
 
 }  // namespace host
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+struct OpusEncoder;
+
+namespace host {
+
+// Opus for desktop audio. DTX makes the encoder emit one- or two-byte frames
+// for near-silence, which the caller does not send; in-band FEC adds a
+// low-bitrate copy of the previous frame to each packet, sized for the
+// expected loss. Needs libopus (HOST_ENABLE_OPUS); otherwise initialize()
+// fails.
+class AudioEncoder {
+public:
+    static constexpr int kSampleRate = 48000;
+
+    struct Config {
+        int channels = 2;
+        int bitrateKbps = 64;
+        bool dtx = true;
+    };
+
+    AudioEncoder();
+    ~AudioEncoder();
+
+    AudioEncoder(const AudioEncoder &) = delete;
+    AudioEncoder &operator=(const AudioEncoder &) = delete;
+
+    bool initialize(const Config &config);
+    bool isInitialized() const { return m_encoder != nullptr; }
+    // `pcm` holds `frameSamples` interleaved 16-bit samples per channel at
+    // kSampleRate; 10, 20, 40 and 60 ms are valid Opus frame sizes. Returns
+    // false on error.
+    bool encode(const qint16 *pcm, int frameSamples, QByteArray &out);
+    void setBitrate(int kbps);
+    // Percent of packets expected to be lost; above zero turns on in-band FEC
+    // and moves the encoder from CELT to hybrid frames, which can carry it.
+    void setExpectedLoss(int percent);
+    // Clears the predictor after a gap, so the next frame does not lean on
+    // audio the receiver never got.
+    void reset();
+    QString name() const { return QStringLiteral("libopus"); }
+
+    static bool isAvailable();
+    // Whether a packet carries audio; DTX frames are two bytes or less.
+    static bool isDtxPacket(const QByteArray &packet) { return packet.size() <= 2; }
+    // Whether a packet is SILK or hybrid (TOC configurations 0-15), the only
+    // modes with room for an in-band FEC copy.
+    static bool hasSilkLayer(const QByteArray &packet) {
+        return !packet.isEmpty() && (static_cast<uchar>(packet.at(0)) >> 3) < 16;
+    }
+
+private:
+    OpusEncoder *m_encoder = nullptr;
+    Config m_config;
+    int m_expectedLoss = 0;
+};
+
+}  // namespace host
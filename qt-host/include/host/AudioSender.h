@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <atomic>
+#include <functional>
+
+#include "host/AudioEncoder.h"
+
+namespace host {
+
+// One outgoing Opus SSRC (RFC 7587). Cuts captured PCM into frames, skips
+// silence and DTX frames instead of sending them, and follows the network:
+// in-band FEC while the viewer reports loss, longer frames on slow links to
+// save per-packet overhead, short ones on fast clean links for latency.
+// Transport-agnostic; packets leave through the send function.
+class AudioSender {
+public:
+    struct Config {
+        AudioEncoder::Config encoder;
+        quint32 ssrc = 0;
+        quint8 payloadType = 111;
+        // The viewer's useinbandfec: whether it decodes the FEC copy at all.
+        bool fecAllowed = true;
+        // Longest frame the viewer accepts (its maxptime), in ms.
+        int maxFrameMs = 60;
+    };
+
+    using SendFunction = std::function<void(const QByteArray &packet)>;
+
+    AudioSender();
+    ~AudioSender();
+
+    // `send` is called with the sender's lock held, from sendPcm(); it must
+    // not call back into the sender.
+    bool initialize(const Config &config, SendFunction send);
+    bool isInitialized() const { return m_encoder.isInitialized(); }
+
+    // The thread CaptureAudio delivers on, which for WebRtcPeer is the GUI
+    // thread. `pcm` is interleaved 16-bit samples at 48 kHz with the
+    // configured channel count; any length, frames are cut as it fills up.
+    bool sendPcm(const QByteArray &pcm);
+
+    // Any thread; typically the transport's receive callback.
+    void handleRtcp(const QByteArray &packet);
+    // Latest loss fraction from the viewer's receiver reports, in 1/256 units.
+    int fractionLost() const { return m_fractionLost.load(std::memory_order_relaxed); }
+    // About once a second: picks FEC and frame duration from the round trip
+    // time and the loss the viewer reported since.
+    void updateNetwork(int rttMs);
+
+    int frameMs() const { return m_frameMs.load(std::memory_order_relaxed); }
+    int expectedLossPercent() const { return m_expectedLoss.load(std::memory_order_relaxed); }
+
+    // The duration updateNetwork() moves towards, exposed for the bench and logs.
+    static int chooseFrameMs(int rttMs, int lossPercent, int maxFrameMs);
+
+private:
+    bool sendFrame(const qint16 *samples, int frameSamples);
+    QByteArray makePacket(const QByteArray &payload, quint32 timestamp, bool marker);
+
+    Config m_config;
+    SendFunction m_send;
+
+    std::atomic<int> m_fractionLost{0};
+    std::atomic<int> m_frameMs{20};
+    std::atomic<int> m_expectedLoss{0};
+    // Only touched by updateNetwork().
+    int m_smoothedLoss = 0;
+    int m_proposedFrameMs = 20;
+    int m_proposedCount = 0;
+
+    // Guards everything below and calls to m_send.
+    QMutex m_mutex;
+    AudioEncoder m_encoder;
+    int m_appliedLoss = 0;
+    QByteArray m_pending;
+    QByteArray m_payload;
+    quint16 m_sequence = 0;
+    quint32 m_timestamp = 0;
+    // Silence since the last audible frame, in ms.
+    int m_silentMs = 0;
+    // Nothing was sent for the last frame, so the next packet starts a talkspurt.
+    bool m_inGap = true;
+    // Silent frames were not encoded at all; the encoder needs a reset before the next.
+    bool m_encoderSkipped = false;
+};
+
+}  // namespace host
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+#include "host/VideoEncoder.h"
+
+namespace host {
+
+// Measures what this machine can encode in real time: BGRA -> I420 conversion
+// and every compiled-in encoder at a few 16:9 sizes, on a synthetic scrolling
+// text desktop. Results are cached on disk per CPU model, so only the first
+// start on a machine pays the couple of seconds the measurement takes; it runs
+// on its own thread and sessions started before it finishes use defaults.
+class CapabilityProbe {
+public:
+    struct EncoderTiming {
+        VideoEncoder::Codec codec = VideoEncoder::Codec::H264;
+        int height = 0;
+        int threads = 0;
+        double msPerFrame = 0;
+    };
+
+    struct Results {
+        QString cpuModel;
+        int cores = 0;
+        // Pipeline threads the sizes were measured with.
+        int threads = 0;
+        // Single-threaded.
+        double convertMsPerMegapixel = 0;
+        // Every size on `threads` threads, plus 1080p on one thread to tell how
+        // well each encoder scales.
+        QVector<EncoderTiming> encoders;
+    };
+
+    struct Profile {
+        VideoEncoder::Codec codec = VideoEncoder::Codec::H264;
+        // Frames are encoded at this percentage of the captured size.
+        int scalePercent = 100;
+        // Pipeline threads, 0 = one per core.
+        int threads = 0;
+        int fps = 30;
+        // Predicted conversion + encode time per frame, 0 when not measured.
+        double frameMs = 0;
+    };
+
+    static CapabilityProbe &instance();
+    ~CapabilityProbe();
+
+    // GUI thread, once. Loads the results for this CPU from `cachePath`, or
+    // measures them in the background and adds them to the file.
+    void start(const QString &cachePath);
+    // Any thread; empty until loaded or measured.
+    std::optional<Results> results() const;
+
+    // The largest scale and frame rate at which one of `codecs` (in order of
+    // preference) keeps up with frames of `frameSize`, and the fewest threads
+    // that suffice. `fps` > 0 fixes the frame rate.
+    static Profile chooseProfile(const Results &results, const QSize &frameSize,
+                                 const QVector<VideoEncoder::Codec> &codecs, int fps);
+
+    static QString cpuModel();
+    // Blocks for a second or more; returns early, incomplete, once `cancel` is set.
+    static Results measure(const std::atomic<bool> &cancel);
+
+private:
+    CapabilityProbe() = default;
+
+    static QString cacheKey(const QString &cpuModel, int cores);
+    static QJsonObject toJson(const Results &results);
+    static std::optional<Results> fromJson(const QJsonObject &json);
+    void store(const QString &cachePath, const Results &results);
+
+    mutable QMutex m_mutex;
+    std::optional<Results> m_results;
+    std::thread m_worker;
+    std::atomic<bool> m_cancel{false};
+};
+
+}  // namespace host
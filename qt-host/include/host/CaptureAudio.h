@@ -15,6 +15,7 @@ public:
     void stop();
 
 signals:
+    // Interleaved signed 16-bit samples; WebRtcPeer sends 48 kHz stereo as Opus.
     void audioFrameCaptured(const QByteArray &pcmData, int sampleRate, int channels, qint64 timestampUs);
     void errorOccurred(const QString &message);
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+#include <atomic>
+#include <functional>
+
+namespace host {
+
+// Chooses the capture rate from recent activity. Capture runs at the full
+// rate while the screen changes or the viewer sends input, and drops to a
+// keep-alive rate once neither has happened for `idleAfterUs`. The first
+// damaged frame or input event switches straight back.
+class CaptureGovernor {
+public:
+    struct Config {
+        int activeFps = 30;
+        // 0 keeps capturing at the full rate.
+        int idleFps = 1;
+        qint64 idleAfterUs = 5000000;
+    };
+
+    // Receives the new rate on every change, on the thread that caused it,
+    // with the governor's lock held: calls arrive in the order of the changes.
+    using RateCallback = std::function<void(int fps)>;
+
+    // Not thread-safe; call before capture starts.
+    void setConfig(const Config &config);
+    void setRateCallback(RateCallback callback) { m_onRate = std::move(callback); }
+
+    // Any thread.
+    void noteInput(qint64 nowUs);
+    // Capture thread, once per delivered frame.
+    void noteFrame(qint64 nowUs, bool damaged);
+
+    bool isIdle() const { return m_idle.load(std::memory_order_relaxed); }
+    int frameRate() const { return isIdle() ? m_config.idleFps : m_config.activeFps; }
+
+private:
+    void noteActivity(qint64 nowUs);
+
+    Config m_config;
+    RateCallback m_onRate;
+    // Serializes idle/active transitions with their callbacks. Activity reads
+    // m_idle without it and only locks to leave idle.
+    QMutex m_mutex;
+    std::atomic<qint64> m_lastActivityUs{0};
+    std::atomic<bool> m_idle{false};
+};
+
+}  // namespace host
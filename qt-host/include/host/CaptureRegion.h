@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QList>
+#include <QRect>
+#include <QString>
+
+class QScreen;
+
+namespace host {
+
+// Physical pixel geometry of a screen: Qt keeps the native top-left and only
+// divides the size by the device pixel ratio.
+QRect physicalScreenGeometry(const QScreen *screen);
+
+// Which part of the selected screen is streamed: all of it, a fixed
+// rectangle, or one top-level window followed as it moves and resizes.
+// Rectangles are in physical pixels relative to the screen's top-left.
+class CaptureRegion {
+public:
+    struct Window {
+        // Native handle (HWND on Windows).
+        quintptr handle = 0;
+        QString title;
+    };
+
+    // Visible, titled top-level windows, front to back. Empty where the
+    // platform has no window enumeration.
+    static QList<Window> topLevelWindows();
+    // First window whose title contains `text` (case-insensitive), or 0.
+    static quintptr findWindow(const QString &text);
+
+    void setScreenIndex(int index) { m_screenIndex = index; }
+    void setRect(const QRect &rect);
+    void setWindow(quintptr handle);
+    bool isWholeScreen() const { return m_window == 0 && m_rect.isEmpty(); }
+    // The tracked window was closed.
+    bool windowLost() const { return m_windowLost; }
+
+    // Current capture rectangle, clipped to the screen and snapped to even
+    // coordinates and sizes for I420. Empty means the whole screen if
+    // isWholeScreen(), and otherwise that there is nothing to show: the window
+    // is minimized, closed or on another screen, or the rectangle is off it.
+    // Nothing else on the screen should be sent in that case.
+    QRect update();
+
+private:
+    QRect snap(const QRect &rect, const QSize &screen) const;
+
+    int m_screenIndex = 0;
+    QRect m_rect;
+    quintptr m_window = 0;
+    bool m_windowLost = false;
+};
+
+}  // namespace host
@@ -4,24 +4,28 @@
 #include <QString>
 #include <memory>
 
+#include "host/VideoSource.h"
+
 namespace host {
 
-class CaptureVideo : public QObject {
+// The live desktop. Delegates to a platform backend where one was compiled in
+// (PipeWire on Linux).
+class CaptureVideo : public VideoSource {
     Q_OBJECT
 public:
     explicit CaptureVideo(QObject *parent = nullptr);
     ~CaptureVideo() override;
 
-    void setScreenIndex(int index);
-    void setFrameRate(int fps);
+    void setScreenIndex(int index) override;
+    void setFrameRate(int fps) override;
+    void setCaptureRegion(const QRect &region) override;
+    void setPixelFormat(PixelFormat format) override;
 
-    bool start();
-    void stop();
+    bool start() override;
+    void stop() override;
 
-signals:
-    void frameCaptured(const QByteArray &i420Data, int width, int height, qint64 timestampUs);
-    void errorOccurred(const QString &message);
+private:
+    std::unique_ptr<VideoSource> m_backend;
 };
 
 }  // namespace host
-
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+namespace host {
+
+// BT.601 limited range BGRA -> I420. Width and height must be even; the
+// destination planes are tightly packed (Y stride = width, U/V stride = width / 2).
+void convertBgraToI420(const std::uint8_t *bgra, int bgraStride, int width, int height, std::uint8_t *i420);
+
+// Converts only source rows [firstRow, firstRow + rowCount) into their place in
+// a full-height I420 frame. firstRow and rowCount must be even; disjoint bands
+// may be converted concurrently.
+void convertBgraToI420Rows(const std::uint8_t *bgra, int bgraStride, int width, int height, int firstRow, int rowCount,
+                           std::uint8_t *i420);
+
+// BT.601 limited range BGRA -> I444 (no chroma subsampling): Y, U and V planes
+// of width x height each. The Rows variant follows convertBgraToI420Rows.
+void convertBgraToI444(const std::uint8_t *bgra, int bgraStride, int width, int height, std::uint8_t *i444);
+void convertBgraToI444Rows(const std::uint8_t *bgra, int bgraStride, int width, int height, int firstRow, int rowCount,
+                           std::uint8_t *i444);
+
+// Between packed I420 and I444 frames of the same even size: chroma is
+// replicated up or averaged down over 2x2 blocks.
+void convertI420ToI444(const std::uint8_t *i420, int width, int height, std::uint8_t *i444);
+void convertI444ToI420(const std::uint8_t *i444, int width, int height, std::uint8_t *i420);
+
+// Copies the cropWidth x cropHeight rectangle at (x, y) of a packed I420 frame
+// into a packed I420 frame of that size. All four must be even.
+void cropI420(const std::uint8_t *i420, int width, int height, int x, int y, int cropWidth, int cropHeight,
+              std::uint8_t *out);
+
+// The reverse of cropI420: writes a packed patchWidth x patchHeight I420 frame
+// back at (x, y) of a packed width x height one.
+void pasteI420(const std::uint8_t *patch, int x, int y, int patchWidth, int patchHeight, int width, int height,
+               std::uint8_t *i420);
+
+// The same for packed I444 frames.
+void cropI444(const std::uint8_t *i444, int width, int height, int x, int y, int cropWidth, int cropHeight,
+              std::uint8_t *out);
+void pasteI444(const std::uint8_t *patch, int x, int y, int patchWidth, int patchHeight, int width, int height,
+               std::uint8_t *i444);
+
+// Resamples a packed width x height I420 frame to outWidth x outHeight
+// (bilinear; box-filtered with libyuv). All four must be even.
+void scaleI420(const std::uint8_t *i420, int width, int height, int outWidth, int outHeight, std::uint8_t *out);
+void scaleI444(const std::uint8_t *i444, int width, int height, int outWidth, int outHeight, std::uint8_t *out);
+
+}  // namespace host
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <functional>
+#include <map>
+#include <memory>
+
+class QJsonObject;
+
+namespace host {
+
+// Serves the file data channel (see protocol::json::kFileChannelName): lists,
+// sends and receives files inside one directory. Downloads stream from a
+// memory-mapped window of the file in fixed-size chunks and stop once the
+// channel buffers the high watermark; the channel's low-watermark callback
+// calls pump() to continue, so the SCTP queue stays short and the video track
+// keeps its share of the link. Both directions resume from an offset.
+// Transport-agnostic; all calls on the object's thread.
+class FileTransfer : public QObject {
+    Q_OBJECT
+public:
+    struct Config {
+        // Empty disables the channel.
+        QString directory;
+        // Below libdatachannel's and the browsers' 64 KiB message limit.
+        int chunkBytes = 16 * 1024;
+        qint64 highWatermarkBytes = 1024 * 1024;
+        // For the channel's setBufferedAmountLowThreshold().
+        qint64 lowWatermarkBytes = 256 * 1024;
+    };
+
+    struct Transport {
+        std::function<bool(const QByteArray &message, bool binary)> send;
+        std::function<qint64()> bufferedAmount;
+    };
+
+    explicit FileTransfer(QObject *parent = nullptr);
+    ~FileTransfer() override;
+
+    void setConfig(const Config &config) { m_config = config; }
+    const Config &config() const { return m_config; }
+    bool isEnabled() const { return !m_config.directory.isEmpty(); }
+
+    // A new channel; transfers on the previous one are dropped, partial
+    // uploads stay on disk to be resumed. Both clear the throttle.
+    void attach(Transport transport);
+    void detach();
+
+    void handleMessage(const QByteArray &message, bool binary);
+    // Sends chunks until the channel buffers the high watermark, the
+    // downloads are done or the transfer is throttled.
+    void pump();
+    // While set, downloads pause so a congested link goes to the video.
+    void setThrottled(bool throttled);
+
+    int activeDownloads() const { return static_cast<int>(m_downloads.size()); }
+    int activeUploads() const { return static_cast<int>(m_uploads.size()); }
+
+signals:
+    void logLine(const QString &line);
+
+private:
+    struct Download {
+        QString name;
+        std::unique_ptr<QFile> file;
+        qint64 size = 0;
+        qint64 offset = 0;
+        uchar *window = nullptr;
+        qint64 windowOffset = 0;
+        qint64 windowSize = 0;
+    };
+    struct Upload {
+        QString name;
+        std::unique_ptr<QFile> file;
+        qint64 size = 0;
+        qint64 offset = 0;
+    };
+
+    void handleControl(const QByteArray &message);
+    void handleChunk(const QByteArray &chunk);
+    void sendList();
+    void startDownload(quint32 id, const QString &name, qint64 offset);
+    void startUpload(quint32 id, const QString &name, qint64 size);
+    void finishUpload(quint32 id, Upload &upload);
+    void cancel(quint32 id);
+    // Builds the next chunk of `download` in m_chunk; false when its window cannot be mapped.
+    bool nextChunk(quint32 id, Download &download);
+    void closeDownload(Download &download);
+    void sendControl(const QJsonObject &message);
+    void sendError(quint32 id, const QString &message);
+    QString pathFor(const QString &name) const;
+    void clearTransfers();
+
+    Config m_config;
+    Transport m_transport;
+    bool m_throttled = false;
+    std::map<quint32, Download> m_downloads;
+    std::map<quint32, Upload> m_uploads;
+    // Round robin between downloads: the one after this id goes next.
+    quint32 m_lastServed = 0;
+    QByteArray m_chunk;
+};
+
+}  // namespace host
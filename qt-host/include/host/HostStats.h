@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+
+namespace host {
+
+// Process-wide counters updated from the capture, encode, network and input
+// threads. A counter or gauge update is a single relaxed atomic op on its own
+// cache line; a timing updates the three atomics (count, sum, max) of one
+// slot, which share a cache line and are read without a common lock, so a
+// snapshot may catch them mid-update. Readers (the stats endpoint, logs) take
+// a snapshot.
+class HostStats {
+public:
+    enum Counter {
+        FramesCaptured,
+        FramesDropped,
+        FramesEncoded,
+        EncodedBytes,
+        BytesSent,
+        PacketsSent,
+        PacketsRetransmitted,
+        FecPacketsSent,
+        InputEvents,
+        InputEventsDropped,
+        InputMotionStale,
+        MovesDetected,
+        TileCacheLookups,
+        TileCacheHits,
+        FramesFromTileCache,
+        // Static pictures re-encoded at (near-)lossless quality.
+        FramesRefined,
+        AudioPacketsSent,
+        // Audio frames not sent: digital silence, or Opus DTX.
+        AudioFramesSilent,
+        // Audio packets sent while FEC is on in a mode that can carry it.
+        AudioFecPackets,
+        // File data channel payload, without chunk headers.
+        FileBytesSent,
+        FileBytesReceived,
+        CounterCount,
+    };
+
+    enum Gauge {
+        SendQueueDepth,
+        // Time the pacer's backlog needs to drain at its nominal rate.
+        PacerQueueTimeMs,
+        RttMs,
+        // Fraction lost as reported by RTCP receiver reports, in 1/256 units.
+        PacketLoss,
+        TargetBitrateKbps,
+        // Capture rate chosen by CaptureGovernor; drops while the session is idle.
+        CaptureFps,
+        // Derived by sample() from the counters above.
+        SendBitrateKbps,
+        InputEventsPerSecond,
+        // Percent of tile lookups that hit since the previous sample.
+        TileCacheHitRate,
+        // Share of macroblocks RoiMap currently encodes at raised quality.
+        RoiFocusPercent,
+        // Last sampled picture against its source (--quality-sample), in
+        // 1/100 dB and 1/10000.
+        VideoPsnr,
+        VideoSsim,
+        // Opus frame duration and the loss in-band FEC is sized for (0 = off).
+        AudioFrameMs,
+        AudioFecLossPercent,
+        GaugeCount,
+    };
+
+    enum Timing {
+        EncodeTime,
+        InjectionLatency,
+        InputDispatchDelay,
+        PacerDelay,
+        MoveDetectTime,
+        TimingCount,
+    };
+
+    struct TimingSnapshot {
+        quint64 count = 0;
+        quint64 sumUs = 0;
+        quint64 maxUs = 0;
+    };
+
+    struct Snapshot {
+        std::array<quint64, CounterCount> counters{};
+        std::array<qint64, GaugeCount> gauges{};
+        std::array<TimingSnapshot, TimingCount> timings{};
+    };
+
+    static HostStats &instance();
+
+    void add(Counter counter, quint64 amount = 1) {
+        m_counters[counter].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void set(Gauge gauge, qint64 value) { m_gauges[gauge].value.store(value, std::memory_order_relaxed); }
+
+    void record(Timing timing, qint64 durationUs);
+
+    // Recomputes the derived rate gauges; call about once a second.
+    void sample(qint64 nowUs);
+
+    Snapshot snapshot() const;
+    QByteArray toPrometheus() const;
+    QJsonObject toJson() const;
+
+private:
+    HostStats() = default;
+
+    struct alignas(64) PaddedCounter {
+        std::atomic<quint64> value{0};
+    };
+    struct alignas(64) PaddedGauge {
+        std::atomic<qint64> value{0};
+    };
+    struct alignas(64) TimingSlot {
+        std::atomic<quint64> count{0};
+        std::atomic<quint64> sumUs{0};
+        std::atomic<quint64> maxUs{0};
+    };
+
+    std::array<PaddedCounter, CounterCount> m_counters;
+    std::array<PaddedGauge, GaugeCount> m_gauges;
+    std::array<TimingSlot, TimingCount> m_timings;
+
+    // Only touched by sample(), which runs on one thread.
+    qint64 m_lastSampleUs = 0;
+    quint64 m_lastBytesSent = 0;
+    quint64 m_lastInputEvents = 0;
+    quint64 m_lastTileLookups = 0;
+    quint64 m_lastTileHits = 0;
+};
+
+}  // namespace host
@@ -1,29 +1,111 @@
 #pragma once
 
+#include "host/KeyCodes.h"
+#include "host/MpscQueue.h"
+
+#include <QJsonObject>
 #include <QObject>
+#include <QPointF>
+#include <QPointer>
+#include <QRect>
 #include <QString>
+#include <QVector>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
 
-class QJsonObject;
+class QScreen;
 
 namespace host {
 
+// Injects viewer input on a dedicated dispatch thread so the network thread
+// never blocks in SendInput. Keys, buttons and wheel events go through an
+// urgent queue that is always drained before pointer motion; motion that piles
+// up behind them is coalesced into a single move. Keys and mouse buttons are
+// tracked while held so they can be released when the viewer goes away.
+//
+// Pointer positions arrive normalized to the shared video ([0, 1] on both
+// axes) and are mapped onto the captured screen's physical pixels.
 class InputInjector : public QObject {
     Q_OBJECT
 public:
     explicit InputInjector(QObject *parent = nullptr);
     ~InputInjector() override;
 
+    // Picks the screen pointer positions are mapped onto; call from the GUI
+    // thread. Follows the screen's geometry and DPI while it stays connected.
+    void setScreenIndex(int index);
+    // Thread-safe. The part of the screen the video shows (physical pixels,
+    // relative to the screen); empty for the whole screen.
+    void setCaptureRegion(const QRect &region);
+
+    // Thread-safe. Disabling also discards events that are already queued.
     void setEnabled(bool enabled);
-    bool enabled() const { return m_enabled; }
+    bool enabled() const { return m_enabled.load(std::memory_order_acquire); }
 
+    // Thread-safe and non-blocking; the event is injected on the dispatch thread.
     void handleInputEvent(const QJsonObject &event);
 
+    // Thread-safe. Releases every key and mouse button the viewer left pressed;
+    // call when the viewer disconnects so nothing stays stuck on the host.
+    void releaseHeldInput();
+
 signals:
     void errorOccurred(const QString &message);
 
 private:
-    bool m_enabled = false;
+    struct QueuedEvent {
+        quint64 sequence = 0;
+        qint64 enqueuedUs = 0;
+        QJsonObject event;
+        // Moves only: normalized positions, oldest first.
+        QVector<QPointF> points;
+    };
+
+    void wake();
+    void run();
+    bool drain();
+    bool flushMotion(quint64 beforeSequence);
+    void dispatch(const QueuedEvent &queued);
+    void inject(const QJsonObject &event);
+    void injectMotion(const QVector<QPointF> &points);
+    void injectButton(int button, bool down);
+    void updateScreenGeometry();
+    void handleKeyEvent(const QJsonObject &event);
+    void syncModifiers(const QJsonObject &event);
+    void releaseHeldKeys(KeyModifier onlyModifier = KeyModifier::None);
+    void releaseHeldButtons();
+    void injectKey(const KeyInfo &key, bool down);
+    void injectPointerEvent(const QString &type, const QJsonObject &event);
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<quint64> m_nextSequence{0};
+    MpscQueue<QueuedEvent> m_urgent;
+    MpscQueue<QueuedEvent> m_motion;
+
+    std::atomic<bool> m_running{true};
+    std::atomic<bool> m_pending{false};
+    std::atomic<bool> m_releaseRequested{false};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::thread m_worker;
+
+    // Dispatch thread only: first motion event queued after the urgent event
+    // that triggered the last flush.
+    std::optional<QueuedEvent> m_heldMotion;
+    // Dispatch thread only, indexed like kKeyTable.
+    std::bitset<kKeyCount> m_pressedKeys;
+    // Dispatch thread only: bit n set while button n is down.
+    quint32 m_pressedButtons = 0;
+
+    QPointer<QScreen> m_screen;
+    std::mutex m_geometryMutex;
+    // Physical pixels in virtual desktop coordinates.
+    QRect m_screenGeometry;
+    QRect m_captureRegion;
 };
 
 }  // namespace host
-
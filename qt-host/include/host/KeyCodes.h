@@ -0,0 +1,300 @@
+#pragma once
+
+#include <QStringView>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// DOM KeyboardEvent.code -> platform key codes. The lookup table is a perfect
+// hash built at compile time, so translating a keystroke is one hash, one
+// probe and one string compare, with no allocation.
+
+namespace host {
+
+enum class KeyModifier : std::uint8_t {
+    None = 0,
+    Shift = 1 << 0,
+    Control = 1 << 1,
+    Alt = 1 << 2,
+    Meta = 1 << 3,
+};
+
+struct KeyInfo {
+    const char *code;
+    std::uint16_t windowsVk;
+    // Needs KEYEVENTF_EXTENDEDKEY (right-hand modifiers, navigation cluster, ...).
+    bool windowsExtended;
+    std::uint32_t xKeysym;
+    // evdev KEY_* from linux/input-event-codes.h.
+    std::uint16_t linuxKeycode;
+    KeyModifier modifier;
+};
+
+// clang-format off
+inline constexpr KeyInfo kKeyTable[] = {
+    {"KeyA",               0x41, false, 0x0061,  30, KeyModifier::None},
+    {"KeyB",               0x42, false, 0x0062,  48, KeyModifier::None},
+    {"KeyC",               0x43, false, 0x0063,  46, KeyModifier::None},
+    {"KeyD",               0x44, false, 0x0064,  32, KeyModifier::None},
+    {"KeyE",               0x45, false, 0x0065,  18, KeyModifier::None},
+    {"KeyF",               0x46, false, 0x0066,  33, KeyModifier::None},
+    {"KeyG",               0x47, false, 0x0067,  34, KeyModifier::None},
+    {"KeyH",               0x48, false, 0x0068,  35, KeyModifier::None},
+    {"KeyI",               0x49, false, 0x0069,  23, KeyModifier::None},
+    {"KeyJ",               0x4a, false, 0x006a,  36, KeyModifier::None},
+    {"KeyK",               0x4b, false, 0x006b,  37, KeyModifier::None},
+    {"KeyL",               0x4c, false, 0x006c,  38, KeyModifier::None},
+    {"KeyM",               0x4d, false, 0x006d,  50, KeyModifier::None},
+    {"KeyN",               0x4e, false, 0x006e,  49, KeyModifier::None},
+    {"KeyO",               0x4f, false, 0x006f,  24, KeyModifier::None},
+    {"KeyP",               0x50, false, 0x0070,  25, KeyModifier::None},
+    {"KeyQ",               0x51, false, 0x0071,  16, KeyModifier::None},
+    {"KeyR",               0x52, false, 0x0072,  19, KeyModifier::None},
+    {"KeyS",               0x53, false, 0x0073,  31, KeyModifier::None},
+    {"KeyT",               0x54, false, 0x0074,  20, KeyModifier::None},
+    {"KeyU",               0x55, false, 0x0075,  22, KeyModifier::None},
+    {"KeyV",               0x56, false, 0x0076,  47, KeyModifier::None},
+    {"KeyW",               0x57, false, 0x0077,  17, KeyModifier::None},
+    {"KeyX",               0x58, false, 0x0078,  45, KeyModifier::None},
+    {"KeyY",               0x59, false, 0x0079,  21, KeyModifier::None},
+    {"KeyZ",               0x5a, false, 0x007a,  44, KeyModifier::None},
+    {"Digit0",             0x30, false, 0x0030,  11, KeyModifier::None},
+    {"Digit1",             0x31, false, 0x0031,   2, KeyModifier::None},
+    {"Digit2",             0x32, false, 0x0032,   3, KeyModifier::None},
+    {"Digit3",             0x33, false, 0x0033,   4, KeyModifier::None},
+    {"Digit4",             0x34, false, 0x0034,   5, KeyModifier::None},
+    {"Digit5",             0x35, false, 0x0035,   6, KeyModifier::None},
+    {"Digit6",             0x36, false, 0x0036,   7, KeyModifier::None},
+    {"Digit7",             0x37, false, 0x0037,   8, KeyModifier::None},
+    {"Digit8",             0x38, false, 0x0038,   9, KeyModifier::None},
+    {"Digit9",             0x39, false, 0x0039,  10, KeyModifier::None},
+    {"F1",                 0x70, false, 0xffbe,  59, KeyModifier::None},
+    {"F2",                 0x71, false, 0xffbf,  60, KeyModifier::None},
+    {"F3",                 0x72, false, 0xffc0,  61, KeyModifier::None},
+    {"F4",                 0x73, false, 0xffc1,  62, KeyModifier::None},
+    {"F5",                 0x74, false, 0xffc2,  63, KeyModifier::None},
+    {"F6",                 0x75, false, 0xffc3,  64, KeyModifier::None},
+    {"F7",                 0x76, false, 0xffc4,  65, KeyModifier::None},
+    {"F8",                 0x77, false, 0xffc5,  66, KeyModifier::None},
+    {"F9",                 0x78, false, 0xffc6,  67, KeyModifier::None},
+    {"F10",                0x79, false, 0xffc7,  68, KeyModifier::None},
+    {"F11",                0x7a, false, 0xffc8,  87, KeyModifier::None},
+    {"F12",                0x7b, false, 0xffc9,  88, KeyModifier::None},
+    {"F13",                0x7c, false, 0xffca, 183, KeyModifier::None},
+    {"F14",                0x7d, false, 0xffcb, 184, KeyModifier::None},
+    {"F15",                0x7e, false, 0xffcc, 185, KeyModifier::None},
+    {"F16",                0x7f, false, 0xffcd, 186, KeyModifier::None},
+    {"F17",                0x80, false, 0xffce, 187, KeyModifier::None},
+    {"F18",                0x81, false, 0xffcf, 188, KeyModifier::None},
+    {"F19",                0x82, false, 0xffd0, 189, KeyModifier::None},
+    {"F20",                0x83, false, 0xffd1, 190, KeyModifier::None},
+    {"F21",                0x84, false, 0xffd2, 191, KeyModifier::None},
+    {"F22",                0x85, false, 0xffd3, 192, KeyModifier::None},
+    {"F23",                0x86, false, 0xffd4, 193, KeyModifier::None},
+    {"F24",                0x87, false, 0xffd5, 194, KeyModifier::None},
+    {"Enter",              0x0d, false, 0xff0d,  28, KeyModifier::None},
+    {"Escape",             0x1b, false, 0xff1b,   1, KeyModifier::None},
+    {"Backspace",          0x08, false, 0xff08,  14, KeyModifier::None},
+    {"Tab",                0x09, false, 0xff09,  15, KeyModifier::None},
+    {"Space",              0x20, false, 0x0020,  57, KeyModifier::None},
+    {"Minus",              0xbd, false, 0x002d,  12, KeyModifier::None},
+    {"Equal",              0xbb, false, 0x003d,  13, KeyModifier::None},
+    {"BracketLeft",        0xdb, false, 0x005b,  26, KeyModifier::None},
+    {"BracketRight",       0xdd, false, 0x005d,  27, KeyModifier::None},
+    {"Backslash",          0xdc, false, 0x005c,  43, KeyModifier::None},
+    {"IntlBackslash",      0xe2, false, 0x003c,  86, KeyModifier::None},
+    {"Semicolon",          0xba, false, 0x003b,  39, KeyModifier::None},
+    {"Quote",              0xde, false, 0x0027,  40, KeyModifier::None},
+    {"Backquote",          0xc0, false, 0x0060,  41, KeyModifier::None},
+    {"Comma",              0xbc, false, 0x002c,  51, KeyModifier::None},
+    {"Period",             0xbe, false, 0x002e,  52, KeyModifier::None},
+    {"Slash",              0xbf, false, 0x002f,  53, KeyModifier::None},
+    {"CapsLock",           0x14, false, 0xffe5,  58, KeyModifier::None},
+    {"PrintScreen",        0x2c, true, 0xff61,  99, KeyModifier::None},
+    {"ScrollLock",         0x91, false, 0xff14,  70, KeyModifier::None},
+    {"Pause",              0x13, false, 0xff13, 119, KeyModifier::None},
+    {"Insert",             0x2d, true, 0xff63, 110, KeyModifier::None},
+    {"Home",               0x24, true, 0xff50, 102, KeyModifier::None},
+    {"PageUp",             0x21, true, 0xff55, 104, KeyModifier::None},
+    {"Delete",             0x2e, true, 0xffff, 111, KeyModifier::None},
+    {"End",                0x23, true, 0xff57, 107, KeyModifier::None},
+    {"PageDown",           0x22, true, 0xff56, 109, KeyModifier::None},
+    {"ArrowRight",         0x27, true, 0xff53, 106, KeyModifier::None},
+    {"ArrowLeft",          0x25, true, 0xff51, 105, KeyModifier::None},
+    {"ArrowDown",          0x28, true, 0xff54, 108, KeyModifier::None},
+    {"ArrowUp",            0x26, true, 0xff52, 103, KeyModifier::None},
+    {"NumLock",            0x90, true, 0xff7f,  69, KeyModifier::None},
+    {"NumpadDivide",       0x6f, true, 0xffaf,  98, KeyModifier::None},
+    {"NumpadMultiply",     0x6a, false, 0xffaa,  55, KeyModifier::None},
+    {"NumpadSubtract",     0x6d, false, 0xffad,  74, KeyModifier::None},
+    {"NumpadAdd",          0x6b, false, 0xffab,  78, KeyModifier::None},
+    {"NumpadEnter",        0x0d, true, 0xff8d,  96, KeyModifier::None},
+    {"Numpad0",            0x60, false, 0xffb0,  82, KeyModifier::None},
+    {"Numpad1",            0x61, false, 0xffb1,  79, KeyModifier::None},
+    {"Numpad2",            0x62, false, 0xffb2,  80, KeyModifier::None},
+    {"Numpad3",            0x63, false, 0xffb3,  81, KeyModifier::None},
+    {"Numpad4",            0x64, false, 0xffb4,  75, KeyModifier::None},
+    {"Numpad5",            0x65, false, 0xffb5,  76, KeyModifier::None},
+    {"Numpad6",            0x66, false, 0xffb6,  77, KeyModifier::None},
+    {"Numpad7",            0x67, false, 0xffb7,  71, KeyModifier::None},
+    {"Numpad8",            0x68, false, 0xffb8,  72, KeyModifier::None},
+    {"Numpad9",            0x69, false, 0xffb9,  73, KeyModifier::None},
+    {"NumpadDecimal",      0x6e, false, 0xffae,  83, KeyModifier::None},
+    {"NumpadEqual",        0x92, false, 0xffbd, 117, KeyModifier::None},
+    {"NumpadComma",        0xc2, false, 0xffac, 121, KeyModifier::None},
+    {"ContextMenu",        0x5d, true, 0xff67, 127, KeyModifier::None},
+    {"ShiftLeft",          0xa0, false, 0xffe1,  42, KeyModifier::Shift},
+    {"ShiftRight",         0xa1, false, 0xffe2,  54, KeyModifier::Shift},
+    {"ControlLeft",        0xa2, false, 0xffe3,  29, KeyModifier::Control},
+    {"ControlRight",       0xa3, true, 0xffe4,  97, KeyModifier::Control},
+    {"AltLeft",            0xa4, false, 0xffe9,  56, KeyModifier::Alt},
+    {"AltRight",           0xa5, true, 0xffea, 100, KeyModifier::Alt},
+    {"MetaLeft",           0x5b, true, 0xffeb, 125, KeyModifier::Meta},
+    {"MetaRight",          0x5c, true, 0xffec, 126, KeyModifier::Meta},
+    {"IntlRo",             0xc1, false, 0x005c,  89, KeyModifier::None},
+    {"IntlYen",            0xdc, false, 0x00a5, 124, KeyModifier::None},
+    {"KanaMode",           0x15, false, 0xff27,  93, KeyModifier::None},
+    {"Lang1",              0x15, false, 0xff31, 122, KeyModifier::None},
+    {"Lang2",              0x19, false, 0xff34, 123, KeyModifier::None},
+    {"Convert",            0x1c, false, 0xff23,  92, KeyModifier::None},
+    {"NonConvert",         0x1d, false, 0xff22,  94, KeyModifier::None},
+    {"AudioVolumeMute",    0xad, true, 0x1008ff12, 113, KeyModifier::None},
+    {"AudioVolumeDown",    0xae, true, 0x1008ff11, 114, KeyModifier::None},
+    {"AudioVolumeUp",      0xaf, true, 0x1008ff13, 115, KeyModifier::None},
+    {"MediaTrackNext",     0xb0, true, 0x1008ff17, 163, KeyModifier::None},
+    {"MediaTrackPrevious", 0xb1, true, 0x1008ff16, 165, KeyModifier::None},
+    {"MediaStop",          0xb2, true, 0x1008ff15, 166, KeyModifier::None},
+    {"MediaPlayPause",     0xb3, true, 0x1008ff14, 164, KeyModifier::None},
+    {"BrowserBack",        0xa6, true, 0x1008ff26, 158, KeyModifier::None},
+    {"BrowserForward",     0xa7, true, 0x1008ff27, 159, KeyModifier::None},
+    {"BrowserRefresh",     0xa8, true, 0x1008ff73, 173, KeyModifier::None},
+    {"BrowserStop",        0xa9, true, 0x1008ff28, 128, KeyModifier::None},
+    {"BrowserSearch",      0xaa, true, 0x1008ff1b, 217, KeyModifier::None},
+    {"BrowserFavorites",   0xab, true, 0x1008ff30, 156, KeyModifier::None},
+    {"BrowserHome",        0xac, true, 0x1008ff18, 172, KeyModifier::None},
+    {"LaunchMail",         0xb4, true, 0x1008ff19, 155, KeyModifier::None},
+    {"Sleep",              0x5f, false, 0x1008ff2f, 142, KeyModifier::None},
+};
+// clang-format on
+
+inline constexpr std::size_t kKeyCount = sizeof(kKeyTable) / sizeof(kKeyTable[0]);
+
+namespace keycodes_detail {
+
+constexpr std::size_t kSlotCount = 2048;
+static_assert((kSlotCount & (kSlotCount - 1)) == 0, "slot count must be a power of two");
+static_assert(kKeyCount < 255, "slot entries are stored as uint8_t");
+
+constexpr std::size_t length(const char *text) {
+    std::size_t size = 0;
+    while (text[size] != '\0') {
+        ++size;
+    }
+    return size;
+}
+
+// FNV-1a with a seed and a final fold. Codes are ASCII; anything wider cannot match.
+template <typename Char>
+constexpr std::uint32_t hash(const Char *text, std::size_t size, std::uint32_t seed) {
+    std::uint32_t value = 2166136261u ^ seed;
+    for (std::size_t i = 0; i < size; ++i) {
+        value ^= static_cast<std::uint32_t>(text[i]);
+        value *= 16777619u;
+    }
+    return value ^ (value >> 15);
+}
+
+constexpr bool isPerfect(std::uint32_t seed) {
+    std::array<bool, kSlotCount> used{};
+    for (const KeyInfo &key : kKeyTable) {
+        const std::size_t slot = hash(key.code, length(key.code), seed) & (kSlotCount - 1);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr std::uint32_t findSeed() {
+    for (std::uint32_t seed = 1; seed < (1u << 16); ++seed) {
+        if (isPerfect(seed)) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+inline constexpr std::uint32_t kSeed = findSeed();
+static_assert(kSeed != 0, "no perfect hash seed; grow kSlotCount");
+
+// Slot -> table index + 1; 0 marks an empty slot.
+constexpr std::array<std::uint8_t, kSlotCount> buildSlots() {
+    std::array<std::uint8_t, kSlotCount> table{};
+    for (std::size_t i = 0; i < kKeyCount; ++i) {
+        const char *code = kKeyTable[i].code;
+        table[hash(code, length(code), kSeed) & (kSlotCount - 1)] = static_cast<std::uint8_t>(i + 1);
+    }
+    return table;
+}
+
+inline constexpr std::array<std::uint8_t, kSlotCount> kSlots = buildSlots();
+
+template <typename Char>
+constexpr bool equals(const char *code, const Char *text, std::size_t size) {
+    std::size_t i = 0;
+    for (; i < size; ++i) {
+        if (code[i] == '\0' || static_cast<std::uint32_t>(code[i]) != static_cast<std::uint32_t>(text[i])) {
+            return false;
+        }
+    }
+    return code[i] == '\0';
+}
+
+}  // namespace keycodes_detail
+
+// Returns nullptr for codes not in the table.
+template <typename Char>
+constexpr const KeyInfo *findKey(const Char *code, std::size_t size) {
+    using namespace keycodes_detail;
+    const std::uint8_t entry = kSlots[hash(code, size, kSeed) & (kSlotCount - 1)];
+    if (entry == 0 || !equals(kKeyTable[entry - 1].code, code, size)) {
+        return nullptr;
+    }
+    return &kKeyTable[entry - 1];
+}
+
+inline const KeyInfo *findKey(QStringView code) { return findKey(code.utf16(), static_cast<std::size_t>(code.size())); }
+
+constexpr std::size_t keyIndex(const KeyInfo &key) { return static_cast<std::size_t>(&key - kKeyTable); }
+
+namespace keycodes_detail {
+
+constexpr bool everyCodeResolves() {
+    for (const KeyInfo &key : kKeyTable) {
+        if (findKey(key.code, length(key.code)) != &key) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool everyCodeHasPlatformCodes() {
+    for (const KeyInfo &key : kKeyTable) {
+        if (key.windowsVk == 0 || key.xKeysym == 0 || key.linuxKeycode == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(everyCodeResolves(), "every DOM code must map back to its own entry");
+static_assert(everyCodeHasPlatformCodes(), "every DOM code needs a VK, keysym and evdev code");
+static_assert(findKey("KeyQ", 4)->linuxKeycode == 16 && findKey("KeyQ", 4)->windowsVk == 'Q');
+static_assert(findKey("ControlRight", 12)->windowsExtended);
+static_assert(findKey("Keya", 4) == nullptr && findKey("Key", 3) == nullptr && findKey("", 0) == nullptr);
+static_assert(findKey(u"Enter", 5)->xKeysym == 0xff0d);
+
+}  // namespace keycodes_detail
+
+}  // namespace host
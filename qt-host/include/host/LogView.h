@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QPlainTextEdit>
+#include <QStringList>
+
+namespace host {
+
+// Read-only log pane fed in batches by Logger::linesReady. Keeps at most
+// maxLines blocks; QPlainTextEdit only lays out the blocks that are visible,
+// so a chatty session costs one insert per batch instead of one per line.
+class LogView : public QPlainTextEdit {
+    Q_OBJECT
+public:
+    explicit LogView(QWidget *parent = nullptr);
+
+    void setMaxLines(int lines);
+    int maxLines() const { return m_maxLines; }
+
+public slots:
+    void appendLines(const QStringList &lines);
+
+private:
+    int m_maxLines = 2000;
+};
+
+}  // namespace host
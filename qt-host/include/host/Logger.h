@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "host/MpscQueue.h"
+
+namespace host {
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+// Asynchronous logger. log() is lock-free and safe from any thread: records
+// go into a bounded ring, a background thread formats them, writes the file
+// sink and hands batches to the UI through linesReady(). When the ring is
+// full or the rate limit is exceeded, lines are dropped and counted instead of
+// blocking the caller. Errors are never rate limited.
+class Logger : public QObject {
+    Q_OBJECT
+public:
+    struct Config {
+        LogLevel minLevel = LogLevel::Info;
+        // Empty disables the file sink.
+        QString filePath;
+        qint64 maxFileBytes = 5 * 1024 * 1024;
+        int maxFiles = 3;
+        int linesPerSecond = 200;
+        int burstLines = 400;
+    };
+
+    static Logger &instance();
+
+    void start(const Config &config);
+    // Drains what is queued and stops the worker; later log() calls are dropped.
+    void shutdown();
+
+    void log(LogLevel level, const QString &message);
+    bool isEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= m_minLevel.load(std::memory_order_relaxed);
+    }
+
+    quint64 droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+signals:
+    // Emitted from the logger thread with formatted lines, oldest first.
+    void linesReady(const QStringList &lines);
+
+private:
+    struct Record {
+        qint64 timestampMs = 0;
+        LogLevel level = LogLevel::Info;
+        QString message;
+    };
+
+    Logger();
+    ~Logger() override;
+
+    bool admit(qint64 nowUs);
+    void run();
+    void drain();
+    void writeToFile(const QStringList &lines);
+    void rotate();
+
+    MpscQueue<Record> m_queue;
+    Config m_config;
+    std::atomic<int> m_minLevel{static_cast<int>(LogLevel::Info)};
+    std::atomic<bool> m_running{false};
+    std::atomic<quint64> m_dropped{0};
+    std::atomic<quint64> m_suppressed{0};
+    // GCRA state: theoretical arrival time of the next admitted line.
+    std::atomic<qint64> m_nextAdmitUs{0};
+    qint64 m_emissionIntervalUs = 0;
+    qint64 m_burstToleranceUs = 0;
+
+    std::thread m_worker;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    QFile m_file;
+    quint64 m_reportedDropped = 0;
+};
+
+}  // namespace host
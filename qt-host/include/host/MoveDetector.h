@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace host {
+
+// A region of the current frame that is a pure translation of the previous
+// one: its pixels equal the previous frame's `rect.translated(-offset)`.
+struct MoveRect {
+    QRect rect;
+    QPoint offset;
+};
+
+// Finds scrolls and window moves between consecutive frames by hashing rows
+// of the luma plane inside each dirty rectangle. Vertical scrolls are found by
+// voting on where changed rows reappear in the previous frame; moves by
+// pairing dirty rectangles of equal size (old and new window position). Every
+// candidate is verified row by row, so a reported move is exact.
+class MoveDetector {
+public:
+    // Smallest translated area worth reporting, in rows and pixels.
+    static constexpr int kMinRows = 16;
+    static constexpr int kMinArea = 64 * 64;
+
+    // `previous` and `current` are Y planes with stride == width. Appends at
+    // most one move per dirty rectangle to `moves`.
+    void detect(const std::uint8_t *previous, const std::uint8_t *current, int width, int height,
+                const QVector<QRect> &dirtyRects, QVector<MoveRect> &moves);
+
+private:
+    // Longest run of rows in `rect` whose pixels match the previous frame
+    // shifted by `offset`; empty if shorter than kMinRows.
+    QRect verify(const std::uint8_t *previous, const std::uint8_t *current, int width, int height, const QRect &rect,
+                 const QPoint &offset) const;
+    int voteVerticalShift(const std::uint8_t *previous, const std::uint8_t *current, int width, const QRect &rect);
+
+    // Scratch space reused across frames.
+    std::unordered_map<std::uint64_t, int> m_previousRows;
+    std::unordered_map<int, int> m_votes;
+};
+
+}  // namespace host
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace host {
+
+// Bounded lock-free queue for many producers and one consumer (Vyukov's
+// sequence-numbered ring). tryPush never blocks and fails when the ring is
+// full; only one thread may call tryPop.
+template <typename T>
+class MpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit MpscQueue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots = std::make_unique<Slot[]>(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    bool tryPush(T &&value) {
+        std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[position & m_mask];
+            const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (diff == 0) {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &out) {
+        Slot &slot = m_slots[m_dequeuePosition & m_mask];
+        const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(m_dequeuePosition + 1) < 0) {
+            return false;
+        }
+        out = std::move(slot.value);
+        slot.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+        ++m_dequeuePosition;
+        return true;
+    }
+
+    // Approximate; only meaningful on the consumer thread.
+    bool isEmpty() const {
+        const Slot &slot = m_slots[m_dequeuePosition & m_mask];
+        return slot.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1;
+    }
+
+    std::size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask = 0;
+    alignas(64) std::atomic<std::size_t> m_enqueuePosition{0};
+    alignas(64) std::size_t m_dequeuePosition = 0;
+};
+
+}  // namespace host
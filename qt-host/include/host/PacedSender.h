@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QByteArray>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace host {
+
+// Spreads outgoing RTP packets over time with a token bucket on its own
+// thread, so a key frame leaves as a steady stream instead of one burst that
+// overflows shallow router queues. The bucket refills at pacingFactor times
+// the target bitrate and never holds more than one tick of credit. Audio is
+// sent as soon as it arrives; retransmissions go ahead of queued video.
+class PacedSender {
+public:
+    // Highest priority first.
+    enum class Priority {
+        Audio,
+        Retransmission,
+        Video,
+    };
+
+    struct Config {
+        int bitrateKbps = 4000;
+        // Headroom over the encoder target so a frame drains well before the next one.
+        double pacingFactor = 2.5;
+        // When the backlog would take longer than this to drain, the pacing rate
+        // is raised to meet it; late packets are worth less than a burst.
+        qint64 maxQueueTimeUs = 2000000;
+        qint64 tickUs = 5000;
+    };
+
+    using SendFunction = std::function<void(const QByteArray &packet)>;
+
+    // `send` runs on the pacer thread, without the pacer's lock held.
+    PacedSender(const Config &config, SendFunction send);
+    ~PacedSender();
+
+    PacedSender(const PacedSender &) = delete;
+    PacedSender &operator=(const PacedSender &) = delete;
+
+    // Thread-safe.
+    void enqueue(Priority priority, const QByteArray &packet);
+    // Thread-safe. Video a later frame may replace, such as a static picture's
+    // refinement; queued behind earlier video like any other.
+    void enqueueReplaceable(const QByteArray &packet);
+    // Thread-safe. Drops the replaceable packets queued since the last other
+    // video packet, provided none of them has left yet, and returns how many;
+    // they are always the newest video. 0 when there is nothing to drop.
+    int dropReplaceable();
+    void setBitrate(int kbps);
+    void clear();
+
+    // Time the queued packets need to drain at the current pacing rate. The
+    // rate controller backs off when this grows, before the network drops.
+    // Replaceable packets are left out: they are an overshoot the sender
+    // chose, not congestion.
+    qint64 expectedQueueTimeUs() const;
+    int queuedPackets() const;
+
+private:
+    struct QueuedPacket {
+        QByteArray data;
+        qint64 enqueuedUs = 0;
+        bool replaceable = false;
+    };
+    static constexpr int kPriorityCount = 3;
+
+    void run();
+    // Called with m_mutex held.
+    qint64 nominalRateBps() const;
+    qint64 pacingRateBps() const;
+    qint64 queueTimeUs(qint64 bytes) const;
+    bool takeNext(qint64 nowUs, QueuedPacket &packet);
+
+    Config m_config;
+    SendFunction m_send;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::array<std::deque<QueuedPacket>, kPriorityCount> m_queues;
+    qint64 m_queuedBytes = 0;
+    int m_queuedPackets = 0;
+    // Replaceable packets still queued since the last other video packet.
+    int m_replaceablePackets = 0;
+    qint64 m_replaceableBytes = 0;
+    // One of them has left, so the rest must follow.
+    bool m_replaceableStarted = false;
+    // Bytes that may still be sent this tick; negative after an oversized packet.
+    qint64 m_budgetBytes = 0;
+    qint64 m_lastRefillUs = 0;
+    bool m_running = true;
+    std::thread m_worker;
+};
+
+}  // namespace host
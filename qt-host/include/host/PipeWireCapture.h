@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+#include <cstdint>
+
+#include <spa/utils/hook.h>
+
+#include "host/VideoSource.h"
+
+struct pw_buffer;
+struct pw_context;
+struct pw_core;
+struct pw_stream;
+struct pw_thread_loop;
+struct spa_buffer;
+struct spa_pod;
+struct spa_source;
+
+namespace host {
+
+// Linux desktop capture through the xdg-desktop-portal ScreenCast interface,
+// which is the only way in on Wayland. Only shared-memory BGRx/BGRA buffers
+// are negotiated; PipeWire maps them and they are converted to I420 or I444
+// straight from the mapping, only in the rows the compositor reports as
+// damaged. The cursor arrives as metadata and is blended into the picture here.
+//
+// The portal's own dialog picks the monitor, so the screen index is ignored.
+// HOST_PIPEWIRE_NODE=<id> skips the portal and connects to that node on the
+// default PipeWire daemon instead.
+class PipeWireCapture : public VideoSource {
+    Q_OBJECT
+public:
+    explicit PipeWireCapture(QObject *parent = nullptr);
+    ~PipeWireCapture() override;
+
+    void setScreenIndex(int index) override;
+    void setFrameRate(int fps) override;
+    void setCaptureRegion(const QRect &region) override;
+    void setPixelFormat(PixelFormat format) override;
+
+    bool start() override;
+    void stop() override;
+
+private slots:
+    void onPortalResponse(uint response, const QVariantMap &results);
+
+private:
+    enum class PortalStep {
+        None,
+        CreateSession,
+        SelectSources,
+        Start,
+    };
+
+    struct Cursor {
+        bool visible = false;
+        QPoint position;
+        QPoint hotspot;
+        QSize size;
+        // Tightly packed BGRA, straight alpha.
+        QByteArray image;
+    };
+
+    // Portal handshake (GUI thread).
+    bool requestSession();
+    bool callPortal(PortalStep step, const QString &method, QVariantList arguments, QVariantMap options);
+    void watchRequest(const QString &path);
+    void unwatchRequest();
+    uint availableCursorModes() const;
+    int openPipeWireRemote();
+    void closeSession();
+
+    bool openStream(int fd, uint node);
+    void closeStream();
+
+    // Stream callbacks; everything below runs on the PipeWire loop thread.
+    struct Callbacks;
+    friend struct Callbacks;
+    void streamFailed(const QString &message);
+    void formatChanged(const spa_pod *param);
+    void accept(pw_buffer *buffer);
+    void readCursor(spa_buffer *buffer);
+    void addDamage(spa_buffer *buffer);
+    void schedule();
+    void deliver();
+    void drawCursor(std::uint8_t *yuv, QVector<QRect> &dirty);
+
+    std::atomic<bool> m_running{false};
+    std::atomic<qint64> m_intervalUs{0};
+
+    PortalStep m_step = PortalStep::None;
+    QString m_requestPath;
+    QString m_session;
+    uint m_cursorMode = 0;
+
+    pw_thread_loop *m_loop = nullptr;
+    pw_context *m_context = nullptr;
+    pw_core *m_core = nullptr;
+    pw_stream *m_stream = nullptr;
+    spa_hook m_streamListener{};
+    spa_source *m_timer = nullptr;
+
+    // Guarded by the loop lock.
+    QRect m_region;
+    PixelFormat m_pixelFormat = PixelFormat::I420;
+    QSize m_streamSize;
+    pw_buffer *m_held = nullptr;
+    QVector<QRect> m_damage;
+    bool m_fullDamage = true;
+    bool m_cursorChanged = false;
+    qint64 m_lastDeliveryUs = 0;
+    Cursor m_cursor;
+    QByteArray m_frame;
+    QRect m_frameRect;
+    PixelFormat m_frameFormat = PixelFormat::I420;
+    // Pixels under the blended cursor, so it can be taken out again.
+    QByteArray m_underCursor;
+    QRect m_underCursorRect;
+};
+
+}  // namespace host
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QtGlobal>
+#include <cstdint>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// Objective quality of a decoded picture against its source. PSNR is in dB,
+// capped at kMaxPsnr for identical planes; SSIM is 0..1 over 8x8 windows on a
+// 4-pixel grid (as libvpx and x264 compute it).
+struct QualityScore {
+    static constexpr double kMaxPsnr = 100.0;
+
+    // Over all three planes, from their summed squared error.
+    double psnr = 0;
+    double psnrY = 0;
+    double psnrU = 0;
+    double psnrV = 0;
+    // 0.8 Y + 0.1 U + 0.1 V.
+    double ssim = 0;
+    double ssimY = 0;
+};
+
+// Both frames I420, or both I444, of the same size with stride == width.
+// Returns false when they do not match.
+bool measureQuality(const VideoFrame &reference, const VideoFrame &distorted, QualityScore &score);
+
+// Single planes. AVX2 where the CPU has it, scalar otherwise; both give the
+// same result.
+quint64 planeSquaredError(const std::uint8_t *reference, const std::uint8_t *distorted, int width, int height,
+                          int stride);
+double planeSsim(const std::uint8_t *reference, const std::uint8_t *distorted, int width, int height, int stride);
+double psnrFromSquaredError(quint64 squaredError, qint64 samples);
+
+// Whether the AVX2 kernels are in use on this machine.
+bool qualityMetricsUseAvx2();
+
+}  // namespace host
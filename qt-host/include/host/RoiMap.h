@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+#include <QtGlobal>
+
+namespace host {
+
+// Per-macroblock QP offsets that move encoder quality to where the user is
+// working. Focus comes from the viewer's pointer and from screen changes that
+// answer its input (typed text, an opened menu); damage nobody asked for, such
+// as a clock or a playing video, gets none. Macroblocks near a focus get a
+// negative offset, the rest a positive one, so rate control spends the same
+// total bitrate on a sharper working area.
+class RoiMap {
+public:
+    static constexpr int kMacroblockSize = 16;
+    static constexpr int kMaxStrength = 6;
+
+    // Largest offset either way, 0 = uniform quality. Not thread-safe.
+    void setStrength(int strength) { m_strength = qBound(0, strength, kMaxStrength); }
+    int strength() const { return m_strength; }
+    bool isEnabled() const { return m_strength > 0; }
+
+    // Any thread. Pointer position normalized to the video, 0..1 on each axis.
+    void notePointer(double x, double y, qint64 nowUs);
+    // Any thread. A click, key or wheel event: what changes right after it is
+    // the answer to it.
+    void noteInput(qint64 nowUs);
+
+    // Capture thread, once per frame. Fills `offsets` row-major, one per
+    // macroblock, or clears it while there is no focus yet. `dirtyRects` are
+    // the frame's changes in pixels.
+    void build(int width, int height, const QVector<QRect> &dirtyRects, qint64 nowUs, QVector<qint8> &offsets);
+
+private:
+    // Normalized to the video so a focus survives a change of frame size.
+    struct Focus {
+        double left = 0;
+        double top = 0;
+        double right = 0;
+        double bottom = 0;
+        qint64 atUs = 0;
+    };
+
+    void addFocus(const Focus &focus);
+
+    int m_strength = 0;
+    QMutex m_mutex;
+    bool m_hasPointer = false;
+    Focus m_pointer;
+    qint64 m_lastInputUs = 0;
+    // Capture thread only.
+    QVector<Focus> m_areas;
+};
+
+}  // namespace host
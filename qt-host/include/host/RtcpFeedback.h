@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+namespace host {
+
+// What a viewer's RTCP says about one of our media SSRCs.
+struct RtcpFeedback {
+    QVector<quint16> nackedSequences;
+    bool keyFrameRequested = false;
+    bool hasReportBlock = false;
+    // From the last receiver report block: fraction lost in 1/256 units and
+    // interarrival jitter in RTP clock units.
+    quint8 fractionLost = 0;
+    quint32 jitter = 0;
+};
+
+// Walks a compound RTCP packet and collects receiver reports (SR/RR), generic
+// NACKs (RFC 4585) and PLI/FIR addressed to `mediaSsrc`. Returns false if the
+// packet is malformed; anything parsed before the error is kept.
+bool parseRtcpFeedback(const QByteArray &compound, quint32 mediaSsrc, RtcpFeedback &feedback);
+
+}  // namespace host
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+namespace host {
+
+// Recently sent RTP packets of one SSRC, kept for NACK retransmission. A ring
+// indexed by sequence number: inserting overwrites whatever was stored
+// `capacity` packets ago. Not thread safe.
+class RtpPacketHistory {
+public:
+    // Capacity is rounded up to a power of two. Packets older than maxAgeUs are
+    // not retransmitted; by then the receiver has given up on them.
+    explicit RtpPacketHistory(int capacity = 1024, qint64 maxAgeUs = 1000000);
+
+    void insert(quint16 sequence, const QByteArray &packet, qint64 sentUs);
+
+    // Returns the stored packet, or an empty array if it is unknown, too old, or
+    // was already resent within minIntervalUs (one RTT keeps a burst of NACKs
+    // for the same packet from multiplying the repair traffic).
+    QByteArray takeForRetransmit(quint16 sequence, qint64 nowUs, qint64 minIntervalUs);
+
+    void clear();
+    int capacity() const { return static_cast<int>(m_entries.size()); }
+
+private:
+    struct Entry {
+        QByteArray packet;
+        qint64 sentUs = 0;
+        qint64 resentUs = 0;
+        quint16 sequence = 0;
+        bool valid = false;
+    };
+
+    QVector<Entry> m_entries;
+    quint16 m_mask = 0;
+    qint64 m_maxAgeUs = 0;
+};
+
+}  // namespace host
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// H.264: RFC 6184 packetization mode 1, single NAL unit packets and FU-A for
+// NAL units larger than the MTU; STAP-A is not used.
+// AV1: the AV1 RTP payload format, OBU elements behind a one-byte aggregation
+// header, each with a length prefix and fragmented across packets as needed.
+class RtpPacketizer {
+public:
+    enum class Format {
+        H264,
+        AV1,
+    };
+
+    struct Config {
+        quint32 ssrc = 0;
+        quint8 payloadType = 96;
+        int mtu = 1200;
+        Format format = Format::H264;
+    };
+
+    static constexpr int kHeaderSize = 12;
+    static constexpr int kClockRate = 90000;
+
+    RtpPacketizer();
+    explicit RtpPacketizer(const Config &config);
+
+    void setConfig(const Config &config);
+    const Config &config() const { return m_config; }
+
+    // Appends the RTP packets for one access unit to `packets`. The marker bit
+    // is set on the last packet.
+    void packetize(const EncodedFrame &frame, QList<QByteArray> &packets);
+
+    // Packetizes bytes [begin, end) of the access unit, which must start on a
+    // start code or OBU header (e.g. one slice). The marker bit is set only if
+    // `lastOfFrame`.
+    void packetize(const EncodedFrame &frame, int begin, int end, bool lastOfFrame, QList<QByteArray> &packets);
+
+    quint16 nextSequence() const { return m_sequence; }
+
+private:
+    QByteArray makePacket(quint32 timestamp, bool marker, int payloadSize);
+    void packetizeH264(const char *data, int size, quint32 timestamp, bool lastOfFrame, QList<QByteArray> &packets);
+    void packetizeAv1(const char *data, int size, quint32 timestamp, bool newSequence, bool lastOfFrame,
+                      QList<QByteArray> &packets);
+
+    Config m_config;
+    quint16 m_sequence = 0;
+};
+
+}  // namespace host
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// On-disk layout of a recorded session. All integers are little-endian and
+// every record starts on an 8-byte boundary so the file can be mapped and read
+// in place:
+//
+//   FileHeader
+//   { RecordHeader, payload, padding to 8 }...
+//
+// Frame payload: FrameRecord, rectCount x RectRecord, I420 pixels (I444 with
+// kFrameI444; omitted when kFrameRepeat is set). Input payload: the UTF-8 JSON message as received
+// on the "input" data channel.
+namespace recording {
+inline constexpr char kMagic[8] = {'R', 'D', 'S', 'R', 'E', 'C', '1', '\0'};
+inline constexpr quint32 kVersion = 1;
+
+enum RecordType : quint32 {
+    kRecordFrame = 1,
+    kRecordInput = 2,
+};
+
+enum FrameFlags : quint32 {
+    // Nothing changed: the pixels are those of the previous frame.
+    kFrameRepeat = 1u << 0,
+    kFrameI444 = 1u << 1,
+};
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+};
+
+struct RecordHeader {
+    quint32 type;
+    quint32 payloadSize;
+    qint64 timestampUs;
+};
+
+struct FrameRecord {
+    qint32 width;
+    qint32 height;
+    quint32 flags;
+    quint32 rectCount;
+};
+
+struct RectRecord {
+    qint32 x;
+    qint32 y;
+    qint32 width;
+    qint32 height;
+};
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader must stay packed");
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must stay packed");
+static_assert(sizeof(FrameRecord) == 16, "FrameRecord must stay packed");
+static_assert(sizeof(RectRecord) == 16, "RectRecord must stay packed");
+
+inline int paddedSize(int size) { return (size + 7) & ~7; }
+}  // namespace recording
+
+// Appends captured frames and received input messages to a session file.
+// Safe to call from the capture thread and the data channel thread at once.
+class SessionRecorder {
+public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    void writeFrame(const QByteArray &pixels, PixelFormat format, int width, int height, qint64 timestampUs,
+                    const QVector<QRect> &dirtyRects);
+    void writeInput(const QByteArray &message, qint64 timestampUs);
+
+    qint64 bytesWritten() const;
+
+private:
+    void writeRecord(quint32 type, qint64 timestampUs, const QByteArray &head, const char *body, int bodySize);
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    qint64 m_bytesWritten = 0;
+};
+
+}  // namespace host
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QTimer>
+#include <QVector>
+
+#include "host/VideoFrame.h"
+#include "host/VideoSource.h"
+
+namespace host {
+
+// Plays back a file written by SessionRecorder. The file is memory-mapped and
+// frames are handed out without copying the pixels.
+class SessionReplaySource : public VideoSource {
+    Q_OBJECT
+public:
+    enum class Pacing {
+        // Honour the recorded timestamps.
+        Recorded,
+        // Emit records back to back, as fast as the event loop allows.
+        FullSpeed,
+    };
+
+    explicit SessionReplaySource(QObject *parent = nullptr);
+    ~SessionReplaySource() override;
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return m_map != nullptr; }
+
+    void setPacing(Pacing pacing) { m_pacing = pacing; }
+    void setLoop(bool loop) { m_loop = loop; }
+
+    int frameCount() const { return m_frameCount; }
+    int inputCount() const { return m_records.size() - m_frameCount; }
+
+    // Pull API for offline use (benchmarks): fills `frame` with the next frame
+    // record, skipping input records. Returns false at the end of the file.
+    bool readNextFrame(VideoFrame &frame);
+    void rewind();
+
+    void setScreenIndex(int index) override;
+    void setFrameRate(int fps) override;
+    void setCaptureRegion(const QRect &region) override;
+
+    bool start() override;
+    void stop() override;
+
+signals:
+    void inputEventReplayed(const QJsonObject &event);
+    void finished();
+
+private slots:
+    void emitDue();
+
+private:
+    struct Record {
+        quint32 type = 0;
+        qint64 timestampUs = 0;
+        const uchar *payload = nullptr;
+        quint32 payloadSize = 0;
+    };
+
+    bool decodeFrame(const Record &record, VideoFrame &frame);
+    void scheduleNext();
+
+    QFile m_file;
+    uchar *m_map = nullptr;
+    QVector<Record> m_records;
+    int m_frameCount = 0;
+    int m_position = 0;
+    QByteArray m_lastPixels;
+    Pacing m_pacing = Pacing::Recorded;
+    bool m_loop = false;
+    bool m_running = false;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_baseTimestampUs = 0;
+};
+
+}  // namespace host
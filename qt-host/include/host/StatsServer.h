@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <memory>
+
+class QTcpServer;
+class QTcpSocket;
+
+namespace host {
+
+// Serves HostStats on 127.0.0.1: GET /metrics (Prometheus text format) and
+// GET /stats (JSON). Also drives HostStats::sample() once a second.
+class StatsServer : public QObject {
+    Q_OBJECT
+public:
+    explicit StatsServer(QObject *parent = nullptr);
+    ~StatsServer() override;
+
+    bool listen(quint16 port);
+    quint16 port() const;
+
+signals:
+    void logMessage(const QString &line);
+
+private:
+    void handleConnection();
+    void respond(QTcpSocket *socket);
+
+    std::unique_ptr<QTcpServer> m_server;
+    QTimer m_sampleTimer;
+};
+
+}  // namespace host
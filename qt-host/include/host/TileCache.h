@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QPoint>
+#include <QVector>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// Host half of a bitmap cache shared with the viewer, in the spirit of RDP's.
+// The frame is cut into fixed tiles identified by a hash of their YUV
+// content. Once a tile has been on the viewer's screen for a frame it is
+// assigned a slot, and the viewer copies it there; the host only keeps the
+// hashes, in LRU order. When every tile that changed in a frame is already in
+// a slot, the frame need not be encoded: the viewer redraws it from its slots.
+class TileCache {
+public:
+    static constexpr int kTileSize = 64;
+    // Viewer memory per slot (one RGBA tile); budgets are counted in these.
+    static constexpr qint64 kSlotBytes = qint64(kTileSize) * kTileSize * 4;
+
+    struct TileRef {
+        int slot = 0;
+        // Top-left pixel; edge tiles are clipped to the frame.
+        QPoint position;
+    };
+
+    struct Result {
+        // Every changed tile was a hit: the frame can be sent as `draws` alone.
+        bool cached = false;
+        // Tiles the viewer should copy from its current picture into a slot.
+        QVector<TileRef> stores;
+        // Slots to paint over the current picture instead of a video frame.
+        QVector<TileRef> draws;
+        int lookups = 0;
+        int hits = 0;
+
+        bool hasMessage() const { return !stores.isEmpty() || !draws.isEmpty(); }
+    };
+
+    enum class Outcome {
+        Encoded,
+        // Replaced by Result::draws.
+        Drawn,
+        // Not shown to the viewer (encoder skipped or failed).
+        Dropped,
+    };
+
+    // Keeps the current contents if the slot count does not change.
+    void setBudget(qint64 bytes);
+    bool isEnabled() const { return m_capacity > 0; }
+    int capacity() const { return m_capacity; }
+    void clear();
+
+    // Hashes the tiles touched by the frame's dirty rectangles and fills
+    // `result`. `picture` is I420 or I444 with stride == width. Must be followed by commit() with
+    // what became of the frame.
+    void lookup(const VideoFrame &picture, Result &result);
+    void commit(Outcome outcome);
+
+private:
+    static constexpr int kNone = -1;
+
+    struct Slot {
+        std::uint64_t hash = 0;
+        int newer = kNone;
+        int older = kNone;
+    };
+
+    void resize(int width, int height);
+    int find(std::uint64_t hash);
+    int insert(std::uint64_t hash);
+    void unlink(int slot);
+    void pushNewest(int slot);
+
+    // LRU of slots, newest first.
+    int m_capacity = 0;
+    std::vector<Slot> m_slots;
+    std::unordered_map<std::uint64_t, int> m_index;
+    int m_newest = kNone;
+    int m_oldest = kNone;
+
+    // Per tile position.
+    int m_width = 0;
+    int m_height = 0;
+    int m_columns = 0;
+    std::vector<std::uint64_t> m_shown;
+    std::vector<std::uint64_t> m_current;
+    std::vector<quint32> m_examined;
+    quint32 m_generation = 0;
+    // Positions hashed in the current frame.
+    std::vector<int> m_touched;
+    // Positions whose shown content came from video and is not cached yet.
+    std::vector<int> m_pending;
+    // Positions that changed in the frame awaiting commit().
+    std::vector<int> m_changed;
+};
+
+}  // namespace host
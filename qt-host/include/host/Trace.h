@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Scoped trace events for the hot path. Build with HOST_ENABLE_TRACING (CMake
+// option of the same name) to compile them in; otherwise HOST_TRACE_SCOPE
+// expands to nothing. When compiled in but not recording, a scope costs one
+// relaxed atomic load.
+//
+//   void encode() {
+//       HOST_TRACE_SCOPE("encode");
+//       ...
+//   }
+
+namespace host::trace {
+
+enum class Format {
+    ChromeJson,
+    Perfetto,
+};
+
+#ifdef HOST_ENABLE_TRACING
+extern std::atomic<bool> g_recording;
+
+inline std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Appends a complete slice to the calling thread's buffer. `name` must be a
+// string literal (only the pointer is stored).
+void record(const char *name, std::int64_t startNs, std::int64_t endNs);
+
+class Scope {
+public:
+    explicit Scope(const char *name)
+        : m_name(g_recording.load(std::memory_order_relaxed) ? name : nullptr), m_startNs(m_name ? nowNs() : 0) {}
+    ~Scope() {
+        if (m_name) {
+            record(m_name, m_startNs, nowNs());
+        }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *m_name;
+    std::int64_t m_startNs;
+};
+#endif
+
+// Names the calling thread in exported traces. `name` must outlive the trace.
+void setThreadName(const char *name);
+
+void start();
+void stop();
+bool isAvailable();
+
+// Writes everything buffered so far. Call after stop().
+bool exportTo(const QString &path, Format format, QString *error = nullptr);
+
+}  // namespace host::trace
+
+#ifdef HOST_ENABLE_TRACING
+#define HOST_TRACE_CONCAT_INNER(a, b) a##b
+#define HOST_TRACE_CONCAT(a, b) HOST_TRACE_CONCAT_INNER(a, b)
+#define HOST_TRACE_SCOPE(name) ::host::trace::Scope HOST_TRACE_CONCAT(hostTraceScope, __LINE__)(name)
+#else
+#define HOST_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
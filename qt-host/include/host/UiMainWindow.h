@@ -2,12 +2,15 @@
 
 #include <QJsonObject>
 #include <QMainWindow>
+#include <QRect>
 #include <QString>
 #include <QTimer>
 #include <functional>
 #include <memory>
+#include <optional>
 
 #include "host/IceConfig.h"
+#include "host/VideoEncoder.h"
 
 QT_BEGIN_NAMESPACE
 class QLabel;
@@ -15,7 +18,6 @@ class QLineEdit;
 class QPushButton;
 class QComboBox;
 class QCheckBox;
-class QTextEdit;
 class QSystemTrayIcon;
 class QNetworkAccessManager;
 QT_END_NAMESPACE
@@ -25,6 +27,8 @@ namespace host {
 class AuthClient;
 class SignalingClient;
 class WebRtcPeer;
+class StatsServer;
+class LogView;
 
 struct DeviceCodeInfo {
     QString deviceCode;
@@ -42,7 +46,27 @@ public:
 
     void setInitialCode(const QString &code);
     void setInitialScreenIndex(int index);
+    // Preselects the first window whose title contains `text`.
+    void setCaptureWindowTitle(const QString &text);
+    // Shares this part of the screen when no window is selected.
+    void setCaptureRect(const QRect &rect);
     void setAllowControlDefault(bool enabled);
+    void setRecordPath(const QString &path);
+    void setReplayPath(const QString &path);
+    void setStatsPort(int port);
+    void setVideoSlices(int slices);
+    void setTileCacheMb(int megabytes);
+    void setIdleFps(int fps);
+    void setRoiStrength(int strength);
+    // 0 selects "Auto".
+    void setDefaultFps(int fps);
+    // Empty = chosen by the capability probe.
+    void setVideoCodec(std::optional<VideoEncoder::Codec> codec);
+    void setFullChroma(bool enabled);
+    void setRefineAfterMs(int milliseconds);
+    void setQualitySampleInterval(int frames);
+    // Empty = no file transfer.
+    void setFileDirectory(const QString &directory);
 
 signals:
     void appTokenAvailable(const QString &token);
@@ -66,6 +90,7 @@ private:
     void updateDeviceCodeUi(const DeviceCodeInfo &info);
     void updateStatus(const QString &text);
     void enableUi(bool enabled);
+    void refreshWindowList();
     void createPeerIfNeeded();
     void destroyPeer();
     void joinRealtimeChannel(const QString &sessionId);
@@ -73,6 +98,7 @@ private:
     std::unique_ptr<AuthClient> m_authClient;
     std::unique_ptr<SignalingClient> m_signalingClient;
     std::unique_ptr<WebRtcPeer> m_peer;
+    std::unique_ptr<StatsServer> m_statsServer;
     std::unique_ptr<QNetworkAccessManager> m_network;
 
     QLabel *m_deviceCodeLabel = nullptr;
@@ -82,9 +108,10 @@ private:
     QPushButton *m_joinButton = nullptr;
     QPushButton *m_disconnectButton = nullptr;
     QComboBox *m_screenCombo = nullptr;
+    QComboBox *m_windowCombo = nullptr;
     QComboBox *m_fpsCombo = nullptr;
     QCheckBox *m_allowControlCheck = nullptr;
-    QTextEdit *m_logView = nullptr;
+    LogView *m_logView = nullptr;
     QSystemTrayIcon *m_trayIcon = nullptr;
 
     QTimer m_pollTimer;
@@ -93,8 +120,20 @@ private:
     QString m_sessionId;
     QString m_initialCode;
     int m_initialScreenIndex = 0;
+    QRect m_captureRect;
     bool m_initialAllowControl = false;
     bool m_allowControl = false;
+    QString m_recordPath;
+    QString m_replayPath;
+    int m_videoSlices = 1;
+    int m_tileCacheMb = 64;
+    int m_idleFps = 1;
+    int m_roiStrength = 0;
+    std::optional<VideoEncoder::Codec> m_videoCodec = VideoEncoder::Codec::H264;
+    bool m_fullChroma = false;
+    int m_refineAfterMs = 0;
+    int m_qualitySampleInterval = 0;
+    QString m_fileDirectory;
     QString m_realtimeEndpoint;
     QString m_realtimeApiKey;
     QString m_realtimeTopic;
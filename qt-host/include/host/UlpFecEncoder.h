@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+
+namespace host {
+
+// RFC 5109 ULPFEC with a single protection level covering whole packets, as
+// negotiated by browsers under "ulpfec" (carried inside RFC 2198 RED). Each
+// FEC packet is the XOR of an interleaved subset of a block of consecutive
+// media packets and can rebuild any one of them.
+class UlpFecEncoder {
+public:
+    // Largest block a 48-bit mask can describe.
+    static constexpr int kMaxBlockPackets = 48;
+
+    // FEC packets per media packet, clamped to [0, 0.5]. 0 disables FEC.
+    void setProtectionRate(double rate);
+    double protectionRate() const { return m_rate; }
+
+    // Redundancy for a given loss fraction (0..1): none on a clean link, then
+    // enough that one loss per group is the common case.
+    static double rateForLoss(double lossFraction);
+
+    // Appends FEC payloads (FEC header, level 0 header, XOR data) for `media`,
+    // which must be complete RTP packets with 12-byte headers and consecutive
+    // sequence numbers. The caller wraps each payload in RED and RTP.
+    void encode(const QList<QByteArray> &media, QList<QByteArray> &fecPayloads) const;
+
+private:
+    void encodeBlock(const QList<QByteArray> &media, int first, int count, QList<QByteArray> &fecPayloads) const;
+
+    double m_rate = 0.0;
+};
+
+}  // namespace host
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QString>
+#include <memory>
+
+#include "host/VideoEncoder.h"
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// Decodes the host's own stream, for measuring what the viewer sees. Uses the
+// decoder of the library that provides the encoder.
+class VideoDecoder {
+public:
+    virtual ~VideoDecoder() = default;
+
+    virtual bool initialize() = 0;
+    // Decodes one encoded frame into `out` as packed I420 or I444. Returns false
+    // on error, true with empty data while there is no picture yet. Every
+    // encoded frame must pass through, in order.
+    virtual bool decode(const EncodedFrame &frame, VideoFrame &out) = 0;
+    virtual QString name() const = 0;
+
+    // Returns nullptr when no decoder for the codec was compiled in.
+    static std::unique_ptr<VideoDecoder> create(VideoEncoder::Codec codec);
+};
+
+}  // namespace host
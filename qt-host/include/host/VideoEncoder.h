@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <memory>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+class VideoEncoder {
+public:
+    enum class Codec {
+        H264,
+        AV1,
+    };
+
+    struct Config {
+        int width = 0;
+        int height = 0;
+        int fps = 30;
+        int bitrateKbps = 4000;
+        int threads = 1;
+        // More than one: each picture is cut into this many row slices, encoded
+        // in parallel and reported through EncodedFrame::sliceEnds. H.264 only;
+        // AV1 splits the picture into tile columns by thread count instead.
+        int slices = 1;
+        // I420, or I444 where supportsFormat() allows it.
+        PixelFormat format = PixelFormat::I420;
+    };
+
+    virtual ~VideoEncoder() = default;
+
+    virtual bool initialize(const Config &config) = 0;
+    // Encodes one frame in the configured format. Returns false on error; an empty output means
+    // the encoder decided to skip the frame.
+    virtual bool encode(const VideoFrame &frame, bool forceKeyFrame, EncodedFrame &out) = 0;
+    virtual void setBitrate(int kbps) = 0;
+    // Per-macroblock (16x16) QP offsets for the following frames, row-major;
+    // negative means better quality. An empty map, or one that does not match
+    // the frame size, means uniform quality. Encoders without a QP map input
+    // may approximate it by pre-filtering the picture, which is lossy.
+    virtual void setQpOffsets(const QVector<qint8> &offsets) { Q_UNUSED(offsets); }
+    // While the picture is static: spend bits on bringing it to lossless (AV1)
+    // or near-lossless (H.264) quality instead of holding the bitrate. The
+    // refinement is an inter frame; the caller switches this off before
+    // encoding the next change.
+    virtual void setRefining(bool refining) { Q_UNUSED(refining); }
+    virtual QString name() const = 0;
+
+    // Returns nullptr when no backend for the codec was compiled in.
+    static std::unique_ptr<VideoEncoder> create(Codec codec);
+    static bool isAvailable(Codec codec);
+    // 4:4:4 needs AV1 High profile; OpenH264 only does 4:2:0.
+    static bool supportsFormat(Codec codec, PixelFormat format);
+};
+
+}  // namespace host
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QRect>
+#include <QVector>
+
+namespace host {
+
+enum class PixelFormat {
+    Bgra,
+    I420,
+    // Full-resolution chroma, for coloured text and thin lines.
+    I444,
+};
+
+// A single captured picture. I420 and I444 frames are stored as contiguous Y,
+// U, V planes; I420 chroma planes have half the width and height (stride
+// width / 2), I444 ones are the size of the luma plane.
+struct VideoFrame {
+    PixelFormat format = PixelFormat::Bgra;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    qint64 timestampUs = 0;
+    QByteArray data;
+    // Regions that changed since the previous frame. Sources that do not track
+    // damage report a single rect covering the frame; empty means unchanged.
+    QVector<QRect> dirtyRects;
+};
+
+struct EncodedFrame {
+    // Annex-B byte stream for H.264, one temporal unit of OBUs (low-overhead
+    // bitstream format) for AV1.
+    QByteArray data;
+    qint64 timestampUs = 0;
+    bool keyFrame = false;
+    // End offset in `data` of each slice, in order; parameter sets travel with
+    // the first. Empty when the frame was encoded as a single slice.
+    QVector<int> sliceEnds;
+};
+
+inline int i420FrameSize(int width, int height) {
+    return width * height + 2 * ((width / 2) * (height / 2));
+}
+
+inline int i444FrameSize(int width, int height) { return 3 * width * height; }
+
+// I420 or I444.
+inline int yuvFrameSize(PixelFormat format, int width, int height) {
+    return format == PixelFormat::I444 ? i444FrameSize(width, height) : i420FrameSize(width, height);
+}
+
+}  // namespace host
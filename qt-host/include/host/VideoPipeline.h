@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "host/RtpPacketizer.h"
+#include "host/MoveDetector.h"
+#include "host/QualityMetrics.h"
+#include "host/TileCache.h"
+#include "host/VideoDecoder.h"
+#include "host/VideoEncoder.h"
+#include "host/VideoFrame.h"
+#include "host/WorkerPool.h"
+
+namespace host {
+
+// Convert -> encode -> packetize for one video stream. Not thread safe; the
+// owner drives it from a single thread.
+class VideoPipeline {
+public:
+    struct Config {
+        int width = 0;
+        int height = 0;
+        int fps = 30;
+        int bitrateKbps = 4000;
+        VideoEncoder::Codec codec = VideoEncoder::Codec::H264;
+        RtpPacketizer::Config rtp;
+        // Row slices per picture. Each slice is packetized and handed on
+        // before the next, so more slices means the first packets leave
+        // sooner (low-latency mode), at some cost in compression.
+        int slices = 1;
+        // Threads for conversion and encoding, 0 = one per core. BGRA input is
+        // converted in at least this many row bands; the encoder gets as many
+        // threads but no extra slices.
+        int threads = 0;
+        // Look for scrolls and window moves inside the dirty rectangles.
+        bool detectMoves = true;
+        // Viewer memory for cached tiles, 0 = no tile cache. Frames whose
+        // changes are all cached tiles are not encoded; see TileCache.
+        qint64 tileCacheBytes = 0;
+        // What the encoder is fed: I420, or I444 for codecs that support it.
+        // Input in the other YUV layout is converted.
+        PixelFormat format = PixelFormat::I420;
+        // Once the picture has been static this long, one more inter frame
+        // brings it to (near-)lossless quality; see VideoEncoder::setRefining.
+        // 0 = never.
+        int refineAfterMs = 0;
+        // Decode the output locally and compare 1 in this many pictures with
+        // the encoder's input (PSNR/SSIM, see lastQuality()); 0 = off. Every
+        // frame is decoded to keep the decoder's references, after its
+        // packets have been handed on.
+        int qualitySampleInterval = 0;
+    };
+
+    struct Timing {
+        qint64 convertUs = 0;
+        qint64 encodeUs = 0;
+        qint64 packetizeUs = 0;
+        int encodedBytes = 0;
+        int packetCount = 0;
+        bool keyFrame = false;
+        // From entering process() to the first slice's packets being handed on.
+        qint64 firstSliceUs = 0;
+        // Sent as tile cache draws instead of video.
+        bool fromTileCache = false;
+        // Encoded as the lossless refinement of a static picture.
+        bool refined = false;
+        // Local decoding and quality measurement, not part of the latency above.
+        qint64 qualityUs = 0;
+    };
+
+    // Receives each slice's packets as soon as they exist: `packets[first..]`.
+    // The packets may be modified in place (e.g. renumbered) and stay in the list.
+    using SliceSink = std::function<void(QList<QByteArray> &packets, int first)>;
+
+    VideoPipeline();
+    ~VideoPipeline();
+
+    bool initialize(const Config &config);
+    bool isInitialized() const { return m_encoder != nullptr; }
+    QString encoderName() const;
+    int threadCount() const { return m_pool ? m_pool->threadCount() : 1; }
+
+    // Runs one captured frame (BGRA, I420 or I444) through the pipeline and appends
+    // the resulting RTP packets to `packets`, calling `onSlice` after each slice.
+    bool process(const VideoFrame &frame, QList<QByteArray> &packets, bool forceKeyFrame = false,
+                 const SliceSink &onSlice = {});
+
+    void setBitrate(int kbps);
+    void setTileCacheBytes(qint64 bytes);
+    // Per-macroblock QP offsets for the following frames; see
+    // VideoEncoder::setQpOffsets.
+    void setQpOffsets(const QVector<qint8> &offsets);
+    const Timing &lastTiming() const { return m_timing; }
+    // Translations found in the last processed frame, relative to the one before.
+    const QVector<MoveRect> &lastMoves() const { return m_moves; }
+    // Tile stores and draws for the last processed frame; when `cached` is set
+    // no packets were produced and the viewer must paint the draws instead.
+    const TileCache::Result &lastTiles() const { return m_tiles; }
+    // Set when the last processed frame was sampled for quality.
+    const std::optional<QualityScore> &lastQuality() const { return m_quality; }
+
+private:
+    void convert(const VideoFrame &frame);
+    void detectMoves(const VideoFrame &picture);
+    void retainReference(const VideoFrame &picture);
+    bool lookupTiles(const VideoFrame &picture, bool forceKeyFrame);
+    bool updateRefinement(const VideoFrame &picture);
+    void sampleQuality(const VideoFrame &source);
+    void commitTiles(TileCache::Outcome outcome);
+
+    Config m_config;
+    std::unique_ptr<WorkerPool> m_pool;
+    std::unique_ptr<VideoEncoder> m_encoder;
+    RtpPacketizer m_packetizer;
+    // Conversion output, in m_config.format.
+    VideoFrame m_picture;
+    // Previous picture for move detection: swapped with m_picture's buffer,
+    // or a shallow copy of the caller's frame.
+    QByteArray m_reference;
+    MoveDetector m_moveDetector;
+    QVector<MoveRect> m_moves;
+    TileCache m_tileCache;
+    TileCache::Result m_tiles;
+    EncodedFrame m_encoded;
+    Timing m_timing;
+    // Timestamp of the last change, -1 before the first frame.
+    qint64 m_staticSinceUs = -1;
+    bool m_refining = false;
+    std::unique_ptr<VideoDecoder> m_decoder;
+    VideoFrame m_decoded;
+    int m_decodedFrames = 0;
+    std::optional<QualityScore> m_quality;
+};
+
+}  // namespace host
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <atomic>
+#include <functional>
+
+#include "host/RtpPacketHistory.h"
+#include "host/UlpFecEncoder.h"
+#include "host/VideoPipeline.h"
+
+namespace host {
+
+// One outgoing video SSRC: runs frames through the pipeline, owns the wire
+// sequence numbers, keeps a packet history for NACKs and adds ULPFEC in RED
+// when the viewer negotiated it. Transport-agnostic; packets leave through the
+// send function.
+class VideoSender {
+public:
+    struct Config {
+        VideoPipeline::Config pipeline;
+        // Payload types from the viewer's offer, or -1 when absent. FEC needs both.
+        int redPayloadType = -1;
+        int ulpfecPayloadType = -1;
+        int historyPackets = 1024;
+    };
+
+    enum class PacketKind {
+        Media,
+        // Resent for a NACK; a pacer should send it ahead of new media.
+        Retransmission,
+        // Part of a static picture's refinement, which the next change may
+        // replace while none of it has left; see dropUnsent().
+        Refinement,
+    };
+
+    using SendFunction = std::function<void(const QByteArray &packet, PacketKind kind)>;
+
+    VideoSender();
+    ~VideoSender();
+
+    // `send` is called with the sender's lock held, from sendFrame() and
+    // handleRtcp(); it must not call back into the sender.
+    bool initialize(const Config &config, SendFunction send);
+    bool isInitialized() const { return m_pipeline.isInitialized(); }
+    QString encoderName() const { return m_pipeline.encoderName(); }
+    // Scrolls and moves found in the last frame passed to sendFrame().
+    const QVector<MoveRect> &lastMoves() const { return m_pipeline.lastMoves(); }
+    const TileCache::Result &lastTiles() const { return m_pipeline.lastTiles(); }
+    bool fecEnabled() const { return m_config.redPayloadType >= 0 && m_config.ulpfecPayloadType >= 0; }
+
+    // Capture thread. Re-initializes the encoder (and sends a key frame) when
+    // the frame size changes.
+    bool sendFrame(const VideoFrame &frame);
+    // Capture thread. The newest `packets` packets never left (a pacer dropped
+    // an unsent refinement): their sequence numbers are reused so the viewer
+    // sees no gap, and the next frame is a key frame, since the encoder
+    // predicts from a picture the viewer never got.
+    void dropUnsent(int packets);
+
+    // Any thread; typically the transport's receive callback.
+    void handleRtcp(const QByteArray &packet);
+    void requestKeyFrame() { m_keyFrameRequested.store(true, std::memory_order_relaxed); }
+    void setRttMs(int rttMs) { m_rttMs.store(rttMs, std::memory_order_relaxed); }
+    // Latest loss fraction from the viewer's receiver reports, in 1/256 units.
+    int fractionLost() const { return m_fractionLost.load(std::memory_order_relaxed); }
+    void setBitrate(int kbps);
+    // Capture thread; the viewer's slot budget once it has announced one.
+    void setTileCacheBytes(qint64 bytes);
+    // Capture thread; region-of-interest map for the next frames.
+    void setQpOffsets(const QVector<qint8> &offsets) { m_pipeline.setQpOffsets(offsets); }
+
+private:
+    QByteArray wrapRed(const QByteArray &media) const;
+    QByteArray makeFecPacket(const QByteArray &fecPayload, quint32 timestamp);
+
+    Config m_config;
+    SendFunction m_send;
+    VideoPipeline m_pipeline;
+    UlpFecEncoder m_fec;
+
+    std::atomic<bool> m_keyFrameRequested{false};
+    std::atomic<int> m_fractionLost{0};
+    std::atomic<int> m_rttMs{100};
+
+    // Guards the history, the sequence counter and calls to m_send.
+    QMutex m_mutex;
+    RtpPacketHistory m_history;
+    quint16 m_sequence = 0;
+};
+
+}  // namespace host
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <chrono>
+
+#include "host/VideoFrame.h"
+
+namespace host {
+
+// Timebase for frame timestamps; anything correlated with frames (input
+// events, stats) should use the same clock.
+inline qint64 captureClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Anything that can stand in for the desktop capturer: the real CaptureVideo
+// or a recorded session being replayed.
+class VideoSource : public QObject {
+    Q_OBJECT
+public:
+    using QObject::QObject;
+
+    virtual void setScreenIndex(int index) = 0;
+    // May be called while running (idle throttling); the next frame should
+    // follow within one interval of the new rate, not the old one.
+    virtual void setFrameRate(int fps) = 0;
+    // Part of the screen to deliver (physical pixels, relative to the screen),
+    // empty for all of it. Sources that can should only grab and convert this
+    // area; frames that still cover the whole screen are cropped downstream.
+    virtual void setCaptureRegion(const QRect &region) = 0;
+    // I420 (the default) or I444. Sources that cannot convert to I444 keep
+    // delivering I420; frames say what they are.
+    virtual void setPixelFormat(PixelFormat format) { Q_UNUSED(format); }
+
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+signals:
+    // `pixels` is a packed I420 or I444 picture as `format` says; `dirtyRects`
+    // follows VideoFrame::dirtyRects: empty means nothing changed.
+    void frameCaptured(const QByteArray &pixels, PixelFormat format, int width, int height, qint64 timestampUs,
+                       const QVector<QRect> &dirtyRects);
+    void errorOccurred(const QString &message);
+};
+
+}  // namespace host
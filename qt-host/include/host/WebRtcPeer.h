@@ -4,16 +4,27 @@
 #include <QString>
 #include <QVariantMap>
 #include <QList>
+#include <QTimer>
+#include <QRect>
+#include <QVector>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <optional>
 
+#include "host/CapabilityProbe.h"
+#include "host/CaptureGovernor.h"
+#include "host/CaptureRegion.h"
 #include "host/IceConfig.h"
+#include "host/RoiMap.h"
+#include "host/VideoFrame.h"
 
 class QJsonObject;
 
 namespace rtc {
 class PeerConnection;
+class DataChannel;
+class Track;
 class Configuration;
 class RtcpeerConnection;
 class Description;
@@ -23,9 +34,14 @@ class IceCandidate;
 namespace host {
 
 class SignalingClient;
-class CaptureVideo;
+class VideoSource;
 class CaptureAudio;
 class InputInjector;
+class SessionRecorder;
+class VideoSender;
+class AudioSender;
+class FileTransfer;
+class PacedSender;
 
 class WebRtcPeer : public QObject {
     Q_OBJECT
@@ -33,7 +49,40 @@ public:
     struct Options {
         bool allowControl = false;
         int screenIndex = 0;
+        // Share one top-level window (native handle) or a rectangle of the
+        // screen instead of all of it; the window takes precedence.
+        quintptr captureWindow = 0;
+        QRect captureRect;
+        // 0 = as fast as CapabilityProbe says this machine keeps up with.
         int fps = 30;
+        // Above one: low-latency mode, see VideoPipeline::Config::slices.
+        int slices = 1;
+        // Most viewer memory the tile cache may ask for; the viewer's own
+        // announced budget applies if smaller.
+        int tileCacheMb = 64;
+        // Capture rate after a few seconds without damage or input; 0 = never throttle.
+        int idleFps = 1;
+        // Largest QP offset RoiMap applies around the pointer and recent
+        // input; 0 = uniform quality. The encoders emulate it by pre-filtering
+        // the picture, which loses detail, hence off by default.
+        int roiStrength = 0;
+        // Answer with this codec when the viewer offers it. Empty (--codec
+        // auto): AV1 (screen-content tools, better compression on text, several
+        // times the CPU of H.264) if the capability probe says it keeps up,
+        // else H.264.
+        std::optional<VideoEncoder::Codec> codec = VideoEncoder::Codec::H264;
+        // 4:4:4 video (AV1 High profile) when the viewer offers it, 4:2:0 otherwise.
+        bool fullChroma = false;
+        // See VideoPipeline::Config::refineAfterMs.
+        int refineAfterMs = 0;
+        // See VideoPipeline::Config::qualitySampleInterval; scores go to the stats.
+        int qualitySampleInterval = 0;
+        // The viewer may list, download and upload files here; empty = no file channel.
+        QString fileDirectory;
+        // Debugging aids: dump capture + input to a file, or stream a recording
+        // instead of the live desktop.
+        QString recordPath;
+        QString replayPath;
     };
 
     explicit WebRtcPeer(SignalingClient *signaling, QObject *parent = nullptr);
@@ -54,20 +103,76 @@ public slots:
     void handleSignal(const QJsonObject &payload);
 
 private:
+    void chooseProfile();
     void createPeer();
     void destroyPeer();
+    void setupReplay();
+    void setupRecording();
+    void pollTransportStats();
+    void adaptBitrate();
+    void sendCapturedFrame(const QByteArray &pixels, PixelFormat format, int width, int height, qint64 timestampUs,
+                           const QVector<QRect> &dirtyRects);
+    void refineStaticPicture();
+    bool cropToCaptureRegion(VideoFrame &frame);
+    void scaleToProfile(VideoFrame &frame);
+#ifdef HOST_ENABLE_RTC
+    void setupVideoTrack(rtc::Description &offer);
+    void setupAudioTrack(rtc::Description &offer);
+    void attachInputChannel(const std::shared_ptr<rtc::DataChannel> &channel, bool motion);
+    void attachFileChannel(const std::shared_ptr<rtc::DataChannel> &channel);
+#endif
+    void handleInputMessage(const QByteArray &message, bool motion);
+    void noteFocus(const QJsonObject &event);
+    void sendCopyRects(qint64 timestampUs);
+    void sendTiles(qint64 timestampUs);
     void sendLocalDescription(const QString &type, const QString &sdp);
     void sendIceCandidate(const QJsonObject &candidate);
 
 #ifdef HOST_ENABLE_RTC
     std::unique_ptr<rtc::PeerConnection> m_peer;
+    std::shared_ptr<rtc::DataChannel> m_inputChannel;
+    std::shared_ptr<rtc::DataChannel> m_motionChannel;
+    std::shared_ptr<rtc::DataChannel> m_fileChannel;
+    std::shared_ptr<rtc::Track> m_videoTrack;
+    std::shared_ptr<rtc::Track> m_audioTrack;
 #endif
     SignalingClient *m_signaling = nullptr;
-    std::unique_ptr<CaptureVideo> m_videoCapture;
+    std::unique_ptr<VideoSource> m_videoCapture;
     std::unique_ptr<CaptureAudio> m_audioCapture;
     std::unique_ptr<InputInjector> m_inputInjector;
+    std::unique_ptr<FileTransfer> m_fileTransfer;
+    std::unique_ptr<SessionRecorder> m_recorder;
+    // Shared so libdatachannel callbacks can hold them weakly past destroyPeer().
+    std::shared_ptr<PacedSender> m_pacer;
+    std::shared_ptr<VideoSender> m_videoSender;
+    std::shared_ptr<AudioSender> m_audioSender;
+    CaptureGovernor m_captureGovernor;
+    CaptureRegion m_captureRegion;
+    RoiMap m_roiMap;
+    // Codec, size, threads and frame rate for this session.
+    CapabilityProbe::Profile m_profile;
+    QVector<qint8> m_qpOffsets;
+    // Last frame sent, kept while refinement is on: sources stop delivering
+    // when nothing changes, so the pipeline is fed it again to notice.
+    VideoFrame m_lastFrame;
+    QTimer m_refineTimer;
+    // Region the source and the injector were last told about.
+    QRect m_activeRegion;
+    bool m_windowLostLogged = false;
+    int m_maxBitrateKbps = 0;
+    int m_targetBitrateKbps = 0;
+    bool m_videoSendFailed = false;
+    bool m_audioSendFailed = false;
     IceConfig m_iceConfig;
     Options m_options;
+    QTimer m_statsTimer;
+    quint64 m_lastBytesSent = 0;
+    // Highest move sequence seen on this peer; written from libdatachannel threads.
+    std::atomic<qint64> m_lastMotionSequence{-1};
+    // Set once the viewer announces it can apply copy-rect hints.
+    std::atomic<bool> m_viewerCopyRect{false};
+    // Tile slot memory the viewer offered; 0 until it does.
+    std::atomic<qint64> m_viewerTileCacheBytes{0};
     bool m_allowControl = false;
 };
 
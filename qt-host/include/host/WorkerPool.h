@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace host {
+
+// Fixed set of worker threads for data-parallel frame work (row bands,
+// slices). Each worker owns a deque: it takes its own work from the back and,
+// when that runs dry, steals from the front of the others', so uneven bands
+// even out without a central queue. The submitting thread joins in until its
+// batch is done.
+class WorkerPool {
+public:
+    // 0 picks one thread per core, capped at kMaxAutoThreads. The calling
+    // thread of parallelFor() counts as one of them.
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    static constexpr int kMaxAutoThreads = 8;
+    static int defaultThreadCount();
+
+    // Threads that take part in parallelFor(), including the caller.
+    int threadCount() const { return static_cast<int>(m_queues.size()) + 1; }
+
+    // Runs fn(0) .. fn(count - 1) across the pool and returns once all have
+    // finished. Not reentrant: fn must not call parallelFor() on the same pool.
+    void parallelFor(int count, const std::function<void(int index)> &fn);
+
+private:
+    struct Batch {
+        const std::function<void(int)> *fn = nullptr;
+        std::atomic<int> remaining{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    struct Task {
+        Batch *batch = nullptr;
+        int index = 0;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int self);
+    bool popOwn(int self, Task &task);
+    bool steal(int thief, Task &task);
+    void execute(const Task &task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // Tasks sitting in any queue; idle workers sleep while it is zero.
+    std::atomic<int> m_queued{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
+
+}  // namespace host
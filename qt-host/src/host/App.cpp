@@ -1,17 +1,23 @@
 #include "host/App.h"
 
+#include "host/CapabilityProbe.h"
+#include "host/Logger.h"
+#include "host/RoiMap.h"
+#include "host/Trace.h"
 #include "host/UiMainWindow.h"
 
 #include <QCommandLineOption>
 #include <QCommandLineParser>
+#include <QStandardPaths>
 
 namespace host {
 
 App::App(QApplication &qtApp) : QObject(&qtApp), m_qtApp(qtApp) {
+    Logger::instance().start(Logger::Config{});
     m_mainWindow = std::make_unique<UiMainWindow>();
 }
 
-App::~App() = default;
+App::~App() { Logger::instance().shutdown(); }
 
 int App::run() {
     QCommandLineParser parser;
@@ -19,28 +25,148 @@ int App::run() {
     parser.addHelpOption();
     QCommandLineOption codeOption({"c", "code"}, "Six digit session code", "code");
     QCommandLineOption screenOption({"s", "screen"}, "Screen index", "index", "0");
-    QCommandLineOption fpsOption({"f", "fps"}, "Frame rate", "fps", "30");
+    QCommandLineOption windowOption("window", "Share only the first window whose title contains <text>", "text");
+    QCommandLineOption regionOption("region", "Share only this part of the screen (physical pixels)", "x,y,w,h");
+    QCommandLineOption fpsOption({"f", "fps"}, "Frame rate (0 = what this machine keeps up with)", "fps", "30");
     QCommandLineOption allowControlOption("allow-control", "Enable control by default", "0");
+    QCommandLineOption recordOption("record", "Record captured frames and input to a file", "path");
+    QCommandLineOption replayOption("replay", "Stream a recorded session instead of the desktop", "path");
+    QCommandLineOption logFileOption("log-file", "Also write the log to a rotating file", "path");
+    QCommandLineOption verboseOption("verbose", "Enable debug logging");
+    QCommandLineOption traceOption("trace", "Record hot-path trace events and write them on exit", "path");
+    QCommandLineOption traceFormatOption("trace-format", "Trace format: chrome or perfetto (default: from extension)",
+                                         "format");
+    QCommandLineOption slicesOption("slices", "Low latency: encode and send each frame as <n> slices", "n", "1");
+    QCommandLineOption tileCacheOption("tile-cache-mb", "Largest tile cache a viewer may keep, in MiB (0 = off)",
+                                       "MiB", "64");
+    QCommandLineOption idleFpsOption("idle-fps", "Capture rate while nothing changes (0 = always full rate)", "fps",
+                                     "1");
+    QCommandLineOption roiStrengthOption(
+        "roi-strength", "Blur detail away from the pointer and recent input to save bits, 0-6 (0 = off)", "n", "0");
+    QCommandLineOption codecOption(
+        "codec", "Video codec: h264, av1 when the viewer supports it, or auto (AV1 if this machine keeps up)", "name",
+        "h264");
+    QCommandLineOption chromaOption("chroma", "Chroma subsampling: 420, or 444 for sharp coloured text (AV1 only)",
+                                    "mode", "420");
+    QCommandLineOption refineOption("refine-after-ms",
+                                    "Re-encode a static picture losslessly after this long (0 = never)", "ms", "0");
+    QCommandLineOption qualityOption("quality-sample",
+                                     "Decode the stream locally and report PSNR/SSIM of 1 in <n> frames (0 = off)",
+                                     "n", "0");
+    QCommandLineOption fileDirOption("file-dir", "Let the viewer list, download and upload files in <dir>", "dir");
+    QCommandLineOption statsPortOption("stats-port", "Serve /metrics and /stats on 127.0.0.1:<port>", "port", "0");
     parser.addOption(codeOption);
     parser.addOption(screenOption);
+    parser.addOption(windowOption);
+    parser.addOption(regionOption);
     parser.addOption(fpsOption);
     parser.addOption(allowControlOption);
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(slicesOption);
+    parser.addOption(tileCacheOption);
+    parser.addOption(idleFpsOption);
+    parser.addOption(roiStrengthOption);
+    parser.addOption(codecOption);
+    parser.addOption(chromaOption);
+    parser.addOption(refineOption);
+    parser.addOption(qualityOption);
+    parser.addOption(fileDirOption);
+    parser.addOption(statsPortOption);
+    parser.addOption(logFileOption);
+    parser.addOption(verboseOption);
+    parser.addOption(traceOption);
+    parser.addOption(traceFormatOption);
     parser.process(m_qtApp);
 
     if (parser.isSet(codeOption)) {
         m_initialCode = parser.value(codeOption);
     }
     m_initialScreenIndex = parser.value(screenOption).toInt();
+    m_captureWindowTitle = parser.value(windowOption);
+    const QStringList region = parser.value(regionOption).split(QLatin1Char(','));
+    if (region.size() == 4) {
+        m_captureRect = QRect(region.at(0).toInt(), region.at(1).toInt(), region.at(2).toInt(), region.at(3).toInt());
+    }
     m_initialAllowControl = parser.value(allowControlOption).toInt() != 0;
+    m_recordPath = parser.value(recordOption);
+    m_replayPath = parser.value(replayOption);
+    m_statsPort = parser.value(statsPortOption).toInt();
+    m_videoSlices = qBound(1, parser.value(slicesOption).toInt(), 16);
+    m_tileCacheMb = qBound(0, parser.value(tileCacheOption).toInt(), 4096);
+    m_idleFps = qBound(0, parser.value(idleFpsOption).toInt(), 30);
+    m_roiStrength = qBound(0, parser.value(roiStrengthOption).toInt(), RoiMap::kMaxStrength);
+    m_fps = qBound(0, parser.value(fpsOption).toInt(), 120);
+    const QString codec = parser.value(codecOption).toLower();
+    if (codec == QLatin1String("auto")) {
+        m_videoCodec.reset();
+    } else if (codec == QLatin1String("av1")) {
+        m_videoCodec = VideoEncoder::Codec::AV1;
+    }
+    m_fullChroma = parser.value(chromaOption) == QLatin1String("444");
+    m_refineAfterMs = qBound(0, parser.value(refineOption).toInt(), 60000);
+    m_qualitySampleInterval = qMax(0, parser.value(qualityOption).toInt());
+    m_fileDirectory = parser.value(fileDirOption);
+
+    const bool verbose = parser.isSet(verboseOption) || qEnvironmentVariableIntValue("HOST_VERBOSE") != 0;
+    if (verbose || parser.isSet(logFileOption)) {
+        Logger::Config logConfig;
+        logConfig.minLevel = verbose ? LogLevel::Debug : LogLevel::Info;
+        logConfig.filePath = parser.value(logFileOption);
+        Logger::instance().start(logConfig);
+    }
+    // Usually loaded from the cache; a first run measures while the user enters the code.
+    CapabilityProbe::instance().start(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) +
+                                      QStringLiteral("/capabilities.json"));
 
     if (!m_initialCode.isEmpty()) {
         m_mainWindow->setInitialCode(m_initialCode);
     }
     m_mainWindow->setInitialScreenIndex(m_initialScreenIndex);
+    m_mainWindow->setCaptureWindowTitle(m_captureWindowTitle);
+    m_mainWindow->setCaptureRect(m_captureRect);
     m_mainWindow->setAllowControlDefault(m_initialAllowControl);
+    m_mainWindow->setRecordPath(m_recordPath);
+    m_mainWindow->setReplayPath(m_replayPath);
+    m_mainWindow->setStatsPort(m_statsPort);
+    m_mainWindow->setVideoSlices(m_videoSlices);
+    m_mainWindow->setTileCacheMb(m_tileCacheMb);
+    m_mainWindow->setIdleFps(m_idleFps);
+    m_mainWindow->setRoiStrength(m_roiStrength);
+    m_mainWindow->setDefaultFps(m_fps);
+    m_mainWindow->setVideoCodec(m_videoCodec);
+    m_mainWindow->setFullChroma(m_fullChroma);
+    m_mainWindow->setRefineAfterMs(m_refineAfterMs);
+    m_mainWindow->setQualitySampleInterval(m_qualitySampleInterval);
+    m_mainWindow->setFileDirectory(m_fileDirectory);
+
+    const QString tracePath = parser.value(traceOption);
+    if (!tracePath.isEmpty()) {
+        if (!trace::isAvailable()) {
+            Logger::instance().log(LogLevel::Warning, tr("--trace ignored: tracing was compiled out"));
+        }
+        trace::setThreadName("main");
+        trace::start();
+    }
 
     m_mainWindow->show();
-    return m_qtApp.exec();
+    const int exitCode = m_qtApp.exec();
+
+    if (!tracePath.isEmpty() && trace::isAvailable()) {
+        trace::stop();
+        QString format = parser.value(traceFormatOption).toLower();
+        if (format.isEmpty()) {
+            format = tracePath.endsWith(QStringLiteral(".json"), Qt::CaseInsensitive) ? QStringLiteral("chrome")
+                                                                                       : QStringLiteral("perfetto");
+        }
+        QString error;
+        const auto traceFormat =
+            format == QStringLiteral("chrome") ? trace::Format::ChromeJson : trace::Format::Perfetto;
+        if (!trace::exportTo(tracePath, traceFormat, &error)) {
+            Logger::instance().log(LogLevel::Error, tr("Failed to write trace %1: %2").arg(tracePath, error));
+        }
+    }
+    return exitCode;
 }
 
 void App::setInitialCode(const QString &code) {
@@ -0,0 +1,116 @@
+#include "host/AudioEncoder.h"
+
+#ifdef HOST_ENABLE_OPUS
+#include <opus/opus.h>
+#endif
+
+namespace host {
+
+namespace {
+// libopus' recommended output buffer; a 60 ms packet is at most 3 * 1275 bytes plus framing.
+constexpr int kMaxPacketBytes = 4000;
+}  // namespace
+
+AudioEncoder::AudioEncoder() = default;
+
+AudioEncoder::~AudioEncoder() {
+#ifdef HOST_ENABLE_OPUS
+    if (m_encoder) {
+        opus_encoder_destroy(m_encoder);
+    }
+#endif
+}
+
+bool AudioEncoder::initialize(const Config &config) {
+#ifdef HOST_ENABLE_OPUS
+    if (m_encoder) {
+        opus_encoder_destroy(m_encoder);
+        m_encoder = nullptr;
+    }
+    if (config.channels < 1 || config.channels > 2) {
+        return false;
+    }
+    int error = OPUS_OK;
+    m_encoder = opus_encoder_create(kSampleRate, config.channels, OPUS_APPLICATION_AUDIO, &error);
+    if (error != OPUS_OK || !m_encoder) {
+        m_encoder = nullptr;
+        return false;
+    }
+    m_config = config;
+    opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(config.bitrateKbps * 1000));
+    opus_encoder_ctl(m_encoder, OPUS_SET_DTX(config.dtx ? 1 : 0));
+    // Also sets the signal type.
+    setExpectedLoss(m_expectedLoss);
+    return true;
+#else
+    Q_UNUSED(config);
+    return false;
+#endif
+}
+
+bool AudioEncoder::encode(const qint16 *pcm, int frameSamples, QByteArray &out) {
+    out.clear();
+#ifdef HOST_ENABLE_OPUS
+    if (!m_encoder) {
+        return false;
+    }
+    out.resize(kMaxPacketBytes);
+    const opus_int32 size = opus_encode(m_encoder, pcm, frameSamples, reinterpret_cast<unsigned char *>(out.data()),
+                                        kMaxPacketBytes);
+    if (size < 0) {
+        out.clear();
+        return false;
+    }
+    out.resize(size);
+    return true;
+#else
+    Q_UNUSED(pcm);
+    Q_UNUSED(frameSamples);
+    return false;
+#endif
+}
+
+void AudioEncoder::setBitrate(int kbps) {
+    m_config.bitrateKbps = kbps;
+#ifdef HOST_ENABLE_OPUS
+    if (m_encoder) {
+        opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(kbps * 1000));
+    }
+#endif
+}
+
+void AudioEncoder::setExpectedLoss(int percent) {
+    m_expectedLoss = qBound(0, percent, 100);
+#ifdef HOST_ENABLE_OPUS
+    if (m_encoder) {
+        const bool fec = m_expectedLoss > 0;
+        // Desktop audio is mostly media, which CELT codes best. But the FEC
+        // copy only exists in SILK and hybrid frames, and libopus only leaves
+        // CELT for FEC when the loss exceeds (128 - voice estimate) / 16
+        // percent: 8% for music, any loss for voice. So while FEC is wanted
+        // the signal is declared voice; at 64 kbps stereo that means hybrid
+        // frames, SILK below 8 kHz and CELT above.
+        opus_encoder_ctl(m_encoder, OPUS_SET_SIGNAL(fec ? OPUS_SIGNAL_VOICE : OPUS_SIGNAL_MUSIC));
+        opus_encoder_ctl(m_encoder, OPUS_SET_INBAND_FEC(fec ? 1 : 0));
+        opus_encoder_ctl(m_encoder, OPUS_SET_PACKET_LOSS_PERC(m_expectedLoss));
+    }
+#endif
+}
+
+void AudioEncoder::reset() {
+#ifdef HOST_ENABLE_OPUS
+    if (m_encoder) {
+        opus_encoder_ctl(m_encoder, OPUS_RESET_STATE);
+    }
+#endif
+}
+
+bool AudioEncoder::isAvailable() {
+#ifdef HOST_ENABLE_OPUS
+    return true;
+#else
+    return false;
+#endif
+}
+
+}  // namespace host
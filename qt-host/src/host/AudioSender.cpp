@@ -0,0 +1,220 @@
+#include "host/AudioSender.h"
+
+#include "host/HostStats.h"
+#include "host/RtcpFeedback.h"
+#include "host/RtpPacketizer.h"
+
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstdlib>
+#include <cstring>
+
+namespace host {
+
+namespace {
+constexpr int kRtpHeaderSize = RtpPacketizer::kHeaderSize;
+// Peak below which a frame counts as silent: about -72 dBFS, above the
+// dither some mixers add to an idle output.
+constexpr int kSilencePeak = 8;
+// Keep sending this long after the audio stops, so the decoder fades out
+// instead of cutting off mid-decay.
+constexpr int kHangoverMs = 200;
+// In-band FEC on at this smoothed loss, off again below kFecOffPercent.
+constexpr int kFecOnPercent = 2;
+constexpr int kFecOffPercent = 1;
+// More than this and FEC mostly just starves the primary encoding.
+constexpr int kMaxFecLossPercent = 25;
+// From this loss on, frames stay at 20 ms whatever the round trip time.
+constexpr int kHighLossPercent = 5;
+// A new frame duration must be proposed by this many updates in a row.
+constexpr int kSettleUpdates = 3;
+
+bool isSilent(const qint16 *samples, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (std::abs(samples[i]) > kSilencePeak) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Opus frame sizes this sender uses; 2.5 and 5 ms cost too much overhead.
+int fitFrameMs(int frameMs, int maxFrameMs) {
+    for (const int allowed : {60, 40, 20}) {
+        if (frameMs >= allowed && maxFrameMs >= allowed) {
+            return allowed;
+        }
+    }
+    return 10;
+}
+}  // namespace
+
+AudioSender::AudioSender() = default;
+
+AudioSender::~AudioSender() = default;
+
+bool AudioSender::initialize(const Config &config, SendFunction send) {
+    m_config = config;
+    m_send = std::move(send);
+    const int frameMs = fitFrameMs(20, config.maxFrameMs);
+    m_frameMs.store(frameMs, std::memory_order_relaxed);
+    m_proposedFrameMs = frameMs;
+    m_proposedCount = 0;
+    m_smoothedLoss = 0;
+    m_expectedLoss.store(0, std::memory_order_relaxed);
+    QMutexLocker locker(&m_mutex);
+    m_pending.clear();
+    m_appliedLoss = 0;
+    m_silentMs = 0;
+    m_inGap = true;
+    m_encoderSkipped = false;
+    // Random initial sequence number and timestamp, as RFC 3550 recommends.
+    m_sequence = static_cast<quint16>(QRandomGenerator::global()->generate());
+    m_timestamp = QRandomGenerator::global()->generate();
+    HostStats::instance().set(HostStats::AudioFrameMs, frameMs);
+    return m_encoder.initialize(config.encoder);
+}
+
+bool AudioSender::sendPcm(const QByteArray &pcm) {
+    QMutexLocker locker(&m_mutex);
+    if (!m_send || !m_encoder.isInitialized()) {
+        return false;
+    }
+    const int expectedLoss = m_expectedLoss.load(std::memory_order_relaxed);
+    if (expectedLoss != m_appliedLoss) {
+        m_encoder.setExpectedLoss(expectedLoss);
+        m_appliedLoss = expectedLoss;
+    }
+    m_pending.append(pcm);
+    const int channels = m_config.encoder.channels;
+    bool ok = true;
+    qsizetype offset = 0;
+    for (;;) {
+        // Re-read per frame: a change from updateNetwork() applies at the next boundary.
+        const int frameSamples = AudioEncoder::kSampleRate / 1000 * m_frameMs.load(std::memory_order_relaxed);
+        const qsizetype frameBytes = qsizetype(frameSamples) * channels * qsizetype(sizeof(qint16));
+        if (m_pending.size() - offset < frameBytes) {
+            break;
+        }
+        ok = sendFrame(reinterpret_cast<const qint16 *>(m_pending.constData() + offset), frameSamples) && ok;
+        offset += frameBytes;
+    }
+    m_pending.remove(0, offset);
+    return ok;
+}
+
+bool AudioSender::sendFrame(const qint16 *samples, int frameSamples) {
+    HostStats &stats = HostStats::instance();
+    const int frameMs = frameSamples * 1000 / AudioEncoder::kSampleRate;
+    if (isSilent(samples, frameSamples * m_config.encoder.channels)) {
+        m_silentMs = qMin(m_silentMs + frameMs, kHangoverMs + frameMs);
+    } else {
+        m_silentMs = 0;
+    }
+    // The timestamp keeps running through gaps, so the viewer plays the next
+    // talkspurt at the right time.
+    const quint32 timestamp = m_timestamp;
+    m_timestamp += static_cast<quint32>(frameSamples);
+
+    if (m_silentMs > kHangoverMs) {
+        // Digital silence: not even worth encoding.
+        m_encoderSkipped = true;
+        m_inGap = true;
+        stats.add(HostStats::AudioFramesSilent);
+        return true;
+    }
+    if (m_encoderSkipped) {
+        m_encoder.reset();
+        m_encoderSkipped = false;
+    }
+    if (!m_encoder.encode(samples, frameSamples, m_payload)) {
+        m_inGap = true;
+        return false;
+    }
+    if (AudioEncoder::isDtxPacket(m_payload)) {
+        // Opus DTX: near-silence the encoder itself decided not to code.
+        m_inGap = true;
+        stats.add(HostStats::AudioFramesSilent);
+        return true;
+    }
+    m_send(makePacket(m_payload, timestamp, m_inGap));
+    m_inGap = false;
+    stats.add(HostStats::AudioPacketsSent);
+    if (m_appliedLoss > 0 && AudioEncoder::hasSilkLayer(m_payload)) {
+        stats.add(HostStats::AudioFecPackets);
+    }
+    return true;
+}
+
+// RFC 7587: one Opus packet per RTP packet, 48 kHz clock whatever the
+// encoder's bandwidth; the marker bit starts a talkspurt after DTX.
+QByteArray AudioSender::makePacket(const QByteArray &payload, quint32 timestamp, bool marker) {
+    QByteArray packet(kRtpHeaderSize + payload.size(), Qt::Uninitialized);
+    auto *header = reinterpret_cast<uchar *>(packet.data());
+    header[0] = 0x80;
+    header[1] = static_cast<uchar>((marker ? 0x80 : 0) | (m_config.payloadType & 0x7f));
+    qToBigEndian<quint16>(m_sequence++, header + 2);
+    qToBigEndian<quint32>(timestamp, header + 4);
+    qToBigEndian<quint32>(m_config.ssrc, header + 8);
+    memcpy(packet.data() + kRtpHeaderSize, payload.constData(), static_cast<size_t>(payload.size()));
+    return packet;
+}
+
+void AudioSender::handleRtcp(const QByteArray &packet) {
+    RtcpFeedback feedback;
+    parseRtcpFeedback(packet, m_config.ssrc, feedback);
+    if (feedback.hasReportBlock) {
+        m_fractionLost.store(feedback.fractionLost, std::memory_order_relaxed);
+    }
+}
+
+void AudioSender::updateNetwork(int rttMs) {
+    // Receiver reports come about once a second and swing a lot on short audio
+    // streams; smooth them before acting.
+    m_smoothedLoss = (m_smoothedLoss * 3 + m_fractionLost.load(std::memory_order_relaxed)) / 4;
+    const int lossPercent = m_smoothedLoss * 100 / 256;
+
+    int expectedLoss = m_expectedLoss.load(std::memory_order_relaxed);
+    if (!m_config.fecAllowed || lossPercent < kFecOffPercent) {
+        expectedLoss = 0;
+    } else if (lossPercent >= kFecOnPercent || expectedLoss > 0) {
+        expectedLoss = qBound(kFecOnPercent, lossPercent, kMaxFecLossPercent);
+    }
+    m_expectedLoss.store(expectedLoss, std::memory_order_relaxed);
+
+    const int proposed = chooseFrameMs(rttMs, lossPercent, m_config.maxFrameMs);
+    if (proposed == m_frameMs.load(std::memory_order_relaxed)) {
+        m_proposedCount = 0;
+    } else if (proposed != m_proposedFrameMs) {
+        m_proposedFrameMs = proposed;
+        m_proposedCount = 1;
+    } else if (++m_proposedCount >= kSettleUpdates) {
+        m_frameMs.store(proposed, std::memory_order_relaxed);
+        m_proposedCount = 0;
+    }
+
+    HostStats &stats = HostStats::instance();
+    stats.set(HostStats::AudioFrameMs, m_frameMs.load(std::memory_order_relaxed));
+    stats.set(HostStats::AudioFecLossPercent, expectedLoss);
+}
+
+int AudioSender::chooseFrameMs(int rttMs, int lossPercent, int maxFrameMs) {
+    int frameMs = 20;
+    if (lossPercent >= kHighLossPercent) {
+        // Each lost packet takes less audio with it, and FEC covers exactly one frame.
+        frameMs = 20;
+    } else if (rttMs >= 0 && rttMs < 40 && lossPercent < 1) {
+        // Fast clean link: packetization delay is the largest part of the latency.
+        frameMs = 10;
+    } else if (rttMs > 250) {
+        // Slow link: 40 more ms hardly show, and 60 ms frames send a third of
+        // the packets (and header bytes) of 20 ms ones.
+        frameMs = 60;
+    } else if (rttMs > 120) {
+        frameMs = 40;
+    }
+    return fitFrameMs(frameMs, maxFrameMs);
+}
+
+}  // namespace host
@@ -0,0 +1,443 @@
+#include "host/CapabilityProbe.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstring>
+
+#include "host/ColorConvert.h"
+#include "host/WorkerPool.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace host {
+
+namespace {
+constexpr int kCacheVersion = 2;
+constexpr int kHeights[] = {720, 1080, 1440};
+constexpr int kScalingHeight = 1080;
+constexpr int kConvertRuns = 5;
+// After the key frame, which is not timed.
+constexpr int kTimedFrames = 8;
+constexpr int kGlyphWidth = 9;
+constexpr int kLineHeight = 18;
+// Scrolls one text line per frame, which keeps every macroblock changing.
+constexpr int kScrollRows = kLineHeight;
+// Share of the frame interval conversion and encoding may use; capture,
+// packetization and the rest of the machine need the remainder.
+constexpr double kBudgetShare = 0.5;
+
+constexpr quint32 kPaper = 0xfffafafa;
+constexpr quint32 kInk = 0xff202020;
+
+struct Candidate {
+    int scalePercent;
+    int fps;
+};
+
+inline quint32 mix(quint32 value) {
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+// A sidebar with a colour gradient next to ragged lines of glyph-sized ink
+// blobs, which is about as hard to encode as a busy desktop gets.
+void paintDesktop(int width, int height, QByteArray &bgra) {
+    bgra.resize(width * height * 4);
+    const int sidebar = width / 6;
+    for (int y = 0; y < height; ++y) {
+        auto *row = reinterpret_cast<quint32 *>(bgra.data() + y * width * 4);
+        const int line = y / kLineHeight;
+        const int gy = y % kLineHeight;
+        const quint32 lineSeed = mix(static_cast<quint32>(line) * 0x9e3779b9U);
+        const int lineLength = static_cast<int>(lineSeed % 90) + 10;
+        for (int x = 0; x < sidebar; ++x) {
+            const auto shade = static_cast<quint32>(x * 96 / sidebar + y * 64 / height);
+            row[x] = 0xff000000 | (shade << 16) | ((shade + 40) << 8) | (shade + 120);
+        }
+        for (int x = sidebar; x < width; ++x) {
+            const int column = (x - sidebar) / kGlyphWidth;
+            const int gx = (x - sidebar) % kGlyphWidth;
+            bool ink = false;
+            if (column < lineLength && gx < kGlyphWidth - 1 && gy >= 3 && gy <= 14) {
+                const quint32 cell = mix(lineSeed ^ static_cast<quint32>(column));
+                ink = cell % 6 != 0 && (mix(cell + static_cast<quint32>(gy * 8 + gx)) & 3) == 0;
+            }
+            row[x] = ink ? kInk : kPaper;
+        }
+    }
+}
+
+QString codecName(VideoEncoder::Codec codec) {
+    return codec == VideoEncoder::Codec::AV1 ? QStringLiteral("av1") : QStringLiteral("h264");
+}
+
+std::optional<VideoEncoder::Codec> codecFromName(const QString &name) {
+    if (name == QLatin1String("h264")) {
+        return VideoEncoder::Codec::H264;
+    }
+    if (name == QLatin1String("av1")) {
+        return VideoEncoder::Codec::AV1;
+    }
+    return std::nullopt;
+}
+
+double convertMsPerMegapixel(const std::atomic<bool> &cancel) {
+    const int width = 1920;
+    const int height = 1080;
+    QByteArray bgra;
+    paintDesktop(width, height, bgra);
+    QByteArray i420(i420FrameSize(width, height), Qt::Uninitialized);
+    qint64 bestNs = -1;
+    for (int run = 0; run < kConvertRuns && !cancel.load(); ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        convertBgraToI420(reinterpret_cast<const std::uint8_t *>(bgra.constData()), width * 4, width, height,
+                          reinterpret_cast<std::uint8_t *>(i420.data()));
+        const qint64 ns = timer.nsecsElapsed();
+        bestNs = bestNs < 0 ? ns : qMin(bestNs, ns);
+    }
+    return bestNs / 1e6 / (width * height / 1e6);
+}
+
+// `tall` is an I420 picture twice the frame height; frame n shows it from row
+// n * kScrollRows. Returns -1 when the encoder fails or the probe is cancelled.
+double encodeMsPerFrame(VideoEncoder::Codec codec, const QByteArray &tall, int width, int height, int threads,
+                        const std::atomic<bool> &cancel) {
+    std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create(codec);
+    VideoEncoder::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 30;
+    config.bitrateKbps = qMax(1000, static_cast<int>(qint64(width) * height * 3 / 1000));
+    // As VideoPipeline sets it up without --slices: one slice, so OpenH264
+    // gains little from the extra threads and the timings say so.
+    config.threads = threads;
+    config.slices = 1;
+    if (!encoder || !encoder->initialize(config)) {
+        return -1;
+    }
+    VideoFrame frame;
+    frame.format = PixelFormat::I420;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = width;
+    frame.data.resize(i420FrameSize(width, height));
+    frame.dirtyRects = {QRect(0, 0, width, height)};
+    EncodedFrame out;
+    qint64 totalNs = 0;
+    for (int n = 0; n <= kTimedFrames; ++n) {
+        if (cancel.load()) {
+            return -1;
+        }
+        cropI420(reinterpret_cast<const std::uint8_t *>(tall.constData()), width, height * 2, 0,
+                 (n * kScrollRows) % height, width, height, reinterpret_cast<std::uint8_t *>(frame.data.data()));
+        frame.timestampUs = n * 1000000LL / config.fps;
+        QElapsedTimer timer;
+        timer.start();
+        if (!encoder->encode(frame, n == 0, out)) {
+            return -1;
+        }
+        if (n > 0) {
+            totalNs += timer.nsecsElapsed();
+        }
+    }
+    return totalNs / 1e6 / kTimedFrames;
+}
+
+// Per-frame encode time for `pixels` on the measured thread count, linear in
+// the pixel count between measured sizes; -1 when the codec was not measured.
+double encodeMsAt(const CapabilityProbe::Results &results, VideoEncoder::Codec codec, qint64 pixels) {
+    QVector<QPair<qint64, double>> points;
+    for (const CapabilityProbe::EncoderTiming &timing : results.encoders) {
+        if (timing.codec == codec && timing.threads == results.threads) {
+            points.append({qint64(timing.height) * 16 / 9 * timing.height, timing.msPerFrame});
+        }
+    }
+    if (points.isEmpty()) {
+        return -1;
+    }
+    std::sort(points.begin(), points.end());
+    if (pixels <= points.first().first) {
+        return points.first().second * pixels / points.first().first;
+    }
+    for (int i = 1; i < points.size(); ++i) {
+        if (pixels <= points.at(i).first) {
+            const double t = double(pixels - points.at(i - 1).first) / (points.at(i).first - points.at(i - 1).first);
+            return points.at(i - 1).second + t * (points.at(i).second - points.at(i - 1).second);
+        }
+    }
+    return points.last().second * pixels / points.last().first;
+}
+
+// Fraction of the encode time that parallelizes (Amdahl), from the one- and
+// many-thread timings at the same size.
+double parallelShare(const CapabilityProbe::Results &results, VideoEncoder::Codec codec) {
+    double single = -1;
+    double multi = -1;
+    for (const CapabilityProbe::EncoderTiming &timing : results.encoders) {
+        if (timing.codec != codec || timing.height != kScalingHeight) {
+            continue;
+        }
+        if (timing.threads == 1) {
+            single = timing.msPerFrame;
+        }
+        if (timing.threads == results.threads) {
+            multi = timing.msPerFrame;
+        }
+    }
+    if (results.threads <= 1 || single <= 0 || multi <= 0) {
+        return 0;
+    }
+    return qBound(0.0, (1 - multi / single) / (1 - 1.0 / results.threads), 1.0);
+}
+}  // namespace
+
+CapabilityProbe &CapabilityProbe::instance() {
+    static CapabilityProbe probe;
+    return probe;
+}
+
+CapabilityProbe::~CapabilityProbe() {
+    m_cancel.store(true);
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+void CapabilityProbe::start(const QString &cachePath) {
+    if (m_worker.joinable()) {
+        return;
+    }
+    const QString key = cacheKey(cpuModel(), static_cast<int>(std::thread::hardware_concurrency()));
+    QFile file(cachePath);
+    if (!cachePath.isEmpty() && file.open(QIODevice::ReadOnly)) {
+        const QJsonObject cache = QJsonDocument::fromJson(file.readAll()).object();
+        std::optional<Results> cached;
+        if (cache.value(QStringLiteral("version")).toInt() == kCacheVersion) {
+            cached = fromJson(cache.value(QStringLiteral("machines")).toObject().value(key).toObject());
+        }
+        // A build with a new encoder measures again.
+        for (const VideoEncoder::Codec codec : {VideoEncoder::Codec::H264, VideoEncoder::Codec::AV1}) {
+            if (cached && VideoEncoder::isAvailable(codec) && encodeMsAt(*cached, codec, 1) < 0) {
+                cached.reset();
+            }
+        }
+        if (cached && cached->threads == WorkerPool::defaultThreadCount()) {
+            QMutexLocker locker(&m_mutex);
+            m_results = cached;
+            return;
+        }
+    }
+    m_worker = std::thread([this, cachePath]() {
+        const Results results = measure(m_cancel);
+        if (m_cancel.load()) {
+            return;
+        }
+        {
+            QMutexLocker locker(&m_mutex);
+            m_results = results;
+        }
+        if (!cachePath.isEmpty()) {
+            store(cachePath, results);
+        }
+    });
+}
+
+std::optional<CapabilityProbe::Results> CapabilityProbe::results() const {
+    QMutexLocker locker(&m_mutex);
+    return m_results;
+}
+
+CapabilityProbe::Profile CapabilityProbe::chooseProfile(const Results &results, const QSize &frameSize,
+                                                        const QVector<VideoEncoder::Codec> &codecs, int fps) {
+    QVector<Candidate> candidates;
+    if (fps > 0) {
+        candidates = {{100, fps}, {75, fps}, {50, fps}};
+    } else {
+        candidates = {{100, 60}, {100, 30}, {75, 30}, {50, 30}, {50, 15}};
+    }
+    const int maxThreads = qMax(1, results.threads);
+    for (const Candidate &candidate : candidates) {
+        const double budgetMs = 1000.0 / candidate.fps * kBudgetShare;
+        const qint64 pixels = qint64(frameSize.width() * candidate.scalePercent / 100) *
+                              (frameSize.height() * candidate.scalePercent / 100);
+        for (const VideoEncoder::Codec codec : codecs) {
+            const double encodeMs = encodeMsAt(results, codec, pixels);
+            if (encodeMs < 0) {
+                continue;
+            }
+            const double share = parallelShare(results, codec);
+            const double atMaxThreads = (1 - share) + share / maxThreads;
+            // The fewest threads that fit leave the other cores to the rest of the machine.
+            for (int threads = 1; threads <= maxThreads; ++threads) {
+                const double frameMs = results.convertMsPerMegapixel * pixels / 1e6 / threads +
+                                       encodeMs * ((1 - share) + share / threads) / atMaxThreads;
+                if (frameMs <= budgetMs) {
+                    return {codec, candidate.scalePercent, threads, candidate.fps, frameMs};
+                }
+            }
+        }
+    }
+    // Nothing keeps up; the smallest candidate on every core is the best there is.
+    Profile profile;
+    profile.codec = codecs.isEmpty() ? VideoEncoder::Codec::H264 : codecs.first();
+    profile.scalePercent = candidates.last().scalePercent;
+    profile.fps = candidates.last().fps;
+    return profile;
+}
+
+QString CapabilityProbe::cpuModel() {
+    char brand[49] = {};
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4] = {};
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned int>(regs[0]) >= 0x80000004) {
+        for (int i = 0; i < 3; ++i) {
+            __cpuid(regs, 0x80000002 + i);
+            memcpy(brand + 16 * i, regs, sizeof(regs));
+        }
+    }
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int regs[4] = {};
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+        for (unsigned int i = 0; i < 3; ++i) {
+            __get_cpuid(0x80000002 + i, &regs[0], &regs[1], &regs[2], &regs[3]);
+            memcpy(brand + 16 * i, regs, sizeof(regs));
+        }
+    }
+#endif
+    QString model = QString::fromLatin1(brand).simplified();
+    QFile cpuinfo(QStringLiteral("/proc/cpuinfo"));
+    if (model.isEmpty() && cpuinfo.open(QIODevice::ReadOnly)) {
+        // ARM kernels name the SoC in "Hardware" or the core in "model name".
+        while (!cpuinfo.atEnd() && model.isEmpty()) {
+            const QString line = QString::fromLatin1(cpuinfo.readLine());
+            if (line.startsWith(QLatin1String("model name")) || line.startsWith(QLatin1String("Hardware"))) {
+                model = line.section(QLatin1Char(':'), 1).simplified();
+            }
+        }
+    }
+    return model.isEmpty() ? QSysInfo::currentCpuArchitecture() : model;
+}
+
+CapabilityProbe::Results CapabilityProbe::measure(const std::atomic<bool> &cancel) {
+    Results results;
+    results.cpuModel = cpuModel();
+    results.cores = static_cast<int>(std::thread::hardware_concurrency());
+    results.threads = WorkerPool::defaultThreadCount();
+    results.convertMsPerMegapixel = convertMsPerMegapixel(cancel);
+
+    const auto add = [&](VideoEncoder::Codec codec, const QByteArray &tall, int width, int height, int threads) {
+        const double ms = encodeMsPerFrame(codec, tall, width, height, threads, cancel);
+        if (ms >= 0) {
+            results.encoders.append({codec, height, threads, ms});
+        }
+    };
+    for (const int height : kHeights) {
+        const int width = height * 16 / 9 / 2 * 2;
+        QByteArray bgra;
+        paintDesktop(width, height * 2, bgra);
+        QByteArray tall(i420FrameSize(width, height * 2), Qt::Uninitialized);
+        convertBgraToI420(reinterpret_cast<const std::uint8_t *>(bgra.constData()), width * 4, width, height * 2,
+                          reinterpret_cast<std::uint8_t *>(tall.data()));
+        for (const VideoEncoder::Codec codec : {VideoEncoder::Codec::H264, VideoEncoder::Codec::AV1}) {
+            if (cancel.load() || !VideoEncoder::isAvailable(codec)) {
+                continue;
+            }
+            add(codec, tall, width, height, results.threads);
+            if (height == kScalingHeight && results.threads > 1) {
+                add(codec, tall, width, height, 1);
+            }
+        }
+    }
+    return results;
+}
+
+QString CapabilityProbe::cacheKey(const QString &cpuModel, int cores) {
+    return QStringLiteral("%1 / %2").arg(cpuModel).arg(cores);
+}
+
+QJsonObject CapabilityProbe::toJson(const Results &results) {
+    QJsonArray encoders;
+    for (const EncoderTiming &timing : results.encoders) {
+        QJsonObject entry;
+        entry.insert(QStringLiteral("codec"), codecName(timing.codec));
+        entry.insert(QStringLiteral("height"), timing.height);
+        entry.insert(QStringLiteral("threads"), timing.threads);
+        entry.insert(QStringLiteral("msPerFrame"), timing.msPerFrame);
+        encoders.append(entry);
+    }
+    QJsonObject json;
+    json.insert(QStringLiteral("cpuModel"), results.cpuModel);
+    json.insert(QStringLiteral("cores"), results.cores);
+    json.insert(QStringLiteral("threads"), results.threads);
+    json.insert(QStringLiteral("convertMsPerMegapixel"), results.convertMsPerMegapixel);
+    json.insert(QStringLiteral("encoders"), encoders);
+    return json;
+}
+
+std::optional<CapabilityProbe::Results> CapabilityProbe::fromJson(const QJsonObject &json) {
+    Results results;
+    results.cpuModel = json.value(QStringLiteral("cpuModel")).toString();
+    results.cores = json.value(QStringLiteral("cores")).toInt();
+    results.threads = json.value(QStringLiteral("threads")).toInt();
+    results.convertMsPerMegapixel = json.value(QStringLiteral("convertMsPerMegapixel")).toDouble(-1);
+    if (results.threads <= 0 || results.convertMsPerMegapixel < 0) {
+        return std::nullopt;
+    }
+    for (const QJsonValue &value : json.value(QStringLiteral("encoders")).toArray()) {
+        const QJsonObject entry = value.toObject();
+        const auto codec = codecFromName(entry.value(QStringLiteral("codec")).toString());
+        EncoderTiming timing;
+        timing.height = entry.value(QStringLiteral("height")).toInt();
+        timing.threads = entry.value(QStringLiteral("threads")).toInt();
+        timing.msPerFrame = entry.value(QStringLiteral("msPerFrame")).toDouble(-1);
+        if (!codec || timing.height <= 0 || timing.threads <= 0 || timing.msPerFrame < 0) {
+            return std::nullopt;
+        }
+        timing.codec = *codec;
+        results.encoders.append(timing);
+    }
+    return results;
+}
+
+void CapabilityProbe::store(const QString &cachePath, const Results &results) {
+    QJsonObject cache;
+    QFile existing(cachePath);
+    if (existing.open(QIODevice::ReadOnly)) {
+        cache = QJsonDocument::fromJson(existing.readAll()).object();
+        existing.close();
+    }
+    QJsonObject machines;
+    if (cache.value(QStringLiteral("version")).toInt() == kCacheVersion) {
+        machines = cache.value(QStringLiteral("machines")).toObject();
+    }
+    machines.insert(cacheKey(results.cpuModel, results.cores), toJson(results));
+    cache.insert(QStringLiteral("version"), kCacheVersion);
+    cache.insert(QStringLiteral("machines"), machines);
+
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QSaveFile file(cachePath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(cache).toJson());
+        file.commit();
+    }
+}
+
+}  // namespace host
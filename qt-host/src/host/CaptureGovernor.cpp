@@ -0,0 +1,64 @@
+#include "host/CaptureGovernor.h"
+
+#include "host/HostStats.h"
+
+namespace host {
+
+void CaptureGovernor::setConfig(const Config &config) {
+    m_config = config;
+    m_lastActivityUs.store(0, std::memory_order_relaxed);
+    m_idle.store(false, std::memory_order_relaxed);
+    HostStats::instance().set(HostStats::CaptureFps, config.activeFps);
+}
+
+void CaptureGovernor::noteInput(qint64 nowUs) { noteActivity(nowUs); }
+
+void CaptureGovernor::noteFrame(qint64 nowUs, bool damaged) {
+    if (damaged) {
+        noteActivity(nowUs);
+        return;
+    }
+    if (m_config.idleFps <= 0 || m_config.idleFps >= m_config.activeFps || isIdle()) {
+        return;
+    }
+    qint64 last = m_lastActivityUs.load(std::memory_order_relaxed);
+    if (last == 0) {
+        // The quiet period starts with the first frame.
+        m_lastActivityUs.compare_exchange_strong(last, nowUs, std::memory_order_relaxed);
+        return;
+    }
+    if (nowUs - last < m_config.idleAfterUs) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (m_idle.exchange(true)) {
+        return;
+    }
+    // Sequentially consistent against noteActivity(), which stores the time
+    // and then reads m_idle: either it sees idle and switches back after this
+    // callback, or the new time is seen here.
+    if (m_lastActivityUs.load() != last) {
+        m_idle.store(false);
+        return;
+    }
+    HostStats::instance().set(HostStats::CaptureFps, m_config.idleFps);
+    if (m_onRate) {
+        m_onRate(m_config.idleFps);
+    }
+}
+
+void CaptureGovernor::noteActivity(qint64 nowUs) {
+    m_lastActivityUs.store(nowUs);
+    if (!m_idle.load()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (m_idle.exchange(false)) {
+        HostStats::instance().set(HostStats::CaptureFps, m_config.activeFps);
+        if (m_onRate) {
+            m_onRate(m_config.activeFps);
+        }
+    }
+}
+
+}  // namespace host
@@ -0,0 +1,133 @@
+#include "host/CaptureRegion.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <dwmapi.h>
+#endif
+
+namespace host {
+
+namespace {
+// Anything smaller is not worth an encoder of its own.
+constexpr int kMinSize = 16;
+constexpr int kMaxTitleLength = 256;
+
+#ifdef Q_OS_WIN
+bool isShareable(HWND hwnd) {
+    if (!IsWindowVisible(hwnd) || GetWindow(hwnd, GW_OWNER) != nullptr || GetWindowTextLengthW(hwnd) == 0) {
+        return false;
+    }
+    if (GetWindowLongPtrW(hwnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) {
+        return false;
+    }
+    // UWP frames and windows on other virtual desktops are visible but cloaked.
+    DWORD cloaked = 0;
+    DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked));
+    return cloaked == 0;
+}
+
+BOOL CALLBACK collectWindow(HWND hwnd, LPARAM param) {
+    if (isShareable(hwnd)) {
+        wchar_t title[kMaxTitleLength];
+        const int length = GetWindowTextW(hwnd, title, kMaxTitleLength);
+        auto *windows = reinterpret_cast<QList<CaptureRegion::Window> *>(param);
+        windows->append({reinterpret_cast<quintptr>(hwnd), QString::fromWCharArray(title, length)});
+    }
+    return TRUE;
+}
+#endif
+
+// Desktop rectangle of a window in physical pixels, without the invisible
+// resize borders; empty while minimized or once it is gone.
+QRect windowRect(quintptr handle, bool &exists) {
+#ifdef Q_OS_WIN
+    const auto hwnd = reinterpret_cast<HWND>(handle);
+    exists = IsWindow(hwnd) != 0;
+    if (!exists || IsIconic(hwnd)) {
+        return QRect();
+    }
+    RECT rect{};
+    if (FAILED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &rect, sizeof(rect))) &&
+        !GetWindowRect(hwnd, &rect)) {
+        return QRect();
+    }
+    return QRect(QPoint(rect.left, rect.top), QPoint(rect.right - 1, rect.bottom - 1));
+#else
+    Q_UNUSED(handle);
+    exists = false;
+    return QRect();
+#endif
+}
+}  // namespace
+
+QRect physicalScreenGeometry(const QScreen *screen) {
+    const QRect logical = screen->geometry();
+    const qreal ratio = screen->devicePixelRatio();
+    return QRect(logical.topLeft(), QSize(qRound(logical.width() * ratio), qRound(logical.height() * ratio)));
+}
+
+QList<CaptureRegion::Window> CaptureRegion::topLevelWindows() {
+    QList<Window> windows;
+#ifdef Q_OS_WIN
+    EnumWindows(collectWindow, reinterpret_cast<LPARAM>(&windows));
+#endif
+    return windows;
+}
+
+quintptr CaptureRegion::findWindow(const QString &text) {
+    for (const Window &window : topLevelWindows()) {
+        if (window.title.contains(text, Qt::CaseInsensitive)) {
+            return window.handle;
+        }
+    }
+    return 0;
+}
+
+void CaptureRegion::setRect(const QRect &rect) {
+    m_rect = rect;
+    m_window = 0;
+    m_windowLost = false;
+}
+
+void CaptureRegion::setWindow(quintptr handle) {
+    m_window = handle;
+    m_rect = QRect();
+    m_windowLost = false;
+}
+
+QRect CaptureRegion::snap(const QRect &rect, const QSize &screen) const {
+    const QRect clipped = rect.intersected(QRect(QPoint(0, 0), screen));
+    const int left = clipped.left() & ~1;
+    const int top = clipped.top() & ~1;
+    const int width = (clipped.right() + 1 - left) & ~1;
+    const int height = (clipped.bottom() + 1 - top) & ~1;
+    if (width < kMinSize || height < kMinSize) {
+        return QRect();
+    }
+    return QRect(left, top, width, height);
+}
+
+QRect CaptureRegion::update() {
+    if (isWholeScreen()) {
+        return QRect();
+    }
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    QScreen *screen = m_screenIndex >= 0 && m_screenIndex < screens.size() ? screens.at(m_screenIndex)
+                                                                           : QGuiApplication::primaryScreen();
+    if (!screen) {
+        return QRect();
+    }
+    const QRect geometry = physicalScreenGeometry(screen);
+    if (m_window == 0) {
+        return snap(m_rect, geometry.size());
+    }
+    bool exists = false;
+    const QRect desktop = windowRect(m_window, exists);
+    m_windowLost = !exists;
+    return snap(desktop.translated(-geometry.topLeft()), geometry.size());
+}
+
+}  // namespace host
@@ -2,17 +2,52 @@
 
 #include <QByteArray>
 
+#ifdef HOST_ENABLE_PIPEWIRE
+#include "host/PipeWireCapture.h"
+#endif
+
 namespace host {
 
-CaptureVideo::CaptureVideo(QObject *parent) : QObject(parent) {}
+CaptureVideo::CaptureVideo(QObject *parent) : VideoSource(parent) {
+#ifdef HOST_ENABLE_PIPEWIRE
+    m_backend = std::make_unique<PipeWireCapture>(this);
+#endif
+    if (m_backend) {
+        connect(m_backend.get(), &VideoSource::frameCaptured, this, &VideoSource::frameCaptured);
+        connect(m_backend.get(), &VideoSource::errorOccurred, this, &VideoSource::errorOccurred);
+    }
+}
 
 CaptureVideo::~CaptureVideo() = default;
 
-void CaptureVideo::setScreenIndex(int index) { Q_UNUSED(index); }
+void CaptureVideo::setScreenIndex(int index) {
+    if (m_backend) {
+        m_backend->setScreenIndex(index);
+    }
+}
+
+void CaptureVideo::setFrameRate(int fps) {
+    if (m_backend) {
+        m_backend->setFrameRate(fps);
+    }
+}
+
+void CaptureVideo::setCaptureRegion(const QRect &region) {
+    if (m_backend) {
+        m_backend->setCaptureRegion(region);
+    }
+}
 
-void CaptureVideo::setFrameRate(int fps) { Q_UNUSED(fps); }
+void CaptureVideo::setPixelFormat(PixelFormat format) {
+    if (m_backend) {
+        m_backend->setPixelFormat(format);
+    }
+}
 
 bool CaptureVideo::start() {
+    if (m_backend) {
+        return m_backend->start();
+    }
 #ifdef Q_OS_WIN
     emit errorOccurred(tr("DXGI Desktop Duplication capture not yet implemented."));
 #else
@@ -21,7 +56,10 @@ bool CaptureVideo::start() {
     return false;
 }
 
-void CaptureVideo::stop() {}
+void CaptureVideo::stop() {
+    if (m_backend) {
+        m_backend->stop();
+    }
+}
 
 }  // namespace host
-
@@ -0,0 +1,274 @@
+#include "host/ColorConvert.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef HOST_ENABLE_LIBYUV
+#include <libyuv/convert.h>
+#include <libyuv/convert_from.h>
+#include <libyuv/convert_from_argb.h>
+#include <libyuv/scale.h>
+#endif
+
+namespace host {
+
+namespace {
+inline std::uint8_t lumaOf(int r, int g, int b) {
+    return static_cast<std::uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+inline std::uint8_t chromaUOf(int r, int g, int b) {
+    return static_cast<std::uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+inline std::uint8_t chromaVOf(int r, int g, int b) {
+    return static_cast<std::uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+#ifndef HOST_ENABLE_LIBYUV
+// Samples pixel centres in 16.16 fixed point.
+void scalePlane(const std::uint8_t *src, int width, int height, std::uint8_t *dst, int outWidth, int outHeight) {
+    const std::int64_t stepX = (std::int64_t(width) << 16) / outWidth;
+    const std::int64_t stepY = (std::int64_t(height) << 16) / outHeight;
+    const std::int64_t maxX = std::int64_t(width - 1) << 16;
+    const std::int64_t maxY = std::int64_t(height - 1) << 16;
+    for (int row = 0; row < outHeight; ++row) {
+        const std::int64_t sy = std::clamp<std::int64_t>(row * stepY + stepY / 2 - 0x8000, 0, maxY);
+        const int y0 = static_cast<int>(sy >> 16);
+        const int y1 = std::min(y0 + 1, height - 1);
+        const int fy = static_cast<int>(sy & 0xffff) >> 8;
+        const std::uint8_t *top = src + y0 * width;
+        const std::uint8_t *bottom = src + y1 * width;
+        std::uint8_t *out = dst + row * outWidth;
+        for (int col = 0; col < outWidth; ++col) {
+            const std::int64_t sx = std::clamp<std::int64_t>(col * stepX + stepX / 2 - 0x8000, 0, maxX);
+            const int x0 = static_cast<int>(sx >> 16);
+            const int x1 = std::min(x0 + 1, width - 1);
+            const int fx = static_cast<int>(sx & 0xffff) >> 8;
+            const int upper = top[x0] * (256 - fx) + top[x1] * fx;
+            const int lower = bottom[x0] * (256 - fx) + bottom[x1] * fx;
+            out[col] = static_cast<std::uint8_t>((upper * (256 - fy) + lower * fy + 32768) >> 16);
+        }
+    }
+}
+#endif
+
+// Crop and paste for packed planar frames whose chroma planes are subsampled
+// by 2^chromaShift in both directions (1 for I420, 0 for I444).
+void cropPlanes(const std::uint8_t *src, int width, int height, int x, int y, int cropWidth, int cropHeight,
+                int chromaShift, std::uint8_t *out) {
+    const auto copyPlane = [](const std::uint8_t *from, int srcStride, int dstWidth, int rows, std::uint8_t *dst) {
+        for (int row = 0; row < rows; ++row) {
+            memcpy(dst + row * dstWidth, from + row * srcStride, static_cast<size_t>(dstWidth));
+        }
+    };
+    const int chromaStride = width >> chromaShift;
+    const int outChromaWidth = cropWidth >> chromaShift;
+    const int outChromaHeight = cropHeight >> chromaShift;
+    const std::uint8_t *u = src + width * height;
+    const std::uint8_t *v = u + chromaStride * (height >> chromaShift);
+    const int chromaOffset = (y >> chromaShift) * chromaStride + (x >> chromaShift);
+    std::uint8_t *outU = out + cropWidth * cropHeight;
+    std::uint8_t *outV = outU + outChromaWidth * outChromaHeight;
+    copyPlane(src + y * width + x, width, cropWidth, cropHeight, out);
+    copyPlane(u + chromaOffset, chromaStride, outChromaWidth, outChromaHeight, outU);
+    copyPlane(v + chromaOffset, chromaStride, outChromaWidth, outChromaHeight, outV);
+}
+
+void pastePlanes(const std::uint8_t *patch, int x, int y, int patchWidth, int patchHeight, int width, int height,
+                 int chromaShift, std::uint8_t *dst) {
+    const auto copyPlane = [](const std::uint8_t *src, int srcWidth, int rows, int dstStride, std::uint8_t *to) {
+        for (int row = 0; row < rows; ++row) {
+            memcpy(to + row * dstStride, src + row * srcWidth, static_cast<size_t>(srcWidth));
+        }
+    };
+    const int chromaStride = width >> chromaShift;
+    const int patchChromaWidth = patchWidth >> chromaShift;
+    const int patchChromaHeight = patchHeight >> chromaShift;
+    std::uint8_t *u = dst + width * height;
+    std::uint8_t *v = u + chromaStride * (height >> chromaShift);
+    const int chromaOffset = (y >> chromaShift) * chromaStride + (x >> chromaShift);
+    const std::uint8_t *patchU = patch + patchWidth * patchHeight;
+    const std::uint8_t *patchV = patchU + patchChromaWidth * patchChromaHeight;
+    copyPlane(patch, patchWidth, patchHeight, width, dst + y * width + x);
+    copyPlane(patchU, patchChromaWidth, patchChromaHeight, chromaStride, u + chromaOffset);
+    copyPlane(patchV, patchChromaWidth, patchChromaHeight, chromaStride, v + chromaOffset);
+}
+}  // namespace
+
+void convertBgraToI420(const std::uint8_t *bgra, int bgraStride, int width, int height, std::uint8_t *i420) {
+    convertBgraToI420Rows(bgra, bgraStride, width, height, 0, height, i420);
+}
+
+void convertBgraToI420Rows(const std::uint8_t *bgra, int bgraStride, int width, int height, int firstRow, int rowCount,
+                           std::uint8_t *i420) {
+    const int chromaWidth = width / 2;
+    std::uint8_t *yPlane = i420;
+    std::uint8_t *uPlane = yPlane + width * height;
+    std::uint8_t *vPlane = uPlane + chromaWidth * (height / 2);
+    const int endRow = std::min(height, firstRow + rowCount);
+
+#ifdef HOST_ENABLE_LIBYUV
+    // libyuv names formats by little-endian word order: "ARGB" is B,G,R,A in memory.
+    const int chromaOffset = (firstRow / 2) * chromaWidth;
+    libyuv::ARGBToI420(bgra + firstRow * bgraStride, bgraStride, yPlane + firstRow * width, width,
+                       uPlane + chromaOffset, chromaWidth, vPlane + chromaOffset, chromaWidth, width, endRow - firstRow);
+#else
+    for (int row = firstRow; row < endRow; row += 2) {
+        const std::uint8_t *top = bgra + row * bgraStride;
+        const std::uint8_t *bottom = top + bgraStride;
+        std::uint8_t *yTop = yPlane + row * width;
+        std::uint8_t *yBottom = yTop + width;
+        std::uint8_t *u = uPlane + (row / 2) * chromaWidth;
+        std::uint8_t *v = vPlane + (row / 2) * chromaWidth;
+        for (int col = 0; col < width; col += 2) {
+            const std::uint8_t *p00 = top + col * 4;
+            const std::uint8_t *p01 = p00 + 4;
+            const std::uint8_t *p10 = bottom + col * 4;
+            const std::uint8_t *p11 = p10 + 4;
+            yTop[col] = lumaOf(p00[2], p00[1], p00[0]);
+            yTop[col + 1] = lumaOf(p01[2], p01[1], p01[0]);
+            yBottom[col] = lumaOf(p10[2], p10[1], p10[0]);
+            yBottom[col + 1] = lumaOf(p11[2], p11[1], p11[0]);
+            const int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+            const int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+            const int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+            u[col / 2] = chromaUOf(r, g, b);
+            v[col / 2] = chromaVOf(r, g, b);
+        }
+    }
+#endif
+}
+
+void convertBgraToI444(const std::uint8_t *bgra, int bgraStride, int width, int height, std::uint8_t *i444) {
+    convertBgraToI444Rows(bgra, bgraStride, width, height, 0, height, i444);
+}
+
+void convertBgraToI444Rows(const std::uint8_t *bgra, int bgraStride, int width, int height, int firstRow, int rowCount,
+                           std::uint8_t *i444) {
+    const int planeSize = width * height;
+    std::uint8_t *yPlane = i444;
+    std::uint8_t *uPlane = yPlane + planeSize;
+    std::uint8_t *vPlane = uPlane + planeSize;
+    const int endRow = std::min(height, firstRow + rowCount);
+
+#ifdef HOST_ENABLE_LIBYUV
+    const int offset = firstRow * width;
+    libyuv::ARGBToI444(bgra + firstRow * bgraStride, bgraStride, yPlane + offset, width, uPlane + offset, width,
+                       vPlane + offset, width, width, endRow - firstRow);
+#else
+    for (int row = firstRow; row < endRow; ++row) {
+        const std::uint8_t *pixel = bgra + row * bgraStride;
+        std::uint8_t *y = yPlane + row * width;
+        std::uint8_t *u = uPlane + row * width;
+        std::uint8_t *v = vPlane + row * width;
+        for (int col = 0; col < width; ++col, pixel += 4) {
+            y[col] = lumaOf(pixel[2], pixel[1], pixel[0]);
+            u[col] = chromaUOf(pixel[2], pixel[1], pixel[0]);
+            v[col] = chromaVOf(pixel[2], pixel[1], pixel[0]);
+        }
+    }
+#endif
+}
+
+void convertI420ToI444(const std::uint8_t *i420, int width, int height, std::uint8_t *i444) {
+    const int chromaWidth = width / 2;
+    const std::uint8_t *u = i420 + width * height;
+    const std::uint8_t *v = u + chromaWidth * (height / 2);
+    std::uint8_t *outU = i444 + width * height;
+    std::uint8_t *outV = outU + width * height;
+#ifdef HOST_ENABLE_LIBYUV
+    libyuv::I420ToI444(i420, width, u, chromaWidth, v, chromaWidth, i444, width, outU, width, outV, width, width,
+                       height);
+#else
+    memcpy(i444, i420, static_cast<size_t>(width) * height);
+    for (int row = 0; row < height; ++row) {
+        const int from = (row / 2) * chromaWidth;
+        for (int col = 0; col < width; ++col) {
+            outU[row * width + col] = u[from + col / 2];
+            outV[row * width + col] = v[from + col / 2];
+        }
+    }
+#endif
+}
+
+void convertI444ToI420(const std::uint8_t *i444, int width, int height, std::uint8_t *i420) {
+    const int chromaWidth = width / 2;
+    const std::uint8_t *u = i444 + width * height;
+    const std::uint8_t *v = u + width * height;
+    std::uint8_t *outU = i420 + width * height;
+    std::uint8_t *outV = outU + chromaWidth * (height / 2);
+#ifdef HOST_ENABLE_LIBYUV
+    libyuv::I444ToI420(i444, width, u, width, v, width, i420, width, outU, chromaWidth, outV, chromaWidth, width,
+                       height);
+#else
+    memcpy(i420, i444, static_cast<size_t>(width) * height);
+    for (int row = 0; row < height / 2; ++row) {
+        const std::uint8_t *uTop = u + 2 * row * width;
+        const std::uint8_t *vTop = v + 2 * row * width;
+        for (int col = 0; col < chromaWidth; ++col) {
+            const int at = 2 * col;
+            outU[row * chromaWidth + col] = static_cast<std::uint8_t>(
+                (uTop[at] + uTop[at + 1] + uTop[width + at] + uTop[width + at + 1] + 2) >> 2);
+            outV[row * chromaWidth + col] = static_cast<std::uint8_t>(
+                (vTop[at] + vTop[at + 1] + vTop[width + at] + vTop[width + at + 1] + 2) >> 2);
+        }
+    }
+#endif
+}
+
+void cropI420(const std::uint8_t *i420, int width, int height, int x, int y, int cropWidth, int cropHeight,
+              std::uint8_t *out) {
+    cropPlanes(i420, width, height, x, y, cropWidth, cropHeight, 1, out);
+}
+
+void cropI444(const std::uint8_t *i444, int width, int height, int x, int y, int cropWidth, int cropHeight,
+              std::uint8_t *out) {
+    cropPlanes(i444, width, height, x, y, cropWidth, cropHeight, 0, out);
+}
+
+void pasteI420(const std::uint8_t *patch, int x, int y, int patchWidth, int patchHeight, int width, int height,
+               std::uint8_t *i420) {
+    pastePlanes(patch, x, y, patchWidth, patchHeight, width, height, 1, i420);
+}
+
+void pasteI444(const std::uint8_t *patch, int x, int y, int patchWidth, int patchHeight, int width, int height,
+               std::uint8_t *i444) {
+    pastePlanes(patch, x, y, patchWidth, patchHeight, width, height, 0, i444);
+}
+
+void scaleI420(const std::uint8_t *i420, int width, int height, int outWidth, int outHeight, std::uint8_t *out) {
+    const int chromaWidth = width / 2;
+    const int chromaHeight = height / 2;
+    const int outChromaWidth = outWidth / 2;
+    const int outChromaHeight = outHeight / 2;
+    const std::uint8_t *u = i420 + width * height;
+    const std::uint8_t *v = u + chromaWidth * chromaHeight;
+    std::uint8_t *outU = out + outWidth * outHeight;
+    std::uint8_t *outV = outU + outChromaWidth * outChromaHeight;
+#ifdef HOST_ENABLE_LIBYUV
+    libyuv::I420Scale(i420, width, u, chromaWidth, v, chromaWidth, width, height, out, outWidth, outU, outChromaWidth,
+                      outV, outChromaWidth, outWidth, outHeight, libyuv::kFilterBox);
+#else
+    scalePlane(i420, width, height, out, outWidth, outHeight);
+    scalePlane(u, chromaWidth, chromaHeight, outU, outChromaWidth, outChromaHeight);
+    scalePlane(v, chromaWidth, chromaHeight, outV, outChromaWidth, outChromaHeight);
+#endif
+}
+
+void scaleI444(const std::uint8_t *i444, int width, int height, int outWidth, int outHeight, std::uint8_t *out) {
+    const std::uint8_t *u = i444 + width * height;
+    const std::uint8_t *v = u + width * height;
+    std::uint8_t *outU = out + outWidth * outHeight;
+    std::uint8_t *outV = outU + outWidth * outHeight;
+#ifdef HOST_ENABLE_LIBYUV
+    libyuv::I444Scale(i444, width, u, width, v, width, width, height, out, outWidth, outU, outWidth, outV, outWidth,
+                      outWidth, outHeight, libyuv::kFilterBox);
+#else
+    scalePlane(i444, width, height, out, outWidth, outHeight);
+    scalePlane(u, width, height, outU, outWidth, outHeight);
+    scalePlane(v, width, height, outV, outWidth, outHeight);
+#endif
+}
+
+}  // namespace host
@@ -0,0 +1,364 @@
+#include "host/FileTransfer.h"
+
+#include "common/Protocol.h"
+#include "host/HostStats.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLatin1String>
+#include <QStorageInfo>
+#include <QtEndian>
+#include <cstring>
+
+namespace host {
+
+namespace json = protocol::json;
+
+namespace {
+// Mapped at a time per download; keeps the address space small for large files.
+constexpr qint64 kMapWindowBytes = 64 * 1024 * 1024;
+constexpr auto kPartSuffix = ".part";
+
+// A plain name inside the transfer directory: no separators, no drive or
+// stream syntax, nothing that walks upwards.
+bool isValidName(const QString &name) {
+    return !name.isEmpty() && name.size() <= 255 && name != QLatin1String(".") && name != QLatin1String("..") &&
+           !name.contains(QLatin1Char('/')) && !name.contains(QLatin1Char('\\')) && !name.contains(QLatin1Char(':')) &&
+           !name.endsWith(QLatin1String(kPartSuffix));
+}
+
+// "report.pdf" -> "report (1).pdf" while the name is taken.
+QString uniquePath(const QDir &directory, const QString &name) {
+    QString path = directory.filePath(name);
+    const QFileInfo info(name);
+    const QString suffix = info.suffix().isEmpty() ? QString() : QStringLiteral(".") + info.suffix();
+    for (int n = 1; QFileInfo::exists(path); ++n) {
+        path = directory.filePath(QStringLiteral("%1 (%2)%3").arg(info.completeBaseName()).arg(n).arg(suffix));
+    }
+    return path;
+}
+}  // namespace
+
+FileTransfer::FileTransfer(QObject *parent) : QObject(parent) {}
+
+FileTransfer::~FileTransfer() { clearTransfers(); }
+
+void FileTransfer::attach(Transport transport) {
+    clearTransfers();
+    m_transport = std::move(transport);
+    // Congestion on a previous session says nothing about this one.
+    m_throttled = false;
+}
+
+void FileTransfer::detach() {
+    clearTransfers();
+    m_transport = Transport{};
+    m_throttled = false;
+}
+
+void FileTransfer::clearTransfers() {
+    for (auto &entry : m_downloads) {
+        closeDownload(entry.second);
+    }
+    m_downloads.clear();
+    // Partial uploads stay on disk; the viewer resumes them with the same name and size.
+    m_uploads.clear();
+}
+
+void FileTransfer::setThrottled(bool throttled) {
+    if (m_throttled == throttled) {
+        return;
+    }
+    m_throttled = throttled;
+    if (!throttled) {
+        pump();
+    }
+}
+
+void FileTransfer::handleMessage(const QByteArray &message, bool binary) {
+    if (!isEnabled()) {
+        if (!binary) {
+            sendError(0, tr("File transfer is disabled on this host."));
+        }
+        return;
+    }
+    if (binary) {
+        handleChunk(message);
+    } else {
+        handleControl(message);
+    }
+}
+
+void FileTransfer::handleControl(const QByteArray &message) {
+    const QJsonObject json = QJsonDocument::fromJson(message).object();
+    const QString type = json.value(QStringLiteral("t")).toString();
+    const auto id = static_cast<quint32>(json.value(QLatin1String(json::kFileId)).toInteger());
+    const QString name = json.value(QLatin1String(json::kFileName)).toString();
+    if (type == QLatin1String(json::kFileList)) {
+        sendList();
+    } else if (type == QLatin1String(json::kFileGet)) {
+        startDownload(id, name, json.value(QLatin1String(json::kFileOffset)).toInteger());
+    } else if (type == QLatin1String(json::kFilePut)) {
+        startUpload(id, name, json.value(QLatin1String(json::kFileSize)).toInteger(-1));
+    } else if (type == QLatin1String(json::kFileCancel)) {
+        cancel(id);
+    }
+}
+
+void FileTransfer::sendList() {
+    QJsonArray files;
+    const QFileInfoList entries =
+        QDir(m_config.directory).entryInfoList(QDir::Files | QDir::Readable | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QFileInfo &entry : entries) {
+        if (entry.fileName().endsWith(QLatin1String(kPartSuffix))) {
+            continue;
+        }
+        QJsonObject file;
+        file.insert(QLatin1String(json::kFileName), entry.fileName());
+        file.insert(QLatin1String(json::kFileSize), entry.size());
+        files.append(file);
+    }
+    QJsonObject message;
+    message.insert(QStringLiteral("t"), QLatin1String(json::kFiles));
+    message.insert(QLatin1String(json::kFiles), files);
+    sendControl(message);
+}
+
+void FileTransfer::startDownload(quint32 id, const QString &name, qint64 offset) {
+    if (!isValidName(name)) {
+        sendError(id, tr("Invalid file name."));
+        return;
+    }
+    if (m_downloads.count(id) || m_uploads.count(id)) {
+        sendError(id, tr("Transfer id %1 is in use.").arg(id));
+        return;
+    }
+    auto file = std::make_unique<QFile>(pathFor(name));
+    if (!file->open(QIODevice::ReadOnly)) {
+        sendError(id, tr("Cannot open %1: %2").arg(name, file->errorString()));
+        return;
+    }
+    const qint64 size = file->size();
+    if (offset < 0 || offset > size) {
+        sendError(id, tr("Offset %1 is outside %2 (%3 bytes).").arg(offset).arg(name).arg(size));
+        return;
+    }
+    QJsonObject header;
+    header.insert(QStringLiteral("t"), QLatin1String(json::kFileHeader));
+    header.insert(QLatin1String(json::kFileId), static_cast<qint64>(id));
+    header.insert(QLatin1String(json::kFileName), name);
+    header.insert(QLatin1String(json::kFileSize), size);
+    header.insert(QLatin1String(json::kFileOffset), offset);
+    sendControl(header);
+
+    Download download;
+    download.name = name;
+    download.file = std::move(file);
+    download.size = size;
+    download.offset = offset;
+    m_downloads.emplace(id, std::move(download));
+    if (offset > 0) {
+        emit logLine(tr("Resuming %1 at %2 of %3 bytes").arg(name).arg(offset).arg(size));
+    } else {
+        emit logLine(tr("Sending %1 (%2 bytes)").arg(name).arg(size));
+    }
+    pump();
+}
+
+void FileTransfer::pump() {
+    if (!m_transport.send || m_throttled) {
+        return;
+    }
+    HostStats &stats = HostStats::instance();
+    while (!m_downloads.empty() && m_transport.bufferedAmount() < m_config.highWatermarkBytes) {
+        auto it = m_downloads.upper_bound(m_lastServed);
+        if (it == m_downloads.end()) {
+            it = m_downloads.begin();
+        }
+        m_lastServed = it->first;
+        Download &download = it->second;
+        if (download.offset < download.size) {
+            if (!nextChunk(it->first, download)) {
+                sendError(it->first, tr("Cannot read %1: %2").arg(download.name, download.file->errorString()));
+                closeDownload(download);
+                m_downloads.erase(it);
+                continue;
+            }
+            if (!m_transport.send(m_chunk, true)) {
+                // Closed or full; the next low-watermark callback or attach() picks up from here.
+                return;
+            }
+            const qint64 length = m_chunk.size() - json::kFileChunkHeader;
+            download.offset += length;
+            stats.add(HostStats::FileBytesSent, static_cast<quint64>(length));
+        }
+        if (download.offset >= download.size) {
+            QJsonObject done;
+            done.insert(QStringLiteral("t"), QLatin1String(json::kFileDone));
+            done.insert(QLatin1String(json::kFileId), static_cast<qint64>(it->first));
+            sendControl(done);
+            emit logLine(tr("Sent %1").arg(download.name));
+            closeDownload(download);
+            m_downloads.erase(it);
+        }
+    }
+}
+
+bool FileTransfer::nextChunk(quint32 id, Download &download) {
+    const qint64 length = qMin<qint64>(m_config.chunkBytes, download.size - download.offset);
+    if (!download.window || download.offset < download.windowOffset ||
+        download.offset + length > download.windowOffset + download.windowSize) {
+        if (download.window) {
+            download.file->unmap(download.window);
+        }
+        download.windowOffset = download.offset;
+        download.windowSize = qMin(kMapWindowBytes, download.size - download.offset);
+        download.window = download.file->map(download.windowOffset, download.windowSize);
+        if (!download.window) {
+            return false;
+        }
+    }
+    m_chunk.resize(json::kFileChunkHeader + length);
+    auto *header = reinterpret_cast<uchar *>(m_chunk.data());
+    qToBigEndian<quint32>(id, header);
+    qToBigEndian<quint64>(static_cast<quint64>(download.offset), header + 4);
+    memcpy(m_chunk.data() + json::kFileChunkHeader, download.window + (download.offset - download.windowOffset),
+           static_cast<size_t>(length));
+    return true;
+}
+
+void FileTransfer::closeDownload(Download &download) {
+    if (download.window) {
+        download.file->unmap(download.window);
+        download.window = nullptr;
+    }
+    download.file->close();
+}
+
+void FileTransfer::startUpload(quint32 id, const QString &name, qint64 size) {
+    if (!isValidName(name) || size < 0) {
+        sendError(id, tr("Invalid file name or size."));
+        return;
+    }
+    if (m_downloads.count(id) || m_uploads.count(id)) {
+        sendError(id, tr("Transfer id %1 is in use.").arg(id));
+        return;
+    }
+    // The size is part of the name, so a different file of the same name
+    // never resumes from this one's bytes.
+    auto file = std::make_unique<QFile>(pathFor(QStringLiteral("%1.%2%3").arg(name).arg(size).arg(kPartSuffix)));
+    if (!file->open(QIODevice::ReadWrite)) {
+        sendError(id, tr("Cannot write %1: %2").arg(name, file->errorString()));
+        return;
+    }
+    qint64 offset = file->size();
+    if (offset > size) {
+        file->resize(0);
+        offset = 0;
+    }
+    if (QStorageInfo(m_config.directory).bytesAvailable() < size - offset) {
+        sendError(id, tr("Not enough disk space for %1.").arg(name));
+        return;
+    }
+    file->seek(offset);
+
+    Upload upload;
+    upload.name = name;
+    upload.file = std::move(file);
+    upload.size = size;
+    upload.offset = offset;
+    QJsonObject ready;
+    ready.insert(QStringLiteral("t"), QLatin1String(json::kFilePutReady));
+    ready.insert(QLatin1String(json::kFileId), static_cast<qint64>(id));
+    ready.insert(QLatin1String(json::kFileOffset), offset);
+    sendControl(ready);
+    if (offset == size) {
+        finishUpload(id, upload);
+        return;
+    }
+    if (offset > 0) {
+        emit logLine(tr("Resuming upload of %1 at %2 of %3 bytes").arg(name).arg(offset).arg(size));
+    } else {
+        emit logLine(tr("Receiving %1 (%2 bytes)").arg(name).arg(size));
+    }
+    m_uploads.emplace(id, std::move(upload));
+}
+
+void FileTransfer::handleChunk(const QByteArray &chunk) {
+    if (chunk.size() < json::kFileChunkHeader) {
+        return;
+    }
+    const auto *header = reinterpret_cast<const uchar *>(chunk.constData());
+    const quint32 id = qFromBigEndian<quint32>(header);
+    const auto offset = static_cast<qint64>(qFromBigEndian<quint64>(header + 4));
+    const auto it = m_uploads.find(id);
+    if (it == m_uploads.end()) {
+        // Chunks still in flight after a cancel.
+        return;
+    }
+    Upload &upload = it->second;
+    const qint64 length = chunk.size() - json::kFileChunkHeader;
+    if (offset != upload.offset || length > upload.size - upload.offset) {
+        sendError(id, tr("Unexpected chunk at offset %1 for %2.").arg(offset).arg(upload.name));
+        m_uploads.erase(it);
+        return;
+    }
+    if (upload.file->write(chunk.constData() + json::kFileChunkHeader, length) != length) {
+        sendError(id, tr("Cannot write %1: %2").arg(upload.name, upload.file->errorString()));
+        m_uploads.erase(it);
+        return;
+    }
+    upload.offset += length;
+    HostStats::instance().add(HostStats::FileBytesReceived, static_cast<quint64>(length));
+    if (upload.offset == upload.size) {
+        finishUpload(id, upload);
+        m_uploads.erase(it);
+    }
+}
+
+void FileTransfer::finishUpload(quint32 id, Upload &upload) {
+    const QString partPath = upload.file->fileName();
+    upload.file->close();
+    const QString path = uniquePath(QDir(m_config.directory), upload.name);
+    if (!QFile::rename(partPath, path)) {
+        sendError(id, tr("Cannot rename the received %1.").arg(upload.name));
+        return;
+    }
+    QJsonObject done;
+    done.insert(QStringLiteral("t"), QLatin1String(json::kFileDone));
+    done.insert(QLatin1String(json::kFileId), static_cast<qint64>(id));
+    sendControl(done);
+    emit logLine(tr("Received %1").arg(QFileInfo(path).fileName()));
+}
+
+void FileTransfer::cancel(quint32 id) {
+    const auto download = m_downloads.find(id);
+    if (download != m_downloads.end()) {
+        closeDownload(download->second);
+        m_downloads.erase(download);
+    }
+    // Closing the file keeps the .part for a later resume.
+    m_uploads.erase(id);
+}
+
+void FileTransfer::sendControl(const QJsonObject &message) {
+    if (m_transport.send) {
+        m_transport.send(QJsonDocument(message).toJson(QJsonDocument::Compact), false);
+    }
+}
+
+void FileTransfer::sendError(quint32 id, const QString &message) {
+    QJsonObject error;
+    error.insert(QStringLiteral("t"), QLatin1String(json::kFileError));
+    error.insert(QLatin1String(json::kFileId), static_cast<qint64>(id));
+    error.insert(QLatin1String(json::kMessage), message);
+    sendControl(error);
+    emit logLine(tr("File transfer: %1").arg(message));
+}
+
+QString FileTransfer::pathFor(const QString &name) const { return QDir(m_config.directory).filePath(name); }
+
+}  // namespace host
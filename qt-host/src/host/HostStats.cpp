@@ -0,0 +1,191 @@
+#include "host/HostStats.h"
+
+#include <QJsonObject>
+
+namespace host {
+
+namespace {
+struct MetricInfo {
+    const char *promName;
+    const char *jsonName;
+    const char *help;
+};
+
+constexpr MetricInfo kCounterInfo[HostStats::CounterCount] = {
+    {"host_frames_captured_total", "framesCaptured", "Frames delivered by the capture source."},
+    {"host_frames_dropped_total", "framesDropped", "Captured frames that were not encoded."},
+    {"host_frames_encoded_total", "framesEncoded", "Frames produced by the video encoder."},
+    {"host_encoded_bytes_total", "encodedBytes", "Encoded video bytes."},
+    {"host_bytes_sent_total", "bytesSent", "Bytes sent on the peer connection."},
+    {"host_packets_sent_total", "packetsSent", "RTP packets handed to the transport."},
+    {"host_packets_retransmitted_total", "packetsRetransmitted", "RTP packets resent in answer to NACKs."},
+    {"host_fec_packets_sent_total", "fecPacketsSent", "ULPFEC packets sent."},
+    {"host_input_events_total", "inputEvents", "Input events received from the viewer."},
+    {"host_input_events_dropped_total", "inputEventsDropped", "Input events dropped because the queue was full."},
+    {"host_input_motion_stale_total", "inputMotionStale", "Pointer moves discarded as older than one already seen."},
+    {"host_moves_detected_total", "movesDetected", "Scrolled or moved screen regions found between frames."},
+    {"host_tile_cache_lookups_total", "tileCacheLookups", "Changed tiles looked up in the tile cache."},
+    {"host_tile_cache_hits_total", "tileCacheHits", "Changed tiles found in the tile cache."},
+    {"host_frames_from_tile_cache_total", "framesFromTileCache", "Frames sent as cached tiles instead of video."},
+    {"host_frames_refined_total", "framesRefined", "Static pictures re-encoded at lossless quality."},
+    {"host_audio_packets_sent_total", "audioPacketsSent", "Opus RTP packets handed to the transport."},
+    {"host_audio_frames_silent_total", "audioFramesSilent", "Audio frames skipped as silence or DTX."},
+    {"host_audio_fec_packets_total", "audioFecPackets", "Opus packets sent with FEC on in SILK or hybrid mode."},
+    {"host_file_bytes_sent_total", "fileBytesSent", "File bytes sent on the file transfer channel."},
+    {"host_file_bytes_received_total", "fileBytesReceived", "File bytes received on the file transfer channel."},
+};
+
+constexpr MetricInfo kGaugeInfo[HostStats::GaugeCount] = {
+    {"host_send_queue_depth", "sendQueueDepth", "Packets waiting to be sent."},
+    {"host_pacer_queue_time_ms", "pacerQueueMs", "Time the paced send queue needs to drain."},
+    {"host_rtt_ms", "rttMs", "Round trip time reported by the transport."},
+    {"host_packet_loss_fraction_256", "packetLoss", "Fraction lost from RTCP receiver reports, in 1/256."},
+    {"host_target_bitrate_kbps", "targetBitrateKbps", "Encoder target bitrate."},
+    {"host_capture_fps", "captureFps", "Current capture frame rate."},
+    {"host_send_bitrate_kbps", "sendBitrateKbps", "Measured send bitrate."},
+    {"host_input_events_per_second", "inputEventsPerSecond", "Input event rate."},
+    {"host_tile_cache_hit_rate_percent", "tileCacheHitRate", "Tile cache hit rate since the previous sample."},
+    {"host_roi_focus_percent", "roiFocusPercent", "Share of macroblocks encoded at raised quality."},
+    {"host_video_psnr_centidb", "videoPsnr", "PSNR of the last sampled picture, in 1/100 dB."},
+    {"host_video_ssim_ten_thousandths", "videoSsim", "SSIM of the last sampled picture, in 1/10000."},
+    {"host_audio_frame_ms", "audioFrameMs", "Current Opus frame duration."},
+    {"host_audio_fec_loss_percent", "audioFecLossPercent", "Loss Opus in-band FEC is sized for; 0 when off."},
+};
+
+constexpr MetricInfo kTimingInfo[HostStats::TimingCount] = {
+    {"host_encode_duration_us", "encodeUs", "Time spent encoding one frame."},
+    {"host_input_injection_duration_us", "injectionUs", "Time spent injecting one input event."},
+    {"host_input_dispatch_delay_us", "inputDispatchUs", "Time from receiving an input event to injecting it."},
+    {"host_pacer_delay_us", "pacerDelayUs", "Time a packet waited in the pacer."},
+    {"host_move_detect_duration_us", "moveDetectUs", "Time spent looking for scrolls and moves in one frame."},
+};
+
+void appendMetric(QByteArray &out, const MetricInfo &info, const char *type, const QByteArray &value) {
+    out += "# HELP ";
+    out += info.promName;
+    out += ' ';
+    out += info.help;
+    out += "\n# TYPE ";
+    out += info.promName;
+    out += ' ';
+    out += type;
+    out += '\n';
+    out += info.promName;
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+}  // namespace
+
+HostStats &HostStats::instance() {
+    static HostStats stats;
+    return stats;
+}
+
+void HostStats::record(Timing timing, qint64 durationUs) {
+    TimingSlot &slot = m_timings[timing];
+    const auto value = static_cast<quint64>(durationUs < 0 ? 0 : durationUs);
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.sumUs.fetch_add(value, std::memory_order_relaxed);
+    quint64 current = slot.maxUs.load(std::memory_order_relaxed);
+    while (value > current && !slot.maxUs.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void HostStats::sample(qint64 nowUs) {
+    const quint64 bytesSent = m_counters[BytesSent].value.load(std::memory_order_relaxed);
+    const quint64 inputEvents = m_counters[InputEvents].value.load(std::memory_order_relaxed);
+    const quint64 tileLookups = m_counters[TileCacheLookups].value.load(std::memory_order_relaxed);
+    const quint64 tileHits = m_counters[TileCacheHits].value.load(std::memory_order_relaxed);
+    if (m_lastSampleUs > 0 && nowUs > m_lastSampleUs) {
+        const qint64 elapsedUs = nowUs - m_lastSampleUs;
+        set(SendBitrateKbps, static_cast<qint64>((bytesSent - m_lastBytesSent) * 8000 / elapsedUs));
+        set(InputEventsPerSecond, static_cast<qint64>((inputEvents - m_lastInputEvents) * 1000000 / elapsedUs));
+        if (tileLookups > m_lastTileLookups) {
+            set(TileCacheHitRate,
+                static_cast<qint64>((tileHits - m_lastTileHits) * 100 / (tileLookups - m_lastTileLookups)));
+        }
+    }
+    m_lastSampleUs = nowUs;
+    m_lastBytesSent = bytesSent;
+    m_lastInputEvents = inputEvents;
+    m_lastTileLookups = tileLookups;
+    m_lastTileHits = tileHits;
+}
+
+HostStats::Snapshot HostStats::snapshot() const {
+    Snapshot result;
+    for (int i = 0; i < CounterCount; ++i) {
+        result.counters[i] = m_counters[i].value.load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < GaugeCount; ++i) {
+        result.gauges[i] = m_gauges[i].value.load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < TimingCount; ++i) {
+        result.timings[i].count = m_timings[i].count.load(std::memory_order_relaxed);
+        result.timings[i].sumUs = m_timings[i].sumUs.load(std::memory_order_relaxed);
+        result.timings[i].maxUs = m_timings[i].maxUs.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+QByteArray HostStats::toPrometheus() const {
+    const Snapshot stats = snapshot();
+    QByteArray out;
+    out.reserve(4096);
+    for (int i = 0; i < CounterCount; ++i) {
+        appendMetric(out, kCounterInfo[i], "counter", QByteArray::number(stats.counters[i]));
+    }
+    for (int i = 0; i < GaugeCount; ++i) {
+        appendMetric(out, kGaugeInfo[i], "gauge", QByteArray::number(stats.gauges[i]));
+    }
+    for (int i = 0; i < TimingCount; ++i) {
+        const MetricInfo &info = kTimingInfo[i];
+        const TimingSnapshot &timing = stats.timings[i];
+        out += "# HELP ";
+        out += info.promName;
+        out += ' ';
+        out += info.help;
+        out += "\n# TYPE ";
+        out += info.promName;
+        out += " summary\n";
+        out += info.promName;
+        out += "_sum " + QByteArray::number(timing.sumUs) + '\n';
+        out += info.promName;
+        out += "_count " + QByteArray::number(timing.count) + '\n';
+    }
+    // A maximum is no part of a summary; each gets a gauge family of its own.
+    for (int i = 0; i < TimingCount; ++i) {
+        QByteArray name(kTimingInfo[i].promName);
+        if (name.endsWith("_us")) {
+            name.chop(3);
+        }
+        name += "_max_us";
+        out += "# HELP " + name + " Largest value of " + kTimingInfo[i].promName + " since start.\n";
+        out += "# TYPE " + name + " gauge\n";
+        out += name + ' ' + QByteArray::number(stats.timings[i].maxUs) + '\n';
+    }
+    return out;
+}
+
+QJsonObject HostStats::toJson() const {
+    const Snapshot stats = snapshot();
+    QJsonObject json;
+    for (int i = 0; i < CounterCount; ++i) {
+        json.insert(QLatin1String(kCounterInfo[i].jsonName), static_cast<qint64>(stats.counters[i]));
+    }
+    for (int i = 0; i < GaugeCount; ++i) {
+        json.insert(QLatin1String(kGaugeInfo[i].jsonName), stats.gauges[i]);
+    }
+    for (int i = 0; i < TimingCount; ++i) {
+        const TimingSnapshot &timing = stats.timings[i];
+        QJsonObject entry;
+        entry.insert(QStringLiteral("count"), static_cast<qint64>(timing.count));
+        entry.insert(QStringLiteral("avg"), timing.count ? static_cast<double>(timing.sumUs) / timing.count : 0.0);
+        entry.insert(QStringLiteral("max"), static_cast<qint64>(timing.maxUs));
+        json.insert(QLatin1String(kTimingInfo[i].jsonName), entry);
+    }
+    return json;
+}
+
+}  // namespace host
@@ -1,6 +1,17 @@
 #include "host/InputInjector.h"
 
-#include <QJsonObject>
+#include "host/CaptureRegion.h"
+#include "host/HostStats.h"
+#include "host/Trace.h"
+#include "host/VideoSource.h"
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QScreen>
+#include <array>
+#include <cmath>
+#include <limits>
 
 #ifdef Q_OS_WIN
 #include <Windows.h>
@@ -8,68 +19,399 @@
 
 namespace host {
 
-InputInjector::InputInjector(QObject *parent) : QObject(parent) {}
+namespace {
+constexpr std::size_t kUrgentCapacity = 512;
+constexpr std::size_t kMotionCapacity = 1024;
+// Upper bound on samples kept while a button is held (and sent per SendInput).
+constexpr int kMaxBatchedPoints = 64;
+
+bool isMotion(const QJsonObject &event) { return event.value("t").toString() == QStringLiteral("move"); }
+
+bool isPointerButton(const QJsonObject &event) {
+    const QString type = event.value("t").toString();
+    return type == QStringLiteral("click") || type == QStringLiteral("wheel");
+}
+
+// Viewers may batch coalesced pointer samples ("points": [[x, y], ...]) into
+// one move; a plain move is a single x/y.
+QVector<QPointF> motionPoints(const QJsonObject &event) {
+    QVector<QPointF> points;
+    const QJsonArray batch = event.value("points").toArray();
+    if (batch.isEmpty()) {
+        points.append(QPointF(event.value("x").toDouble(), event.value("y").toDouble()));
+        return points;
+    }
+    const int first = qMax(0, static_cast<int>(batch.size()) - kMaxBatchedPoints);
+    points.reserve(static_cast<int>(batch.size()) - first);
+    for (int i = first; i < batch.size(); ++i) {
+        const QJsonArray point = batch.at(i).toArray();
+        points.append(QPointF(point.at(0).toDouble(), point.at(1).toDouble()));
+    }
+    return points;
+}
+
+// Normalized video coordinates -> physical desktop pixels, keeping the fraction.
+QPointF toDesktop(const QRect &screen, const QPointF &normalized) {
+    return QPointF(screen.x() + qBound(0.0, normalized.x(), 1.0) * (screen.width() - 1),
+                   screen.y() + qBound(0.0, normalized.y(), 1.0) * (screen.height() - 1));
+}
+}  // namespace
+
+InputInjector::InputInjector(QObject *parent)
+    : QObject(parent), m_urgent(kUrgentCapacity), m_motion(kMotionCapacity) {
+    m_worker = std::thread(&InputInjector::run, this);
+}
+
+InputInjector::~InputInjector() {
+    m_running.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    releaseHeldKeys();
+    releaseHeldButtons();
+}
+
+void InputInjector::setScreenIndex(int index) {
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    QScreen *screen = index >= 0 && index < screens.size() ? screens.at(index) : QGuiApplication::primaryScreen();
+    if (m_screen) {
+        disconnect(m_screen, nullptr, this, nullptr);
+    }
+    m_screen = screen;
+    if (screen) {
+        connect(screen, &QScreen::geometryChanged, this, &InputInjector::updateScreenGeometry);
+        connect(screen, &QScreen::logicalDotsPerInchChanged, this, &InputInjector::updateScreenGeometry);
+    }
+    updateScreenGeometry();
+}
+
+void InputInjector::updateScreenGeometry() {
+    const QRect geometry = m_screen ? physicalScreenGeometry(m_screen) : QRect();
+    std::lock_guard<std::mutex> lock(m_geometryMutex);
+    m_screenGeometry = geometry;
+}
+
+void InputInjector::setCaptureRegion(const QRect &region) {
+    std::lock_guard<std::mutex> lock(m_geometryMutex);
+    m_captureRegion = region;
+}
 
-InputInjector::~InputInjector() = default;
+void InputInjector::setEnabled(bool enabled) {
+    m_enabled.store(enabled, std::memory_order_release);
+    if (!enabled) {
+        releaseHeldInput();
+    }
+}
 
-void InputInjector::setEnabled(bool enabled) { m_enabled = enabled; }
+void InputInjector::releaseHeldInput() {
+    m_releaseRequested.store(true, std::memory_order_release);
+    wake();
+}
 
 void InputInjector::handleInputEvent(const QJsonObject &event) {
-    if (!m_enabled) {
+    if (!m_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+    QueuedEvent queued;
+    queued.sequence = m_nextSequence.fetch_add(1, std::memory_order_relaxed);
+    queued.enqueuedUs = captureClockUs();
+    queued.event = event;
+    const bool motion = isMotion(event);
+    if (motion) {
+        queued.points = motionPoints(event);
+    }
+    MpscQueue<QueuedEvent> &queue = motion ? m_motion : m_urgent;
+    if (!queue.tryPush(std::move(queued))) {
+        HostStats::instance().add(HostStats::InputEventsDropped);
+        return;
+    }
+    wake();
+}
+
+void InputInjector::wake() {
+    // Only the first producer after a drain pays for the wakeup.
+    if (!m_pending.exchange(true, std::memory_order_acq_rel)) {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+        }
+        m_wake.notify_one();
+    }
+}
+
+void InputInjector::run() {
+    trace::setThreadName("input");
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait(lock, [this]() {
+                return m_pending.load(std::memory_order_acquire) || !m_running.load(std::memory_order_acquire);
+            });
+        }
+        if (!m_running.load(std::memory_order_acquire)) {
+            return;
+        }
+        m_pending.exchange(false, std::memory_order_acq_rel);
+        while (drain()) {
+        }
+        if (m_releaseRequested.exchange(false, std::memory_order_acq_rel)) {
+            releaseHeldKeys();
+            releaseHeldButtons();
+        }
+    }
+}
+
+bool InputInjector::drain() {
+    bool drained = false;
+    QueuedEvent queued;
+    while (m_urgent.tryPop(queued)) {
+        drained = true;
+        // A click lands wherever the cursor is, so motion that arrived before it
+        // still has to be applied first, but only as one coalesced move.
+        if (isPointerButton(queued.event)) {
+            flushMotion(queued.sequence);
+        }
+        dispatch(queued);
+    }
+    return flushMotion(std::numeric_limits<quint64>::max()) || drained;
+}
+
+bool InputInjector::flushMotion(quint64 beforeSequence) {
+    std::optional<QueuedEvent> merged;
+    // Positions are absolute, so when hovering only the newest matters. While a
+    // button is held the path matters too (drags, drawing), so samples are
+    // concatenated. The oldest receive time is kept for the delay stat.
+    const bool dragging = m_pressedButtons != 0;
+    auto merge = [&merged, dragging](QueuedEvent &&next) {
+        if (!merged) {
+            merged = std::move(next);
+            return;
+        }
+        const qint64 enqueuedUs = merged->enqueuedUs;
+        if (dragging) {
+            QVector<QPointF> points = std::move(merged->points);
+            points += next.points;
+            if (points.size() > kMaxBatchedPoints) {
+                points.remove(0, points.size() - kMaxBatchedPoints);
+            }
+            merged = std::move(next);
+            merged->points = std::move(points);
+        } else {
+            merged = std::move(next);
+        }
+        merged->enqueuedUs = enqueuedUs;
+    };
+
+    if (m_heldMotion) {
+        if (m_heldMotion->sequence >= beforeSequence) {
+            return false;
+        }
+        merge(std::move(*m_heldMotion));
+        m_heldMotion.reset();
+    }
+    QueuedEvent queued;
+    while (m_motion.tryPop(queued)) {
+        if (queued.sequence >= beforeSequence) {
+            m_heldMotion = std::move(queued);
+            break;
+        }
+        merge(std::move(queued));
+    }
+    if (!merged) {
+        return false;
+    }
+    dispatch(*merged);
+    return true;
+}
+
+void InputInjector::dispatch(const QueuedEvent &queued) {
+    // Checked per event so a disable takes effect even for events already queued.
+    if (!m_enabled.load(std::memory_order_acquire)) {
         return;
     }
+    if (queued.points.isEmpty()) {
+        inject(queued.event);
+    } else {
+        HOST_TRACE_SCOPE("input.inject");
+        QElapsedTimer timer;
+        timer.start();
+        injectMotion(queued.points);
+        HostStats::instance().record(HostStats::InjectionLatency, timer.nsecsElapsed() / 1000);
+    }
+    HostStats::instance().record(HostStats::InputDispatchDelay, captureClockUs() - queued.enqueuedUs);
+}
+
+void InputInjector::inject(const QJsonObject &event) {
+    HOST_TRACE_SCOPE("input.inject");
+    QElapsedTimer timer;
+    timer.start();
     const QString type = event.value("t").toString();
-#ifdef Q_OS_WIN
     if (type == QStringLiteral("key")) {
-        INPUT input{};
-        input.type = INPUT_KEYBOARD;
-        const QString keyType = event.value("type").toString();
-        const bool keyDown = keyType == QStringLiteral("down");
-        input.ki.wVk = 0;
-        input.ki.dwFlags = keyDown ? 0 : KEYEVENTF_KEYUP;
-        SendInput(1, &input, sizeof(INPUT));
-    } else if (type == QStringLiteral("move")) {
-        // Basic absolute move placeholder.
-        INPUT input{};
+        handleKeyEvent(event);
+    } else {
+        injectPointerEvent(type, event);
+    }
+    HostStats::instance().record(HostStats::InjectionLatency, timer.nsecsElapsed() / 1000);
+}
+
+void InputInjector::handleKeyEvent(const QJsonObject &event) {
+    const KeyInfo *key = findKey(event.value("code").toString());
+    if (!key) {
+        return;
+    }
+    syncModifiers(event);
+    const bool down = event.value("type").toString() == QStringLiteral("down");
+    const std::size_t index = keyIndex(*key);
+    // An up for a key we never pressed (or already released) would confuse the target app.
+    if (!down && !m_pressedKeys.test(index)) {
+        return;
+    }
+    m_pressedKeys.set(index, down);
+    injectKey(*key, down);
+}
+
+// The viewer can lose a modifier key-up (e.g. its window lost focus mid-chord).
+// Every DOM key event carries the live modifier flags, so release whatever we
+// still hold that the viewer says is up.
+void InputInjector::syncModifiers(const QJsonObject &event) {
+    static constexpr struct {
+        const char *flag;
+        KeyModifier modifier;
+    } kFlags[] = {
+        {"shiftKey", KeyModifier::Shift},
+        {"ctrlKey", KeyModifier::Control},
+        {"altKey", KeyModifier::Alt},
+        {"metaKey", KeyModifier::Meta},
+    };
+    for (const auto &entry : kFlags) {
+        const QJsonValue value = event.value(QLatin1String(entry.flag));
+        if (value.isBool() && !value.toBool()) {
+            releaseHeldKeys(entry.modifier);
+        }
+    }
+}
+
+void InputInjector::releaseHeldKeys(KeyModifier onlyModifier) {
+    if (m_pressedKeys.none()) {
+        return;
+    }
+    for (std::size_t i = 0; i < kKeyCount; ++i) {
+        if (!m_pressedKeys.test(i)) {
+            continue;
+        }
+        if (onlyModifier != KeyModifier::None && kKeyTable[i].modifier != onlyModifier) {
+            continue;
+        }
+        m_pressedKeys.reset(i);
+        injectKey(kKeyTable[i], false);
+    }
+}
+
+void InputInjector::injectKey(const KeyInfo &key, bool down) {
+#ifdef Q_OS_WIN
+    INPUT input{};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = key.windowsVk;
+    input.ki.wScan = static_cast<WORD>(MapVirtualKeyW(key.windowsVk, MAPVK_VK_TO_VSC));
+    input.ki.dwFlags = (key.windowsExtended ? KEYEVENTF_EXTENDEDKEY : 0) | (down ? 0 : KEYEVENTF_KEYUP);
+    SendInput(1, &input, sizeof(INPUT));
+#else
+    Q_UNUSED(key);
+    Q_UNUSED(down);
+#endif
+}
+
+void InputInjector::injectMotion(const QVector<QPointF> &points) {
+    QRect screen;
+    {
+        std::lock_guard<std::mutex> lock(m_geometryMutex);
+        screen = m_captureRegion.isEmpty() ? m_screenGeometry
+                                           : m_captureRegion.translated(m_screenGeometry.topLeft());
+    }
+    if (screen.isEmpty()) {
+        return;
+    }
+#ifdef Q_OS_WIN
+    // Absolute coordinates span the whole virtual desktop as 0..65535, which is
+    // finer than a pixel on any realistic layout; that keeps the sub-pixel part.
+    const int desktopX = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    const int desktopY = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    const double scaleX = 65535.0 / qMax(1, GetSystemMetrics(SM_CXVIRTUALSCREEN) - 1);
+    const double scaleY = 65535.0 / qMax(1, GetSystemMetrics(SM_CYVIRTUALSCREEN) - 1);
+    std::array<INPUT, kMaxBatchedPoints> inputs{};
+    const int count = qMin(static_cast<int>(points.size()), kMaxBatchedPoints);
+    for (int i = 0; i < count; ++i) {
+        const QPointF desktop = toDesktop(screen, points.at(points.size() - count + i));
+        INPUT &input = inputs[static_cast<std::size_t>(i)];
         input.type = INPUT_MOUSE;
-        input.mi.dwFlags = MOUSEEVENTF_MOVE;
-        input.mi.dx = event.value("x").toInt();
-        input.mi.dy = event.value("y").toInt();
-        SendInput(1, &input, sizeof(INPUT));
-    } else if (type == QStringLiteral("click")) {
-        int button = event.value("button").toInt();
-        INPUT down{};
-        down.type = INPUT_MOUSE;
-        INPUT up = down;
-        switch (button) {
-        case 0:
-            down.mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
-            up.mi.dwFlags = MOUSEEVENTF_LEFTUP;
-            break;
-        case 1:
-            down.mi.dwFlags = MOUSEEVENTF_MIDDLEDOWN;
-            up.mi.dwFlags = MOUSEEVENTF_MIDDLEUP;
-            break;
-        case 2:
-            down.mi.dwFlags = MOUSEEVENTF_RIGHTDOWN;
-            up.mi.dwFlags = MOUSEEVENTF_RIGHTUP;
-            break;
-        default:
-            return;
+        input.mi.dx = static_cast<LONG>(std::lround((desktop.x() - desktopX) * scaleX));
+        input.mi.dy = static_cast<LONG>(std::lround((desktop.y() - desktopY) * scaleY));
+        // NOCOALESCE keeps intermediate drag samples from being merged by Windows.
+        input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK |
+                           (count > 1 ? MOUSEEVENTF_MOVE_NOCOALESCE : 0);
+    }
+    SendInput(static_cast<UINT>(count), inputs.data(), sizeof(INPUT));
+#else
+    Q_UNUSED(points);
+#endif
+}
+
+void InputInjector::injectButton(int button, bool down) {
+    if (button < 0 || button > 2) {
+        return;
+    }
+    const quint32 bit = 1u << button;
+    if (!down && !(m_pressedButtons & bit)) {
+        return;
+    }
+    m_pressedButtons = down ? (m_pressedButtons | bit) : (m_pressedButtons & ~bit);
+#ifdef Q_OS_WIN
+    static constexpr DWORD kFlags[3][2] = {
+        {MOUSEEVENTF_LEFTUP, MOUSEEVENTF_LEFTDOWN},
+        {MOUSEEVENTF_MIDDLEUP, MOUSEEVENTF_MIDDLEDOWN},
+        {MOUSEEVENTF_RIGHTUP, MOUSEEVENTF_RIGHTDOWN},
+    };
+    INPUT input{};
+    input.type = INPUT_MOUSE;
+    input.mi.dwFlags = kFlags[button][down ? 1 : 0];
+    SendInput(1, &input, sizeof(INPUT));
+#endif
+}
+
+void InputInjector::releaseHeldButtons() {
+    for (int button = 0; m_pressedButtons != 0 && button < 3; ++button) {
+        injectButton(button, false);
+    }
+}
+
+// "click" is a full press and release unless "type" is "down" or "up" (drags).
+// Clicks and wheel events may carry the pointer position so they land where
+// the viewer clicked even if the preceding motion was lost.
+void InputInjector::injectPointerEvent(const QString &type, const QJsonObject &event) {
+    if (event.contains(QStringLiteral("x")) && event.contains(QStringLiteral("y"))) {
+        injectMotion({QPointF(event.value("x").toDouble(), event.value("y").toDouble())});
+    }
+    if (type == QStringLiteral("click")) {
+        const int button = event.value("button").toInt();
+        const QString phase = event.value("type").toString();
+        if (phase != QStringLiteral("up")) {
+            injectButton(button, true);
+        }
+        if (phase != QStringLiteral("down")) {
+            injectButton(button, false);
         }
-        SendInput(1, &down, sizeof(INPUT));
-        SendInput(1, &up, sizeof(INPUT));
     } else if (type == QStringLiteral("wheel")) {
+#ifdef Q_OS_WIN
         INPUT input{};
         input.type = INPUT_MOUSE;
         input.mi.dwFlags = MOUSEEVENTF_WHEEL;
         input.mi.mouseData = event.value("deltaY").toInt();
         SendInput(1, &input, sizeof(INPUT));
-    }
-#else
-    Q_UNUSED(event);
 #endif
+    }
 }
 
 }  // namespace host
-
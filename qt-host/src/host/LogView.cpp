@@ -0,0 +1,37 @@
+#include "host/LogView.h"
+
+#include <QFontDatabase>
+#include <QScrollBar>
+
+namespace host {
+
+LogView::LogView(QWidget *parent) : QPlainTextEdit(parent) {
+    setReadOnly(true);
+    setUndoRedoEnabled(false);
+    setLineWrapMode(QPlainTextEdit::NoWrap);
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setMaximumBlockCount(m_maxLines);
+}
+
+void LogView::setMaxLines(int lines) {
+    m_maxLines = qMax(1, lines);
+    setMaximumBlockCount(m_maxLines);
+}
+
+void LogView::appendLines(const QStringList &lines) {
+    if (lines.isEmpty()) {
+        return;
+    }
+    // Lines older than the retained window would be trimmed right after insertion.
+    const int first = qMax(0, static_cast<int>(lines.size()) - m_maxLines);
+    const QStringList tail = lines.mid(first);
+
+    QScrollBar *bar = verticalScrollBar();
+    const bool following = bar->value() == bar->maximum();
+    appendPlainText(tail.join(QLatin1Char('\n')));
+    if (following) {
+        bar->setValue(bar->maximum());
+    }
+}
+
+}  // namespace host
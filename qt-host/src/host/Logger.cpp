@@ -0,0 +1,172 @@
+#include "host/Logger.h"
+
+#include "host/Trace.h"
+#include "host/VideoSource.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+namespace host {
+
+namespace {
+constexpr std::size_t kQueueCapacity = 4096;
+constexpr auto kDrainInterval = std::chrono::milliseconds(50);
+
+char levelTag(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug:
+        return 'D';
+    case LogLevel::Info:
+        return 'I';
+    case LogLevel::Warning:
+        return 'W';
+    case LogLevel::Error:
+        return 'E';
+    }
+    return '?';
+}
+}  // namespace
+
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : m_queue(kQueueCapacity) {}
+
+Logger::~Logger() { shutdown(); }
+
+void Logger::start(const Config &config) {
+    shutdown();
+    m_config = config;
+    m_minLevel.store(static_cast<int>(config.minLevel), std::memory_order_relaxed);
+    const int rate = qMax(1, config.linesPerSecond);
+    m_emissionIntervalUs = 1000000 / rate;
+    m_burstToleranceUs = m_emissionIntervalUs * qMax(1, config.burstLines);
+
+    if (!config.filePath.isEmpty()) {
+        QDir().mkpath(QFileInfo(config.filePath).absolutePath());
+        m_file.setFileName(config.filePath);
+        m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    }
+    m_running.store(true, std::memory_order_release);
+    m_worker = std::thread(&Logger::run, this);
+}
+
+void Logger::shutdown() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool Logger::admit(qint64 nowUs) {
+    qint64 next = m_nextAdmitUs.load(std::memory_order_relaxed);
+    for (;;) {
+        const qint64 arrival = qMax(next, nowUs);
+        if (arrival - nowUs > m_burstToleranceUs) {
+            return false;
+        }
+        if (m_nextAdmitUs.compare_exchange_weak(next, arrival + m_emissionIntervalUs, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void Logger::log(LogLevel level, const QString &message) {
+    if (!isEnabled(level) || !m_running.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (level != LogLevel::Error && !admit(captureClockUs())) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record record;
+    record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.message = message;
+    if (!m_queue.tryPush(std::move(record))) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::run() {
+    trace::setThreadName("logger");
+    while (m_running.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, kDrainInterval);
+        }
+        drain();
+    }
+    drain();
+}
+
+void Logger::drain() {
+    QStringList lines;
+    Record record;
+    while (m_queue.tryPop(record)) {
+        const QDateTime time = QDateTime::fromMSecsSinceEpoch(record.timestampMs);
+        lines.append(QStringLiteral("%1 [%2] %3")
+                         .arg(time.toString(QStringLiteral("HH:mm:ss.zzz")))
+                         .arg(QLatin1Char(levelTag(record.level)))
+                         .arg(record.message));
+    }
+
+    const quint64 suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+    const quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+    if (suppressed > 0 || dropped != m_reportedDropped) {
+        lines.append(QStringLiteral("%1 [W] logger: %2 lines rate limited, %3 dropped (queue full)")
+                         .arg(QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss.zzz")))
+                         .arg(suppressed)
+                         .arg(dropped - m_reportedDropped));
+        m_reportedDropped = dropped;
+    }
+    if (lines.isEmpty()) {
+        return;
+    }
+    writeToFile(lines);
+    emit linesReady(lines);
+}
+
+void Logger::writeToFile(const QStringList &lines) {
+    if (!m_file.isOpen()) {
+        return;
+    }
+    QByteArray data;
+    for (const QString &line : lines) {
+        data += line.toUtf8();
+        data += '\n';
+    }
+    m_file.write(data);
+    m_file.flush();
+    if (m_file.size() >= m_config.maxFileBytes) {
+        rotate();
+    }
+}
+
+// host.log -> host.log.1 -> ... -> host.log.<maxFiles - 1>; the oldest is removed.
+void Logger::rotate() {
+    const QString path = m_config.filePath;
+    m_file.close();
+    const int keep = qMax(1, m_config.maxFiles);
+    QFile::remove(QStringLiteral("%1.%2").arg(path).arg(keep - 1));
+    for (int i = keep - 2; i >= 1; --i) {
+        QFile::rename(QStringLiteral("%1.%2").arg(path).arg(i), QStringLiteral("%1.%2").arg(path).arg(i + 1));
+    }
+    if (keep > 1) {
+        QFile::rename(path, QStringLiteral("%1.1").arg(path));
+    } else {
+        QFile::remove(path);
+    }
+    m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
+
+}  // namespace host
@@ -0,0 +1,126 @@
+#include "host/MoveDetector.h"
+
+#include <cstring>
+
+namespace host {
+
+namespace {
+// Marks a row hash that occurs more than once in the previous frame (blank
+// lines, rules); such rows say nothing about where content went.
+constexpr int kAmbiguousRow = -1;
+constexpr int kMinVotes = MoveDetector::kMinRows / 2;
+
+std::uint64_t hashRow(const std::uint8_t *row, int length) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        std::uint64_t word;
+        memcpy(&word, row + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ row[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+}  // namespace
+
+void MoveDetector::detect(const std::uint8_t *previous, const std::uint8_t *current, int width, int height,
+                          const QVector<QRect> &dirtyRects, QVector<MoveRect> &moves) {
+    const QRect frameRect(0, 0, width, height);
+    for (const QRect &dirty : dirtyRects) {
+        const QRect rect = dirty.intersected(frameRect);
+        if (rect.height() < kMinRows || rect.width() * rect.height() < kMinArea) {
+            continue;
+        }
+        MoveRect best;
+        const auto consider = [&](const QPoint &offset) {
+            if (offset.isNull()) {
+                return;
+            }
+            const QRect matched = verify(previous, current, width, height, rect, offset);
+            if (matched.width() * matched.height() > best.rect.width() * best.rect.height()) {
+                best = {matched, offset};
+            }
+        };
+        // A scroll keeps its rectangle and shifts the content inside it.
+        if (const int shift = voteVerticalShift(previous, current, width, rect)) {
+            consider(QPoint(0, shift));
+        }
+        // A dragged window shows up as its old and new rectangles.
+        for (const QRect &other : dirtyRects) {
+            if (&other != &dirty && other.size() == dirty.size()) {
+                consider(dirty.topLeft() - other.topLeft());
+            }
+        }
+        if (!best.rect.isEmpty() && best.rect.width() * best.rect.height() >= kMinArea) {
+            moves.append(best);
+        }
+    }
+}
+
+int MoveDetector::voteVerticalShift(const std::uint8_t *previous, const std::uint8_t *current, int width,
+                                    const QRect &rect) {
+    const int length = rect.width();
+    m_previousRows.clear();
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const auto inserted = m_previousRows.emplace(hashRow(previous + y * width + rect.left(), length), y);
+        if (!inserted.second) {
+            inserted.first->second = kAmbiguousRow;
+        }
+    }
+
+    m_votes.clear();
+    int bestShift = 0;
+    int bestVotes = 0;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const auto found = m_previousRows.find(hashRow(current + y * width + rect.left(), length));
+        if (found == m_previousRows.end() || found->second == kAmbiguousRow || found->second == y) {
+            continue;
+        }
+        const int shift = y - found->second;
+        const int votes = ++m_votes[shift];
+        if (votes > bestVotes) {
+            bestVotes = votes;
+            bestShift = shift;
+        }
+    }
+    return bestVotes >= kMinVotes ? bestShift : 0;
+}
+
+QRect MoveDetector::verify(const std::uint8_t *previous, const std::uint8_t *current, int width, int height,
+                           const QRect &rect, const QPoint &offset) const {
+    // Clip to where the source lies inside the previous frame.
+    const int left = qMax(rect.left(), offset.x());
+    const int right = qMin(rect.right(), width - 1 + offset.x());
+    const int top = qMax(rect.top(), offset.y());
+    const int bottom = qMin(rect.bottom(), height - 1 + offset.y());
+    const int length = right - left + 1;
+    if (length <= 0 || bottom < top) {
+        return {};
+    }
+
+    int bestTop = top;
+    int bestRows = 0;
+    int runTop = top;
+    for (int y = top; y <= bottom + 1; ++y) {
+        const bool match = y <= bottom && memcmp(current + y * width + left,
+                                                 previous + (y - offset.y()) * width + (left - offset.x()),
+                                                 static_cast<size_t>(length)) == 0;
+        if (match) {
+            continue;
+        }
+        if (y - runTop > bestRows) {
+            bestRows = y - runTop;
+            bestTop = runTop;
+        }
+        runTop = y + 1;
+    }
+    if (bestRows < kMinRows) {
+        return {};
+    }
+    return QRect(left, bestTop, length, bestRows);
+}
+
+}  // namespace host
@@ -0,0 +1,176 @@
+#include "host/PacedSender.h"
+
+#include "host/HostStats.h"
+#include "host/Trace.h"
+#include "host/VideoSource.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace host {
+
+PacedSender::PacedSender(const Config &config, SendFunction send) : m_config(config), m_send(std::move(send)) {
+    m_worker = std::thread(&PacedSender::run, this);
+}
+
+PacedSender::~PacedSender() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    HostStats &stats = HostStats::instance();
+    stats.set(HostStats::SendQueueDepth, 0);
+    stats.set(HostStats::PacerQueueTimeMs, 0);
+}
+
+void PacedSender::enqueue(Priority priority, const QByteArray &packet) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<int>(priority)].push_back({packet, captureClockUs()});
+        m_queuedBytes += packet.size();
+        ++m_queuedPackets;
+        if (priority == Priority::Video) {
+            // Queued behind them, so the replaceable packets are needed now.
+            m_replaceablePackets = 0;
+            m_replaceableBytes = 0;
+            m_replaceableStarted = false;
+        }
+    }
+    m_wake.notify_one();
+}
+
+void PacedSender::enqueueReplaceable(const QByteArray &packet) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<int>(Priority::Video)].push_back({packet, captureClockUs(), true});
+        m_queuedBytes += packet.size();
+        ++m_queuedPackets;
+        ++m_replaceablePackets;
+        m_replaceableBytes += packet.size();
+    }
+    m_wake.notify_one();
+}
+
+int PacedSender::dropReplaceable() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int dropped = m_replaceableStarted ? 0 : m_replaceablePackets;
+    auto &queue = m_queues[static_cast<int>(Priority::Video)];
+    for (int i = 0; i < dropped; ++i) {
+        m_queuedBytes -= queue.back().data.size();
+        --m_queuedPackets;
+        queue.pop_back();
+    }
+    m_replaceablePackets = 0;
+    m_replaceableBytes = 0;
+    m_replaceableStarted = false;
+    return dropped;
+}
+
+void PacedSender::setBitrate(int kbps) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config.bitrateKbps = qMax(1, kbps);
+}
+
+void PacedSender::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &queue : m_queues) {
+        queue.clear();
+    }
+    m_queuedBytes = 0;
+    m_queuedPackets = 0;
+    m_replaceablePackets = 0;
+    m_replaceableBytes = 0;
+    m_replaceableStarted = false;
+}
+
+qint64 PacedSender::expectedQueueTimeUs() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return queueTimeUs(m_queuedBytes - m_replaceableBytes);
+}
+
+int PacedSender::queuedPackets() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queuedPackets;
+}
+
+qint64 PacedSender::nominalRateBps() const {
+    return static_cast<qint64>(m_config.bitrateKbps * 1000.0 * m_config.pacingFactor);
+}
+
+qint64 PacedSender::queueTimeUs(qint64 bytes) const {
+    // At the nominal rate: a backlog that needs the max-queue boost still reads as late.
+    return bytes * 8 * 1000000 / qMax<qint64>(1, nominalRateBps());
+}
+
+qint64 PacedSender::pacingRateBps() const {
+    const qint64 nominal = nominalRateBps();
+    const qint64 drain = m_queuedBytes * 8 * 1000000 / qMax<qint64>(1, m_config.maxQueueTimeUs);
+    return std::max(nominal, drain);
+}
+
+bool PacedSender::takeNext(qint64 nowUs, QueuedPacket &packet) {
+    for (int priority = 0; priority < kPriorityCount; ++priority) {
+        auto &queue = m_queues[priority];
+        if (queue.empty()) {
+            continue;
+        }
+        // Audio is small and latency-critical; it is never held back, only charged.
+        if (m_budgetBytes <= 0 && priority != static_cast<int>(Priority::Audio)) {
+            return false;
+        }
+        packet = std::move(queue.front());
+        queue.pop_front();
+        if (packet.replaceable && m_replaceablePackets > 0) {
+            m_replaceableStarted = true;
+            --m_replaceablePackets;
+            m_replaceableBytes -= packet.data.size();
+        }
+        m_queuedBytes -= packet.data.size();
+        --m_queuedPackets;
+        m_budgetBytes -= packet.data.size();
+        HostStats::instance().record(HostStats::PacerDelay, nowUs - packet.enqueuedUs);
+        return true;
+    }
+    return false;
+}
+
+void PacedSender::run() {
+    trace::setThreadName("pacer");
+    HostStats &stats = HostStats::instance();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        if (m_queuedPackets == 0) {
+            m_wake.wait(lock, [this]() { return !m_running || m_queuedPackets > 0; });
+            continue;
+        }
+
+        const qint64 nowUs = captureClockUs();
+        const qint64 rateBps = pacingRateBps();
+        // Credit never exceeds one tick, so an idle link does not bank a burst.
+        const qint64 elapsedUs = std::clamp<qint64>(nowUs - m_lastRefillUs, 0, m_config.tickUs);
+        const qint64 maxBudget = rateBps * m_config.tickUs / 8000000;
+        m_budgetBytes = std::min(m_budgetBytes + rateBps * elapsedUs / 8000000, maxBudget);
+        m_lastRefillUs = nowUs;
+
+        QueuedPacket packet;
+        while (takeNext(nowUs, packet)) {
+            lock.unlock();
+            {
+                HOST_TRACE_SCOPE("pacer.send");
+                m_send(packet.data);
+            }
+            lock.lock();
+        }
+        stats.set(HostStats::SendQueueDepth, m_queuedPackets);
+        stats.set(HostStats::PacerQueueTimeMs, queueTimeUs(m_queuedBytes) / 1000);
+        if (m_queuedPackets > 0) {
+            m_wake.wait_for(lock, std::chrono::microseconds(m_config.tickUs));
+        }
+    }
+}
+
+}  // namespace host
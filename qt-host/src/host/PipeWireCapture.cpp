@@ -0,0 +1,762 @@
+#include "host/PipeWireCapture.h"
+
+#include "host/ColorConvert.h"
+#include "host/Trace.h"
+#include "host/VideoFrame.h"
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusUnixFileDescriptor>
+#include <QDBusVariant>
+#include <QPair>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+
+#include <pipewire/pipewire.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/video/format-utils.h>
+
+namespace host {
+
+namespace {
+constexpr char kPortalService[] = "org.freedesktop.portal.Desktop";
+constexpr char kPortalPath[] = "/org/freedesktop/portal/desktop";
+constexpr char kScreenCastInterface[] = "org.freedesktop.portal.ScreenCast";
+constexpr char kRequestInterface[] = "org.freedesktop.portal.Request";
+constexpr char kSessionInterface[] = "org.freedesktop.portal.Session";
+// ScreenCast source types and cursor modes (bit flags in the portal API).
+constexpr uint kSourceMonitor = 1;
+constexpr uint kCursorEmbedded = 2;
+constexpr uint kCursorMetadata = 4;
+
+constexpr int kDefaultFps = 30;
+constexpr int kBuffers = 4;
+constexpr int kDamageRegions = 16;
+// Past this many rectangles waiting for delivery, convert the whole frame.
+constexpr int kMaxPendingDamage = 64;
+constexpr int kMaxCursorSize = 256;
+// A buffer this early for its slot is still taken instead of being held back.
+constexpr qint64 kJitterUs = 2000;
+
+int cursorMetaSize(int width, int height) {
+    return static_cast<int>(sizeof(spa_meta_cursor) + sizeof(spa_meta_bitmap)) + width * height * 4;
+}
+
+QString newToken() { return QStringLiteral("host%1").arg(QRandomGenerator::global()->generate()); }
+
+QString requestPath(const QString &token) {
+    // The portal derives the request object from our unique bus name.
+    QString sender = QDBusConnection::sessionBus().baseService().mid(1);
+    sender.replace(QLatin1Char('.'), QLatin1Char('_'));
+    return QStringLiteral("/org/freedesktop/portal/desktop/request/%1/%2").arg(sender, token);
+}
+
+// Node id of the first entry of the Start response's a(ua{sv}) "streams".
+uint firstStreamNode(const QVariant &streams) {
+    if (streams.userType() != qMetaTypeId<QDBusArgument>()) {
+        return 0;
+    }
+    const QDBusArgument argument = streams.value<QDBusArgument>();
+    uint node = 0;
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        uint id = 0;
+        QVariantMap properties;
+        argument.beginStructure();
+        argument >> id >> properties;
+        argument.endStructure();
+        if (node == 0) {
+            node = id;
+        }
+    }
+    argument.endArray();
+    return node;
+}
+
+class LoopLock {
+public:
+    explicit LoopLock(pw_thread_loop *loop) : m_loop(loop) { pw_thread_loop_lock(m_loop); }
+    ~LoopLock() { pw_thread_loop_unlock(m_loop); }
+    LoopLock(const LoopLock &) = delete;
+    LoopLock &operator=(const LoopLock &) = delete;
+
+private:
+    pw_thread_loop *m_loop;
+};
+
+// Shared memory only: no modifiers are offered, so compositors fall back from DMA-BUF.
+const spa_pod *buildFormat(spa_pod_builder *builder, int fps) {
+    const spa_rectangle defaultSize{1920, 1080};
+    const spa_rectangle minSize{1, 1};
+    const spa_rectangle maxSize{8192, 8192};
+    const spa_fraction variableRate{0, 1};
+    const spa_fraction minRate{1, 1};
+    const spa_fraction maxRate{static_cast<uint32_t>(fps), 1};
+    return static_cast<const spa_pod *>(spa_pod_builder_add_object(
+        builder, SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat, SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
+        SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw), SPA_FORMAT_VIDEO_format,
+        SPA_POD_CHOICE_ENUM_Id(3, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRA),
+        SPA_FORMAT_VIDEO_size, SPA_POD_CHOICE_RANGE_Rectangle(&defaultSize, &minSize, &maxSize),
+        SPA_FORMAT_VIDEO_framerate, SPA_POD_Fraction(&variableRate), SPA_FORMAT_VIDEO_maxFramerate,
+        SPA_POD_CHOICE_RANGE_Fraction(&maxRate, &minRate, &maxRate)));
+}
+
+const spa_pod *buildMeta(spa_pod_builder *builder, spa_meta_type type, int size, int minSize, int maxSize) {
+    return static_cast<const spa_pod *>(spa_pod_builder_add_object(
+        builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type, SPA_POD_Id(type),
+        SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int(size, minSize, maxSize)));
+}
+
+QRect evenBounds(const QRect &rect) {
+    const int left = rect.left() & ~1;
+    const int top = rect.top() & ~1;
+    const int right = (rect.right() + 2) & ~1;
+    const int bottom = (rect.bottom() + 2) & ~1;
+    return QRect(left, top, right - left, bottom - top);
+}
+
+// Alpha-blends a straight-alpha BGRA patch over the same-sized, even-aligned
+// `rect` of a packed I420 or I444 frame.
+void blendBgraInto(const QByteArray &bgra, const QRect &rect, PixelFormat format, std::uint8_t *frame, int width,
+                   int height) {
+    const int patchWidth = rect.width();
+    const int patchHeight = rect.height();
+    const auto *pixels = reinterpret_cast<const std::uint8_t *>(bgra.constData());
+    QByteArray converted(yuvFrameSize(format, patchWidth, patchHeight), Qt::Uninitialized);
+    auto *patch = reinterpret_cast<std::uint8_t *>(converted.data());
+    if (format == PixelFormat::I444) {
+        convertBgraToI444(pixels, patchWidth * 4, patchWidth, patchHeight, patch);
+    } else {
+        convertBgraToI420(pixels, patchWidth * 4, patchWidth, patchHeight, patch);
+    }
+
+    const auto mix = [](std::uint8_t &dst, int src, int alpha) {
+        dst = static_cast<std::uint8_t>((dst * (255 - alpha) + src * alpha + 127) / 255);
+    };
+    for (int row = 0; row < patchHeight; ++row) {
+        std::uint8_t *y = frame + (rect.y() + row) * width + rect.x();
+        for (int col = 0; col < patchWidth; ++col) {
+            mix(y[col], patch[row * patchWidth + col], pixels[(row * patchWidth + col) * 4 + 3]);
+        }
+    }
+    const int shift = format == PixelFormat::I444 ? 0 : 1;
+    const int chromaStride = width >> shift;
+    const int chromaWidth = patchWidth >> shift;
+    const int chromaHeight = patchHeight >> shift;
+    std::uint8_t *u = frame + width * height + (rect.y() >> shift) * chromaStride + (rect.x() >> shift);
+    std::uint8_t *v = u + chromaStride * (height >> shift);
+    const std::uint8_t *patchU = patch + patchWidth * patchHeight;
+    const std::uint8_t *patchV = patchU + chromaWidth * chromaHeight;
+    for (int row = 0; row < chromaHeight; ++row) {
+        for (int col = 0; col < chromaWidth; ++col) {
+            const std::uint8_t *top = pixels + ((row << shift) * patchWidth + (col << shift)) * 4 + 3;
+            const std::uint8_t *bottom = top + patchWidth * 4;
+            const int alpha = shift == 0 ? top[0] : (top[0] + top[4] + bottom[0] + bottom[4] + 2) >> 2;
+            mix(u[row * chromaStride + col], patchU[row * chromaWidth + col], alpha);
+            mix(v[row * chromaStride + col], patchV[row * chromaWidth + col], alpha);
+        }
+    }
+}
+}  // namespace
+
+struct PipeWireCapture::Callbacks {
+    static void stateChanged(void *data, pw_stream_state, pw_stream_state state, const char *error) {
+        auto *self = static_cast<PipeWireCapture *>(data);
+        if (state == PW_STREAM_STATE_ERROR) {
+            self->streamFailed(PipeWireCapture::tr("PipeWire stream error: %1").arg(QString::fromUtf8(error)));
+        } else if (state == PW_STREAM_STATE_UNCONNECTED && self->m_running) {
+            self->streamFailed(PipeWireCapture::tr("The screen cast was ended by the compositor."));
+        }
+    }
+
+    static void paramChanged(void *data, uint32_t id, const spa_pod *param) {
+        if (id == SPA_PARAM_Format) {
+            static_cast<PipeWireCapture *>(data)->formatChanged(param);
+        }
+    }
+
+    static void removeBuffer(void *data, pw_buffer *buffer) {
+        auto *self = static_cast<PipeWireCapture *>(data);
+        if (self->m_held == buffer) {
+            self->m_held = nullptr;
+        }
+    }
+
+    static void process(void *data) {
+        auto *self = static_cast<PipeWireCapture *>(data);
+        while (pw_buffer *buffer = pw_stream_dequeue_buffer(self->m_stream)) {
+            self->accept(buffer);
+        }
+    }
+
+    static void timer(void *data, uint64_t expirations) {
+        Q_UNUSED(expirations);
+        static_cast<PipeWireCapture *>(data)->schedule();
+    }
+
+    static pw_stream_events streamEvents() {
+        pw_stream_events events{};
+        events.version = PW_VERSION_STREAM_EVENTS;
+        events.state_changed = &stateChanged;
+        events.param_changed = &paramChanged;
+        events.remove_buffer = &removeBuffer;
+        events.process = &process;
+        return events;
+    }
+};
+
+PipeWireCapture::PipeWireCapture(QObject *parent) : VideoSource(parent) {}
+
+PipeWireCapture::~PipeWireCapture() { stop(); }
+
+void PipeWireCapture::setScreenIndex(int index) { Q_UNUSED(index); }
+
+void PipeWireCapture::setFrameRate(int fps) {
+    m_intervalUs.store(fps > 0 ? 1000000 / fps : 0, std::memory_order_relaxed);
+    if (m_loop) {
+        // A frame held back for the old, slower rate goes out now if it is due.
+        LoopLock lock(m_loop);
+        schedule();
+    }
+}
+
+void PipeWireCapture::setPixelFormat(PixelFormat format) {
+    if (!m_loop) {
+        m_pixelFormat = format;
+        return;
+    }
+    LoopLock lock(m_loop);
+    m_pixelFormat = format;
+}
+
+void PipeWireCapture::setCaptureRegion(const QRect &region) {
+    if (!m_loop) {
+        m_region = region;
+        return;
+    }
+    LoopLock lock(m_loop);
+    m_region = region;
+}
+
+bool PipeWireCapture::start() {
+    if (m_running) {
+        return true;
+    }
+    m_running = true;
+    bool haveNode = false;
+    const uint node = qEnvironmentVariable("HOST_PIPEWIRE_NODE").toUInt(&haveNode);
+    const bool started = haveNode ? openStream(-1, node) : requestSession();
+    if (!started) {
+        m_running = false;
+    }
+    return started;
+}
+
+void PipeWireCapture::stop() {
+    m_running = false;
+    unwatchRequest();
+    m_step = PortalStep::None;
+    closeStream();
+    closeSession();
+}
+
+bool PipeWireCapture::requestSession() {
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        emit errorOccurred(tr("No D-Bus session bus; the screen cast portal is unreachable."));
+        return false;
+    }
+    // With metadata the cursor does not damage the picture; older portals can only embed it.
+    m_cursorMode = (availableCursorModes() & kCursorMetadata) != 0 ? kCursorMetadata : kCursorEmbedded;
+    QVariantMap options;
+    options.insert(QStringLiteral("session_handle_token"), newToken());
+    return callPortal(PortalStep::CreateSession, QStringLiteral("CreateSession"), QVariantList(), options);
+}
+
+bool PipeWireCapture::callPortal(PortalStep step, const QString &method, QVariantList arguments,
+                                 QVariantMap options) {
+    const QString token = newToken();
+    options.insert(QStringLiteral("handle_token"), token);
+    arguments.append(options);
+    // Subscribe before calling so a quick response is not missed.
+    watchRequest(requestPath(token));
+    m_step = step;
+    QDBusMessage call = QDBusMessage::createMethodCall(QLatin1String(kPortalService), QLatin1String(kPortalPath),
+                                                       QLatin1String(kScreenCastInterface), method);
+    call.setArguments(arguments);
+    const QDBusMessage reply = QDBusConnection::sessionBus().call(call);
+    if (reply.type() == QDBusMessage::ErrorMessage) {
+        unwatchRequest();
+        m_step = PortalStep::None;
+        emit errorOccurred(tr("Screen cast portal %1 failed: %2").arg(method, reply.errorMessage()));
+        return false;
+    }
+    // Portals before 0.9 choose their own request path.
+    const QString handle = reply.arguments().value(0).value<QDBusObjectPath>().path();
+    if (!handle.isEmpty() && handle != m_requestPath) {
+        watchRequest(handle);
+    }
+    return true;
+}
+
+void PipeWireCapture::watchRequest(const QString &path) {
+    unwatchRequest();
+    QDBusConnection::sessionBus().connect(QString(), path, QLatin1String(kRequestInterface),
+                                          QStringLiteral("Response"), this,
+                                          SLOT(onPortalResponse(uint, QVariantMap)));
+    m_requestPath = path;
+}
+
+void PipeWireCapture::unwatchRequest() {
+    if (m_requestPath.isEmpty()) {
+        return;
+    }
+    QDBusConnection::sessionBus().disconnect(QString(), m_requestPath, QLatin1String(kRequestInterface),
+                                             QStringLiteral("Response"), this,
+                                             SLOT(onPortalResponse(uint, QVariantMap)));
+    m_requestPath.clear();
+}
+
+void PipeWireCapture::onPortalResponse(uint response, const QVariantMap &results) {
+    unwatchRequest();
+    const PortalStep step = std::exchange(m_step, PortalStep::None);
+    if (!m_running) {
+        return;
+    }
+    if (response != 0) {
+        // 1 is the user dismissing the dialog.
+        emit errorOccurred(response == 1 ? tr("Screen sharing was cancelled.")
+                                         : tr("The screen cast portal refused to share the screen."));
+        m_running = false;
+        closeSession();
+        return;
+    }
+    switch (step) {
+    case PortalStep::CreateSession: {
+        m_session = results.value(QStringLiteral("session_handle")).toString();
+        QVariantMap options;
+        options.insert(QStringLiteral("types"), kSourceMonitor);
+        options.insert(QStringLiteral("multiple"), false);
+        options.insert(QStringLiteral("cursor_mode"), m_cursorMode);
+        callPortal(PortalStep::SelectSources, QStringLiteral("SelectSources"),
+                   {QVariant::fromValue(QDBusObjectPath(m_session))}, options);
+        break;
+    }
+    case PortalStep::SelectSources:
+        // No parent window to anchor the dialog to.
+        callPortal(PortalStep::Start, QStringLiteral("Start"),
+                   {QVariant::fromValue(QDBusObjectPath(m_session)), QString()}, QVariantMap());
+        break;
+    case PortalStep::Start: {
+        const uint node = firstStreamNode(results.value(QStringLiteral("streams")));
+        if (node == 0) {
+            emit errorOccurred(tr("The screen cast portal returned no stream."));
+            m_running = false;
+            closeSession();
+            break;
+        }
+        const int fd = openPipeWireRemote();
+        if (fd < 0 || !openStream(fd, node)) {
+            m_running = false;
+            closeSession();
+        }
+        break;
+    }
+    case PortalStep::None:
+        break;
+    }
+}
+
+uint PipeWireCapture::availableCursorModes() const {
+    QDBusMessage call =
+        QDBusMessage::createMethodCall(QLatin1String(kPortalService), QLatin1String(kPortalPath),
+                                       QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("Get"));
+    call.setArguments({QString::fromLatin1(kScreenCastInterface), QStringLiteral("AvailableCursorModes")});
+    const QDBusMessage reply = QDBusConnection::sessionBus().call(call);
+    if (reply.type() != QDBusMessage::ReplyMessage) {
+        return 0;
+    }
+    return reply.arguments().value(0).value<QDBusVariant>().variant().toUInt();
+}
+
+int PipeWireCapture::openPipeWireRemote() {
+    QDBusMessage call = QDBusMessage::createMethodCall(QLatin1String(kPortalService), QLatin1String(kPortalPath),
+                                                       QLatin1String(kScreenCastInterface),
+                                                       QStringLiteral("OpenPipeWireRemote"));
+    call.setArguments({QVariant::fromValue(QDBusObjectPath(m_session)), QVariantMap()});
+    const QDBusMessage reply = QDBusConnection::sessionBus().call(call);
+    const auto descriptor = reply.arguments().value(0).value<QDBusUnixFileDescriptor>();
+    if (reply.type() != QDBusMessage::ReplyMessage || !descriptor.isValid()) {
+        emit errorOccurred(tr("Cannot open the PipeWire remote: %1").arg(reply.errorMessage()));
+        return -1;
+    }
+    // `descriptor` closes its own copy.
+    return fcntl(descriptor.fileDescriptor(), F_DUPFD_CLOEXEC, 3);
+}
+
+void PipeWireCapture::closeSession() {
+    if (m_session.isEmpty()) {
+        return;
+    }
+    const QDBusMessage call = QDBusMessage::createMethodCall(QLatin1String(kPortalService), m_session,
+                                                             QLatin1String(kSessionInterface), QStringLiteral("Close"));
+    QDBusConnection::sessionBus().call(call, QDBus::NoBlock);
+    m_session.clear();
+}
+
+bool PipeWireCapture::openStream(int fd, uint node) {
+    static const pw_stream_events events = Callbacks::streamEvents();
+    pw_init(nullptr, nullptr);
+    m_loop = pw_thread_loop_new("host-capture", nullptr);
+    if (m_loop) {
+        m_context = pw_context_new(pw_thread_loop_get_loop(m_loop), nullptr, 0);
+    }
+    if (!m_context || pw_thread_loop_start(m_loop) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        emit errorOccurred(tr("Cannot start the PipeWire loop."));
+        closeStream();
+        return false;
+    }
+
+    bool connected = false;
+    {
+        LoopLock lock(m_loop);
+        // Takes ownership of fd.
+        m_core = fd >= 0 ? pw_context_connect_fd(m_context, fd, nullptr, 0) : pw_context_connect(m_context, nullptr, 0);
+        if (m_core) {
+            m_stream = pw_stream_new(m_core, "RemoteDesk host",
+                                     pw_properties_new(PW_KEY_MEDIA_TYPE, "Video", PW_KEY_MEDIA_CATEGORY, "Capture",
+                                                       PW_KEY_MEDIA_ROLE, "Screen", nullptr));
+        }
+        if (m_stream) {
+            pw_stream_add_listener(m_stream, &m_streamListener, &events, this);
+            m_timer = pw_loop_add_timer(pw_thread_loop_get_loop(m_loop), &Callbacks::timer, this);
+            const qint64 intervalUs = m_intervalUs.load(std::memory_order_relaxed);
+            std::uint8_t storage[1024];
+            spa_pod_builder builder = SPA_POD_BUILDER_INIT(storage, sizeof(storage));
+            const spa_pod *params[] = {
+                buildFormat(&builder, intervalUs > 0 ? static_cast<int>(1000000 / intervalUs) : kDefaultFps)};
+            const auto flags = static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS);
+            connected = pw_stream_connect(m_stream, PW_DIRECTION_INPUT, node, flags, params, 1) == 0;
+        }
+    }
+    if (!connected) {
+        emit errorOccurred(tr("Cannot connect to PipeWire node %1.").arg(node));
+        closeStream();
+        return false;
+    }
+    return true;
+}
+
+void PipeWireCapture::closeStream() {
+    if (m_loop) {
+        pw_thread_loop_stop(m_loop);
+    }
+    if (m_timer) {
+        pw_loop_destroy_source(pw_thread_loop_get_loop(m_loop), m_timer);
+        m_timer = nullptr;
+    }
+    if (m_stream) {
+        spa_hook_remove(&m_streamListener);
+        pw_stream_destroy(m_stream);
+        m_stream = nullptr;
+    }
+    if (m_core) {
+        pw_core_disconnect(m_core);
+        m_core = nullptr;
+    }
+    if (m_context) {
+        pw_context_destroy(m_context);
+        m_context = nullptr;
+    }
+    if (m_loop) {
+        pw_thread_loop_destroy(m_loop);
+        m_loop = nullptr;
+    }
+    m_held = nullptr;
+    m_streamSize = QSize();
+    m_damage.clear();
+    m_fullDamage = true;
+    m_cursor = Cursor();
+    m_cursorChanged = false;
+    m_frame.clear();
+    m_frameRect = QRect();
+    m_underCursorRect = QRect();
+}
+
+void PipeWireCapture::streamFailed(const QString &message) { emit errorOccurred(message); }
+
+void PipeWireCapture::formatChanged(const spa_pod *param) {
+    uint32_t mediaType = 0;
+    uint32_t mediaSubtype = 0;
+    if (!param || spa_format_parse(param, &mediaType, &mediaSubtype) < 0 || mediaType != SPA_MEDIA_TYPE_video ||
+        mediaSubtype != SPA_MEDIA_SUBTYPE_raw) {
+        return;
+    }
+    spa_video_info_raw info{};
+    if (spa_format_video_raw_parse(param, &info) < 0) {
+        streamFailed(tr("The screen cast offered an unusable video format."));
+        return;
+    }
+    m_streamSize = QSize(static_cast<int>(info.size.width), static_cast<int>(info.size.height));
+    m_fullDamage = true;
+
+    std::uint8_t storage[1024];
+    spa_pod_builder builder = SPA_POD_BUILDER_INIT(storage, sizeof(storage));
+    const spa_pod *params[4];
+    params[0] = static_cast<const spa_pod *>(spa_pod_builder_add_object(
+        &builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers, SPA_PARAM_BUFFERS_buffers,
+        SPA_POD_CHOICE_RANGE_Int(kBuffers, 2, 16), SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+        SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int((1 << SPA_DATA_MemFd) | (1 << SPA_DATA_MemPtr))));
+    const int headerSize = static_cast<int>(sizeof(spa_meta_header));
+    const int regionSize = static_cast<int>(sizeof(spa_meta_region));
+    params[1] = buildMeta(&builder, SPA_META_Header, headerSize, headerSize, headerSize);
+    params[2] = buildMeta(&builder, SPA_META_VideoDamage, regionSize * kDamageRegions, regionSize,
+                          regionSize * kDamageRegions);
+    params[3] = buildMeta(&builder, SPA_META_Cursor, cursorMetaSize(64, 64), cursorMetaSize(1, 1),
+                          cursorMetaSize(kMaxCursorSize, kMaxCursorSize));
+    pw_stream_update_params(m_stream, params, 4);
+}
+
+void PipeWireCapture::accept(pw_buffer *buffer) {
+    spa_buffer *spaBuffer = buffer->buffer;
+    readCursor(spaBuffer);
+
+    const auto *header = static_cast<const spa_meta_header *>(
+        spa_buffer_find_meta_data(spaBuffer, SPA_META_Header, sizeof(spa_meta_header)));
+    bool hasPixels = spaBuffer->n_datas > 0 && !m_streamSize.isEmpty() &&
+                     !(header && (header->flags & SPA_META_HEADER_FLAG_CORRUPTED));
+    if (hasPixels) {
+        // Cursor-only updates come without pixels.
+        const spa_data &data = spaBuffer->datas[0];
+        const qint64 stride = data.chunk->stride;
+        hasPixels = data.data && data.chunk->size > 0 && !(data.chunk->flags & SPA_CHUNK_FLAG_CORRUPTED) &&
+                    stride >= m_streamSize.width() * 4 &&
+                    data.chunk->offset + stride * m_streamSize.height() <= data.maxsize;
+    }
+    if (!hasPixels) {
+        pw_stream_queue_buffer(m_stream, buffer);
+    } else {
+        addDamage(spaBuffer);
+        // Only the newest picture is worth converting; damage from the ones skipped accumulates.
+        if (m_held) {
+            pw_stream_queue_buffer(m_stream, m_held);
+        }
+        m_held = buffer;
+    }
+    schedule();
+}
+
+void PipeWireCapture::readCursor(spa_buffer *buffer) {
+    auto *cursor =
+        static_cast<spa_meta_cursor *>(spa_buffer_find_meta_data(buffer, SPA_META_Cursor, sizeof(spa_meta_cursor)));
+    if (!cursor) {
+        return;
+    }
+    if (!spa_meta_cursor_is_valid(cursor)) {
+        m_cursorChanged |= m_cursor.visible;
+        m_cursor.visible = false;
+        return;
+    }
+    if (cursor->bitmap_offset >= sizeof(spa_meta_cursor)) {
+        const auto *bitmap = SPA_PTROFF(cursor, cursor->bitmap_offset, const spa_meta_bitmap);
+        const int width = static_cast<int>(bitmap->size.width);
+        const int height = static_cast<int>(bitmap->size.height);
+        const bool swap = bitmap->format == SPA_VIDEO_FORMAT_RGBA;
+        if ((swap || bitmap->format == SPA_VIDEO_FORMAT_BGRA) && width > 0 && height > 0 &&
+            width <= kMaxCursorSize && height <= kMaxCursorSize && bitmap->stride >= width * 4) {
+            const auto *pixels = SPA_PTROFF(bitmap, bitmap->offset, const std::uint8_t);
+            m_cursor.image.resize(width * height * 4);
+            auto *image = reinterpret_cast<std::uint8_t *>(m_cursor.image.data());
+            for (int row = 0; row < height; ++row) {
+                const std::uint8_t *src = pixels + row * bitmap->stride;
+                std::uint8_t *dst = image + row * width * 4;
+                std::memcpy(dst, src, static_cast<size_t>(width) * 4);
+                for (int col = 0; swap && col < width; ++col) {
+                    std::swap(dst[col * 4], dst[col * 4 + 2]);
+                }
+            }
+            m_cursor.size = QSize(width, height);
+        } else {
+            // Hidden, or a format we cannot draw.
+            m_cursor.image.clear();
+        }
+        m_cursorChanged = true;
+    }
+    const QPoint position(cursor->position.x, cursor->position.y);
+    const QPoint hotspot(cursor->hotspot.x, cursor->hotspot.y);
+    m_cursorChanged |= !m_cursor.visible || position != m_cursor.position || hotspot != m_cursor.hotspot;
+    m_cursor.visible = true;
+    m_cursor.position = position;
+    m_cursor.hotspot = hotspot;
+}
+
+void PipeWireCapture::addDamage(spa_buffer *buffer) {
+    if (m_fullDamage) {
+        return;
+    }
+    spa_meta *damage = spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+    int regions = 0;
+    if (damage) {
+        spa_meta_region *region = nullptr;
+        spa_meta_for_each(region, damage) {
+            if (!spa_meta_region_is_valid(region)) {
+                break;
+            }
+            m_damage.append(QRect(region->region.position.x, region->region.position.y,
+                                  static_cast<int>(region->region.size.width),
+                                  static_cast<int>(region->region.size.height)));
+            ++regions;
+        }
+    }
+    // Without damage metadata (or with none filled in) anything may have changed.
+    if (regions == 0 || m_damage.size() > kMaxPendingDamage) {
+        m_fullDamage = true;
+        m_damage.clear();
+    }
+}
+
+void PipeWireCapture::schedule() {
+    if (!m_held && !m_cursorChanged) {
+        return;
+    }
+    const qint64 nowUs = captureClockUs();
+    const qint64 dueUs = m_lastDeliveryUs + m_intervalUs.load(std::memory_order_relaxed);
+    if (nowUs + kJitterUs >= dueUs) {
+        deliver();
+        return;
+    }
+    // Hold the newest buffer until its slot so the frame rate cap is kept.
+    const qint64 waitUs = dueUs - nowUs;
+    timespec value{};
+    value.tv_sec = static_cast<time_t>(waitUs / 1000000);
+    value.tv_nsec = static_cast<long>(waitUs % 1000000) * 1000;
+    pw_loop_update_timer(pw_thread_loop_get_loop(m_loop), m_timer, &value, nullptr, false);
+}
+
+void PipeWireCapture::deliver() {
+    HOST_TRACE_SCOPE("capture");
+    QRect frameRect(0, 0, m_streamSize.width() & ~1, m_streamSize.height() & ~1);
+    if (!m_region.isEmpty() && frameRect.contains(m_region)) {
+        frameRect = m_region;
+    }
+    const bool full = m_fullDamage || frameRect != m_frameRect || m_frame.isEmpty() || m_pixelFormat != m_frameFormat;
+    if (full && !m_held) {
+        // Nothing to draw the cursor on until a picture arrives.
+        m_cursorChanged = false;
+        return;
+    }
+    const int width = frameRect.width();
+    const int height = frameRect.height();
+    const QRect bounds(0, 0, width, height);
+    QVector<QRect> dirty;
+    if (full) {
+        m_frame = QByteArray(yuvFrameSize(m_pixelFormat, width, height), Qt::Uninitialized);
+        m_frameRect = frameRect;
+        m_frameFormat = m_pixelFormat;
+        m_underCursorRect = QRect();
+    }
+    // Detaches from a frame the consumer still holds, keeping the unchanged pixels.
+    auto *yuv = reinterpret_cast<std::uint8_t *>(m_frame.data());
+    const bool fullChroma = m_frameFormat == PixelFormat::I444;
+    if (!m_underCursorRect.isEmpty()) {
+        // Take the old cursor out before new pixels land around it.
+        const auto *under = reinterpret_cast<const std::uint8_t *>(m_underCursor.constData());
+        const QRect &rect = m_underCursorRect;
+        if (fullChroma) {
+            pasteI444(under, rect.x(), rect.y(), rect.width(), rect.height(), width, height, yuv);
+        } else {
+            pasteI420(under, rect.x(), rect.y(), rect.width(), rect.height(), width, height, yuv);
+        }
+        dirty.append(m_underCursorRect);
+        m_underCursorRect = QRect();
+    }
+    if (m_held) {
+        const spa_data &data = m_held->buffer->datas[0];
+        const int stride = data.chunk->stride;
+        const auto *pixels = static_cast<const std::uint8_t *>(data.data) + data.chunk->offset +
+                             frameRect.y() * stride + frameRect.x() * 4;
+        if (full) {
+            if (fullChroma) {
+                convertBgraToI444(pixels, stride, width, height, yuv);
+            } else {
+                convertBgraToI420(pixels, stride, width, height, yuv);
+            }
+            dirty = {bounds};
+        } else {
+            // Convert whole even row bands covering the damage, each band once.
+            QVector<QPair<int, int>> bands;
+            for (const QRect &rect : std::as_const(m_damage)) {
+                const QRect local = rect.translated(-frameRect.topLeft()).intersected(bounds);
+                if (!local.isEmpty()) {
+                    dirty.append(local);
+                    bands.append({local.top() & ~1, qMin(height, (local.bottom() + 2) & ~1)});
+                }
+            }
+            std::sort(bands.begin(), bands.end());
+            int converted = 0;
+            for (const auto &band : std::as_const(bands)) {
+                const int first = qMax(band.first, converted);
+                if (band.second > first) {
+                    if (fullChroma) {
+                        convertBgraToI444Rows(pixels, stride, width, height, first, band.second - first, yuv);
+                    } else {
+                        convertBgraToI420Rows(pixels, stride, width, height, first, band.second - first, yuv);
+                    }
+                    converted = band.second;
+                }
+            }
+        }
+        pw_stream_queue_buffer(m_stream, m_held);
+        m_held = nullptr;
+    }
+    drawCursor(yuv, dirty);
+    m_damage.clear();
+    m_fullDamage = false;
+    m_cursorChanged = false;
+    m_lastDeliveryUs = captureClockUs();
+    emit frameCaptured(m_frame, m_frameFormat, width, height, m_lastDeliveryUs, dirty);
+}
+
+void PipeWireCapture::drawCursor(std::uint8_t *yuv, QVector<QRect> &dirty) {
+    if (!m_cursor.visible || m_cursor.image.isEmpty()) {
+        return;
+    }
+    const int width = m_frameRect.width();
+    const int height = m_frameRect.height();
+    const QRect cursorRect(m_cursor.position - m_cursor.hotspot - m_frameRect.topLeft(), m_cursor.size);
+    const QRect patch = evenBounds(cursorRect).intersected(QRect(0, 0, width, height));
+    if (patch.isEmpty()) {
+        return;
+    }
+    m_underCursor.resize(yuvFrameSize(m_frameFormat, patch.width(), patch.height()));
+    auto *under = reinterpret_cast<std::uint8_t *>(m_underCursor.data());
+    if (m_frameFormat == PixelFormat::I444) {
+        cropI444(yuv, width, height, patch.x(), patch.y(), patch.width(), patch.height(), under);
+    } else {
+        cropI420(yuv, width, height, patch.x(), patch.y(), patch.width(), patch.height(), under);
+    }
+    m_underCursorRect = patch;
+
+    QByteArray bgra(patch.width() * patch.height() * 4, 0);
+    const QRect visible = cursorRect.intersected(patch);
+    const auto *image = reinterpret_cast<const std::uint8_t *>(m_cursor.image.constData());
+    for (int y = visible.top(); y <= visible.bottom(); ++y) {
+        const std::uint8_t *src =
+            image + ((y - cursorRect.y()) * m_cursor.size.width() + visible.x() - cursorRect.x()) * 4;
+        std::memcpy(bgra.data() + ((y - patch.y()) * patch.width() + visible.x() - patch.x()) * 4, src,
+                    static_cast<size_t>(visible.width()) * 4);
+    }
+    blendBgraInto(bgra, patch, m_frameFormat, yuv, width, height);
+    dirty.append(patch);
+}
+
+}  // namespace host
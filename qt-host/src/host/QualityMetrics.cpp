@@ -0,0 +1,273 @@
+#include "host/QualityMetrics.h"
+
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HOST_QUALITY_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define HOST_TARGET_AVX2
+#else
+#define HOST_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace host {
+
+namespace {
+constexpr int kBlockSize = 4;
+// SSIM constants (0.01 * 255)^2 and (0.03 * 255)^2, scaled by 64^2 because the
+// window formula below works on 8x8 sums rather than means.
+constexpr double kSsimC1 = 6.5025 * 64 * 64;
+constexpr double kSsimC2 = 58.5225 * 64 * 64;
+
+// Sums over one 4x4 block; four neighbouring blocks make an SSIM window.
+struct BlockSums {
+    int reference = 0;
+    int distorted = 0;
+    // Both pictures' squares.
+    int squares = 0;
+    int cross = 0;
+};
+
+using SquaredErrorFunction = quint64 (*)(const std::uint8_t *, const std::uint8_t *, int, int, int);
+using BlockSumsFunction = void (*)(const std::uint8_t *, const std::uint8_t *, int, int, int, BlockSums *);
+
+quint64 squaredErrorScalar(const std::uint8_t *reference, const std::uint8_t *distorted, int width, int height,
+                           int stride) {
+    quint64 total = 0;
+    for (int y = 0; y < height; ++y) {
+        const std::uint8_t *a = reference + qsizetype(y) * stride;
+        const std::uint8_t *b = distorted + qsizetype(y) * stride;
+        quint64 row = 0;
+        for (int x = 0; x < width; ++x) {
+            const int difference = a[x] - b[x];
+            row += static_cast<quint64>(difference * difference);
+        }
+        total += row;
+    }
+    return total;
+}
+
+// Blocks [first, count) of the 4-row band starting at the given rows.
+void blockSumsScalar(const std::uint8_t *reference, const std::uint8_t *distorted, int stride, int first, int count,
+                     BlockSums *out) {
+    for (int block = first; block < count; ++block) {
+        BlockSums sums;
+        for (int row = 0; row < kBlockSize; ++row) {
+            const std::uint8_t *a = reference + qsizetype(row) * stride + block * kBlockSize;
+            const std::uint8_t *b = distorted + qsizetype(row) * stride + block * kBlockSize;
+            for (int x = 0; x < kBlockSize; ++x) {
+                sums.reference += a[x];
+                sums.distorted += b[x];
+                sums.squares += a[x] * a[x] + b[x] * b[x];
+                sums.cross += a[x] * b[x];
+            }
+        }
+        out[block] = sums;
+    }
+}
+
+#ifdef HOST_QUALITY_AVX2
+HOST_TARGET_AVX2 int sumLanes(__m256i lanes) {
+    const __m128i half = _mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    const __m128i quarter = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtsi128_si32(_mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, _MM_SHUFFLE(2, 3, 0, 1))));
+}
+
+// 32 pixels per step. Each int32 lane gains at most 4 * 255^2 per step, so a
+// row up to 64K pixels wide cannot overflow before it is added to the total.
+HOST_TARGET_AVX2 quint64 squaredErrorAvx2(const std::uint8_t *reference, const std::uint8_t *distorted, int width,
+                                          int height, int stride) {
+    const __m256i zero = _mm256_setzero_si256();
+    quint64 total = 0;
+    for (int y = 0; y < height; ++y) {
+        const std::uint8_t *a = reference + qsizetype(y) * stride;
+        const std::uint8_t *b = distorted + qsizetype(y) * stride;
+        __m256i accumulator = zero;
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + x));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + x));
+            const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+            const __m256i low = _mm256_unpacklo_epi8(difference, zero);
+            const __m256i high = _mm256_unpackhi_epi8(difference, zero);
+            accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(low, low));
+            accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(high, high));
+        }
+        total += static_cast<quint32>(sumLanes(accumulator));
+        total += squaredErrorScalar(a + x, b + x, width - x, 1, stride);
+    }
+    return total;
+}
+
+// Four blocks (16 pixels) per step.
+HOST_TARGET_AVX2 void blockSumsAvx2(const std::uint8_t *reference, const std::uint8_t *distorted, int stride,
+                                    int first, int count, BlockSums *out) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    int block = first;
+    for (; block + 4 <= count; block += 4) {
+        const int x = block * kBlockSize;
+        __m256i sumA = _mm256_setzero_si256();
+        __m256i sumB = _mm256_setzero_si256();
+        __m256i squares = _mm256_setzero_si256();
+        __m256i cross = _mm256_setzero_si256();
+        for (int row = 0; row < kBlockSize; ++row) {
+            const qsizetype at = qsizetype(row) * stride + x;
+            const __m256i va =
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(reference + at)));
+            const __m256i vb =
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(distorted + at)));
+            sumA = _mm256_add_epi16(sumA, va);
+            sumB = _mm256_add_epi16(sumB, vb);
+            squares = _mm256_add_epi32(squares, _mm256_madd_epi16(va, va));
+            squares = _mm256_add_epi32(squares, _mm256_madd_epi16(vb, vb));
+            cross = _mm256_add_epi32(cross, _mm256_madd_epi16(va, vb));
+        }
+        // Column pairs, then whole blocks. hadd stays within 128-bit halves, so
+        // the lanes come out as [a0 a1 b0 b1 | a2 a3 b2 b3] for blocks 0..3.
+        const __m256i sums = _mm256_hadd_epi32(_mm256_madd_epi16(sumA, ones), _mm256_madd_epi16(sumB, ones));
+        const __m256i products = _mm256_hadd_epi32(squares, cross);
+        alignas(32) int sumValues[8];
+        alignas(32) int productValues[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(sumValues), sums);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(productValues), products);
+        for (int i = 0; i < 4; ++i) {
+            const int lane = i / 2 * 4 + i % 2;
+            out[block + i] = {sumValues[lane], sumValues[lane + 2], productValues[lane], productValues[lane + 2]};
+        }
+    }
+    blockSumsScalar(reference, distorted, stride, block, count, out);
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4] = {};
+    __cpuid(regs, 1);
+    const bool osSavesYmm = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(regs, 7, 0);
+    return osSavesYmm && (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct Kernels {
+    SquaredErrorFunction squaredError = squaredErrorScalar;
+    BlockSumsFunction blockSums = blockSumsScalar;
+    bool avx2 = false;
+};
+
+const Kernels &kernels() {
+    static const Kernels selected = [] {
+        Kernels k;
+#ifdef HOST_QUALITY_AVX2
+        if (cpuHasAvx2()) {
+            k.squaredError = squaredErrorAvx2;
+            k.blockSums = blockSumsAvx2;
+            k.avx2 = true;
+        }
+#endif
+        return k;
+    }();
+    return selected;
+}
+
+double windowSsim(const BlockSums &topLeft, const BlockSums &topRight, const BlockSums &bottomLeft,
+                  const BlockSums &bottomRight) {
+    const double a = double(topLeft.reference) + topRight.reference + bottomLeft.reference + bottomRight.reference;
+    const double b = double(topLeft.distorted) + topRight.distorted + bottomLeft.distorted + bottomRight.distorted;
+    const double squares = double(topLeft.squares) + topRight.squares + bottomLeft.squares + bottomRight.squares;
+    const double cross = double(topLeft.cross) + topRight.cross + bottomLeft.cross + bottomRight.cross;
+    const double variance = 64 * squares - a * a - b * b;
+    const double covariance = 64 * cross - a * b;
+    return (2 * a * b + kSsimC1) * (2 * covariance + kSsimC2) / ((a * a + b * b + kSsimC1) * (variance + kSsimC2));
+}
+}  // namespace
+
+quint64 planeSquaredError(const std::uint8_t *reference, const std::uint8_t *distorted, int width, int height,
+                          int stride) {
+    return kernels().squaredError(reference, distorted, width, height, stride);
+}
+
+double planeSsim(const std::uint8_t *reference, const std::uint8_t *distorted, int width, int height, int stride) {
+    const int blocks = width / kBlockSize;
+    const int bands = height / kBlockSize;
+    if (blocks < 2 || bands < 2) {
+        return 1.0;
+    }
+    const BlockSumsFunction blockSums = kernels().blockSums;
+    std::vector<BlockSums> above(static_cast<size_t>(blocks));
+    std::vector<BlockSums> below(static_cast<size_t>(blocks));
+    blockSums(reference, distorted, stride, 0, blocks, above.data());
+    double total = 0;
+    for (int band = 1; band < bands; ++band) {
+        const qsizetype offset = qsizetype(band) * kBlockSize * stride;
+        blockSums(reference + offset, distorted + offset, stride, 0, blocks, below.data());
+        for (int block = 0; block + 1 < blocks; ++block) {
+            total += windowSsim(above[block], above[block + 1], below[block], below[block + 1]);
+        }
+        above.swap(below);
+    }
+    return total / (double(bands - 1) * (blocks - 1));
+}
+
+double psnrFromSquaredError(quint64 squaredError, qint64 samples) {
+    if (squaredError == 0 || samples <= 0) {
+        return QualityScore::kMaxPsnr;
+    }
+    const double psnr = 10.0 * std::log10(255.0 * 255.0 * double(samples) / double(squaredError));
+    return psnr < QualityScore::kMaxPsnr ? psnr : QualityScore::kMaxPsnr;
+}
+
+bool measureQuality(const VideoFrame &reference, const VideoFrame &distorted, QualityScore &score) {
+    if (reference.format != distorted.format || reference.width != distorted.width ||
+        reference.height != distorted.height ||
+        (reference.format != PixelFormat::I420 && reference.format != PixelFormat::I444)) {
+        return false;
+    }
+    const int width = reference.width;
+    const int height = reference.height;
+    const qsizetype size = yuvFrameSize(reference.format, width, height);
+    if (reference.data.size() < size || distorted.data.size() < size) {
+        return false;
+    }
+    const int shift = reference.format == PixelFormat::I444 ? 0 : 1;
+    const int chromaWidth = width >> shift;
+    const int chromaHeight = height >> shift;
+    const qsizetype lumaSize = qsizetype(width) * height;
+    const qsizetype chromaSize = qsizetype(chromaWidth) * chromaHeight;
+    const struct {
+        qsizetype offset;
+        int width;
+        int height;
+    } planes[3] = {
+        {0, width, height},
+        {lumaSize, chromaWidth, chromaHeight},
+        {lumaSize + chromaSize, chromaWidth, chromaHeight},
+    };
+
+    const auto *a = reinterpret_cast<const std::uint8_t *>(reference.data.constData());
+    const auto *b = reinterpret_cast<const std::uint8_t *>(distorted.data.constData());
+    quint64 errors[3] = {};
+    double ssims[3] = {};
+    for (int plane = 0; plane < 3; ++plane) {
+        const auto &info = planes[plane];
+        errors[plane] = planeSquaredError(a + info.offset, b + info.offset, info.width, info.height, info.width);
+        ssims[plane] = planeSsim(a + info.offset, b + info.offset, info.width, info.height, info.width);
+    }
+    score.psnrY = psnrFromSquaredError(errors[0], lumaSize);
+    score.psnrU = psnrFromSquaredError(errors[1], chromaSize);
+    score.psnrV = psnrFromSquaredError(errors[2], chromaSize);
+    score.psnr = psnrFromSquaredError(errors[0] + errors[1] + errors[2], lumaSize + 2 * chromaSize);
+    score.ssimY = ssims[0];
+    score.ssim = 0.8 * ssims[0] + 0.1 * ssims[1] + 0.1 * ssims[2];
+    return true;
+}
+
+bool qualityMetricsUseAvx2() { return kernels().avx2; }
+
+}  // namespace host
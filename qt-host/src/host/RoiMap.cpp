@@ -0,0 +1,124 @@
+#include "host/RoiMap.h"
+
+#include "host/HostStats.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+namespace host {
+
+namespace {
+// Damage this soon after input is taken as its answer.
+constexpr qint64 kResponseUs = 400000;
+// An older focus fades out over this long relative to the newest one, so the
+// map keeps the last working area instead of going uniform when input stops.
+constexpr qint64 kFocusFadeUs = 5000000;
+constexpr int kMaxAreas = 8;
+// Larger changes (a window switch) say nothing about where to look.
+constexpr double kMaxFocusFraction = 0.4;
+// Full focus within one radius of an area, none beyond two.
+constexpr int kMinRadius = 128;
+constexpr int kRadiusDivisor = 12;
+}  // namespace
+
+void RoiMap::notePointer(double x, double y, qint64 nowUs) {
+    if (!std::isfinite(x) || !std::isfinite(y)) {
+        return;
+    }
+    x = qBound(0.0, x, 1.0);
+    y = qBound(0.0, y, 1.0);
+    QMutexLocker locker(&m_mutex);
+    m_hasPointer = true;
+    m_pointer = Focus{x, y, x, y, nowUs};
+}
+
+void RoiMap::noteInput(qint64 nowUs) {
+    QMutexLocker locker(&m_mutex);
+    m_lastInputUs = nowUs;
+}
+
+void RoiMap::addFocus(const Focus &focus) {
+    m_areas.append(focus);
+    if (m_areas.size() > kMaxAreas) {
+        m_areas.removeFirst();
+    }
+}
+
+void RoiMap::build(int width, int height, const QVector<QRect> &dirtyRects, qint64 nowUs, QVector<qint8> &offsets) {
+    offsets.clear();
+    if (!isEnabled() || width <= 0 || height <= 0) {
+        return;
+    }
+    bool hasPointer = false;
+    Focus pointer;
+    qint64 lastInputUs = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        hasPointer = m_hasPointer;
+        pointer = m_pointer;
+        lastInputUs = m_lastInputUs;
+    }
+
+    if (lastInputUs != 0 && nowUs - lastInputUs <= kResponseUs && !dirtyRects.isEmpty()) {
+        QRect changed;
+        for (const QRect &rect : dirtyRects) {
+            changed = changed.united(rect);
+        }
+        changed = changed.intersected(QRect(0, 0, width, height));
+        const double fraction = static_cast<double>(changed.width()) * changed.height() / (double(width) * height);
+        if (!changed.isEmpty() && fraction <= kMaxFocusFraction) {
+            addFocus(Focus{double(changed.left()) / width, double(changed.top()) / height,
+                           double(changed.right() + 1) / width, double(changed.bottom() + 1) / height, nowUs});
+        }
+    }
+
+    QVector<Focus> focus = m_areas;
+    if (hasPointer) {
+        focus.append(pointer);
+    }
+    if (focus.isEmpty()) {
+        return;
+    }
+    qint64 newestUs = 0;
+    for (const Focus &area : std::as_const(focus)) {
+        newestUs = qMax(newestUs, area.atUs);
+    }
+    m_areas.erase(std::remove_if(m_areas.begin(), m_areas.end(),
+                                 [newestUs](const Focus &area) { return newestUs - area.atUs >= kFocusFadeUs; }),
+                  m_areas.end());
+
+    const int columns = (width + kMacroblockSize - 1) / kMacroblockSize;
+    const int rows = (height + kMacroblockSize - 1) / kMacroblockSize;
+    const double radius = qMax(kMinRadius, width / kRadiusDivisor);
+    offsets.resize(columns * rows);
+    int focused = 0;
+    for (int row = 0; row < rows; ++row) {
+        const double centerY = row * kMacroblockSize + kMacroblockSize / 2.0;
+        for (int column = 0; column < columns; ++column) {
+            const double centerX = column * kMacroblockSize + kMacroblockSize / 2.0;
+            double priority = 0;
+            for (const Focus &area : std::as_const(focus)) {
+                const double weight = 1.0 - static_cast<double>(newestUs - area.atUs) / kFocusFadeUs;
+                const double dx = qMax(0.0, qMax(area.left * width - centerX, centerX - area.right * width));
+                const double dy = qMax(0.0, qMax(area.top * height - centerY, centerY - area.bottom * height));
+                const double distance = std::sqrt(dx * dx + dy * dy);
+                const double falloff = qBound(0.0, 2.0 - distance / radius, 1.0);
+                priority = qMax(priority, weight * falloff);
+            }
+            // Three levels only: a moving pointer should not re-quantize a
+            // ring of macroblocks on every frame.
+            qint8 offset = 0;
+            if (priority >= 0.75) {
+                offset = static_cast<qint8>(-m_strength);
+                ++focused;
+            } else if (priority < 0.25) {
+                offset = static_cast<qint8>(m_strength);
+            }
+            offsets[row * columns + column] = offset;
+        }
+    }
+    HostStats::instance().set(HostStats::RoiFocusPercent, focused * 100 / offsets.size());
+}
+
+}  // namespace host
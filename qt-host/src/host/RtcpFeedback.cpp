@@ -0,0 +1,96 @@
+#include "host/RtcpFeedback.h"
+
+#include <QtEndian>
+
+namespace host {
+
+namespace {
+constexpr quint8 kSenderReport = 200;
+constexpr quint8 kReceiverReport = 201;
+constexpr quint8 kTransportFeedback = 205;
+constexpr quint8 kPayloadFeedback = 206;
+constexpr quint8 kFmtGenericNack = 1;
+constexpr quint8 kFmtPli = 1;
+constexpr quint8 kFmtFir = 4;
+constexpr int kSenderInfoSize = 20;
+constexpr int kReportBlockSize = 24;
+
+void parseReportBlocks(const uchar *blocks, int count, int available, quint32 mediaSsrc, RtcpFeedback &feedback) {
+    for (int i = 0; i < count && (i + 1) * kReportBlockSize <= available; ++i) {
+        const uchar *block = blocks + i * kReportBlockSize;
+        if (qFromBigEndian<quint32>(block) != mediaSsrc) {
+            continue;
+        }
+        feedback.hasReportBlock = true;
+        feedback.fractionLost = block[4];
+        feedback.jitter = qFromBigEndian<quint32>(block + 12);
+    }
+}
+}  // namespace
+
+bool parseRtcpFeedback(const QByteArray &compound, quint32 mediaSsrc, RtcpFeedback &feedback) {
+    const auto *data = reinterpret_cast<const uchar *>(compound.constData());
+    const int size = compound.size();
+    int offset = 0;
+    while (offset + 4 <= size) {
+        const uchar *header = data + offset;
+        if ((header[0] >> 6) != 2) {
+            return false;
+        }
+        const quint8 count = header[0] & 0x1f;
+        const quint8 type = header[1];
+        const int length = (qFromBigEndian<quint16>(header + 2) + 1) * 4;
+        if (offset + length > size) {
+            return false;
+        }
+        const uchar *body = header + 4;
+        const int bodySize = length - 4;
+
+        switch (type) {
+        case kSenderReport:
+            if (bodySize >= 4 + kSenderInfoSize) {
+                parseReportBlocks(body + 4 + kSenderInfoSize, count, bodySize - 4 - kSenderInfoSize, mediaSsrc,
+                                  feedback);
+            }
+            break;
+        case kReceiverReport:
+            if (bodySize >= 4) {
+                parseReportBlocks(body + 4, count, bodySize - 4, mediaSsrc, feedback);
+            }
+            break;
+        case kTransportFeedback:
+            // Sender SSRC, media SSRC, then (PID, BLP) pairs.
+            if (count == kFmtGenericNack && bodySize >= 8 && qFromBigEndian<quint32>(body + 4) == mediaSsrc) {
+                for (int fci = 8; fci + 4 <= bodySize; fci += 4) {
+                    const quint16 pid = qFromBigEndian<quint16>(body + fci);
+                    const quint16 blp = qFromBigEndian<quint16>(body + fci + 2);
+                    feedback.nackedSequences.append(pid);
+                    for (int bit = 0; bit < 16; ++bit) {
+                        if (blp & (1u << bit)) {
+                            feedback.nackedSequences.append(static_cast<quint16>(pid + bit + 1));
+                        }
+                    }
+                }
+            }
+            break;
+        case kPayloadFeedback:
+            if (count == kFmtPli && bodySize >= 8 && qFromBigEndian<quint32>(body + 4) == mediaSsrc) {
+                feedback.keyFrameRequested = true;
+            } else if (count == kFmtFir) {
+                // FIR addresses the media source in its FCI entries, not the common header.
+                for (int fci = 8; fci + 8 <= bodySize; fci += 8) {
+                    if (qFromBigEndian<quint32>(body + fci) == mediaSsrc) {
+                        feedback.keyFrameRequested = true;
+                    }
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        offset += length;
+    }
+    return offset == size;
+}
+
+}  // namespace host
@@ -0,0 +1,41 @@
+#include "host/RtpPacketHistory.h"
+
+namespace host {
+
+RtpPacketHistory::RtpPacketHistory(int capacity, qint64 maxAgeUs) : m_maxAgeUs(maxAgeUs) {
+    int size = 1;
+    while (size < capacity && size < 32768) {
+        size <<= 1;
+    }
+    m_entries.resize(size);
+    m_mask = static_cast<quint16>(size - 1);
+}
+
+void RtpPacketHistory::insert(quint16 sequence, const QByteArray &packet, qint64 sentUs) {
+    Entry &entry = m_entries[sequence & m_mask];
+    entry.packet = packet;
+    entry.sentUs = sentUs;
+    entry.resentUs = 0;
+    entry.sequence = sequence;
+    entry.valid = true;
+}
+
+QByteArray RtpPacketHistory::takeForRetransmit(quint16 sequence, qint64 nowUs, qint64 minIntervalUs) {
+    Entry &entry = m_entries[sequence & m_mask];
+    if (!entry.valid || entry.sequence != sequence || nowUs - entry.sentUs > m_maxAgeUs) {
+        return {};
+    }
+    if (entry.resentUs != 0 && nowUs - entry.resentUs < minIntervalUs) {
+        return {};
+    }
+    entry.resentUs = nowUs;
+    return entry.packet;
+}
+
+void RtpPacketHistory::clear() {
+    for (Entry &entry : m_entries) {
+        entry = Entry{};
+    }
+}
+
+}  // namespace host
@@ -0,0 +1,276 @@
+#include "host/RtpPacketizer.h"
+
+#include <QVarLengthArray>
+#include <QtEndian>
+#include <cstring>
+
+namespace host {
+
+namespace {
+constexpr quint8 kNalTypeFuA = 28;
+
+constexpr int kObuTypeTemporalDelimiter = 2;
+constexpr int kObuTypeTileList = 8;
+constexpr int kObuTypePadding = 15;
+constexpr quint8 kObuExtensionFlag = 0x04;
+constexpr quint8 kObuHasSizeField = 0x02;
+
+// AV1 aggregation header bits.
+constexpr quint8 kAv1Continues = 0x80;  // Z: first element continues the previous packet's OBU
+constexpr quint8 kAv1Fragmented = 0x40;  // Y: last element continues in the next packet
+constexpr quint8 kAv1NewSequence = 0x08;  // N: first packet of a coded video sequence
+
+struct NalUnit {
+    const char *data = nullptr;
+    int size = 0;
+};
+
+// One OBU as it goes on the wire: its header with the size field flag
+// cleared, then the payload.
+struct Obu {
+    quint8 header[2] = {};
+    int headerSize = 0;
+    const char *payload = nullptr;
+    int payloadSize = 0;
+
+    int size() const { return headerSize + payloadSize; }
+};
+
+bool readLeb128(const char *data, int size, int &offset, int &value) {
+    quint64 result = 0;
+    for (int i = 0; i < 8 && offset < size; ++i) {
+        const auto byte = static_cast<quint8>(data[offset++]);
+        result |= static_cast<quint64>(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            if (result > static_cast<quint64>(size)) {
+                return false;
+            }
+            value = static_cast<int>(result);
+            return true;
+        }
+    }
+    return false;
+}
+
+int writeLeb128(int value, char *out) {
+    int written = 0;
+    do {
+        quint8 byte = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        out[written++] = static_cast<char>(byte);
+    } while (value != 0);
+    return written;
+}
+
+// Splits a temporal unit in low-overhead bitstream format. Temporal
+// delimiters, tile lists and padding are not sent over RTP.
+QList<Obu> splitObus(const char *data, int size) {
+    QList<Obu> obus;
+    int offset = 0;
+    while (offset < size) {
+        Obu obu;
+        const auto header = static_cast<quint8>(data[offset]);
+        const int type = (header >> 3) & 0x0f;
+        obu.headerSize = (header & kObuExtensionFlag) ? 2 : 1;
+        if (offset + obu.headerSize > size) {
+            break;
+        }
+        obu.header[0] = header & ~kObuHasSizeField;
+        if (obu.headerSize == 2) {
+            obu.header[1] = static_cast<quint8>(data[offset + 1]);
+        }
+        offset += obu.headerSize;
+        int payloadSize = size - offset;
+        if ((header & kObuHasSizeField) && !readLeb128(data, size, offset, payloadSize)) {
+            break;
+        }
+        if (payloadSize > size - offset) {
+            break;
+        }
+        obu.payload = data + offset;
+        obu.payloadSize = payloadSize;
+        offset += payloadSize;
+        if (type != kObuTypeTemporalDelimiter && type != kObuTypeTileList && type != kObuTypePadding) {
+            obus.append(obu);
+        }
+    }
+    return obus;
+}
+
+// Splits an Annex-B stream on 3- and 4-byte start codes.
+QList<NalUnit> splitAnnexB(const char *data, int size) {
+    QList<NalUnit> units;
+    int start = -1;
+    int i = 0;
+    while (i + 2 < size) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start >= 0) {
+                int end = i;
+                if (end > start && data[end - 1] == 0) {
+                    --end;
+                }
+                units.append({data + start, end - start});
+            }
+            i += 3;
+            start = i;
+        } else {
+            ++i;
+        }
+    }
+    if (start >= 0 && start < size) {
+        units.append({data + start, size - start});
+    }
+    return units;
+}
+}  // namespace
+
+RtpPacketizer::RtpPacketizer() = default;
+
+RtpPacketizer::RtpPacketizer(const Config &config) : m_config(config) {}
+
+void RtpPacketizer::setConfig(const Config &config) { m_config = config; }
+
+QByteArray RtpPacketizer::makePacket(quint32 timestamp, bool marker, int payloadSize) {
+    QByteArray packet(kHeaderSize + payloadSize, Qt::Uninitialized);
+    auto *header = reinterpret_cast<uchar *>(packet.data());
+    header[0] = 0x80;
+    header[1] = static_cast<uchar>((marker ? 0x80 : 0x00) | (m_config.payloadType & 0x7f));
+    qToBigEndian<quint16>(m_sequence++, header + 2);
+    qToBigEndian<quint32>(timestamp, header + 4);
+    qToBigEndian<quint32>(m_config.ssrc, header + 8);
+    return packet;
+}
+
+void RtpPacketizer::packetize(const EncodedFrame &frame, QList<QByteArray> &packets) {
+    packetize(frame, 0, static_cast<int>(frame.data.size()), true, packets);
+}
+
+void RtpPacketizer::packetize(const EncodedFrame &frame, int begin, int end, bool lastOfFrame,
+                              QList<QByteArray> &packets) {
+    const auto timestamp = static_cast<quint32>(frame.timestampUs * kClockRate / 1000000);
+    if (m_config.format == Format::AV1) {
+        // Key frames start with a sequence header, so they begin a new coded video sequence.
+        packetizeAv1(frame.data.constData() + begin, end - begin, timestamp, frame.keyFrame && begin == 0,
+                     lastOfFrame, packets);
+    } else {
+        packetizeH264(frame.data.constData() + begin, end - begin, timestamp, lastOfFrame, packets);
+    }
+}
+
+void RtpPacketizer::packetizeH264(const char *data, int size, quint32 timestamp, bool lastOfFrame,
+                                  QList<QByteArray> &packets) {
+    const QList<NalUnit> units = splitAnnexB(data, size);
+    if (units.isEmpty()) {
+        return;
+    }
+    const int maxPayload = m_config.mtu - kHeaderSize;
+
+    for (int n = 0; n < units.size(); ++n) {
+        const NalUnit &nal = units.at(n);
+        const bool lastNal = lastOfFrame && n == units.size() - 1;
+        if (nal.size <= 0) {
+            continue;
+        }
+        if (nal.size <= maxPayload) {
+            QByteArray packet = makePacket(timestamp, lastNal, nal.size);
+            memcpy(packet.data() + kHeaderSize, nal.data, static_cast<size_t>(nal.size));
+            packets.append(std::move(packet));
+            continue;
+        }
+
+        const auto nalHeader = static_cast<quint8>(nal.data[0]);
+        const quint8 indicator = (nalHeader & 0xe0) | kNalTypeFuA;
+        const quint8 type = nalHeader & 0x1f;
+        const int fragmentPayload = maxPayload - 2;
+        int offset = 1;
+        while (offset < nal.size) {
+            const int chunk = qMin(fragmentPayload, nal.size - offset);
+            const bool first = offset == 1;
+            const bool last = offset + chunk >= nal.size;
+            QByteArray packet = makePacket(timestamp, lastNal && last, chunk + 2);
+            char *payload = packet.data() + kHeaderSize;
+            payload[0] = static_cast<char>(indicator);
+            payload[1] = static_cast<char>((first ? 0x80 : 0x00) | (last ? 0x40 : 0x00) | type);
+            memcpy(payload + 2, nal.data + offset, static_cast<size_t>(chunk));
+            packets.append(std::move(packet));
+            offset += chunk;
+        }
+    }
+}
+
+void RtpPacketizer::packetizeAv1(const char *data, int size, quint32 timestamp, bool newSequence, bool lastOfFrame,
+                                 QList<QByteArray> &packets) {
+    const QList<Obu> obus = splitObus(data, size);
+    if (obus.isEmpty()) {
+        return;
+    }
+    const int maxPayload = m_config.mtu - kHeaderSize - 1;
+    // Elements of the packet being filled, as (OBU index, first byte, length).
+    struct Element {
+        int obu;
+        int offset;
+        int size;
+    };
+    QVarLengthArray<Element, 8> elements;
+    int used = 0;
+    bool continues = false;
+
+    const auto flush = [&](bool lastPacket, bool fragmented) {
+        QByteArray packet = makePacket(timestamp, lastOfFrame && lastPacket, 1 + used);
+        char *out = packet.data() + kHeaderSize;
+        quint8 aggregation = (continues ? kAv1Continues : 0) | (fragmented ? kAv1Fragmented : 0);
+        if (newSequence) {
+            aggregation |= kAv1NewSequence;
+            newSequence = false;
+        }
+        *out++ = static_cast<char>(aggregation);
+        for (const Element &element : elements) {
+            const Obu &obu = obus.at(element.obu);
+            out += writeLeb128(element.size, out);
+            int offset = element.offset;
+            int remaining = element.size;
+            if (offset < obu.headerSize) {
+                const int headerBytes = qMin(remaining, obu.headerSize - offset);
+                memcpy(out, obu.header + offset, static_cast<size_t>(headerBytes));
+                out += headerBytes;
+                offset += headerBytes;
+                remaining -= headerBytes;
+            }
+            memcpy(out, obu.payload + (offset - obu.headerSize), static_cast<size_t>(remaining));
+            out += remaining;
+        }
+        packets.append(std::move(packet));
+        elements.clear();
+        used = 0;
+        continues = fragmented;
+    };
+
+    for (int n = 0; n < obus.size(); ++n) {
+        const int obuSize = obus.at(n).size();
+        int offset = 0;
+        while (offset < obuSize) {
+            const int space = maxPayload - used;
+            // Lengths up to 127 take one LEB128 byte; packets never need more than two.
+            const int lengthBytes = space > 128 ? 2 : 1;
+            if (space - lengthBytes <= 0) {
+                flush(false, false);
+                continue;
+            }
+            const int chunk = qMin(obuSize - offset, space - lengthBytes);
+            elements.append({n, offset, chunk});
+            used += (chunk < 128 ? 1 : 2) + chunk;
+            offset += chunk;
+            if (offset < obuSize) {
+                flush(false, true);
+            }
+        }
+    }
+    if (used > 0) {
+        flush(true, false);
+    }
+}
+
+}  // namespace host
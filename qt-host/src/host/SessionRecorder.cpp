@@ -0,0 +1,107 @@
+#include "host/SessionRecorder.h"
+
+#include <QMutexLocker>
+#include <cstring>
+
+namespace host {
+
+SessionRecorder::SessionRecorder() = default;
+
+SessionRecorder::~SessionRecorder() { close(); }
+
+bool SessionRecorder::open(const QString &path) {
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    recording::FileHeader header{};
+    std::memcpy(header.magic, recording::kMagic, sizeof(header.magic));
+    header.version = recording::kVersion;
+    m_bytesWritten = m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    return m_bytesWritten == sizeof(header);
+}
+
+void SessionRecorder::close() {
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) {
+        m_file.flush();
+        m_file.close();
+    }
+}
+
+bool SessionRecorder::isOpen() const {
+    QMutexLocker locker(&m_mutex);
+    return m_file.isOpen();
+}
+
+QString SessionRecorder::errorString() const {
+    QMutexLocker locker(&m_mutex);
+    return m_file.errorString();
+}
+
+qint64 SessionRecorder::bytesWritten() const {
+    QMutexLocker locker(&m_mutex);
+    return m_bytesWritten;
+}
+
+void SessionRecorder::writeFrame(const QByteArray &pixels, PixelFormat format, int width, int height,
+                                 qint64 timestampUs, const QVector<QRect> &dirtyRects) {
+    recording::FrameRecord frame{};
+    frame.width = width;
+    frame.height = height;
+    frame.flags = dirtyRects.isEmpty() ? static_cast<quint32>(recording::kFrameRepeat) : 0u;
+    if (format == PixelFormat::I444) {
+        frame.flags |= recording::kFrameI444;
+    }
+    frame.rectCount = static_cast<quint32>(dirtyRects.size());
+
+    QByteArray head(static_cast<int>(sizeof(frame) + dirtyRects.size() * sizeof(recording::RectRecord)),
+                    Qt::Uninitialized);
+    std::memcpy(head.data(), &frame, sizeof(frame));
+    auto *rects = reinterpret_cast<recording::RectRecord *>(head.data() + sizeof(frame));
+    for (int i = 0; i < dirtyRects.size(); ++i) {
+        const QRect &rect = dirtyRects.at(i);
+        rects[i] = {rect.x(), rect.y(), rect.width(), rect.height()};
+    }
+
+    if (frame.flags & recording::kFrameRepeat) {
+        writeRecord(recording::kRecordFrame, timestampUs, head, nullptr, 0);
+    } else {
+        writeRecord(recording::kRecordFrame, timestampUs, head, pixels.constData(), pixels.size());
+    }
+}
+
+void SessionRecorder::writeInput(const QByteArray &message, qint64 timestampUs) {
+    writeRecord(recording::kRecordInput, timestampUs, QByteArray(), message.constData(), message.size());
+}
+
+void SessionRecorder::writeRecord(quint32 type, qint64 timestampUs, const QByteArray &head, const char *body,
+                                  int bodySize) {
+    static constexpr char kPadding[8] = {};
+    const int payloadSize = head.size() + bodySize;
+    recording::RecordHeader header{};
+    header.type = type;
+    header.payloadSize = static_cast<quint32>(payloadSize);
+    header.timestampUs = timestampUs;
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) {
+        return;
+    }
+    qint64 written = m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    written += m_file.write(head);
+    if (bodySize > 0) {
+        written += m_file.write(body, bodySize);
+    }
+    const int padding = recording::paddedSize(payloadSize) - payloadSize;
+    if (padding > 0) {
+        written += m_file.write(kPadding, padding);
+    }
+    m_bytesWritten += written;
+}
+
+}  // namespace host
@@ -0,0 +1,223 @@
+#include "host/SessionReplaySource.h"
+
+#include "host/SessionRecorder.h"
+#include "host/Trace.h"
+
+#include <QJsonDocument>
+#include <cstring>
+
+namespace host {
+
+namespace {
+// Larger than any capture; keeps yuvFrameSize() well inside int.
+constexpr qint32 kMaxDimension = 16384;
+}  // namespace
+
+SessionReplaySource::SessionReplaySource(QObject *parent) : VideoSource(parent) {
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &SessionReplaySource::emitDue);
+}
+
+SessionReplaySource::~SessionReplaySource() { close(); }
+
+bool SessionReplaySource::open(const QString &path) {
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        emit errorOccurred(tr("Cannot open recording %1: %2").arg(path, m_file.errorString()));
+        return false;
+    }
+    const qint64 size = m_file.size();
+    if (size < static_cast<qint64>(sizeof(recording::FileHeader))) {
+        emit errorOccurred(tr("Recording %1 is truncated.").arg(path));
+        m_file.close();
+        return false;
+    }
+    m_map = m_file.map(0, size);
+    if (!m_map) {
+        emit errorOccurred(tr("Cannot map recording %1: %2").arg(path, m_file.errorString()));
+        m_file.close();
+        return false;
+    }
+
+    recording::FileHeader header;
+    std::memcpy(&header, m_map, sizeof(header));
+    if (std::memcmp(header.magic, recording::kMagic, sizeof(header.magic)) != 0 ||
+        header.version != recording::kVersion) {
+        emit errorOccurred(tr("%1 is not a session recording.").arg(path));
+        close();
+        return false;
+    }
+
+    qint64 offset = sizeof(header);
+    while (offset + static_cast<qint64>(sizeof(recording::RecordHeader)) <= size) {
+        recording::RecordHeader recordHeader;
+        std::memcpy(&recordHeader, m_map + offset, sizeof(recordHeader));
+        const qint64 payloadOffset = offset + sizeof(recordHeader);
+        if (payloadOffset + recordHeader.payloadSize > size) {
+            // The recorder was interrupted mid-record; keep what is complete.
+            break;
+        }
+        Record record;
+        record.type = recordHeader.type;
+        record.timestampUs = recordHeader.timestampUs;
+        record.payload = m_map + payloadOffset;
+        record.payloadSize = recordHeader.payloadSize;
+        m_records.append(record);
+        if (record.type == recording::kRecordFrame) {
+            ++m_frameCount;
+        }
+        offset = payloadOffset + recording::paddedSize(static_cast<int>(recordHeader.payloadSize));
+    }
+    rewind();
+    return true;
+}
+
+void SessionReplaySource::close() {
+    stop();
+    m_records.clear();
+    m_frameCount = 0;
+    m_lastPixels.clear();
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+void SessionReplaySource::rewind() {
+    m_position = 0;
+    m_lastPixels.clear();
+    m_baseTimestampUs = m_records.isEmpty() ? 0 : m_records.first().timestampUs;
+}
+
+bool SessionReplaySource::decodeFrame(const Record &record, VideoFrame &frame) {
+    recording::FrameRecord header;
+    if (record.payloadSize < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, record.payload, sizeof(header));
+    // The file is untrusted: check the count before it is multiplied, and the
+    // size before it is turned into a buffer length.
+    if (header.rectCount > (record.payloadSize - sizeof(header)) / sizeof(recording::RectRecord)) {
+        return false;
+    }
+    if (header.width <= 0 || header.height <= 0 || header.width > kMaxDimension || header.height > kMaxDimension ||
+        header.width % 2 != 0 || header.height % 2 != 0) {
+        return false;
+    }
+    const quint32 headSize = sizeof(header) + header.rectCount * sizeof(recording::RectRecord);
+
+    frame.format = (header.flags & recording::kFrameI444) ? PixelFormat::I444 : PixelFormat::I420;
+    frame.width = header.width;
+    frame.height = header.height;
+    frame.stride = header.width;
+    frame.timestampUs = record.timestampUs;
+    frame.dirtyRects.resize(static_cast<int>(header.rectCount));
+    for (quint32 i = 0; i < header.rectCount; ++i) {
+        recording::RectRecord rect;
+        std::memcpy(&rect, record.payload + sizeof(header) + i * sizeof(rect), sizeof(rect));
+        frame.dirtyRects[static_cast<int>(i)] = QRect(rect.x, rect.y, rect.width, rect.height);
+    }
+
+    const int pixelSize = yuvFrameSize(frame.format, header.width, header.height);
+    if (header.flags & recording::kFrameRepeat) {
+        frame.data = m_lastPixels;
+        return frame.data.size() == pixelSize;
+    }
+    if (record.payloadSize - headSize < static_cast<quint32>(pixelSize)) {
+        return false;
+    }
+    frame.data = QByteArray::fromRawData(reinterpret_cast<const char *>(record.payload + headSize), pixelSize);
+    m_lastPixels = frame.data;
+    return true;
+}
+
+bool SessionReplaySource::readNextFrame(VideoFrame &frame) {
+    while (m_position < m_records.size()) {
+        const Record &record = m_records.at(m_position++);
+        if (record.type == recording::kRecordFrame && decodeFrame(record, frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SessionReplaySource::setScreenIndex(int index) { Q_UNUSED(index); }
+
+void SessionReplaySource::setFrameRate(int fps) { Q_UNUSED(fps); }
+
+// Recorded frames are replayed whole and cropped by the consumer.
+void SessionReplaySource::setCaptureRegion(const QRect &region) { Q_UNUSED(region); }
+
+bool SessionReplaySource::start() {
+    if (!isOpen()) {
+        emit errorOccurred(tr("No recording loaded."));
+        return false;
+    }
+    rewind();
+    m_running = true;
+    m_clock.start();
+    scheduleNext();
+    return true;
+}
+
+void SessionReplaySource::stop() {
+    m_running = false;
+    m_timer.stop();
+}
+
+void SessionReplaySource::emitDue() {
+    if (!m_running) {
+        return;
+    }
+    const qint64 elapsedUs = m_clock.nsecsElapsed() / 1000;
+    while (m_position < m_records.size()) {
+        const Record &record = m_records.at(m_position);
+        if (m_pacing == Pacing::Recorded && record.timestampUs - m_baseTimestampUs > elapsedUs) {
+            break;
+        }
+        ++m_position;
+        if (record.type == recording::kRecordFrame) {
+            HOST_TRACE_SCOPE("capture");
+            VideoFrame frame;
+            if (decodeFrame(record, frame)) {
+                emit frameCaptured(frame.data, frame.format, frame.width, frame.height, frame.timestampUs,
+                                   frame.dirtyRects);
+            }
+        } else if (record.type == recording::kRecordInput) {
+            const QByteArray message =
+                QByteArray::fromRawData(reinterpret_cast<const char *>(record.payload), record.payloadSize);
+            emit inputEventReplayed(QJsonDocument::fromJson(message).object());
+        }
+        if (m_pacing == Pacing::FullSpeed) {
+            break;
+        }
+    }
+
+    if (m_position >= m_records.size()) {
+        if (!m_loop) {
+            m_running = false;
+            emit finished();
+            return;
+        }
+        rewind();
+        m_clock.restart();
+    }
+    scheduleNext();
+}
+
+void SessionReplaySource::scheduleNext() {
+    if (m_pacing == Pacing::FullSpeed || m_position >= m_records.size()) {
+        m_timer.start(0);
+        return;
+    }
+    const qint64 dueUs = m_records.at(m_position).timestampUs - m_baseTimestampUs;
+    const qint64 waitMs = (dueUs - m_clock.nsecsElapsed() / 1000) / 1000;
+    m_timer.start(static_cast<int>(qBound<qint64>(0, waitMs, 1000)));
+}
+
+}  // namespace host
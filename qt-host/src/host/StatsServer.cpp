@@ -0,0 +1,80 @@
+#include "host/StatsServer.h"
+
+#include "host/HostStats.h"
+#include "host/VideoSource.h"
+
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace host {
+
+namespace {
+constexpr int kSampleIntervalMs = 1000;
+constexpr int kMaxRequestBytes = 8192;
+
+QByteArray httpResponse(const QByteArray &status, const QByteArray &contentType, const QByteArray &body) {
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    return response;
+}
+}  // namespace
+
+StatsServer::StatsServer(QObject *parent) : QObject(parent), m_server(std::make_unique<QTcpServer>()) {
+    connect(m_server.get(), &QTcpServer::newConnection, this, &StatsServer::handleConnection);
+    m_sampleTimer.setInterval(kSampleIntervalMs);
+    connect(&m_sampleTimer, &QTimer::timeout, this, []() { HostStats::instance().sample(captureClockUs()); });
+}
+
+StatsServer::~StatsServer() = default;
+
+bool StatsServer::listen(quint16 port) {
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        emit logMessage(tr("Stats endpoint failed to listen on port %1: %2").arg(port).arg(m_server->errorString()));
+        return false;
+    }
+    HostStats::instance().sample(captureClockUs());
+    m_sampleTimer.start();
+    emit logMessage(tr("Stats endpoint on http://127.0.0.1:%1/metrics").arg(m_server->serverPort()));
+    return true;
+}
+
+quint16 StatsServer::port() const { return m_server->serverPort(); }
+
+void StatsServer::handleConnection() {
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { respond(socket); });
+    }
+}
+
+void StatsServer::respond(QTcpSocket *socket) {
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > kMaxRequestBytes) {
+            socket->abort();
+        }
+        return;
+    }
+    const QList<QByteArray> requestLine = socket->readLine().trimmed().split(' ');
+    socket->disconnect(this);
+
+    QByteArray response;
+    if (requestLine.size() < 2 || requestLine.at(0) != "GET") {
+        response = httpResponse("405 Method Not Allowed", "text/plain", "GET only\n");
+    } else if (requestLine.at(1) == "/metrics") {
+        response = httpResponse("200 OK", "text/plain; version=0.0.4", HostStats::instance().toPrometheus());
+    } else if (requestLine.at(1) == "/stats") {
+        response = httpResponse("200 OK", "application/json",
+                                QJsonDocument(HostStats::instance().toJson()).toJson(QJsonDocument::Compact));
+    } else {
+        response = httpResponse("404 Not Found", "text/plain", "try /metrics or /stats\n");
+    }
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+}  // namespace host
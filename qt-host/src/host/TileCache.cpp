@@ -0,0 +1,225 @@
+#include "host/TileCache.h"
+
+#include <QRect>
+#include <algorithm>
+#include <cstring>
+
+namespace host {
+
+namespace {
+// Shown hash of a position whose content on the viewer is not known.
+constexpr std::uint64_t kUnknown = 0;
+
+std::uint64_t hashRows(std::uint64_t hash, const std::uint8_t *row, int length, int stride, int rows) {
+    for (int y = 0; y < rows; ++y, row += stride) {
+        int i = 0;
+        for (; i + 8 <= length; i += 8) {
+            std::uint64_t word;
+            memcpy(&word, row + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+        for (; i < length; ++i) {
+            hash = (hash ^ row[i]) * 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+std::uint64_t hashTile(const VideoFrame &picture, const QRect &tile) {
+    const int shift = picture.format == PixelFormat::I444 ? 0 : 1;
+    const auto *y = reinterpret_cast<const std::uint8_t *>(picture.data.constData());
+    const int chromaStride = picture.width >> shift;
+    const std::uint8_t *u = y + picture.width * picture.height;
+    const std::uint8_t *v = u + chromaStride * (picture.height >> shift);
+    // The size goes into the seed so clipped edge tiles never match full ones.
+    std::uint64_t hash = 0xcbf29ce484222325ull ^ (static_cast<std::uint64_t>(tile.width()) << 32 | tile.height());
+    hash = hashRows(hash, y + tile.y() * picture.width + tile.x(), tile.width(), picture.width, tile.height());
+    const int chromaOffset = (tile.y() >> shift) * chromaStride + (tile.x() >> shift);
+    hash = hashRows(hash, u + chromaOffset, tile.width() >> shift, chromaStride, tile.height() >> shift);
+    hash = hashRows(hash, v + chromaOffset, tile.width() >> shift, chromaStride, tile.height() >> shift);
+    return hash == kUnknown ? 1 : hash;
+}
+}  // namespace
+
+void TileCache::setBudget(qint64 bytes) {
+    const int capacity = static_cast<int>(qBound<qint64>(0, bytes / kSlotBytes, 1 << 20));
+    if (capacity == m_capacity) {
+        return;
+    }
+    m_capacity = capacity;
+    clear();
+}
+
+void TileCache::clear() {
+    m_slots.assign(static_cast<size_t>(m_capacity), Slot{});
+    m_index.clear();
+    m_index.reserve(static_cast<size_t>(m_capacity));
+    m_newest = kNone;
+    m_oldest = kNone;
+    m_width = 0;
+    m_height = 0;
+    m_pending.clear();
+    m_changed.clear();
+}
+
+void TileCache::resize(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_columns = (width + kTileSize - 1) / kTileSize;
+    const size_t tiles = static_cast<size_t>(m_columns) * static_cast<size_t>((height + kTileSize - 1) / kTileSize);
+    m_shown.assign(tiles, kUnknown);
+    m_current.assign(tiles, kUnknown);
+    m_examined.assign(tiles, 0);
+    m_pending.clear();
+}
+
+void TileCache::lookup(const VideoFrame &picture, Result &result) {
+    result = Result{};
+    m_changed.clear();
+    if (!isEnabled()) {
+        return;
+    }
+    if (picture.width != m_width || picture.height != m_height) {
+        resize(picture.width, picture.height);
+    }
+    if (++m_generation == 0) {
+        std::fill(m_examined.begin(), m_examined.end(), 0);
+        m_generation = 1;
+    }
+
+    const QRect frameRect(0, 0, picture.width, picture.height);
+    m_touched.clear();
+    for (const QRect &dirty : picture.dirtyRects) {
+        const QRect rect = dirty.intersected(frameRect);
+        if (rect.isEmpty()) {
+            continue;
+        }
+        for (int row = rect.top() / kTileSize; row <= rect.bottom() / kTileSize; ++row) {
+            for (int column = rect.left() / kTileSize; column <= rect.right() / kTileSize; ++column) {
+                const int index = row * m_columns + column;
+                if (m_examined[static_cast<size_t>(index)] == m_generation) {
+                    continue;
+                }
+                m_examined[static_cast<size_t>(index)] = m_generation;
+                const QRect tile(column * kTileSize, row * kTileSize, kTileSize, kTileSize);
+                m_current[static_cast<size_t>(index)] = hashTile(picture, tile.intersected(frameRect));
+                m_touched.push_back(index);
+            }
+        }
+    }
+
+    const auto positionOf = [this](int index) {
+        return QPoint(index % m_columns * kTileSize, index / m_columns * kTileSize);
+    };
+
+    // Tiles that stayed put since the last encoded frame are on the viewer's
+    // screen now and can be copied into a slot. Changed ones wait for the
+    // next frame they survive.
+    for (const int index : m_pending) {
+        const auto i = static_cast<size_t>(index);
+        if (m_examined[i] == m_generation && m_current[i] != m_shown[i]) {
+            continue;
+        }
+        if (find(m_shown[i]) == kNone) {
+            result.stores.append({insert(m_shown[i]), positionOf(index)});
+        }
+    }
+    m_pending.clear();
+
+    QVector<TileRef> draws;
+    for (const int index : m_touched) {
+        const auto i = static_cast<size_t>(index);
+        if (m_current[i] == m_shown[i]) {
+            continue;
+        }
+        m_changed.push_back(index);
+        ++result.lookups;
+        const int slot = find(m_current[i]);
+        if (slot != kNone) {
+            ++result.hits;
+            draws.append({slot, positionOf(index)});
+        }
+    }
+    result.cached = !m_changed.empty() && result.hits == result.lookups;
+    if (result.cached) {
+        result.draws = std::move(draws);
+    }
+}
+
+void TileCache::commit(Outcome outcome) {
+    for (const int index : m_changed) {
+        const auto i = static_cast<size_t>(index);
+        switch (outcome) {
+        case Outcome::Encoded:
+            m_shown[i] = m_current[i];
+            if (m_index.find(m_current[i]) == m_index.end()) {
+                m_pending.push_back(index);
+            }
+            break;
+        case Outcome::Drawn:
+            m_shown[i] = m_current[i];
+            break;
+        case Outcome::Dropped:
+            m_shown[i] = kUnknown;
+            break;
+        }
+    }
+    m_changed.clear();
+}
+
+int TileCache::find(std::uint64_t hash) {
+    const auto it = m_index.find(hash);
+    if (it == m_index.end()) {
+        return kNone;
+    }
+    unlink(it->second);
+    pushNewest(it->second);
+    return it->second;
+}
+
+int TileCache::insert(std::uint64_t hash) {
+    int slot;
+    if (static_cast<int>(m_index.size()) < m_capacity) {
+        slot = static_cast<int>(m_index.size());
+    } else {
+        slot = m_oldest;
+        m_index.erase(m_slots[static_cast<size_t>(slot)].hash);
+        unlink(slot);
+    }
+    m_slots[static_cast<size_t>(slot)].hash = hash;
+    m_index.emplace(hash, slot);
+    pushNewest(slot);
+    return slot;
+}
+
+void TileCache::unlink(int slot) {
+    Slot &entry = m_slots[static_cast<size_t>(slot)];
+    if (entry.newer != kNone) {
+        m_slots[static_cast<size_t>(entry.newer)].older = entry.older;
+    } else {
+        m_newest = entry.older;
+    }
+    if (entry.older != kNone) {
+        m_slots[static_cast<size_t>(entry.older)].newer = entry.newer;
+    } else {
+        m_oldest = entry.newer;
+    }
+    entry.newer = kNone;
+    entry.older = kNone;
+}
+
+void TileCache::pushNewest(int slot) {
+    Slot &entry = m_slots[static_cast<size_t>(slot)];
+    entry.newer = kNone;
+    entry.older = m_newest;
+    if (m_newest != kNone) {
+        m_slots[static_cast<size_t>(m_newest)].newer = slot;
+    }
+    m_newest = slot;
+    if (m_oldest == kNone) {
+        m_oldest = slot;
+    }
+}
+
+}  // namespace host
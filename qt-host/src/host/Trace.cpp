@@ -0,0 +1,247 @@
+#include "host/Trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace host::trace {
+
+#ifdef HOST_ENABLE_TRACING
+std::atomic<bool> g_recording{false};
+
+namespace {
+// Per-thread ring; once full the oldest events are overwritten.
+constexpr std::uint64_t kEventsPerThread = 1u << 16;
+
+struct Event {
+    const char *name = nullptr;
+    std::int64_t startNs = 0;
+    std::int64_t endNs = 0;
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    const char *name = nullptr;
+    std::unique_ptr<Event[]> events = std::make_unique<Event[]>(kEventsPerThread);
+    std::atomic<std::uint64_t> written{0};
+};
+
+std::mutex g_registryMutex;
+// Buffers outlive their threads so events from finished threads still export.
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+ThreadBuffer *registerThread() {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->tid = static_cast<int>(g_buffers.size()) + 1;
+    g_buffers.push_back(std::move(buffer));
+    return g_buffers.back().get();
+}
+
+ThreadBuffer &localBuffer() {
+    thread_local ThreadBuffer *buffer = registerThread();
+    return *buffer;
+}
+
+template <typename Fn>
+void forEachEvent(const ThreadBuffer &buffer, Fn &&fn) {
+    const std::uint64_t written = buffer.written.load(std::memory_order_acquire);
+    const std::uint64_t count = std::min(written, kEventsPerThread);
+    for (std::uint64_t i = written - count; i < written; ++i) {
+        fn(buffer.events[i & (kEventsPerThread - 1)]);
+    }
+}
+
+QByteArray threadLabel(const ThreadBuffer &buffer) {
+    return buffer.name ? QByteArray(buffer.name) : QByteArray("thread-") + QByteArray::number(buffer.tid);
+}
+
+QByteArray jsonString(const char *text) {
+    QByteArray out("\"");
+    for (const char *p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            out += '\\';
+        }
+        out += *p;
+    }
+    out += '"';
+    return out;
+}
+
+QByteArray toChromeJson(qint64 pid) {
+    const QByteArray pidText = QByteArray::number(pid);
+    QByteArray out("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&out, &first]() {
+        if (!first) {
+            out += ",\n";
+        }
+        first = false;
+    };
+    for (const auto &buffer : g_buffers) {
+        const QByteArray tid = QByteArray::number(buffer->tid);
+        separator();
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pidText + ",\"tid\":" + tid +
+               ",\"args\":{\"name\":" + jsonString(threadLabel(*buffer).constData()) + "}}";
+        forEachEvent(*buffer, [&](const Event &event) {
+            separator();
+            out += "{\"ph\":\"X\",\"name\":" + jsonString(event.name) + ",\"pid\":" + pidText + ",\"tid\":" + tid +
+                   ",\"ts\":" + QByteArray::number(static_cast<double>(event.startNs) / 1000.0, 'f', 3) +
+                   ",\"dur\":" + QByteArray::number(static_cast<double>(event.endNs - event.startNs) / 1000.0, 'f', 3) +
+                   "}";
+        });
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+// Minimal protobuf writer for the subset of perfetto.protos.Trace we emit.
+namespace pb {
+enum WireType { kVarint = 0, kLengthDelimited = 2 };
+
+void varint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void uintField(QByteArray &out, int field, quint64 value) {
+    varint(out, (static_cast<quint64>(field) << 3) | kVarint);
+    varint(out, value);
+}
+
+void bytesField(QByteArray &out, int field, const QByteArray &value) {
+    varint(out, (static_cast<quint64>(field) << 3) | kLengthDelimited);
+    varint(out, static_cast<quint64>(value.size()));
+    out += value;
+}
+}  // namespace pb
+
+// Field numbers from perfetto/protos/perfetto/trace/.
+constexpr int kTracePacket = 1;
+constexpr int kPacketTimestamp = 8;
+constexpr int kPacketSequenceId = 10;
+constexpr int kPacketTrackEvent = 11;
+constexpr int kPacketTrackDescriptor = 60;
+constexpr int kTrackEventType = 9;
+constexpr int kTrackEventTrackUuid = 11;
+constexpr int kTrackEventName = 23;
+constexpr int kTrackDescriptorUuid = 1;
+constexpr int kTrackDescriptorThread = 4;
+constexpr int kThreadPid = 1;
+constexpr int kThreadTid = 2;
+constexpr int kThreadName = 5;
+constexpr int kSliceBegin = 1;
+constexpr int kSliceEnd = 2;
+constexpr quint64 kSequenceId = 1;
+
+QByteArray toPerfetto(qint64 pid) {
+    struct Edge {
+        std::int64_t timestampNs;
+        bool begin;
+        const char *name;
+    };
+
+    QByteArray out;
+    for (const auto &buffer : g_buffers) {
+        const auto uuid = static_cast<quint64>(buffer->tid);
+
+        QByteArray thread;
+        pb::uintField(thread, kThreadPid, static_cast<quint64>(pid));
+        pb::uintField(thread, kThreadTid, uuid);
+        pb::bytesField(thread, kThreadName, threadLabel(*buffer));
+        QByteArray descriptor;
+        pb::uintField(descriptor, kTrackDescriptorUuid, uuid);
+        pb::bytesField(descriptor, kTrackDescriptorThread, thread);
+        QByteArray packet;
+        pb::uintField(packet, kPacketSequenceId, kSequenceId);
+        pb::bytesField(packet, kPacketTrackDescriptor, descriptor);
+        pb::bytesField(out, kTracePacket, packet);
+
+        // Scopes are recorded when they close, so inner slices precede outer
+        // ones; re-sort into begin/end order for the track.
+        std::vector<Edge> edges;
+        forEachEvent(*buffer, [&edges](const Event &event) {
+            edges.push_back({event.startNs, true, event.name});
+            edges.push_back({event.endNs, false, event.name});
+        });
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+            if (a.timestampNs != b.timestampNs) {
+                return a.timestampNs < b.timestampNs;
+            }
+            return !a.begin && b.begin;
+        });
+        for (const Edge &edge : edges) {
+            QByteArray event;
+            pb::uintField(event, kTrackEventType, edge.begin ? kSliceBegin : kSliceEnd);
+            pb::uintField(event, kTrackEventTrackUuid, uuid);
+            if (edge.begin) {
+                pb::bytesField(event, kTrackEventName, QByteArray(edge.name));
+            }
+            QByteArray slicePacket;
+            pb::uintField(slicePacket, kPacketTimestamp, static_cast<quint64>(edge.timestampNs));
+            pb::uintField(slicePacket, kPacketSequenceId, kSequenceId);
+            pb::bytesField(slicePacket, kPacketTrackEvent, event);
+            pb::bytesField(out, kTracePacket, slicePacket);
+        }
+    }
+    return out;
+}
+}  // namespace
+
+void record(const char *name, std::int64_t startNs, std::int64_t endNs) {
+    ThreadBuffer &buffer = localBuffer();
+    const std::uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index & (kEventsPerThread - 1)] = {name, startNs, endNs};
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void setThreadName(const char *name) { localBuffer().name = name; }
+
+void start() { g_recording.store(true, std::memory_order_relaxed); }
+
+void stop() { g_recording.store(false, std::memory_order_relaxed); }
+
+bool isAvailable() { return true; }
+
+bool exportTo(const QString &path, Format format, QString *error) {
+    QByteArray data;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        const qint64 pid = QCoreApplication::applicationPid();
+        data = format == Format::Perfetto ? toPerfetto(pid) : toChromeJson(pid);
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+#else
+void setThreadName(const char *name) { Q_UNUSED(name); }
+
+void start() {}
+
+void stop() {}
+
+bool isAvailable() { return false; }
+
+bool exportTo(const QString &path, Format format, QString *error) {
+    Q_UNUSED(path);
+    Q_UNUSED(format);
+    if (error) {
+        *error = QStringLiteral("tracing was compiled out (HOST_ENABLE_TRACING=OFF)");
+    }
+    return false;
+}
+#endif
+
+}  // namespace host::trace
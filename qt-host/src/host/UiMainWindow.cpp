@@ -2,7 +2,11 @@
 
 #include "common/Protocol.h"
 #include "host/AuthClient.h"
+#include "host/CaptureRegion.h"
+#include "host/LogView.h"
+#include "host/Logger.h"
 #include "host/SignalingClient.h"
+#include "host/StatsServer.h"
 #include "host/WebRtcPeer.h"
 
 #include <QCheckBox>
@@ -18,7 +22,6 @@
 #include <QPushButton>
 #include <QIcon>
 #include <QSystemTrayIcon>
-#include <QTextEdit>
 #include <QTimer>
 #include <QUrlQuery>
 #include <QVBoxLayout>
@@ -81,6 +84,39 @@ void UiMainWindow::setInitialScreenIndex(int index) {
     }
 }
 
+void UiMainWindow::setCaptureWindowTitle(const QString &text) {
+    if (text.isEmpty() || !m_windowCombo) {
+        return;
+    }
+    refreshWindowList();
+    const int index = m_windowCombo->findData(QVariant::fromValue(CaptureRegion::findWindow(text)));
+    if (index > 0) {
+        m_windowCombo->setCurrentIndex(index);
+    } else {
+        handleLog(tr("No window titled \"%1\"; sharing the screen.").arg(text));
+    }
+}
+
+void UiMainWindow::setCaptureRect(const QRect &rect) {
+    m_captureRect = rect;
+    if (m_windowCombo) {
+        refreshWindowList();
+    }
+}
+
+void UiMainWindow::refreshWindowList() {
+    const QVariant selected = m_windowCombo->currentData();
+    m_windowCombo->clear();
+    m_windowCombo->addItem(m_captureRect.isEmpty() ? tr("Entire screen") : tr("Screen region"),
+                           QVariant::fromValue(quintptr(0)));
+    for (const CaptureRegion::Window &window : CaptureRegion::topLevelWindows()) {
+        if (window.handle != static_cast<quintptr>(winId())) {
+            m_windowCombo->addItem(window.title, QVariant::fromValue(window.handle));
+        }
+    }
+    m_windowCombo->setCurrentIndex(qMax(0, m_windowCombo->findData(selected)));
+}
+
 void UiMainWindow::setAllowControlDefault(bool enabled) {
     m_initialAllowControl = enabled;
     if (m_allowControlCheck) {
@@ -88,6 +124,50 @@ void UiMainWindow::setAllowControlDefault(bool enabled) {
     }
 }
 
+void UiMainWindow::setRecordPath(const QString &path) { m_recordPath = path; }
+
+void UiMainWindow::setReplayPath(const QString &path) { m_replayPath = path; }
+
+void UiMainWindow::setVideoSlices(int slices) { m_videoSlices = slices; }
+
+void UiMainWindow::setTileCacheMb(int megabytes) { m_tileCacheMb = megabytes; }
+
+void UiMainWindow::setIdleFps(int fps) { m_idleFps = fps; }
+
+void UiMainWindow::setRoiStrength(int strength) { m_roiStrength = strength; }
+
+void UiMainWindow::setDefaultFps(int fps) {
+    if (!m_fpsCombo) {
+        return;
+    }
+    int index = m_fpsCombo->findData(fps);
+    if (index < 0) {
+        m_fpsCombo->addItem(QString::number(fps), fps);
+        index = m_fpsCombo->count() - 1;
+    }
+    m_fpsCombo->setCurrentIndex(index);
+}
+
+void UiMainWindow::setVideoCodec(std::optional<VideoEncoder::Codec> codec) { m_videoCodec = codec; }
+
+void UiMainWindow::setFullChroma(bool enabled) { m_fullChroma = enabled; }
+
+void UiMainWindow::setRefineAfterMs(int milliseconds) { m_refineAfterMs = milliseconds; }
+
+void UiMainWindow::setQualitySampleInterval(int frames) { m_qualitySampleInterval = frames; }
+
+void UiMainWindow::setFileDirectory(const QString &directory) { m_fileDirectory = directory; }
+
+void UiMainWindow::setStatsPort(int port) {
+    if (port <= 0 || port > 65535) {
+        m_statsServer.reset();
+        return;
+    }
+    m_statsServer = std::make_unique<StatsServer>();
+    connect(m_statsServer.get(), &StatsServer::logMessage, this, &UiMainWindow::handleLog);
+    m_statsServer->listen(static_cast<quint16>(port));
+}
+
 void UiMainWindow::setupUi() {
     auto *central = new QWidget(this);
     auto *layout = new QVBoxLayout(central);
@@ -108,14 +188,18 @@ void UiMainWindow::setupUi() {
     m_screenCombo->addItem(tr("Primary"));
     m_screenCombo->addItem(tr("Secondary"));
 
+    m_windowCombo = new QComboBox(central);
+    refreshWindowList();
+
     m_fpsCombo = new QComboBox(central);
-    m_fpsCombo->addItem("30");
-    m_fpsCombo->addItem("60");
+    m_fpsCombo->addItem(tr("Auto"), 0);
+    m_fpsCombo->addItem("30", 30);
+    m_fpsCombo->addItem("60", 60);
 
     m_allowControlCheck = new QCheckBox(tr("Allow control"), central);
 
-    m_logView = new QTextEdit(central);
-    m_logView->setReadOnly(true);
+    m_logView = new LogView(central);
+    connect(&Logger::instance(), &Logger::linesReady, m_logView, &LogView::appendLines);
 
     layout->addWidget(m_deviceCodeLabel);
     layout->addWidget(m_verificationUriLabel);
@@ -125,6 +209,8 @@ void UiMainWindow::setupUi() {
     layout->addWidget(m_disconnectButton);
     layout->addWidget(new QLabel(tr("Screen"), central));
     layout->addWidget(m_screenCombo);
+    layout->addWidget(new QLabel(tr("Share"), central));
+    layout->addWidget(m_windowCombo);
     layout->addWidget(new QLabel(tr("FPS"), central));
     layout->addWidget(m_fpsCombo);
     layout->addWidget(m_allowControlCheck);
@@ -183,12 +269,20 @@ void UiMainWindow::enableUi(bool enabled) {
     m_codeEdit->setEnabled(enabled);
     m_joinButton->setEnabled(enabled);
     m_screenCombo->setEnabled(enabled);
+    m_windowCombo->setEnabled(enabled);
+    if (enabled) {
+        refreshWindowList();
+    }
     m_fpsCombo->setEnabled(enabled);
     m_allowControlCheck->setEnabled(enabled);
 }
 
 void UiMainWindow::handleAuthError(const QString &message) {
-    updateStatus(tr("Error: %1").arg(message));
+    const QString text = tr("Error: %1").arg(message);
+    if (m_statusLabel) {
+        m_statusLabel->setText(text);
+    }
+    Logger::instance().log(LogLevel::Error, text);
 }
 
 void UiMainWindow::onJoinClicked() {
@@ -269,12 +363,7 @@ void UiMainWindow::handlePeerStateChanged(const QString &state) {
     updateStatus(state);
 }
 
-void UiMainWindow::handleLog(const QString &line) {
-    if (!m_logView) {
-        return;
-    }
-    m_logView->append(line);
-}
+void UiMainWindow::handleLog(const QString &line) { Logger::instance().log(LogLevel::Info, line); }
 
 void UiMainWindow::createPeerIfNeeded() {
     if (m_peer) {
@@ -282,11 +371,28 @@ void UiMainWindow::createPeerIfNeeded() {
     }
     m_peer = std::make_unique<WebRtcPeer>(m_signalingClient.get(), this);
     connect(m_peer.get(), &WebRtcPeer::stateChanged, this, &UiMainWindow::handlePeerStateChanged);
-    connect(m_peer.get(), &WebRtcPeer::logLine, this, &UiMainWindow::handleLog);
+    // logLine is mostly emitted from libdatachannel threads; hand it straight to
+    // the lock-free logger instead of queueing one event per line to the GUI.
+    connect(
+        m_peer.get(), &WebRtcPeer::logLine, this,
+        [](const QString &line) { Logger::instance().log(LogLevel::Info, line); }, Qt::DirectConnection);
     WebRtcPeer::Options options;
     options.allowControl = m_allowControl;
     options.screenIndex = m_screenCombo->currentIndex();
-    options.fps = m_fpsCombo->currentText().toInt();
+    options.captureWindow = m_windowCombo->currentData().value<quintptr>();
+    options.captureRect = m_captureRect;
+    options.fps = m_fpsCombo->currentData().toInt();
+    options.recordPath = m_recordPath;
+    options.replayPath = m_replayPath;
+    options.slices = m_videoSlices;
+    options.tileCacheMb = m_tileCacheMb;
+    options.idleFps = m_idleFps;
+    options.roiStrength = m_roiStrength;
+    options.codec = m_videoCodec;
+    options.fullChroma = m_fullChroma;
+    options.refineAfterMs = m_refineAfterMs;
+    options.qualitySampleInterval = m_qualitySampleInterval;
+    options.fileDirectory = m_fileDirectory;
     m_peer->setOptions(options);
     m_peer->setIceConfig(m_iceConfig);
     m_peer->start();
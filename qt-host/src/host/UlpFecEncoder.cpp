@@ -0,0 +1,86 @@
+#include "host/UlpFecEncoder.h"
+
+#include <QtEndian>
+#include <cmath>
+
+namespace host {
+
+namespace {
+constexpr int kRtpHeaderSize = 12;
+constexpr int kFecHeaderSize = 10;
+constexpr int kLevelHeaderShortMask = 4;
+constexpr int kLevelHeaderLongMask = 8;
+// Masks fit in 16 bits up to this many packets (L bit clear).
+constexpr int kShortMaskPackets = 16;
+}  // namespace
+
+void UlpFecEncoder::setProtectionRate(double rate) { m_rate = qBound(0.0, rate, 0.5); }
+
+double UlpFecEncoder::rateForLoss(double lossFraction) {
+    if (lossFraction <= 0.0) {
+        return 0.0;
+    }
+    return qBound(0.1, 0.05 + 4.0 * lossFraction, 0.5);
+}
+
+void UlpFecEncoder::encode(const QList<QByteArray> &media, QList<QByteArray> &fecPayloads) const {
+    if (m_rate <= 0.0) {
+        return;
+    }
+    for (int first = 0; first < media.size(); first += kMaxBlockPackets) {
+        encodeBlock(media, first, qMin(kMaxBlockPackets, static_cast<int>(media.size()) - first), fecPayloads);
+    }
+}
+
+void UlpFecEncoder::encodeBlock(const QList<QByteArray> &media, int first, int count,
+                                QList<QByteArray> &fecPayloads) const {
+    const int fecCount = qMax(1, static_cast<int>(std::ceil(count * m_rate)));
+    const bool longMask = count > kShortMaskPackets;
+    const int levelHeaderSize = longMask ? kLevelHeaderLongMask : kLevelHeaderShortMask;
+    const auto *firstHeader = reinterpret_cast<const uchar *>(media.at(first).constData());
+    const quint16 sequenceBase = qFromBigEndian<quint16>(firstHeader + 2);
+
+    for (int group = 0; group < fecCount; ++group) {
+        int protectionLength = 0;
+        for (int i = group; i < count; i += fecCount) {
+            protectionLength = qMax(protectionLength, static_cast<int>(media.at(first + i).size()) - kRtpHeaderSize);
+        }
+
+        QByteArray fec(kFecHeaderSize + levelHeaderSize + protectionLength, '\0');
+        auto *out = reinterpret_cast<uchar *>(fec.data());
+        uchar *payload = out + kFecHeaderSize + levelHeaderSize;
+        quint8 bitsRecovery = 0;
+        quint8 markerTypeRecovery = 0;
+        quint32 timestampRecovery = 0;
+        quint16 lengthRecovery = 0;
+        quint64 mask = 0;
+        for (int i = group; i < count; i += fecCount) {
+            const QByteArray &packet = media.at(first + i);
+            const auto *data = reinterpret_cast<const uchar *>(packet.constData());
+            bitsRecovery ^= data[0];
+            markerTypeRecovery ^= data[1];
+            timestampRecovery ^= qFromBigEndian<quint32>(data + 4);
+            lengthRecovery ^= static_cast<quint16>(packet.size() - kRtpHeaderSize);
+            for (int b = kRtpHeaderSize; b < packet.size(); ++b) {
+                payload[b - kRtpHeaderSize] ^= data[b];
+            }
+            mask |= quint64(1) << (47 - i);
+        }
+
+        // FEC header: E=0, L, P/X/CC recovery | M/PT recovery | SN base | TS recovery | length recovery.
+        out[0] = static_cast<uchar>((longMask ? 0x40 : 0x00) | (bitsRecovery & 0x3f));
+        out[1] = markerTypeRecovery;
+        qToBigEndian<quint16>(sequenceBase, out + 2);
+        qToBigEndian<quint32>(timestampRecovery, out + 4);
+        qToBigEndian<quint16>(lengthRecovery, out + 8);
+        // Level 0 header: protection length, then the mask (bit 0 = SN base).
+        qToBigEndian<quint16>(static_cast<quint16>(protectionLength), out + 10);
+        qToBigEndian<quint16>(static_cast<quint16>(mask >> 32), out + 12);
+        if (longMask) {
+            qToBigEndian<quint32>(static_cast<quint32>(mask), out + 14);
+        }
+        fecPayloads.append(std::move(fec));
+    }
+}
+
+}  // namespace host
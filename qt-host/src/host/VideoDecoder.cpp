@@ -0,0 +1,162 @@
+#include "host/VideoDecoder.h"
+
+#include <cstring>
+
+#ifdef HOST_ENABLE_OPENH264
+#include <wels/codec_api.h>
+#endif
+#ifdef HOST_ENABLE_AOM
+#include <aom/aom_decoder.h>
+#include <aom/aomdx.h>
+#endif
+
+namespace host {
+
+#if defined(HOST_ENABLE_OPENH264) || defined(HOST_ENABLE_AOM)
+namespace {
+// Decoders hand out padded planes; VideoFrame wants them packed.
+void copyPlane(const unsigned char *source, int sourceStride, int width, int height, char *destination) {
+    for (int row = 0; row < height; ++row) {
+        std::memcpy(destination + qsizetype(row) * width, source + qsizetype(row) * sourceStride, width);
+    }
+}
+
+void prepareFrame(PixelFormat format, int width, int height, qint64 timestampUs, VideoFrame &out) {
+    out.format = format;
+    out.width = width;
+    out.height = height;
+    out.stride = width;
+    out.timestampUs = timestampUs;
+    out.dirtyRects.clear();
+    out.data.resize(yuvFrameSize(format, width, height));
+}
+
+#ifdef HOST_ENABLE_OPENH264
+class OpenH264Decoder : public VideoDecoder {
+public:
+    ~OpenH264Decoder() override {
+        if (m_decoder) {
+            m_decoder->Uninitialize();
+            WelsDestroyDecoder(m_decoder);
+        }
+    }
+
+    bool initialize() override {
+        if (WelsCreateDecoder(&m_decoder) != 0 || !m_decoder) {
+            return false;
+        }
+        SDecodingParam param{};
+        param.sVideoProperty.eVideoBsType = VIDEO_BITSTREAM_AVC;
+        return m_decoder->Initialize(&param) == cmResultSuccess;
+    }
+
+    bool decode(const EncodedFrame &frame, VideoFrame &out) override {
+        out.data.clear();
+        if (!m_decoder) {
+            return false;
+        }
+        unsigned char *planes[3] = {};
+        SBufferInfo info{};
+        if (m_decoder->DecodeFrameNoDelay(reinterpret_cast<const unsigned char *>(frame.data.constData()),
+                                          frame.data.size(), planes, &info) != dsErrorFree) {
+            return false;
+        }
+        if (info.iBufferStatus != 1) {
+            return true;
+        }
+        const SSysMEMBuffer &buffer = info.UsrData.sSystemBuffer;
+        const int width = buffer.iWidth;
+        const int height = buffer.iHeight;
+        prepareFrame(PixelFormat::I420, width, height, frame.timestampUs, out);
+        char *target = out.data.data();
+        copyPlane(planes[0], buffer.iStride[0], width, height, target);
+        target += qsizetype(width) * height;
+        copyPlane(planes[1], buffer.iStride[1], width / 2, height / 2, target);
+        target += qsizetype(width / 2) * (height / 2);
+        copyPlane(planes[2], buffer.iStride[1], width / 2, height / 2, target);
+        return true;
+    }
+
+    QString name() const override { return QStringLiteral("openh264"); }
+
+private:
+    ISVCDecoder *m_decoder = nullptr;
+};
+#endif
+
+#ifdef HOST_ENABLE_AOM
+class AomDecoder : public VideoDecoder {
+public:
+    ~AomDecoder() override {
+        if (m_initialized) {
+            aom_codec_destroy(&m_codec);
+        }
+    }
+
+    bool initialize() override {
+        aom_codec_dec_cfg_t config{};
+        config.threads = 1;
+        config.allow_lowbitdepth = 1;
+        m_initialized = aom_codec_dec_init(&m_codec, aom_codec_av1_dx(), &config, 0) == AOM_CODEC_OK;
+        return m_initialized;
+    }
+
+    bool decode(const EncodedFrame &frame, VideoFrame &out) override {
+        out.data.clear();
+        if (!m_initialized || aom_codec_decode(&m_codec, reinterpret_cast<const uint8_t *>(frame.data.constData()),
+                                               static_cast<size_t>(frame.data.size()), nullptr) != AOM_CODEC_OK) {
+            return false;
+        }
+        aom_codec_iter_t iterator = nullptr;
+        const aom_image_t *image = aom_codec_get_frame(&m_codec, &iterator);
+        if (!image) {
+            return true;
+        }
+        // The encoder only produces 8-bit 4:2:0 and 4:4:4.
+        if (image->fmt != AOM_IMG_FMT_I420 && image->fmt != AOM_IMG_FMT_I444) {
+            return false;
+        }
+        const PixelFormat format = image->fmt == AOM_IMG_FMT_I444 ? PixelFormat::I444 : PixelFormat::I420;
+        const int width = static_cast<int>(image->d_w);
+        const int height = static_cast<int>(image->d_h);
+        const int shift = format == PixelFormat::I444 ? 0 : 1;
+        prepareFrame(format, width, height, frame.timestampUs, out);
+        char *target = out.data.data();
+        copyPlane(image->planes[AOM_PLANE_Y], image->stride[AOM_PLANE_Y], width, height, target);
+        target += qsizetype(width) * height;
+        const qsizetype chromaSize = qsizetype(width >> shift) * (height >> shift);
+        copyPlane(image->planes[AOM_PLANE_U], image->stride[AOM_PLANE_U], width >> shift, height >> shift, target);
+        copyPlane(image->planes[AOM_PLANE_V], image->stride[AOM_PLANE_V], width >> shift, height >> shift,
+                  target + chromaSize);
+        return true;
+    }
+
+    QString name() const override { return QStringLiteral("libaom-av1"); }
+
+private:
+    aom_codec_ctx_t m_codec{};
+    bool m_initialized = false;
+};
+#endif
+}  // namespace
+#endif
+
+std::unique_ptr<VideoDecoder> VideoDecoder::create(VideoEncoder::Codec codec) {
+    switch (codec) {
+    case VideoEncoder::Codec::H264:
+#ifdef HOST_ENABLE_OPENH264
+        return std::make_unique<OpenH264Decoder>();
+#else
+        return nullptr;
+#endif
+    case VideoEncoder::Codec::AV1:
+#ifdef HOST_ENABLE_AOM
+        return std::make_unique<AomDecoder>();
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+}  // namespace host
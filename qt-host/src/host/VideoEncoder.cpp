@@ -0,0 +1,477 @@
+#include "host/VideoEncoder.h"
+
+#include <cstring>
+
+#ifdef HOST_ENABLE_OPENH264
+#include <wels/codec_api.h>
+#endif
+#ifdef HOST_ENABLE_AOM
+#include <aom/aom_encoder.h>
+#include <aom/aomcx.h>
+#endif
+
+namespace host {
+
+#if defined(HOST_ENABLE_OPENH264) || defined(HOST_ENABLE_AOM)
+namespace {
+constexpr int kMacroblockSize = 16;
+
+// Pulls every 2x2 block of the area towards its mean, keeping keep/16 of the
+// detail. Width and height are even.
+void flattenDetail(unsigned char *plane, int stride, int x, int y, int width, int height, int keep) {
+    for (int row = y; row + 1 < y + height; row += 2) {
+        unsigned char *top = plane + row * stride;
+        unsigned char *bottom = top + stride;
+        for (int column = x; column + 1 < x + width; column += 2) {
+            const int mean = (top[column] + top[column + 1] + bottom[column] + bottom[column + 1] + 2) / 4;
+            for (unsigned char *pixel : {top + column, top + column + 1, bottom + column, bottom + column + 1}) {
+                *pixel = static_cast<unsigned char>(mean + (*pixel - mean) * keep / 16);
+            }
+        }
+    }
+}
+
+// Encoders without a QP map input emulate positive offsets by flattening the
+// detail of those macroblocks before encoding: they then cost few bits and
+// rate control spends them on the rest. Negative offsets come out of that same
+// budget and need nothing here. This is a lossy pre-filter, not a QP map: the
+// flattened detail is gone whatever the bitrate, so it only runs when RoiMap
+// is switched on. Only macroblocks whose pixels or offset changed since the
+// previous frame are redone, and those a refinement sent pixel-exact stay so
+// until their pixels change.
+class DetailShaper {
+public:
+    // Returns the picture to encode: `frame` itself while there is no usable map.
+    const unsigned char *shape(const VideoFrame &frame, const QVector<qint8> &offsets) {
+        const auto *source = reinterpret_cast<const unsigned char *>(frame.data.constData());
+        const int columns = (frame.width + kMacroblockSize - 1) / kMacroblockSize;
+        const int rows = (frame.height + kMacroblockSize - 1) / kMacroblockSize;
+        if (offsets.size() != columns * rows || frame.width % 2 != 0 || frame.height % 2 != 0) {
+            m_lastSource.clear();
+            return source;
+        }
+        const bool fresh = m_lastSource.size() != frame.data.size() || m_appliedOffsets.size() != offsets.size();
+        if (fresh) {
+            m_lastSource = QByteArray(frame.data.size(), Qt::Uninitialized);
+            m_shaped = QByteArray(frame.data.size(), Qt::Uninitialized);
+            m_appliedOffsets = QVector<qint8>(offsets.size(), 0);
+            m_exact = QVector<bool>(offsets.size(), false);
+        }
+        auto *last = reinterpret_cast<unsigned char *>(m_lastSource.data());
+        auto *shaped = reinterpret_cast<unsigned char *>(m_shaped.data());
+        const bool fullChroma = frame.format == PixelFormat::I444;
+        const int chromaWidth = fullChroma ? frame.width : frame.width / 2;
+        const int chromaHeight = fullChroma ? frame.height : frame.height / 2;
+        const int chromaMacroblock = fullChroma ? kMacroblockSize : kMacroblockSize / 2;
+        const qsizetype lumaSize = qsizetype(frame.width) * frame.height;
+        const qsizetype chromaSize = qsizetype(chromaWidth) * chromaHeight;
+        const struct {
+            qsizetype offset;
+            int stride;
+            int macroblock;
+        } planes[3] = {
+            {0, frame.width, kMacroblockSize},
+            {lumaSize, chromaWidth, chromaMacroblock},
+            {lumaSize + chromaSize, chromaWidth, chromaMacroblock},
+        };
+
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                const int index = row * columns + column;
+                const qint8 offset = offsets[index];
+                bool changed = fresh;
+                for (int plane = 0; plane < 3 && !changed; ++plane) {
+                    const auto &info = planes[plane];
+                    const int x = column * info.macroblock;
+                    const int width = qMin(info.macroblock, info.stride - x);
+                    const int planeHeight = plane == 0 ? frame.height : chromaHeight;
+                    for (int y = row * info.macroblock; y < qMin((row + 1) * info.macroblock, planeHeight); ++y) {
+                        const qsizetype at = info.offset + qsizetype(y) * info.stride + x;
+                        if (std::memcmp(source + at, last + at, width) != 0) {
+                            changed = true;
+                            break;
+                        }
+                    }
+                }
+                if (changed) {
+                    m_exact[index] = false;
+                } else if (m_exact[index] || offset == m_appliedOffsets[index]) {
+                    continue;
+                }
+                m_appliedOffsets[index] = offset;
+                for (int plane = 0; plane < 3; ++plane) {
+                    const auto &info = planes[plane];
+                    const int x = column * info.macroblock;
+                    const int y = row * info.macroblock;
+                    const int width = qMin(info.macroblock, info.stride - x);
+                    const int height = qMin(info.macroblock, (plane == 0 ? frame.height : chromaHeight) - y);
+                    for (int line = y; line < y + height; ++line) {
+                        const qsizetype at = info.offset + qsizetype(line) * info.stride + x;
+                        std::memcpy(last + at, source + at, width);
+                        std::memcpy(shaped + at, source + at, width);
+                    }
+                    if (offset > 0) {
+                        flattenDetail(shaped + info.offset, info.stride, x, y, width & ~1, height & ~1,
+                                      qMax(0, 16 - 2 * offset));
+                    }
+                }
+            }
+        }
+        return shaped;
+    }
+
+    // For a refinement, which encodes `frame` unshaped: returns it and keeps
+    // every macroblock as it is in later frames until its pixels change.
+    const unsigned char *keepExact(const VideoFrame &frame) {
+        const int columns = (frame.width + kMacroblockSize - 1) / kMacroblockSize;
+        const int rows = (frame.height + kMacroblockSize - 1) / kMacroblockSize;
+        m_lastSource = frame.data;
+        m_shaped = frame.data;
+        m_appliedOffsets = QVector<qint8>(columns * rows, 0);
+        m_exact = QVector<bool>(columns * rows, true);
+        return reinterpret_cast<const unsigned char *>(frame.data.constData());
+    }
+
+private:
+    QVector<qint8> m_appliedOffsets;
+    // Sent pixel-exact by a refinement and unchanged since.
+    QVector<bool> m_exact;
+    QByteArray m_lastSource;
+    QByteArray m_shaped;
+};
+
+#ifdef HOST_ENABLE_OPENH264
+// Highest QP while refining a static picture; visually lossless for text.
+constexpr int kRefineMaxQp = 12;
+
+class OpenH264Encoder : public VideoEncoder {
+public:
+    ~OpenH264Encoder() override {
+        if (m_encoder) {
+            m_encoder->Uninitialize();
+            WelsDestroySVCEncoder(m_encoder);
+        }
+    }
+
+    bool initialize(const Config &config) override {
+        if (config.format != PixelFormat::I420 || WelsCreateSVCEncoder(&m_encoder) != 0 || !m_encoder) {
+            return false;
+        }
+        m_config = config;
+
+        SEncParamExt &param = m_param;
+        m_encoder->GetDefaultParams(&param);
+        param.iUsageType = SCREEN_CONTENT_REAL_TIME;
+        param.iPicWidth = config.width;
+        param.iPicHeight = config.height;
+        param.iTargetBitrate = config.bitrateKbps * 1000;
+        param.iMaxBitrate = config.bitrateKbps * 1000;
+        param.iRCMode = RC_BITRATE_MODE;
+        param.fMaxFrameRate = static_cast<float>(config.fps);
+        param.iMultipleThreadIdc = static_cast<unsigned short>(config.threads);
+        param.bEnableFrameSkip = true;
+        param.uiIntraPeriod = 0;
+        param.iSpatialLayerNum = 1;
+        param.sSpatialLayers[0].iVideoWidth = config.width;
+        param.sSpatialLayers[0].iVideoHeight = config.height;
+        param.sSpatialLayers[0].fFrameRate = static_cast<float>(config.fps);
+        param.sSpatialLayers[0].iSpatialBitrate = param.iTargetBitrate;
+        param.sSpatialLayers[0].iMaxSpatialBitrate = param.iMaxBitrate;
+        if (config.slices > 1) {
+            param.sSpatialLayers[0].sSliceArgument.uiSliceMode = SM_FIXEDSLCNUM_SLICE;
+            param.sSpatialLayers[0].sSliceArgument.uiSliceNum = static_cast<unsigned int>(config.slices);
+            param.iMultipleThreadIdc = static_cast<unsigned short>(qMax(config.threads, config.slices));
+        }
+        return m_encoder->InitializeExt(&param) == cmResultSuccess;
+    }
+
+    bool encode(const VideoFrame &frame, bool forceKeyFrame, EncodedFrame &out) override {
+        out.data.clear();
+        out.sliceEnds.clear();
+        out.timestampUs = frame.timestampUs;
+        out.keyFrame = false;
+        if (!m_encoder || frame.format != PixelFormat::I420) {
+            return false;
+        }
+        if (forceKeyFrame) {
+            m_encoder->ForceIntraFrame(true);
+        }
+
+        // Refinement wants every detail; the static picture needs no shaping.
+        auto *base =
+            const_cast<unsigned char *>(m_refining ? m_shaper.keepExact(frame) : m_shaper.shape(frame, m_qpOffsets));
+        SSourcePicture picture{};
+        picture.iColorFormat = videoFormatI420;
+        picture.iPicWidth = frame.width;
+        picture.iPicHeight = frame.height;
+        picture.iStride[0] = frame.width;
+        picture.iStride[1] = frame.width / 2;
+        picture.iStride[2] = frame.width / 2;
+        picture.pData[0] = base;
+        picture.pData[1] = base + frame.width * frame.height;
+        picture.pData[2] = picture.pData[1] + (frame.width / 2) * (frame.height / 2);
+        picture.uiTimeStamp = frame.timestampUs / 1000;
+
+        SFrameBSInfo info{};
+        if (m_encoder->EncodeFrame(&picture, &info) != cmResultSuccess) {
+            return false;
+        }
+        if (info.eFrameType == videoFrameTypeSkip) {
+            return true;
+        }
+        out.keyFrame = info.eFrameType == videoFrameTypeIDR;
+        out.data.reserve(info.iFrameSizeInBytes);
+        for (int i = 0; i < info.iLayerNum; ++i) {
+            const SLayerBSInfo &layer = info.sLayerInfo[i];
+            int layerSize = 0;
+            for (int nal = 0; nal < layer.iNalCount; ++nal) {
+                layerSize += layer.pNalLengthInByte[nal];
+                // With fixed slices every VCL NAL unit is one slice; SPS/PPS
+                // ride along with the slice that follows them.
+                if (m_config.slices > 1 && layer.uiLayerType == VIDEO_CODING_LAYER) {
+                    out.sliceEnds.append(out.data.size() + layerSize);
+                }
+            }
+            out.data.append(reinterpret_cast<const char *>(layer.pBsBuf), layerSize);
+        }
+        return true;
+    }
+
+    void setBitrate(int kbps) override {
+        if (!m_encoder) {
+            return;
+        }
+        SBitrateInfo bitrate{};
+        bitrate.iLayer = SPATIAL_LAYER_ALL;
+        bitrate.iBitrate = kbps * 1000;
+        m_encoder->SetOption(ENCODER_OPTION_BITRATE, &bitrate);
+        m_config.bitrateKbps = kbps;
+        m_param.iTargetBitrate = kbps * 1000;
+        m_param.iMaxBitrate = kbps * 1000;
+        m_param.sSpatialLayers[0].iSpatialBitrate = kbps * 1000;
+        m_param.sSpatialLayers[0].iMaxSpatialBitrate = kbps * 1000;
+    }
+
+    void setQpOffsets(const QVector<qint8> &offsets) override { m_qpOffsets = offsets; }
+
+    // No lossless mode in OpenH264: clamp QP low and let the refinement frame
+    // overshoot the bitrate instead of being skipped. Only QP bounds and
+    // bitrates change through the parameter set; most other fields (background
+    // detection among them) make OpenH264 reset and send an IDR.
+    void setRefining(bool refining) override {
+        if (!m_encoder || refining == m_refining) {
+            return;
+        }
+        m_refining = refining;
+        SEncParamExt param = m_param;
+        if (refining) {
+            param.iMinQp = 0;
+            param.iMaxQp = kRefineMaxQp;
+            param.iMaxBitrate = UNSPECIFIED_BIT_RATE;
+            param.sSpatialLayers[0].iMaxSpatialBitrate = UNSPECIFIED_BIT_RATE;
+        }
+        m_encoder->SetOption(ENCODER_OPTION_SVC_ENCODE_PARAM_EXT, &param);
+        bool frameSkip = !refining && m_param.bEnableFrameSkip;
+        m_encoder->SetOption(ENCODER_OPTION_RC_FRAME_SKIP, &frameSkip);
+    }
+
+    QString name() const override { return QStringLiteral("openh264"); }
+
+private:
+    ISVCEncoder *m_encoder = nullptr;
+    Config m_config;
+    // As initialized, with the current bitrate; restored after refinement.
+    SEncParamExt m_param{};
+    bool m_refining = false;
+    QVector<qint8> m_qpOffsets;
+    DetailShaper m_shaper;
+};
+#endif
+
+#ifdef HOST_ENABLE_AOM
+constexpr unsigned int kAomMinQuantizer = 10;
+constexpr unsigned int kAomMaxQuantizer = 56;
+// Cyclic refresh: spreads intra refresh over frames instead of key frames.
+constexpr int kAomCyclicRefresh = 3;
+
+// libaom in realtime mode, tuned for screen content so palette and intra
+// block copy can code text and flat UI cheaply. One temporal unit per frame,
+// no look-ahead, key frames only on request as with H.264. I444 input is
+// coded in the High profile.
+class AomEncoder : public VideoEncoder {
+public:
+    ~AomEncoder() override {
+        if (m_initialized) {
+            aom_codec_destroy(&m_codec);
+        }
+    }
+
+    bool initialize(const Config &config) override {
+        aom_codec_iface_t *iface = aom_codec_av1_cx();
+        if (aom_codec_enc_config_default(iface, &m_settings, AOM_USAGE_REALTIME) != AOM_CODEC_OK) {
+            return false;
+        }
+        m_config = config;
+        m_settings.g_profile = config.format == PixelFormat::I444 ? 1 : 0;
+        m_settings.g_w = static_cast<unsigned int>(config.width);
+        m_settings.g_h = static_cast<unsigned int>(config.height);
+        m_settings.g_timebase.num = 1;
+        m_settings.g_timebase.den = 1000000;
+        m_settings.g_threads = static_cast<unsigned int>(qMax(1, config.threads));
+        m_settings.g_lag_in_frames = 0;
+        m_settings.g_pass = AOM_RC_ONE_PASS;
+        m_settings.rc_end_usage = AOM_CBR;
+        m_settings.rc_target_bitrate = static_cast<unsigned int>(config.bitrateKbps);
+        m_settings.rc_min_quantizer = kAomMinQuantizer;
+        m_settings.rc_max_quantizer = kAomMaxQuantizer;
+        m_settings.rc_undershoot_pct = 50;
+        m_settings.rc_overshoot_pct = 50;
+        m_settings.rc_buf_initial_sz = 600;
+        m_settings.rc_buf_optimal_sz = 600;
+        m_settings.rc_buf_sz = 1000;
+        m_settings.kf_mode = AOM_KF_DISABLED;
+        if (aom_codec_enc_init(&m_codec, iface, &m_settings, 0) != AOM_CODEC_OK) {
+            return false;
+        }
+        m_initialized = true;
+
+        // Realtime speeds run 7 (slowest) to 10; above 1080p only the fastest keeps up.
+        const int speed = config.width * config.height > 1920 * 1080 ? 10 : 9;
+        int tileColumnsLog2 = 0;
+        while (tileColumnsLog2 < 2 && (2 << tileColumnsLog2) <= config.threads) {
+            ++tileColumnsLog2;
+        }
+        return aom_codec_control(&m_codec, AOME_SET_CPUUSED, speed) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_TUNE_CONTENT, AOM_CONTENT_SCREEN) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_ENABLE_PALETTE, 1) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_ENABLE_INTRABC, 1) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_AQ_MODE, kAomCyclicRefresh) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_ROW_MT, 1) == AOM_CODEC_OK &&
+               aom_codec_control(&m_codec, AV1E_SET_TILE_COLUMNS, tileColumnsLog2) == AOM_CODEC_OK;
+    }
+
+    bool encode(const VideoFrame &frame, bool forceKeyFrame, EncodedFrame &out) override {
+        out.data.clear();
+        out.sliceEnds.clear();
+        out.timestampUs = frame.timestampUs;
+        out.keyFrame = false;
+        if (!m_initialized || frame.format != m_config.format) {
+            return false;
+        }
+
+        auto *base =
+            const_cast<unsigned char *>(m_refining ? m_shaper.keepExact(frame) : m_shaper.shape(frame, m_qpOffsets));
+        const aom_img_fmt_t format = frame.format == PixelFormat::I444 ? AOM_IMG_FMT_I444 : AOM_IMG_FMT_I420;
+        aom_image_t image;
+        if (!aom_img_wrap(&image, format, static_cast<unsigned int>(frame.width),
+                          static_cast<unsigned int>(frame.height), 1, base)) {
+            return false;
+        }
+        const auto duration = static_cast<unsigned long>(1000000 / qMax(1, m_config.fps));
+        const aom_enc_frame_flags_t flags = forceKeyFrame ? AOM_EFLAG_FORCE_KF : 0;
+        if (aom_codec_encode(&m_codec, &image, frame.timestampUs, duration, flags) != AOM_CODEC_OK) {
+            return false;
+        }
+        // Nothing out means rate control dropped the frame.
+        aom_codec_iter_t iterator = nullptr;
+        while (const aom_codec_cx_pkt_t *packet = aom_codec_get_cx_data(&m_codec, &iterator)) {
+            if (packet->kind != AOM_CODEC_CX_FRAME_PKT) {
+                continue;
+            }
+            out.data.append(static_cast<const char *>(packet->data.frame.buf),
+                            static_cast<int>(packet->data.frame.sz));
+            out.keyFrame = out.keyFrame || (packet->data.frame.flags & AOM_FRAME_IS_KEY) != 0;
+        }
+        return true;
+    }
+
+    void setBitrate(int kbps) override {
+        m_config.bitrateKbps = kbps;
+        if (!m_initialized) {
+            return;
+        }
+        m_settings.rc_target_bitrate = static_cast<unsigned int>(kbps);
+        aom_codec_enc_config_set(&m_codec, &m_settings);
+    }
+
+    // Older libaom releases reject AOME_SET_ROI_MAP, so this uses the same
+    // emulation as OpenH264 everywhere.
+    void setQpOffsets(const QVector<qint8> &offsets) override { m_qpOffsets = offsets; }
+
+    // Lossless coding needs quantizer 0 and no segment QP deltas.
+    void setRefining(bool refining) override {
+        if (!m_initialized || refining == m_refining) {
+            return;
+        }
+        m_refining = refining;
+        m_settings.rc_min_quantizer = refining ? 0 : kAomMinQuantizer;
+        m_settings.rc_max_quantizer = refining ? 0 : kAomMaxQuantizer;
+        aom_codec_enc_config_set(&m_codec, &m_settings);
+        aom_codec_control(&m_codec, AV1E_SET_AQ_MODE, refining ? 0 : kAomCyclicRefresh);
+        aom_codec_control(&m_codec, AV1E_SET_LOSSLESS, refining ? 1 : 0);
+    }
+
+    QString name() const override { return QStringLiteral("libaom-av1"); }
+
+private:
+    aom_codec_ctx_t m_codec{};
+    aom_codec_enc_cfg_t m_settings{};
+    bool m_initialized = false;
+    bool m_refining = false;
+    Config m_config;
+    QVector<qint8> m_qpOffsets;
+    DetailShaper m_shaper;
+};
+#endif
+}  // namespace
+#endif
+
+std::unique_ptr<VideoEncoder> VideoEncoder::create(Codec codec) {
+    switch (codec) {
+    case Codec::H264:
+#ifdef HOST_ENABLE_OPENH264
+        return std::make_unique<OpenH264Encoder>();
+#else
+        return nullptr;
+#endif
+    case Codec::AV1:
+#ifdef HOST_ENABLE_AOM
+        return std::make_unique<AomEncoder>();
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+bool VideoEncoder::isAvailable(Codec codec) {
+    switch (codec) {
+    case Codec::H264:
+#ifdef HOST_ENABLE_OPENH264
+        return true;
+#else
+        return false;
+#endif
+    case Codec::AV1:
+#ifdef HOST_ENABLE_AOM
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+bool VideoEncoder::supportsFormat(Codec codec, PixelFormat format) {
+    switch (format) {
+    case PixelFormat::I420:
+        return true;
+    case PixelFormat::I444:
+        return codec == Codec::AV1;
+    case PixelFormat::Bgra:
+        return false;
+    }
+    return false;
+}
+
+}  // namespace host
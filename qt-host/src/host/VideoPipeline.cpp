@@ -0,0 +1,315 @@
+#include "host/VideoPipeline.h"
+
+#include "host/ColorConvert.h"
+#include "host/HostStats.h"
+#include "host/Trace.h"
+
+#include <QElapsedTimer>
+
+namespace host {
+
+namespace {
+// Bands end on macroblock rows so each one feeds whole slices.
+constexpr int kMacroblockRows = 16;
+}  // namespace
+
+VideoPipeline::VideoPipeline() = default;
+
+VideoPipeline::~VideoPipeline() = default;
+
+bool VideoPipeline::initialize(const Config &config) {
+    m_config = config;
+    const int threads = config.threads > 0 ? config.threads : WorkerPool::defaultThreadCount();
+    if (!m_pool || m_pool->threadCount() != threads) {
+        m_pool = std::make_unique<WorkerPool>(threads);
+    }
+    m_encoder = VideoEncoder::create(config.codec);
+    if (!m_encoder) {
+        return false;
+    }
+    VideoEncoder::Config encoderConfig;
+    encoderConfig.width = config.width;
+    encoderConfig.height = config.height;
+    encoderConfig.fps = config.fps;
+    encoderConfig.bitrateKbps = config.bitrateKbps;
+    encoderConfig.threads = threads;
+    // Slices cost compression and show as seams in text, so only on request;
+    // the encoder gets the threads either way.
+    encoderConfig.slices = qMax(1, config.slices);
+    encoderConfig.format = config.format;
+    if (!m_encoder->initialize(encoderConfig)) {
+        m_encoder.reset();
+        return false;
+    }
+    RtpPacketizer::Config rtp = config.rtp;
+    rtp.format = config.codec == VideoEncoder::Codec::AV1 ? RtpPacketizer::Format::AV1 : RtpPacketizer::Format::H264;
+    m_packetizer.setConfig(rtp);
+    HostStats::instance().set(HostStats::TargetBitrateKbps, config.bitrateKbps);
+
+    m_picture.format = config.format;
+    m_picture.width = config.width;
+    m_picture.height = config.height;
+    m_picture.stride = config.width;
+    m_picture.data.resize(yuvFrameSize(config.format, config.width, config.height));
+    m_reference.clear();
+    m_moves.clear();
+    m_tileCache.setBudget(config.tileCacheBytes);
+    m_tiles = TileCache::Result{};
+    m_staticSinceUs = -1;
+    m_refining = false;
+    m_decoder.reset();
+    m_decodedFrames = 0;
+    m_quality.reset();
+    if (config.qualitySampleInterval > 0) {
+        m_decoder = VideoDecoder::create(config.codec);
+        if (m_decoder && !m_decoder->initialize()) {
+            m_decoder.reset();
+        }
+    }
+    return true;
+}
+
+QString VideoPipeline::encoderName() const { return m_encoder ? m_encoder->name() : QString(); }
+
+void VideoPipeline::convert(const VideoFrame &frame) {
+    const auto *source = reinterpret_cast<const std::uint8_t *>(frame.data.constData());
+    auto *yuv = reinterpret_cast<std::uint8_t *>(m_picture.data.data());
+    if (frame.format == PixelFormat::I420) {
+        convertI420ToI444(source, frame.width, frame.height, yuv);
+        return;
+    }
+    if (frame.format == PixelFormat::I444) {
+        convertI444ToI420(source, frame.width, frame.height, yuv);
+        return;
+    }
+    const bool fullChroma = m_config.format == PixelFormat::I444;
+    const int bands = qMin(qMax(m_config.slices, m_pool->threadCount()), frame.height / kMacroblockRows);
+    if (bands <= 1) {
+        if (fullChroma) {
+            convertBgraToI444(source, frame.stride, frame.width, frame.height, yuv);
+        } else {
+            convertBgraToI420(source, frame.stride, frame.width, frame.height, yuv);
+        }
+        return;
+    }
+    const int macroblockRows = (frame.height + kMacroblockRows - 1) / kMacroblockRows;
+    const int bandRows = (macroblockRows + bands - 1) / bands * kMacroblockRows;
+    m_pool->parallelFor(bands, [&frame, source, yuv, bandRows, fullChroma](int band) {
+        HOST_TRACE_SCOPE("convert.band");
+        if (fullChroma) {
+            convertBgraToI444Rows(source, frame.stride, frame.width, frame.height, band * bandRows, bandRows, yuv);
+        } else {
+            convertBgraToI420Rows(source, frame.stride, frame.width, frame.height, band * bandRows, bandRows, yuv);
+        }
+    });
+}
+
+void VideoPipeline::detectMoves(const VideoFrame &picture) {
+    m_moves.clear();
+    if (!m_config.detectMoves || picture.dirtyRects.isEmpty() || m_reference.size() != picture.data.size()) {
+        return;
+    }
+    HOST_TRACE_SCOPE("moves");
+    QElapsedTimer timer;
+    timer.start();
+    m_moveDetector.detect(reinterpret_cast<const std::uint8_t *>(m_reference.constData()),
+                          reinterpret_cast<const std::uint8_t *>(picture.data.constData()), picture.width,
+                          picture.height, picture.dirtyRects, m_moves);
+    HostStats &stats = HostStats::instance();
+    stats.record(HostStats::MoveDetectTime, timer.nsecsElapsed() / 1000);
+    stats.add(HostStats::MovesDetected, static_cast<quint64>(m_moves.size()));
+}
+
+void VideoPipeline::retainReference(const VideoFrame &picture) {
+    if (!m_config.detectMoves) {
+        return;
+    }
+    if (&picture != &m_picture) {
+        // Implicitly shared; no copy as long as the caller does not write to it.
+        m_reference = picture.data;
+        return;
+    }
+    // Double-buffer the converted picture instead of detaching it next frame.
+    m_reference.swap(m_picture.data);
+    if (m_picture.data.size() != m_reference.size()) {
+        m_picture.data.resize(m_reference.size());
+    }
+}
+
+bool VideoPipeline::lookupTiles(const VideoFrame &picture, bool forceKeyFrame) {
+    if (!m_tileCache.isEnabled()) {
+        m_tiles = TileCache::Result{};
+        return false;
+    }
+    HOST_TRACE_SCOPE("tiles");
+    m_tileCache.lookup(picture, m_tiles);
+    HostStats &stats = HostStats::instance();
+    stats.add(HostStats::TileCacheLookups, static_cast<quint64>(m_tiles.lookups));
+    stats.add(HostStats::TileCacheHits, static_cast<quint64>(m_tiles.hits));
+    if (m_tiles.cached && !forceKeyFrame) {
+        commitTiles(TileCache::Outcome::Drawn);
+        stats.add(HostStats::FramesFromTileCache);
+        return true;
+    }
+    m_tiles.cached = false;
+    m_tiles.draws.clear();
+    return false;
+}
+
+// Returns true when this frame starts a refinement. It stays an inter frame:
+// only what earlier frames got wrong is coded, not the whole desktop again.
+bool VideoPipeline::updateRefinement(const VideoFrame &picture) {
+    if (m_config.refineAfterMs <= 0) {
+        return false;
+    }
+    if (m_staticSinceUs < 0 || !picture.dirtyRects.isEmpty()) {
+        m_staticSinceUs = picture.timestampUs;
+        if (m_refining) {
+            m_refining = false;
+            m_encoder->setRefining(false);
+        }
+        return false;
+    }
+    if (m_refining || picture.timestampUs - m_staticSinceUs < qint64(m_config.refineAfterMs) * 1000) {
+        return false;
+    }
+    m_refining = true;
+    m_encoder->setRefining(true);
+    return true;
+}
+
+void VideoPipeline::sampleQuality(const VideoFrame &source) {
+    HOST_TRACE_SCOPE("quality");
+    QElapsedTimer timer;
+    timer.start();
+    if (!m_decoder->decode(m_encoded, m_decoded)) {
+        // Out of step with the encoder; no point in comparing anything after this.
+        m_decoder.reset();
+        return;
+    }
+    if (!m_decoded.data.isEmpty() && m_decodedFrames++ % m_config.qualitySampleInterval == 0) {
+        QualityScore score;
+        if (measureQuality(source, m_decoded, score)) {
+            m_quality = score;
+            HostStats &stats = HostStats::instance();
+            stats.set(HostStats::VideoPsnr, qRound64(score.psnr * 100));
+            stats.set(HostStats::VideoSsim, qRound64(score.ssim * 10000));
+        }
+    }
+    m_timing.qualityUs = timer.nsecsElapsed() / 1000;
+}
+
+void VideoPipeline::commitTiles(TileCache::Outcome outcome) {
+    if (m_tileCache.isEnabled()) {
+        m_tileCache.commit(outcome);
+    }
+}
+
+bool VideoPipeline::process(const VideoFrame &frame, QList<QByteArray> &packets, bool forceKeyFrame,
+                            const SliceSink &onSlice) {
+    m_timing = Timing{};
+    m_quality.reset();
+    if (!m_encoder || frame.width != m_config.width || frame.height != m_config.height) {
+        return false;
+    }
+
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    timer.start();
+    const VideoFrame *input = &frame;
+    if (frame.format != m_config.format) {
+        HOST_TRACE_SCOPE("convert");
+        convert(frame);
+        m_picture.timestampUs = frame.timestampUs;
+        m_picture.dirtyRects = frame.dirtyRects;
+        input = &m_picture;
+    }
+    m_timing.convertUs = timer.nsecsElapsed() / 1000;
+    detectMoves(*input);
+    const bool refine = updateRefinement(*input);
+    if (lookupTiles(*input, forceKeyFrame || refine)) {
+        // The viewer rebuilds this picture from its tile slots.
+        m_moves.clear();
+        retainReference(*input);
+        m_timing.fromTileCache = true;
+        return true;
+    }
+
+    timer.restart();
+    {
+        HOST_TRACE_SCOPE("encode");
+        if (!m_encoder->encode(*input, forceKeyFrame, m_encoded)) {
+            commitTiles(TileCache::Outcome::Dropped);
+            return false;
+        }
+    }
+    // Held before retainReference() may hand the converted buffer on.
+    const VideoFrame source = m_decoder ? *input : VideoFrame{};
+    retainReference(*input);
+    commitTiles(m_encoded.data.isEmpty() ? TileCache::Outcome::Dropped : TileCache::Outcome::Encoded);
+    m_timing.encodeUs = timer.nsecsElapsed() / 1000;
+    m_timing.encodedBytes = m_encoded.data.size();
+    m_timing.keyFrame = m_encoded.keyFrame;
+    m_timing.refined = refine && !m_encoded.data.isEmpty();
+
+    HostStats &stats = HostStats::instance();
+    stats.record(HostStats::EncodeTime, m_timing.encodeUs);
+    if (m_encoded.data.isEmpty()) {
+        stats.add(HostStats::FramesDropped);
+        return true;
+    }
+    stats.add(HostStats::FramesEncoded);
+    stats.add(HostStats::EncodedBytes, static_cast<quint64>(m_timing.encodedBytes));
+    if (m_timing.refined) {
+        stats.add(HostStats::FramesRefined);
+    }
+
+    const int before = packets.size();
+    const int sliceCount = qMax(1, static_cast<int>(m_encoded.sliceEnds.size()));
+    int begin = 0;
+    for (int slice = 0; slice < sliceCount; ++slice) {
+        const bool lastSlice = slice == sliceCount - 1;
+        const int end = lastSlice ? static_cast<int>(m_encoded.data.size()) : m_encoded.sliceEnds.at(slice);
+        const int first = packets.size();
+        timer.restart();
+        {
+            HOST_TRACE_SCOPE("packetize");
+            m_packetizer.packetize(m_encoded, begin, end, lastSlice, packets);
+        }
+        m_timing.packetizeUs += timer.nsecsElapsed() / 1000;
+        if (onSlice && packets.size() > first) {
+            onSlice(packets, first);
+        }
+        if (slice == 0) {
+            m_timing.firstSliceUs = total.nsecsElapsed() / 1000;
+        }
+        begin = end;
+    }
+    m_timing.packetCount = packets.size() - before;
+    if (m_decoder) {
+        sampleQuality(source);
+    }
+    return true;
+}
+
+void VideoPipeline::setTileCacheBytes(qint64 bytes) {
+    m_config.tileCacheBytes = bytes;
+    m_tileCache.setBudget(bytes);
+}
+
+void VideoPipeline::setQpOffsets(const QVector<qint8> &offsets) {
+    if (m_encoder) {
+        m_encoder->setQpOffsets(offsets);
+    }
+}
+
+void VideoPipeline::setBitrate(int kbps) {
+    m_config.bitrateKbps = kbps;
+    HostStats::instance().set(HostStats::TargetBitrateKbps, kbps);
+    if (m_encoder) {
+        m_encoder->setBitrate(kbps);
+    }
+}
+
+}  // namespace host
@@ -0,0 +1,181 @@
+#include "host/VideoSender.h"
+
+#include "host/HostStats.h"
+#include "host/RtcpFeedback.h"
+#include "host/VideoSource.h"
+
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+
+namespace host {
+
+namespace {
+constexpr int kRtpHeaderSize = RtpPacketizer::kHeaderSize;
+// Floor for the per-packet retransmit interval when the RTT is tiny.
+constexpr qint64 kMinRetransmitIntervalUs = 5000;
+
+quint16 sequenceOf(const QByteArray &packet) {
+    return qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(packet.constData()) + 2);
+}
+}  // namespace
+
+VideoSender::VideoSender() = default;
+
+VideoSender::~VideoSender() = default;
+
+bool VideoSender::initialize(const Config &config, SendFunction send) {
+    m_config = config;
+    m_send = std::move(send);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_history = RtpPacketHistory(config.historyPackets);
+        // Random initial sequence number, as RFC 3550 recommends.
+        m_sequence = static_cast<quint16>(QRandomGenerator::global()->generate());
+    }
+    m_keyFrameRequested.store(true, std::memory_order_relaxed);
+    if (config.pipeline.width <= 0 || config.pipeline.height <= 0) {
+        // Sized by the first frame.
+        return true;
+    }
+    return m_pipeline.initialize(config.pipeline);
+}
+
+void VideoSender::setBitrate(int kbps) {
+    m_config.pipeline.bitrateKbps = kbps;
+    m_pipeline.setBitrate(kbps);
+}
+
+void VideoSender::setTileCacheBytes(qint64 bytes) {
+    m_config.pipeline.tileCacheBytes = bytes;
+    m_pipeline.setTileCacheBytes(bytes);
+}
+
+bool VideoSender::sendFrame(const VideoFrame &frame) {
+    if (!m_send) {
+        return false;
+    }
+    if (!m_pipeline.isInitialized() || frame.width != m_config.pipeline.width ||
+        frame.height != m_config.pipeline.height) {
+        m_config.pipeline.width = frame.width;
+        m_config.pipeline.height = frame.height;
+        if (!m_pipeline.initialize(m_config.pipeline)) {
+            return false;
+        }
+        m_keyFrameRequested.store(true, std::memory_order_relaxed);
+    }
+
+    const bool useRed = fecEnabled();
+    QList<QByteArray> media;
+    // Slices go out as soon as they are packetized; FEC follows once the whole
+    // frame is known.
+    const auto sendSlice = [this, useRed](QList<QByteArray> &packets, int first) {
+        const PacketKind kind = m_pipeline.lastTiming().refined ? PacketKind::Refinement : PacketKind::Media;
+        QMutexLocker locker(&m_mutex);
+        const qint64 nowUs = captureClockUs();
+        for (int i = first; i < packets.size(); ++i) {
+            // The packetizer numbers packets per frame; FEC shares the sequence
+            // space, so the wire numbers are assigned here.
+            QByteArray &packet = packets[i];
+            qToBigEndian<quint16>(m_sequence++, reinterpret_cast<uchar *>(packet.data()) + 2);
+            const QByteArray wire = useRed ? wrapRed(packet) : packet;
+            m_history.insert(sequenceOf(wire), wire, nowUs);
+            m_send(wire, kind);
+        }
+    };
+    const bool keyFrame = m_keyFrameRequested.exchange(false, std::memory_order_relaxed);
+    if (!m_pipeline.process(frame, media, keyFrame, sendSlice)) {
+        return false;
+    }
+    if (media.isEmpty()) {
+        return true;
+    }
+
+    // FEC protects the packets as the receiver rebuilds them, i.e. without RED.
+    QList<QByteArray> fecPayloads;
+    if (useRed) {
+        m_fec.setProtectionRate(
+            UlpFecEncoder::rateForLoss(m_fractionLost.load(std::memory_order_relaxed) / 256.0));
+        m_fec.encode(media, fecPayloads);
+    }
+    const PacketKind kind = m_pipeline.lastTiming().refined ? PacketKind::Refinement : PacketKind::Media;
+    QMutexLocker locker(&m_mutex);
+    const quint32 timestamp = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(media.last().constData()) + 4);
+    for (const QByteArray &payload : fecPayloads) {
+        m_send(makeFecPacket(payload, timestamp), kind);
+    }
+
+    HostStats &stats = HostStats::instance();
+    stats.add(HostStats::PacketsSent, static_cast<quint64>(media.size() + fecPayloads.size()));
+    stats.add(HostStats::FecPacketsSent, static_cast<quint64>(fecPayloads.size()));
+    return true;
+}
+
+void VideoSender::dropUnsent(int packets) {
+    if (packets <= 0) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sequence = static_cast<quint16>(m_sequence - packets);
+    }
+    requestKeyFrame();
+}
+
+void VideoSender::handleRtcp(const QByteArray &packet) {
+    RtcpFeedback feedback;
+    parseRtcpFeedback(packet, m_config.pipeline.rtp.ssrc, feedback);
+    if (feedback.keyFrameRequested) {
+        requestKeyFrame();
+    }
+    if (feedback.hasReportBlock) {
+        m_fractionLost.store(feedback.fractionLost, std::memory_order_relaxed);
+        HostStats::instance().set(HostStats::PacketLoss, feedback.fractionLost);
+    }
+    if (feedback.nackedSequences.isEmpty()) {
+        return;
+    }
+
+    const qint64 minIntervalUs = qMax<qint64>(kMinRetransmitIntervalUs, m_rttMs.load(std::memory_order_relaxed) * 1000);
+    quint64 resent = 0;
+    QMutexLocker locker(&m_mutex);
+    const qint64 nowUs = captureClockUs();
+    for (const quint16 sequence : feedback.nackedSequences) {
+        const QByteArray stored = m_history.takeForRetransmit(sequence, nowUs, minIntervalUs);
+        if (!stored.isEmpty()) {
+            m_send(stored, PacketKind::Retransmission);
+            ++resent;
+        }
+    }
+    HostStats::instance().add(HostStats::PacketsRetransmitted, resent);
+}
+
+// RFC 2198 with only a primary block: RTP header with the RED payload type,
+// one byte naming the media payload type, then the media payload.
+QByteArray VideoSender::wrapRed(const QByteArray &media) const {
+    QByteArray red(media.size() + 1, Qt::Uninitialized);
+    memcpy(red.data(), media.constData(), kRtpHeaderSize);
+    auto *header = reinterpret_cast<uchar *>(red.data());
+    header[1] = static_cast<uchar>((header[1] & 0x80) | (m_config.redPayloadType & 0x7f));
+    red[kRtpHeaderSize] = static_cast<char>(media.at(1) & 0x7f);
+    memcpy(red.data() + kRtpHeaderSize + 1, media.constData() + kRtpHeaderSize,
+           static_cast<size_t>(media.size() - kRtpHeaderSize));
+    return red;
+}
+
+QByteArray VideoSender::makeFecPacket(const QByteArray &fecPayload, quint32 timestamp) {
+    QByteArray packet(kRtpHeaderSize + 1 + fecPayload.size(), Qt::Uninitialized);
+    auto *header = reinterpret_cast<uchar *>(packet.data());
+    header[0] = 0x80;
+    header[1] = static_cast<uchar>(m_config.redPayloadType & 0x7f);
+    qToBigEndian<quint16>(m_sequence++, header + 2);
+    qToBigEndian<quint32>(timestamp, header + 4);
+    qToBigEndian<quint32>(m_config.pipeline.rtp.ssrc, header + 8);
+    header[kRtpHeaderSize] = static_cast<uchar>(m_config.ulpfecPayloadType & 0x7f);
+    memcpy(packet.data() + kRtpHeaderSize + 1, fecPayload.constData(), static_cast<size_t>(fecPayload.size()));
+    m_history.insert(sequenceOf(packet), packet, captureClockUs());
+    return packet;
+}
+
+}  // namespace host
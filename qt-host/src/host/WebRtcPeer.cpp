@@ -1,15 +1,29 @@
 #include "host/WebRtcPeer.h"
 
 #include "common/Protocol.h"
+#include "host/AudioSender.h"
 #include "host/CaptureAudio.h"
 #include "host/CaptureVideo.h"
+#include "host/ColorConvert.h"
+#include "host/FileTransfer.h"
+#include "host/HostStats.h"
 #include "host/InputInjector.h"
+#include "host/PacedSender.h"
+#include "host/SessionRecorder.h"
+#include "host/SessionReplaySource.h"
 #include "host/SignalingClient.h"
+#include "host/Trace.h"
+#include "host/VideoSender.h"
 
 #include <QByteArray>
+#include <QGuiApplication>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLatin1String>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QScreen>
 #include <cstdint>
 #include <optional>
 #include <string>
@@ -21,8 +35,32 @@
 
 namespace host {
 
+namespace {
+// Sender-side back-off: shed rate while the pacer queue grows or the viewer
+// reports loss, creep back up once both are clear.
+constexpr int kMinBitrateKbps = 300;
+constexpr qint64 kQueueBackoffMs = 150;
+constexpr qint64 kQueueClearMs = 30;
+constexpr int kLossBackoff = 26;  // 10% in RTCP's 1/256 units
+constexpr int kLossClear = 5;     // 2%
+constexpr qint64 kBytesPerMb = 1024 * 1024;
+}  // namespace
+
 #ifdef HOST_ENABLE_RTC
 namespace {
+// Same clock as the RTP timestamps, so the viewer can match a hint to its frame.
+qint64 rtpTimestampOf(qint64 timestampUs) {
+    return static_cast<quint32>(timestampUs * RtpPacketizer::kClockRate / 1000000);
+}
+
+QJsonArray tileRefsToJson(const QVector<TileCache::TileRef> &tiles) {
+    QJsonArray array;
+    for (const TileCache::TileRef &tile : tiles) {
+        array.append(QJsonArray{tile.slot, tile.position.x(), tile.position.y()});
+    }
+    return array;
+}
+
 QString descriptionTypeToString(rtc::Description::Type type) {
     if (type == rtc::Description::Type::Offer) {
         return QString::fromUtf8(protocol::json::kOffer);
@@ -32,18 +70,116 @@ QString descriptionTypeToString(rtc::Description::Type type) {
     }
     return QStringLiteral("unknown");
 }
+
+struct VideoCodecChoice {
+    int h264 = -1;
+    std::string h264Fmtp;
+    int av1 = -1;
+    std::string av1Fmtp;
+    // High profile (profile=1): 4:4:4.
+    int av1High = -1;
+    std::string av1HighFmtp;
+    int red = -1;
+    int ulpfec = -1;
+};
+
+bool hasFmtp(const rtc::Description::Media::RtpMap &map, const std::string &parameter) {
+    for (const std::string &fmtp : map.fmtps) {
+        if (fmtp.find(parameter) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// OpenH264 produces constrained baseline in packetization mode 1; prefer the
+// offer's exact match and settle for any mode 1 H.264 otherwise. libaom
+// produces AV1 main profile (profile=0, the default when absent) for 4:2:0
+// and high profile (profile=1) for 4:4:4.
+VideoCodecChoice chooseVideoCodecs(const rtc::Description::Media &media) {
+    VideoCodecChoice choice;
+    bool exactProfile = false;
+    for (const int payloadType : media.payloadTypes()) {
+        const auto *map = media.rtpMap(payloadType);
+        if (!map) {
+            continue;
+        }
+        const QString format = QString::fromStdString(map->format).toLower();
+        if (format == QStringLiteral("h264") && hasFmtp(*map, "packetization-mode=1") && !exactProfile) {
+            exactProfile = hasFmtp(*map, "profile-level-id=42e01f");
+            choice.h264 = payloadType;
+            choice.h264Fmtp = map->fmtps.empty() ? std::string() : map->fmtps.front();
+        } else if (format == QStringLiteral("av1") && choice.av1High < 0 && hasFmtp(*map, "profile=1")) {
+            choice.av1High = payloadType;
+            choice.av1HighFmtp = map->fmtps.front();
+        } else if (format == QStringLiteral("av1") && choice.av1 < 0 && !hasFmtp(*map, "profile=1") &&
+                   !hasFmtp(*map, "profile=2")) {
+            choice.av1 = payloadType;
+            choice.av1Fmtp = map->fmtps.empty() ? std::string() : map->fmtps.front();
+        } else if (format == QStringLiteral("red") && choice.red < 0) {
+            choice.red = payloadType;
+        } else if (format == QStringLiteral("ulpfec") && choice.ulpfec < 0) {
+            choice.ulpfec = payloadType;
+        }
+    }
+    return choice;
+}
+
+struct AudioCodecChoice {
+    int opus = -1;
+    bool inbandFec = false;
+    // The viewer's a=maxptime, 0 when absent.
+    int maxPtime = 0;
+};
+
+AudioCodecChoice chooseAudioCodec(const rtc::Description::Media &media) {
+    AudioCodecChoice choice;
+    for (const int payloadType : media.payloadTypes()) {
+        const auto *map = media.rtpMap(payloadType);
+        if (map && QString::fromStdString(map->format).toLower() == QStringLiteral("opus")) {
+            choice.opus = payloadType;
+            choice.inbandFec = hasFmtp(*map, "useinbandfec=1");
+            break;
+        }
+    }
+    const std::string maxPtime = "maxptime:";
+    for (const std::string &attribute : media.attributes()) {
+        if (attribute.compare(0, maxPtime.size(), maxPtime) == 0) {
+            choice.maxPtime = QString::fromStdString(attribute.substr(maxPtime.size())).toInt();
+        }
+    }
+    return choice;
+}
 }  // namespace
 #endif
 
 WebRtcPeer::WebRtcPeer(SignalingClient *signaling, QObject *parent)
     : QObject(parent), m_signaling(signaling), m_videoCapture(std::make_unique<CaptureVideo>(this)),
-      m_audioCapture(std::make_unique<CaptureAudio>(this)), m_inputInjector(std::make_unique<InputInjector>(this)) {
-    connect(m_videoCapture.get(), &CaptureVideo::errorOccurred, this, [this](const QString &message) {
+      m_audioCapture(std::make_unique<CaptureAudio>(this)), m_inputInjector(std::make_unique<InputInjector>(this)),
+      m_fileTransfer(std::make_unique<FileTransfer>(this)) {
+    connect(m_videoCapture.get(), &VideoSource::errorOccurred, this, [this](const QString &message) {
         emit logLine(tr("Video capture error: %1").arg(message));
     });
     connect(m_audioCapture.get(), &CaptureAudio::errorOccurred, this, [this](const QString &message) {
         emit logLine(tr("Audio capture error: %1").arg(message));
     });
+    connect(m_audioCapture.get(), &CaptureAudio::audioFrameCaptured, this,
+            [this](const QByteArray &pcmData, int sampleRate, int channels, qint64) {
+                if (!m_audioSender || m_audioSendFailed) {
+                    return;
+                }
+                if (sampleRate != AudioEncoder::kSampleRate || channels != 2 || !m_audioSender->sendPcm(pcmData)) {
+                    m_audioSendFailed = true;
+                    emit logLine(tr("Audio encoding failed (%1 Hz, %2 channels); audio stopped.")
+                                     .arg(sampleRate)
+                                     .arg(channels));
+                }
+            });
+    connect(m_fileTransfer.get(), &FileTransfer::logLine, this, &WebRtcPeer::logLine);
+    m_statsTimer.setInterval(1000);
+    connect(&m_statsTimer, &QTimer::timeout, this, &WebRtcPeer::pollTransportStats);
+    m_refineTimer.setSingleShot(true);
+    connect(&m_refineTimer, &QTimer::timeout, this, &WebRtcPeer::refineStaticPicture);
 }
 
 WebRtcPeer::~WebRtcPeer() { stop(); }
@@ -61,10 +197,44 @@ void WebRtcPeer::setAllowControl(bool enabled) {
 
 void WebRtcPeer::start() {
 #ifdef HOST_ENABLE_RTC
+    setupReplay();
+    setupRecording();
+    chooseProfile();
+    FileTransfer::Config fileConfig;
+    fileConfig.directory = m_options.fileDirectory;
+    m_fileTransfer->setConfig(fileConfig);
     createPeer();
+    m_statsTimer.start();
     if (m_videoCapture) {
+        connect(m_videoCapture.get(), &VideoSource::frameCaptured, this,
+                []() { HostStats::instance().add(HostStats::FramesCaptured); });
+        connect(m_videoCapture.get(), &VideoSource::frameCaptured, this, &WebRtcPeer::sendCapturedFrame);
         m_videoCapture->setScreenIndex(m_options.screenIndex);
-        m_videoCapture->setFrameRate(m_options.fps);
+        m_videoCapture->setFrameRate(m_profile.fps);
+        m_captureRegion.setScreenIndex(m_options.screenIndex);
+        if (m_options.captureWindow != 0) {
+            m_captureRegion.setWindow(m_options.captureWindow);
+        } else {
+            m_captureRegion.setRect(m_options.captureRect);
+        }
+        m_activeRegion = QRect();
+        m_windowLostLogged = false;
+        CaptureGovernor::Config governor;
+        governor.activeFps = m_profile.fps;
+        governor.idleFps = m_options.idleFps;
+        m_captureGovernor.setConfig(governor);
+        m_roiMap.setStrength(m_options.roiStrength);
+        // Input wakes the governor on libdatachannel threads; the source lives here.
+        m_captureGovernor.setRateCallback([this](int fps) {
+            QMetaObject::invokeMethod(
+                this,
+                [this, fps]() {
+                    if (m_videoCapture) {
+                        m_videoCapture->setFrameRate(fps);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
         if (!m_videoCapture->start()) {
             emit logLine(tr("Video capture did not start."));
         }
@@ -75,6 +245,7 @@ void WebRtcPeer::start() {
         }
     }
     if (m_inputInjector) {
+        m_inputInjector->setScreenIndex(m_options.screenIndex);
         m_inputInjector->setEnabled(m_options.allowControl);
     }
 #else
@@ -84,8 +255,49 @@ void WebRtcPeer::start() {
 #endif
 }
 
+void WebRtcPeer::chooseProfile() {
+    m_profile = CapabilityProbe::Profile{};
+    m_profile.codec = m_options.codec.value_or(VideoEncoder::Codec::H264);
+    if (m_options.fps > 0) {
+        m_profile.fps = m_options.fps;
+    }
+    const std::optional<CapabilityProbe::Results> results = CapabilityProbe::instance().results();
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    QScreen *screen = m_options.screenIndex >= 0 && m_options.screenIndex < screens.size()
+                          ? screens.at(m_options.screenIndex)
+                          : QGuiApplication::primaryScreen();
+    // A shared window can grow to the whole screen.
+    QSize frameSize = m_options.captureRect.size();
+    if ((m_options.captureWindow != 0 || frameSize.isEmpty()) && screen) {
+        frameSize = physicalScreenGeometry(screen).size();
+    }
+    if (!results || frameSize.isEmpty()) {
+        emit logLine(tr("Capability probe not finished; streaming at full size, %1 fps.").arg(m_profile.fps));
+        return;
+    }
+    QVector<VideoEncoder::Codec> codecs;
+    if (m_options.codec) {
+        codecs.append(*m_options.codec);
+    } else {
+        codecs = {VideoEncoder::Codec::AV1, VideoEncoder::Codec::H264};
+    }
+    m_profile = CapabilityProbe::chooseProfile(*results, frameSize, codecs, m_options.fps);
+    emit logLine(tr("Profile for %1x%2 on %3: %4 at %5%, %6 fps, %7 threads (%8 ms per frame).")
+                     .arg(frameSize.width())
+                     .arg(frameSize.height())
+                     .arg(results->cpuModel)
+                     .arg(m_profile.codec == VideoEncoder::Codec::AV1 ? QStringLiteral("AV1") : QStringLiteral("H.264"))
+                     .arg(m_profile.scalePercent)
+                     .arg(m_profile.fps)
+                     .arg(m_profile.threads)
+                     .arg(m_profile.frameMs, 0, 'f', 1));
+}
+
 void WebRtcPeer::stop() {
 #ifdef HOST_ENABLE_RTC
+    m_statsTimer.stop();
+    m_refineTimer.stop();
+    m_lastFrame = VideoFrame{};
     if (m_videoCapture) {
         m_videoCapture->stop();
     }
@@ -93,9 +305,304 @@ void WebRtcPeer::stop() {
         m_audioCapture->stop();
     }
     destroyPeer();
+    if (m_inputInjector) {
+        m_inputInjector->releaseHeldInput();
+    }
+    if (m_recorder) {
+        m_recorder->close();
+        emit logLine(tr("Session recording closed (%1 bytes).").arg(m_recorder->bytesWritten()));
+        m_recorder.reset();
+    }
+#endif
+}
+
+void WebRtcPeer::sendCapturedFrame(const QByteArray &pixels, PixelFormat format, int width, int height,
+                                   qint64 timestampUs, const QVector<QRect> &dirtyRects) {
+    if (!m_videoSender) {
+        return;
+    }
+    VideoFrame frame;
+    frame.format = format;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = width;
+    frame.timestampUs = timestampUs;
+    frame.data = pixels;
+    frame.dirtyRects = dirtyRects;
+    if (!m_captureRegion.isWholeScreen() && !cropToCaptureRegion(frame)) {
+        return;
+    }
+    if (m_profile.scalePercent < 100) {
+        scaleToProfile(frame);
+    }
+    m_captureGovernor.noteFrame(captureClockUs(), !frame.dirtyRects.isEmpty());
+    if (m_roiMap.isEnabled()) {
+        m_roiMap.build(frame.width, frame.height, frame.dirtyRects, captureClockUs(), m_qpOffsets);
+        m_videoSender->setQpOffsets(m_qpOffsets);
+    }
+    const qint64 viewerTileBytes = m_viewerTileCacheBytes.load(std::memory_order_relaxed);
+    m_videoSender->setTileCacheBytes(qMin(viewerTileBytes, m_options.tileCacheMb * kBytesPerMb));
+    if (!frame.dirtyRects.isEmpty() && m_pacer) {
+        // A refinement still waiting in the pacer must not hold this change back.
+        m_videoSender->dropUnsent(m_pacer->dropReplaceable());
+    }
+    if (!m_videoSender->sendFrame(frame)) {
+        if (!m_videoSendFailed) {
+            m_videoSendFailed = true;
+            emit logLine(tr("Video encoding failed for %1x%2 frames; is OpenH264 available?").arg(width).arg(height));
+        }
+        return;
+    }
+    // Moves are only known once the frame went through the pipeline, so the
+    // hints follow its packets; the viewer pairs them by RTP timestamp.
+    if (m_viewerCopyRect.load(std::memory_order_relaxed) && !m_videoSender->lastMoves().isEmpty()) {
+        sendCopyRects(timestampUs);
+    }
+    if (m_videoSender->lastTiles().hasMessage()) {
+        sendTiles(timestampUs);
+    }
+    if (m_options.refineAfterMs > 0) {
+        m_lastFrame = frame;
+        if (!frame.dirtyRects.isEmpty() || !m_refineTimer.isActive()) {
+            m_refineTimer.start(m_options.refineAfterMs);
+        }
+    }
+}
+
+void WebRtcPeer::refineStaticPicture() {
+    if (!m_videoSender || m_lastFrame.data.isEmpty()) {
+        return;
+    }
+    // Unchanged, and refineAfterMs after the last change: the pipeline
+    // answers with a lossless refinement.
+    m_lastFrame.dirtyRects.clear();
+    m_lastFrame.timestampUs += qint64(m_options.refineAfterMs) * 1000;
+    m_videoSender->sendFrame(m_lastFrame);
+}
+
+bool WebRtcPeer::cropToCaptureRegion(VideoFrame &frame) {
+    const QRect region = m_captureRegion.update();
+    if (m_captureRegion.windowLost() && !m_windowLostLogged) {
+        m_windowLostLogged = true;
+        emit logLine(tr("The shared window was closed; video is paused."));
+    }
+    if (region.isEmpty()) {
+        // Minimized or gone: the viewer keeps the last picture.
+        return false;
+    }
+    const bool moved = region != m_activeRegion;
+    if (moved) {
+        m_activeRegion = region;
+        if (m_videoCapture) {
+            m_videoCapture->setCaptureRegion(region);
+        }
+        if (m_inputInjector) {
+            m_inputInjector->setCaptureRegion(region);
+        }
+    }
+    if (frame.width == region.width() && frame.height == region.height()) {
+        // The source already captured just the region.
+        return true;
+    }
+    const QRect frameRect(0, 0, frame.width, frame.height);
+    if (!frameRect.contains(region)) {
+        return false;
+    }
+    QByteArray cropped(yuvFrameSize(frame.format, region.width(), region.height()), Qt::Uninitialized);
+    const auto *source = reinterpret_cast<const std::uint8_t *>(frame.data.constData());
+    auto *target = reinterpret_cast<std::uint8_t *>(cropped.data());
+    if (frame.format == PixelFormat::I444) {
+        cropI444(source, frame.width, frame.height, region.x(), region.y(), region.width(), region.height(), target);
+    } else {
+        cropI420(source, frame.width, frame.height, region.x(), region.y(), region.width(), region.height(), target);
+    }
+    QVector<QRect> dirty;
+    if (moved) {
+        dirty.append(QRect(QPoint(0, 0), region.size()));
+    } else {
+        for (const QRect &rect : frame.dirtyRects) {
+            const QRect local = rect.intersected(region).translated(-region.topLeft());
+            if (!local.isEmpty()) {
+                dirty.append(local);
+            }
+        }
+    }
+    frame.data = cropped;
+    frame.width = region.width();
+    frame.height = region.height();
+    frame.stride = region.width();
+    frame.dirtyRects = dirty;
+    return true;
+}
+
+void WebRtcPeer::scaleToProfile(VideoFrame &frame) {
+    const int width = qMax(2, frame.width * m_profile.scalePercent / 100) & ~1;
+    const int height = qMax(2, frame.height * m_profile.scalePercent / 100) & ~1;
+    QByteArray scaled(yuvFrameSize(frame.format, width, height), Qt::Uninitialized);
+    const auto *source = reinterpret_cast<const std::uint8_t *>(frame.data.constData());
+    auto *target = reinterpret_cast<std::uint8_t *>(scaled.data());
+    if (frame.format == PixelFormat::I444) {
+        scaleI444(source, frame.width, frame.height, width, height, target);
+    } else {
+        scaleI420(source, frame.width, frame.height, width, height, target);
+    }
+    // Filtering reaches one source pixel past each edge, so round outwards by one.
+    const QRect bounds(0, 0, width, height);
+    QVector<QRect> dirty;
+    for (const QRect &rect : frame.dirtyRects) {
+        const QPoint topLeft(rect.left() * width / frame.width - 1, rect.top() * height / frame.height - 1);
+        const QPoint bottomRight(((rect.right() + 1) * width + frame.width - 1) / frame.width,
+                                 ((rect.bottom() + 1) * height + frame.height - 1) / frame.height);
+        const QRect mapped = QRect(topLeft, bottomRight).intersected(bounds);
+        if (!mapped.isEmpty()) {
+            dirty.append(mapped);
+        }
+    }
+    frame.data = scaled;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = width;
+    frame.dirtyRects = dirty;
+}
+
+void WebRtcPeer::sendCopyRects(qint64 timestampUs) {
+#ifdef HOST_ENABLE_RTC
+    const auto channel = m_inputChannel;
+    if (!channel || !channel->isOpen()) {
+        return;
+    }
+    QJsonArray rects;
+    for (const MoveRect &move : m_videoSender->lastMoves()) {
+        rects.append(QJsonArray{move.rect.x(), move.rect.y(), move.rect.width(), move.rect.height(), move.offset.x(),
+                                move.offset.y()});
+    }
+    QJsonObject message;
+    message.insert(QStringLiteral("t"), QLatin1String(protocol::json::kCopyRect));
+    message.insert(QLatin1String(protocol::json::kRtpTimestamp), rtpTimestampOf(timestampUs));
+    message.insert(QLatin1String(protocol::json::kRects), rects);
+    channel->send(QJsonDocument(message).toJson(QJsonDocument::Compact).toStdString());
+#else
+    Q_UNUSED(timestampUs);
+#endif
+}
+
+void WebRtcPeer::sendTiles(qint64 timestampUs) {
+#ifdef HOST_ENABLE_RTC
+    const auto channel = m_inputChannel;
+    if (!channel || !channel->isOpen()) {
+        return;
+    }
+    const TileCache::Result &tiles = m_videoSender->lastTiles();
+    QJsonObject message;
+    message.insert(QStringLiteral("t"), QLatin1String(protocol::json::kTiles));
+    message.insert(QLatin1String(protocol::json::kRtpTimestamp), rtpTimestampOf(timestampUs));
+    if (!tiles.stores.isEmpty()) {
+        message.insert(QLatin1String(protocol::json::kTileStore), tileRefsToJson(tiles.stores));
+    }
+    if (!tiles.draws.isEmpty()) {
+        message.insert(QLatin1String(protocol::json::kTileDraw), tileRefsToJson(tiles.draws));
+    }
+    channel->send(QJsonDocument(message).toJson(QJsonDocument::Compact).toStdString());
+#else
+    Q_UNUSED(timestampUs);
 #endif
 }
 
+void WebRtcPeer::pollTransportStats() {
+#ifdef HOST_ENABLE_RTC
+    if (!m_peer) {
+        return;
+    }
+    HostStats &stats = HostStats::instance();
+    int rttMs = -1;
+    if (const auto rtt = m_peer->rtt()) {
+        rttMs = static_cast<int>(rtt->count());
+        stats.set(HostStats::RttMs, rttMs);
+        if (m_videoSender) {
+            m_videoSender->setRttMs(rttMs);
+        }
+    }
+    if (m_audioSender) {
+        m_audioSender->updateNetwork(rttMs);
+    }
+    const auto bytesSent = static_cast<quint64>(m_peer->bytesSent());
+    if (bytesSent >= m_lastBytesSent) {
+        stats.add(HostStats::BytesSent, bytesSent - m_lastBytesSent);
+    }
+    m_lastBytesSent = bytesSent;
+    adaptBitrate();
+#endif
+}
+
+void WebRtcPeer::adaptBitrate() {
+    if (!m_videoSender || !m_pacer) {
+        // No video to yield to, so nothing may keep the files waiting.
+        m_fileTransfer->setThrottled(false);
+        return;
+    }
+    const qint64 queueMs = m_pacer->expectedQueueTimeUs() / 1000;
+    const int fractionLost = m_videoSender->fractionLost();
+    // File chunks wait while video is backing off; SCTP would otherwise keep taking its share.
+    m_fileTransfer->setThrottled(queueMs > kQueueBackoffMs || fractionLost > kLossBackoff);
+    int target = m_targetBitrateKbps;
+    if (queueMs > kQueueBackoffMs || fractionLost > kLossBackoff) {
+        target = qMax(kMinBitrateKbps, target * 85 / 100);
+    } else if (queueMs < kQueueClearMs && fractionLost < kLossClear) {
+        target = qMin(m_maxBitrateKbps, target * 105 / 100 + 10);
+    }
+    if (target == m_targetBitrateKbps) {
+        return;
+    }
+    m_targetBitrateKbps = target;
+    m_videoSender->setBitrate(target);
+    m_pacer->setBitrate(target);
+    HostStats::instance().set(HostStats::TargetBitrateKbps, target);
+}
+
+void WebRtcPeer::setupReplay() {
+    if (m_options.replayPath.isEmpty()) {
+        return;
+    }
+    auto replay = std::make_unique<SessionReplaySource>(this);
+    connect(replay.get(), &VideoSource::errorOccurred, this, [this](const QString &message) {
+        emit logLine(tr("Replay error: %1").arg(message));
+    });
+    if (!replay->open(m_options.replayPath)) {
+        emit logLine(tr("Falling back to live capture."));
+        return;
+    }
+    connect(replay.get(), &SessionReplaySource::inputEventReplayed, this, [this](const QJsonObject &event) {
+        if (m_inputInjector) {
+            m_inputInjector->handleInputEvent(event);
+        }
+    });
+    emit logLine(tr("Replaying %1: %2 frames, %3 input events")
+                     .arg(m_options.replayPath)
+                     .arg(replay->frameCount())
+                     .arg(replay->inputCount()));
+    m_videoCapture = std::move(replay);
+}
+
+void WebRtcPeer::setupRecording() {
+    if (m_options.recordPath.isEmpty() || m_recorder) {
+        return;
+    }
+    auto recorder = std::make_unique<SessionRecorder>();
+    if (!recorder->open(m_options.recordPath)) {
+        emit logLine(tr("Cannot record session to %1: %2").arg(m_options.recordPath, recorder->errorString()));
+        return;
+    }
+    m_recorder = std::move(recorder);
+    connect(m_videoCapture.get(), &VideoSource::frameCaptured, this,
+            [this](const QByteArray &pixels, PixelFormat format, int width, int height, qint64 timestampUs,
+                   const QVector<QRect> &dirtyRects) {
+                if (m_recorder) {
+                    m_recorder->writeFrame(pixels, format, width, height, timestampUs, dirtyRects);
+                }
+            });
+    emit logLine(tr("Recording session to %1").arg(m_options.recordPath));
+}
+
 void WebRtcPeer::handleSignal(const QJsonObject &payload) {
 #ifdef HOST_ENABLE_RTC
     if (!m_peer) {
@@ -107,6 +614,29 @@ void WebRtcPeer::handleSignal(const QJsonObject &payload) {
         const auto sdp = payload.value(QLatin1String(protocol::json::kSdp)).toObject();
         rtc::Description description(sdp.value(QStringLiteral("sdp")).toString().toStdString(), type.toStdString());
         m_peer->setRemoteDescription(description);
+        if (!m_videoTrack) {
+            setupVideoTrack(description);
+        }
+        if (!m_audioTrack) {
+            setupAudioTrack(description);
+        }
+        // Created after the remote offer so it joins the viewer's application
+        // m-line instead of triggering a renegotiation.
+        if (!m_motionChannel) {
+            rtc::DataChannelInit motionInit;
+            motionInit.negotiated = true;
+            motionInit.id = static_cast<std::uint16_t>(protocol::json::kMotionChannelId);
+            motionInit.reliability.unordered = true;
+            motionInit.reliability.maxRetransmits = 0;
+            attachInputChannel(m_peer->createDataChannel(protocol::json::kMotionChannelName, motionInit), true);
+        }
+        if (!m_fileChannel && m_fileTransfer->isEnabled()) {
+            rtc::DataChannelInit fileInit;
+            fileInit.negotiated = true;
+            fileInit.id = static_cast<std::uint16_t>(protocol::json::kFileChannelId);
+            attachFileChannel(m_peer->createDataChannel(protocol::json::kFileChannelName, fileInit));
+        }
+        // Only now, with every track and channel in place (auto-negotiation is off).
         auto answer = m_peer->createAnswer();
         rtc::LocalDescriptionInit init;
         init.sdp = std::string(answer);
@@ -142,6 +672,10 @@ void WebRtcPeer::createPeer() {
         }
         config.iceServers.push_back(ice);
     }
+    // handleSignal() adds the tracks and negotiated channels to the answer and
+    // sets it itself; left automatic, libdatachannel would answer inside
+    // setRemoteDescription() without them.
+    config.disableAutoNegotiation = true;
 
     m_peer = std::make_unique<rtc::PeerConnection>(config);
 
@@ -167,6 +701,11 @@ void WebRtcPeer::createPeer() {
             text = tr("Peer closed");
             break;
         }
+        if (m_inputInjector &&
+            (state == rtc::PeerConnection::State::Disconnected || state == rtc::PeerConnection::State::Failed ||
+             state == rtc::PeerConnection::State::Closed)) {
+            m_inputInjector->releaseHeldInput();
+        }
         emit stateChanged(text);
     });
 
@@ -195,19 +734,22 @@ void WebRtcPeer::createPeer() {
         if (!channel) {
             return;
         }
-        const QString label = QString::fromStdString(channel->label());
-        if (label != QString::fromUtf8(protocol::json::kDataChannelName)) {
-            return;
+        const std::string label = channel->label();
+        if (label == protocol::json::kDataChannelName) {
+            attachInputChannel(channel, false);
+        } else if (label == protocol::json::kMotionChannelName) {
+            attachInputChannel(channel, true);
+        } else if (label == protocol::json::kFileChannelName) {
+            // Accepted even with the channel disabled, to answer with an error.
+            QMetaObject::invokeMethod(
+                this,
+                [this, channel]() {
+                    if (m_peer) {
+                        attachFileChannel(channel);
+                    }
+                },
+                Qt::QueuedConnection);
         }
-        channel->onMessage([this](rtc::message_variant message) {
-            if (std::holds_alternative<std::string>(message)) {
-                const auto &text = std::get<std::string>(message);
-                const auto json = QJsonDocument::fromJson(QByteArray::fromStdString(text)).object();
-                if (m_inputInjector) {
-                    m_inputInjector->handleInputEvent(json);
-                }
-            }
-        });
     });
 
     if (m_inputInjector) {
@@ -218,12 +760,362 @@ void WebRtcPeer::createPeer() {
 #endif
 }
 
+#ifdef HOST_ENABLE_RTC
+void WebRtcPeer::attachInputChannel(const std::shared_ptr<rtc::DataChannel> &channel, bool motion) {
+    // Keep a reference: libdatachannel closes channels nobody holds.
+    (motion ? m_motionChannel : m_inputChannel) = channel;
+    channel->onMessage([this, motion](rtc::message_variant message) {
+        if (std::holds_alternative<std::string>(message)) {
+            handleInputMessage(QByteArray::fromStdString(std::get<std::string>(message)), motion);
+        }
+    });
+}
+
+void WebRtcPeer::attachFileChannel(const std::shared_ptr<rtc::DataChannel> &channel) {
+    m_fileChannel = channel;
+    std::weak_ptr<rtc::DataChannel> weakChannel = channel;
+    FileTransfer::Transport transport;
+    transport.send = [weakChannel](const QByteArray &message, bool binary) {
+        const auto channel = weakChannel.lock();
+        if (!channel || !channel->isOpen()) {
+            return false;
+        }
+        if (binary) {
+            channel->send(reinterpret_cast<const std::byte *>(message.constData()),
+                          static_cast<std::size_t>(message.size()));
+        } else {
+            channel->send(message.toStdString());
+        }
+        return true;
+    };
+    transport.bufferedAmount = [weakChannel]() -> qint64 {
+        const auto channel = weakChannel.lock();
+        return channel ? static_cast<qint64>(channel->bufferedAmount()) : 0;
+    };
+    m_fileTransfer->attach(std::move(transport));
+    channel->setBufferedAmountLowThreshold(static_cast<std::size_t>(m_fileTransfer->config().lowWatermarkBytes));
+    // Callbacks arrive on libdatachannel threads; the transfer and its files live on this one.
+    // The transfer is only dereferenced there, and may be gone by then: the
+    // call is queued on the application object, not on the transfer.
+    const QPointer<FileTransfer> transfer = m_fileTransfer.get();
+    channel->onMessage([transfer](rtc::message_variant message) {
+        const bool binary = std::holds_alternative<rtc::binary>(message);
+        QByteArray bytes;
+        if (binary) {
+            const rtc::binary &data = std::get<rtc::binary>(message);
+            bytes = QByteArray(reinterpret_cast<const char *>(data.data()), static_cast<int>(data.size()));
+        } else {
+            bytes = QByteArray::fromStdString(std::get<std::string>(message));
+        }
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [transfer, bytes, binary]() {
+                if (transfer) {
+                    transfer->handleMessage(bytes, binary);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+    channel->onBufferedAmountLow([transfer]() {
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [transfer]() {
+                if (transfer) {
+                    transfer->pump();
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void WebRtcPeer::setupVideoTrack(rtc::Description &offer) {
+    for (int i = 0; i < offer.mediaCount(); ++i) {
+        auto entry = offer.media(i);
+        auto **offered = std::get_if<rtc::Description::Media *>(&entry);
+        if (!offered || (*offered)->type() != "video") {
+            continue;
+        }
+        const VideoCodecChoice codecs = chooseVideoCodecs(**offered);
+        bool av1 = false;
+        bool fullChroma = false;
+        if (m_profile.codec == VideoEncoder::Codec::AV1) {
+            if (!VideoEncoder::isAvailable(VideoEncoder::Codec::AV1)) {
+                emit logLine(tr("AV1 requested but this build has no AV1 encoder; using H.264."));
+            } else if (codecs.av1 < 0) {
+                emit logLine(tr("Viewer offered no AV1; using H.264."));
+            } else {
+                av1 = true;
+            }
+        }
+        if (m_options.fullChroma) {
+            if (!VideoEncoder::isAvailable(VideoEncoder::Codec::AV1)) {
+                emit logLine(tr("4:4:4 needs AV1 and this build has no AV1 encoder; using 4:2:0."));
+            } else if (codecs.av1High < 0) {
+                emit logLine(tr("Viewer offered no AV1 High profile (profile=1); using 4:2:0."));
+            } else {
+                av1 = true;
+                fullChroma = true;
+            }
+        }
+        if (!av1 && codecs.h264 < 0) {
+            emit logLine(tr("Viewer offered no H.264 (packetization-mode=1); video disabled."));
+            return;
+        }
+        const int payloadType = fullChroma ? codecs.av1High : av1 ? codecs.av1 : codecs.h264;
+        const bool fec = codecs.red >= 0 && codecs.ulpfec >= 0;
+        const quint32 ssrc = QRandomGenerator::global()->generate();
+        rtc::Description::Video media((*offered)->mid(), rtc::Description::Direction::SendOnly);
+        if (fullChroma) {
+            media.addAV1Codec(codecs.av1High, codecs.av1HighFmtp);
+        } else if (av1) {
+            media.addAV1Codec(codecs.av1, codecs.av1Fmtp);
+        } else {
+            media.addH264Codec(codecs.h264, codecs.h264Fmtp);
+        }
+        if (fec) {
+            media.addVideoCodec(codecs.red, "red");
+            media.addVideoCodec(codecs.ulpfec, "ulpfec");
+        }
+        media.addSSRC(ssrc, std::string("host-video"), std::string("host"), std::string("host-video"));
+        // Same mid as the offer, so this answers the viewer's m-line rather than adding one.
+        m_videoTrack = m_peer->addTrack(media);
+
+        VideoSender::Config config;
+        config.pipeline.fps = m_profile.fps;
+        config.pipeline.threads = m_profile.threads;
+        config.pipeline.slices = m_options.slices;
+        config.pipeline.rtp.ssrc = ssrc;
+        config.pipeline.codec = av1 ? VideoEncoder::Codec::AV1 : VideoEncoder::Codec::H264;
+        config.pipeline.format = fullChroma ? PixelFormat::I444 : PixelFormat::I420;
+        config.pipeline.refineAfterMs = m_options.refineAfterMs;
+        config.pipeline.qualitySampleInterval = m_options.qualitySampleInterval;
+        config.pipeline.rtp.payloadType = static_cast<quint8>(payloadType);
+        if (fec) {
+            config.redPayloadType = codecs.red;
+            config.ulpfecPayloadType = codecs.ulpfec;
+        }
+        std::weak_ptr<rtc::Track> weakTrack = m_videoTrack;
+        PacedSender::Config pacing;
+        pacing.bitrateKbps = config.pipeline.bitrateKbps;
+        m_pacer = std::make_shared<PacedSender>(pacing, [weakTrack](const QByteArray &packet) {
+            const auto track = weakTrack.lock();
+            if (track && track->isOpen()) {
+                track->send(reinterpret_cast<const std::byte *>(packet.constData()),
+                            static_cast<std::size_t>(packet.size()));
+            }
+        });
+        m_maxBitrateKbps = config.pipeline.bitrateKbps;
+        m_targetBitrateKbps = m_maxBitrateKbps;
+        HostStats::instance().set(HostStats::TargetBitrateKbps, m_targetBitrateKbps);
+
+        auto sender = std::make_shared<VideoSender>();
+        // Weak: a retransmission answering RTCP may still run after destroyPeer() dropped the pacer.
+        std::weak_ptr<PacedSender> weakPacer = m_pacer;
+        if (!sender->initialize(config, [weakPacer](const QByteArray &packet, VideoSender::PacketKind kind) {
+                const auto pacer = weakPacer.lock();
+                if (!pacer) {
+                    return;
+                }
+                if (kind == VideoSender::PacketKind::Refinement) {
+                    pacer->enqueueReplaceable(packet);
+                } else {
+                    pacer->enqueue(kind == VideoSender::PacketKind::Retransmission
+                                       ? PacedSender::Priority::Retransmission
+                                       : PacedSender::Priority::Video,
+                                   packet);
+                }
+            })) {
+            // Closed and released before the answer is set, so it answers the m-line as rejected.
+            m_videoTrack->close();
+            m_videoTrack.reset();
+            m_pacer.reset();
+            emit logLine(tr("Video encoder did not start; video disabled."));
+            return;
+        }
+        // Incoming messages on a sending track are the viewer's RTCP.
+        std::weak_ptr<VideoSender> weakSender = sender;
+        m_videoTrack->onMessage([weakSender](rtc::message_variant message) {
+            const auto sender = weakSender.lock();
+            if (const auto *data = std::get_if<rtc::binary>(&message); sender && data) {
+                sender->handleRtcp(
+                    QByteArray(reinterpret_cast<const char *>(data->data()), static_cast<int>(data->size())));
+            }
+        });
+        m_videoSender = std::move(sender);
+        if (m_videoCapture) {
+            m_videoCapture->setPixelFormat(config.pipeline.format);
+        }
+        const QString codecName = fullChroma ? QStringLiteral("AV1 4:4:4")
+                                  : av1      ? QStringLiteral("AV1")
+                                             : QStringLiteral("H.264");
+        emit logLine(tr("Video track: %1/%2, %3")
+                         .arg(codecName)
+                         .arg(payloadType)
+                         .arg(fec ? tr("NACK + ULPFEC") : tr("NACK only (viewer offered no RED/ULPFEC)")));
+        return;
+    }
+}
+
+void WebRtcPeer::setupAudioTrack(rtc::Description &offer) {
+    for (int i = 0; i < offer.mediaCount(); ++i) {
+        auto entry = offer.media(i);
+        auto **offered = std::get_if<rtc::Description::Media *>(&entry);
+        if (!offered || (*offered)->type() != "audio") {
+            continue;
+        }
+        if (!AudioEncoder::isAvailable()) {
+            emit logLine(tr("This build has no Opus encoder; audio disabled."));
+            return;
+        }
+        const AudioCodecChoice codec = chooseAudioCodec(**offered);
+        if (codec.opus < 0) {
+            emit logLine(tr("Viewer offered no Opus; audio disabled."));
+            return;
+        }
+        const quint32 ssrc = QRandomGenerator::global()->generate();
+        rtc::Description::Audio media((*offered)->mid(), rtc::Description::Direction::SendOnly);
+        // sprop-stereo: desktop audio is stereo; the viewer decodes it whatever it prefers.
+        media.addOpusCodec(codec.opus, std::string("minptime=10;useinbandfec=1;sprop-stereo=1"));
+        media.addSSRC(ssrc, std::string("host-audio"), std::string("host"), std::string("host-audio"));
+        m_audioTrack = m_peer->addTrack(media);
+
+        AudioSender::Config config;
+        config.ssrc = ssrc;
+        config.payloadType = static_cast<quint8>(codec.opus);
+        config.fecAllowed = codec.inbandFec;
+        if (codec.maxPtime > 0) {
+            config.maxFrameMs = codec.maxPtime;
+        }
+        // Straight to the track rather than through the pacer: a few small
+        // packets that must not wait behind a key frame.
+        std::weak_ptr<rtc::Track> weakTrack = m_audioTrack;
+        auto sender = std::make_shared<AudioSender>();
+        if (!sender->initialize(config, [weakTrack](const QByteArray &packet) {
+                const auto track = weakTrack.lock();
+                if (track && track->isOpen()) {
+                    track->send(reinterpret_cast<const std::byte *>(packet.constData()),
+                                static_cast<std::size_t>(packet.size()));
+                }
+            })) {
+            m_audioTrack->close();
+            m_audioTrack.reset();
+            emit logLine(tr("Opus encoder did not start; audio disabled."));
+            return;
+        }
+        std::weak_ptr<AudioSender> weakSender = sender;
+        m_audioTrack->onMessage([weakSender](rtc::message_variant message) {
+            const auto sender = weakSender.lock();
+            if (const auto *data = std::get_if<rtc::binary>(&message); sender && data) {
+                sender->handleRtcp(
+                    QByteArray(reinterpret_cast<const char *>(data->data()), static_cast<int>(data->size())));
+            }
+        });
+        m_audioSender = std::move(sender);
+        emit logLine(tr("Audio track: Opus/%1, DTX, %2")
+                         .arg(codec.opus)
+                         .arg(codec.inbandFec ? tr("in-band FEC on loss") : tr("no FEC (viewer did not ask)")));
+        return;
+    }
+}
+#endif
+
+void WebRtcPeer::handleInputMessage(const QByteArray &message, bool motion) {
+    HOST_TRACE_SCOPE("datachannel.receive");
+    HostStats &stats = HostStats::instance();
+    stats.add(HostStats::InputEvents);
+    const QJsonObject json = QJsonDocument::fromJson(message).object();
+    // The motion channel is unordered and lossy; a move older than one already
+    // delivered would drag the pointer backwards.
+    const QJsonValue sequenceValue = json.value(QLatin1String(protocol::json::kSeq));
+    if (motion && !sequenceValue.isUndefined() && json.value("t").toString() == QStringLiteral("move")) {
+        const qint64 sequence = sequenceValue.toInteger();
+        qint64 last = m_lastMotionSequence.load(std::memory_order_relaxed);
+        do {
+            if (sequence <= last) {
+                stats.add(HostStats::InputMotionStale);
+                return;
+            }
+        } while (!m_lastMotionSequence.compare_exchange_weak(last, sequence, std::memory_order_relaxed));
+    }
+    if (json.value("t").toString() == QLatin1String(protocol::json::kCaps)) {
+        m_viewerCopyRect.store(json.value(QLatin1String(protocol::json::kCopyRect)).toBool(),
+                               std::memory_order_relaxed);
+        const qint64 tileCacheBytes = json.value(QLatin1String(protocol::json::kTileCache)).toInteger();
+        m_viewerTileCacheBytes.store(qMax<qint64>(0, tileCacheBytes), std::memory_order_relaxed);
+        return;
+    }
+    noteFocus(json);
+    if (!m_options.recordPath.isEmpty()) {
+        // stop() closes the recorder on its thread; write there too.
+        QMetaObject::invokeMethod(
+            this,
+            [this, message, timestampUs = captureClockUs()]() {
+                if (m_recorder) {
+                    m_recorder->writeInput(message, timestampUs);
+                }
+            },
+            Qt::QueuedConnection);
+    }
+    if (m_inputInjector) {
+        if (m_inputInjector->enabled()) {
+            m_captureGovernor.noteInput(captureClockUs());
+        }
+        m_inputInjector->handleInputEvent(json);
+    }
+}
+
+void WebRtcPeer::noteFocus(const QJsonObject &event) {
+    if (!m_roiMap.isEnabled()) {
+        return;
+    }
+    const QString type = event.value("t").toString();
+    const qint64 nowUs = captureClockUs();
+    if (type == QStringLiteral("move") || type == QStringLiteral("click") || type == QStringLiteral("wheel")) {
+        // Batched moves: only where the pointer ended up matters.
+        const QJsonArray points = event.value("points").toArray();
+        if (!points.isEmpty()) {
+            const QJsonArray last = points.last().toArray();
+            m_roiMap.notePointer(last.at(0).toDouble(), last.at(1).toDouble(), nowUs);
+        } else if (event.contains(QStringLiteral("x")) && event.contains(QStringLiteral("y"))) {
+            m_roiMap.notePointer(event.value("x").toDouble(), event.value("y").toDouble(), nowUs);
+        }
+    }
+    if (type == QStringLiteral("click") || type == QStringLiteral("key") || type == QStringLiteral("wheel")) {
+        m_roiMap.noteInput(nowUs);
+    }
+}
+
 void WebRtcPeer::destroyPeer() {
 #ifdef HOST_ENABLE_RTC
     if (!m_peer) {
         return;
     }
+    m_inputChannel.reset();
+    m_motionChannel.reset();
+    if (m_fileChannel) {
+        m_fileChannel->resetCallbacks();
+    }
+    m_fileChannel.reset();
+    m_fileTransfer->detach();
+    // No new RTCP callbacks once the senders go; one already running holds its own reference.
+    if (m_videoTrack) {
+        m_videoTrack->resetCallbacks();
+    }
+    m_videoTrack.reset();
+    if (m_audioTrack) {
+        m_audioTrack->resetCallbacks();
+    }
+    m_audioTrack.reset();
     m_peer.reset();
+    m_videoSender.reset();
+    m_audioSender.reset();
+    m_pacer.reset();
+    m_videoSendFailed = false;
+    m_audioSendFailed = false;
+    m_lastBytesSent = 0;
+    m_lastMotionSequence.store(-1, std::memory_order_relaxed);
+    m_viewerCopyRect.store(false, std::memory_order_relaxed);
+    m_viewerTileCacheBytes.store(0, std::memory_order_relaxed);
 #endif
 }
 
@@ -0,0 +1,131 @@
+#include "host/WorkerPool.h"
+
+#include "host/Trace.h"
+
+#include <algorithm>
+
+namespace host {
+
+WorkerPool::WorkerPool(int threads) {
+    const int total = threads > 0 ? threads : defaultThreadCount();
+    // The thread calling parallelFor() is the last participant.
+    for (int i = 1; i < total; ++i) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < static_cast<int>(m_queues.size()); ++i) {
+        m_workers.emplace_back(&WorkerPool::run, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+int WorkerPool::defaultThreadCount() {
+    const auto cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(cores, 1, kMaxAutoThreads);
+}
+
+void WorkerPool::parallelFor(int count, const std::function<void(int index)> &fn) {
+    if (count <= 0) {
+        return;
+    }
+    if (m_queues.empty() || count == 1) {
+        for (int i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    batch.remaining.store(count, std::memory_order_relaxed);
+    // Index 0 stays with the caller; the rest are dealt round-robin so every
+    // worker starts with local work.
+    const int workers = static_cast<int>(m_queues.size());
+    for (int i = 1; i < count; ++i) {
+        Queue &queue = *m_queues[static_cast<size_t>((i - 1) % workers)];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({&batch, i});
+    }
+    m_queued.fetch_add(count - 1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_all();
+
+    execute({&batch, 0});
+    Task task;
+    while (batch.remaining.load(std::memory_order_acquire) > 0 && steal(-1, task)) {
+        execute(task);
+    }
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch]() { return batch.remaining.load(std::memory_order_acquire) == 0; });
+}
+
+bool WorkerPool::popOwn(int self, Task &task) {
+    Queue &queue = *m_queues[static_cast<size_t>(self)];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool WorkerPool::steal(int thief, Task &task) {
+    const int workers = static_cast<int>(m_queues.size());
+    for (int offset = 1; offset <= workers; ++offset) {
+        const int victim = (thief + offset + workers) % workers;
+        if (victim == thief) {
+            continue;
+        }
+        Queue &queue = *m_queues[static_cast<size_t>(victim)];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::execute(const Task &task) {
+    (*task.batch->fn)(task.index);
+    Batch *batch = task.batch;
+    // The waiter destroys the batch as soon as it sees zero; decrementing under
+    // its mutex keeps this thread's last touch ahead of that.
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        batch->done.notify_one();
+    }
+}
+
+void WorkerPool::run(int self) {
+    trace::setThreadName("worker");
+    Task task;
+    for (;;) {
+        if (popOwn(self, task) || steal(self, task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_stopping) {
+            return;
+        }
+    }
+}
+
+}  // namespace host